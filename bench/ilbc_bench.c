@@ -0,0 +1,286 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_bench.c - Measure the speed of the iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+/*! \page ilbc_bench_page iLBC codec benchmark
+\section ilbc_bench_page_sec_1 What does it do?
+For each frame size mode it times encoding, decoding with and without the
+enhancer, and packet loss concealment, one frame per call. It reports the
+throughput, in frames per second, and the median and 99th percentile time
+for a single frame. If the library was configured with --enable-profile,
+the time spent in each stage of the codec is also given.
+
+The results are written to stdout as JSON. tier_check.sh uses them to check
+the AVX2 kernels really are faster than the SSE2 ones on this machine.
+
+\section ilbc_bench_page_sec_2 How is it used?
+ilbc_bench [-r <repeats>] [<infile>]
+
+<infile> is 16 bit 8000 samples/second raw speech, and defaults to
+../localtests/iLBC.INP. The whole file is processed <repeats> times (default 10).
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ilbc2.h"
+#include "ilbc_profile.h"
+
+#define IN_FILE_NAME            "../localtests/iLBC.INP"
+
+#define DEFAULT_REPEATS         10
+
+enum
+{
+    TEST_ENCODE = 0,
+    TEST_DECODE,
+    TEST_DECODE_ENHANCED,
+    TEST_FILLIN,
+    TESTS
+};
+
+static const char *test_names[TESTS] =
+{
+    "encode",
+    "decode",
+    "decode_enhanced",
+    "fillin"
+};
+
+typedef struct
+{
+    double frames_per_sec;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    int have_stages;
+    uint64_t stage_ns[ILBC_PROF_STAGES];
+} test_result_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x;
+    uint64_t y;
+
+    x = *(const uint64_t *) a;
+    y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int16_t *read_speech(const char *name, int *samples)
+{
+    FILE *f;
+    int16_t *amp;
+    long len;
+
+    if ((f = fopen(name, "rb")) == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    len = ftell(f)/sizeof(int16_t);
+    fseek(f, 0, SEEK_SET);
+    if (len <= 0  ||  (amp = (int16_t *) malloc(len*sizeof(int16_t))) == NULL)
+    {
+        fclose(f);
+        return NULL;
+    }
+    *samples = (int) fread(amp, sizeof(int16_t), len, f);
+    fclose(f);
+    return amp;
+}
+
+static void run_test(test_result_t *res,
+                     int test,
+                     int mode,
+                     const int16_t *amp,
+                     uint8_t *bytes,
+                     int16_t *out,
+                     int frames,
+                     int repeats,
+                     uint64_t *times)
+{
+    ilbc_encode_state_t enc;
+    ilbc_decode_state_t dec;
+    int blockl;
+    int no_of_bytes;
+    int n;
+    int r;
+    int i;
+    uint64_t t0;
+    uint64_t t1;
+    uint64_t total;
+
+    blockl = (mode == 20)  ?  ILBC_BLOCK_LEN_20MS  :  ILBC_BLOCK_LEN_30MS;
+    no_of_bytes = (mode == 20)  ?  ILBC_NO_OF_BYTES_20MS  :  ILBC_NO_OF_BYTES_30MS;
+    total = 0;
+    n = 0;
+    ilbc_profile_reset();
+    for (r = 0;  r < repeats;  r++)
+    {
+        if (test == TEST_ENCODE)
+            ilbc_encode_init(&enc, mode);
+        else
+            ilbc_decode_init(&dec, mode, test == TEST_DECODE_ENHANCED);
+        for (i = 0;  i < frames;  i++)
+        {
+            t0 = now_ns();
+            switch (test)
+            {
+            case TEST_ENCODE:
+                ilbc_encode(&enc, bytes + i*no_of_bytes, amp + i*blockl, blockl);
+                break;
+            case TEST_DECODE:
+            case TEST_DECODE_ENHANCED:
+                ilbc_decode(&dec, out + i*blockl, bytes + i*no_of_bytes, no_of_bytes);
+                break;
+            case TEST_FILLIN:
+                ilbc_fillin(&dec, out + i*blockl, no_of_bytes);
+                break;
+            }
+            t1 = now_ns();
+            times[n++] = t1 - t0;
+            total += t1 - t0;
+        }
+    }
+    res->have_stages = (ilbc_profile_read(res->stage_ns) == 0);
+    for (i = 0;  i < ILBC_PROF_STAGES;  i++)
+        res->stage_ns[i] /= n;
+    qsort(times, n, sizeof(times[0]), cmp_u64);
+    res->frames_per_sec = (total > 0)  ?  (double) n*1.0e9/(double) total  :  0.0;
+    res->p50_ns = times[n/2];
+    res->p99_ns = times[(int) ((int64_t) n*99/100)];
+}
+
+static void print_result(const test_result_t *res, const char *name, int last)
+{
+    int i;
+    int first;
+
+    printf("        \"%s\": {\"frames_per_sec\": %.1f, \"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64,
+           name,
+           res->frames_per_sec,
+           res->p50_ns,
+           res->p99_ns);
+    if (res->have_stages)
+    {
+        printf(", \"stage_ns_per_frame\": {");
+        first = 1;
+        for (i = 0;  i < ILBC_PROF_STAGES;  i++)
+        {
+            if (res->stage_ns[i] == 0)
+                continue;
+            printf("%s\"%s\": %" PRIu64, (first)  ?  ""  :  ", ", ilbc_profile_name(i), res->stage_ns[i]);
+            first = 0;
+        }
+        printf("}");
+    }
+    printf("}%s\n", (last)  ?  ""  :  ",");
+}
+
+int main(int argc, char *argv[])
+{
+    static const int modes[2] = {20, 30};
+    const char *in_file_name;
+    int16_t *amp;
+    int16_t *out;
+    uint8_t *bytes;
+    uint64_t *times;
+    test_result_t res;
+    ilbc_encode_state_t enc;
+    int samples;
+    int repeats;
+    int frames;
+    int blockl;
+    int m;
+    int test;
+    int opt;
+
+    repeats = DEFAULT_REPEATS;
+    while ((opt = getopt(argc, argv, "r:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            repeats = atoi(optarg);
+            if (repeats < 1)
+            {
+                fprintf(stderr, "Bad repeat count '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r <repeats>] [<infile>]\n", argv[0]);
+            exit(2);
+        }
+    }
+    in_file_name = (optind < argc)  ?  argv[optind]  :  IN_FILE_NAME;
+
+    if ((amp = read_speech(in_file_name, &samples)) == NULL)
+    {
+        fprintf(stderr, "Cannot read speech file '%s'\n", in_file_name);
+        exit(2);
+    }
+    frames = samples/ILBC_BLOCK_LEN_20MS;
+    bytes = (uint8_t *) malloc(frames*ILBC_NO_OF_BYTES_MAX);
+    out = (int16_t *) malloc(samples*sizeof(int16_t));
+    times = (uint64_t *) malloc((size_t) frames*repeats*sizeof(uint64_t));
+    if (bytes == NULL  ||  out == NULL  ||  times == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+
+    printf("{\n");
+    printf("    \"input\": \"%s\",\n", in_file_name);
+    printf("    \"repeats\": %d,\n", repeats);
+    printf("    \"cpu_tier\": \"%s\",\n", ilbc_cpu_tier_name(ilbc_cpu_tier()));
+    printf("    \"stage_timing\": %s,\n", (ilbc_profile_read(res.stage_ns) == 0)  ?  "true"  :  "false");
+    for (m = 0;  m < 2;  m++)
+    {
+        blockl = (modes[m] == 20)  ?  ILBC_BLOCK_LEN_20MS  :  ILBC_BLOCK_LEN_30MS;
+        frames = samples/blockl;
+        /* The decoding tests need a bit stream to work on */
+        ilbc_encode_init(&enc, modes[m]);
+        ilbc_encode(&enc, bytes, amp, frames*blockl);
+
+        printf("    \"%dms\": {\n", modes[m]);
+        for (test = 0;  test < TESTS;  test++)
+        {
+            run_test(&res, test, modes[m], amp, bytes, out, frames, repeats, times);
+            print_result(&res, test_names[test], test == TESTS - 1);
+        }
+        printf("    }%s\n", (m == 1)  ?  ""  :  ",");
+    }
+    printf("}\n");
+
+    free(times);
+    free(out);
+    free(bytes);
+    free(amp);
+    return 0;
+}
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,631 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_pareto.c - Weigh the speed of each codec configuration against
+ *                 the quality it gives.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+/*! \page ilbc_pareto_page iLBC speed against quality
+\section ilbc_pareto_page_sec_1 What does it do?
+For each frame size mode, it codes a speech file with every combination of
+encoder complexity level and decoder enhancer tier. For each, it reports
+the CPU time per frame to encode and to decode, and the quality of the
+result:
+
+    - the segmental SNR of the decoded speech against the input, after
+      allowing for the enhancer's delay.
+    - the fraction of frames whose bits differ from the reference bit
+      stream, iLBC_20ms.BIT or iLBC_30ms.BIT, when the input is the
+      reference input, iLBC.INP.
+    - the SNR of the decoded speech against the reference decoder output,
+      such as iLBC_20ms_clean.OUT, when there is one for the input and the
+      channel.
+    - optionally, the score from an external quality measure, such as PESQ
+      or POLQA.
+
+Each configuration which no other beats on both the time and the quality
+is marked as being on the Pareto front. The quality used for this is the
+external score when there is one, or else the segmental SNR.
+
+The results are written to stdout as JSON, or as a table with -t.
+
+\section ilbc_pareto_page_sec_2 How is it used?
+ilbc_pareto [-r <repeats>] [-c <channel file>] [-q <command>] [-t] [<infile>]
+
+<infile> is 16 bit 8000 samples/second raw speech, and defaults to
+../localtests/iLBC.INP. Each configuration is timed <repeats> times
+(default 5), and the fastest pass is used.
+
+<channel file> marks each frame as received (1) or lost (0), as 16 bit
+values, like ../localtests/tlm05.chn. Lost frames are concealed.
+
+<command> is run as "<command> <reference file> <degraded file>", with
+the input and the decoded speech as raw files, and the last number it
+prints is taken as its score.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ilbc2.h"
+
+#define IN_FILE_NAME            "../localtests/iLBC.INP"
+#define REF_DIR                 "../localtests"
+
+#define DEFAULT_REPEATS         5
+
+/* The longest delay looked for between the input and the decoded speech,
+   which only the enhancer adds */
+#define MAX_DELAY               (2*ILBC_BLOCK_LEN_MAX)
+
+/* Segmental SNR works in 10ms segments, leaves out silent ones, and keeps
+   each segment's SNR within the usual limits */
+#define SEG_LEN                 80
+#define SEG_MIN_ENERGY          1000.0
+#define SEG_SNR_MIN             -10.0
+#define SEG_SNR_MAX             35.0
+
+#define COMPLEXITIES            (ILBC_COMPLEXITY_LOWEST + 1)
+#define ENHANCERS               (ILBC_ENHANCER_MINIMAL + 1)
+#define CONFIGS                 (COMPLEXITIES*ENHANCERS)
+
+static const char *enhancer_names[ENHANCERS] =
+{
+    "off",
+    "full",
+    "lite",
+    "minimal"
+};
+
+typedef struct
+{
+    int complexity;
+    int enhancer;
+    double encode_us;
+    double decode_us;
+    int delay;
+    double seg_snr;
+    double bit_divergence;      /* < 0 with no reference bit stream */
+    double ref_snr;             /* with no reference output, not set */
+    int have_ref_snr;
+    double score;               /* from the external measure */
+    int have_score;
+    int pareto;
+} config_result_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static void *read_file(const char *name, long *len)
+{
+    FILE *f;
+    void *buf;
+
+    if ((f = fopen(name, "rb")) == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (*len <= 0  ||  (buf = malloc(*len)) == NULL)
+    {
+        fclose(f);
+        return NULL;
+    }
+    *len = (long) fread(buf, 1, *len, f);
+    fclose(f);
+    return buf;
+}
+
+static int write_file(const char *name, const void *buf, size_t len)
+{
+    FILE *f;
+    size_t n;
+
+    if ((f = fopen(name, "wb")) == NULL)
+        return -1;
+    n = fwrite(buf, 1, len, f);
+    fclose(f);
+    return (n == len)  ?  0  :  -1;
+}
+
+static int find_delay(const int16_t *ref, const int16_t *out, int len)
+{
+    double corr;
+    double best_corr;
+    int best;
+    int lag;
+    int i;
+
+    best = 0;
+    best_corr = 0.0;
+    for (lag = 0;  lag <= MAX_DELAY  &&  lag < len;  lag++)
+    {
+        corr = 0.0;
+        for (i = 0;  i + lag < len;  i++)
+            corr += (double) ref[i]*out[i + lag];
+        if (lag == 0  ||  corr > best_corr)
+        {
+            best_corr = corr;
+            best = lag;
+        }
+    }
+    return best;
+}
+
+static double seg_snr(const int16_t *ref, const int16_t *out, int len)
+{
+    double sig;
+    double err;
+    double snr;
+    double total;
+    int segs;
+    int i;
+    int j;
+
+    total = 0.0;
+    segs = 0;
+    for (i = 0;  i + SEG_LEN <= len;  i += SEG_LEN)
+    {
+        sig = 0.0;
+        err = 0.0;
+        for (j = i;  j < i + SEG_LEN;  j++)
+        {
+            sig += (double) ref[j]*ref[j];
+            err += ((double) out[j] - ref[j])*((double) out[j] - ref[j]);
+        }
+        if (sig < SEG_MIN_ENERGY*SEG_LEN)
+            continue;
+        snr = (err > 0.0)  ?  10.0*log10(sig/err)  :  SEG_SNR_MAX;
+        if (snr < SEG_SNR_MIN)
+            snr = SEG_SNR_MIN;
+        else if (snr > SEG_SNR_MAX)
+            snr = SEG_SNR_MAX;
+        total += snr;
+        segs++;
+    }
+    return (segs > 0)  ?  total/segs  :  0.0;
+}
+
+static double snr(const int16_t *ref, const int16_t *out, int len)
+{
+    double sig;
+    double err;
+    int i;
+
+    sig = 0.0;
+    err = 0.0;
+    for (i = 0;  i < len;  i++)
+    {
+        sig += (double) ref[i]*ref[i];
+        err += ((double) out[i] - ref[i])*((double) out[i] - ref[i]);
+    }
+    if (err <= 0.0)
+        return 99.0;
+    return 10.0*log10(sig/err);
+}
+
+/* Run an external quality measure, and take the last number it prints */
+static int external_score(const char *command, const int16_t *ref, const int16_t *out, int len, double *score)
+{
+    char ref_name[] = "/tmp/ilbc_pareto_refXXXXXX";
+    char out_name[] = "/tmp/ilbc_pareto_outXXXXXX";
+    char cmd[1024];
+    char line[256];
+    char *p;
+    char *end;
+    FILE *pipe;
+    double x;
+    int found;
+    int fd;
+
+    found = -1;
+    if ((fd = mkstemp(ref_name)) < 0)
+        return -1;
+    close(fd);
+    if ((fd = mkstemp(out_name)) < 0)
+    {
+        remove(ref_name);
+        return -1;
+    }
+    close(fd);
+    if (write_file(ref_name, ref, len*sizeof(int16_t)) == 0
+        &&
+        write_file(out_name, out, len*sizeof(int16_t)) == 0)
+    {
+        snprintf(cmd, sizeof(cmd), "%s %s %s", command, ref_name, out_name);
+        if ((pipe = popen(cmd, "r")))
+        {
+            while (fgets(line, sizeof(line), pipe))
+            {
+                for (p = line;  *p;  p++)
+                {
+                    x = strtod(p, &end);
+                    if (end != p)
+                    {
+                        *score = x;
+                        found = 0;
+                        p = end - 1;
+                    }
+                }
+            }
+            pclose(pipe);
+        }
+    }
+    remove(ref_name);
+    remove(out_name);
+    return found;
+}
+
+static void run_config(config_result_t *res,
+                       int mode,
+                       const int16_t *amp,
+                       int frames,
+                       const int16_t *chn,
+                       int repeats,
+                       const uint8_t *ref_bits,
+                       const int16_t *ref_out,
+                       const char *command,
+                       uint8_t *bytes,
+                       int16_t *out)
+{
+    ilbc_encode_state_t enc;
+    ilbc_decode_state_t dec;
+    uint64_t t0;
+    uint64_t best_enc;
+    uint64_t best_dec;
+    int blockl;
+    int no_of_bytes;
+    int differ;
+    int len;
+    int r;
+    int i;
+
+    blockl = (mode == 20)  ?  ILBC_BLOCK_LEN_20MS  :  ILBC_BLOCK_LEN_30MS;
+    no_of_bytes = (mode == 20)  ?  ILBC_NO_OF_BYTES_20MS  :  ILBC_NO_OF_BYTES_30MS;
+    best_enc = UINT64_MAX;
+    best_dec = UINT64_MAX;
+    for (r = 0;  r < repeats;  r++)
+    {
+        ilbc_encode_init(&enc, mode);
+        ilbc_encode_set_complexity(&enc, res->complexity);
+        t0 = now_ns();
+        for (i = 0;  i < frames;  i++)
+            ilbc_encode(&enc, bytes + i*no_of_bytes, amp + i*blockl, blockl);
+        t0 = now_ns() - t0;
+        if (t0 < best_enc)
+            best_enc = t0;
+
+        ilbc_decode_init(&dec, mode, res->enhancer);
+        t0 = now_ns();
+        for (i = 0;  i < frames;  i++)
+        {
+            if (chn  &&  chn[i] == 0)
+                ilbc_fillin(&dec, out + i*blockl, no_of_bytes);
+            else
+                ilbc_decode(&dec, out + i*blockl, bytes + i*no_of_bytes, no_of_bytes);
+        }
+        t0 = now_ns() - t0;
+        if (t0 < best_dec)
+            best_dec = t0;
+    }
+    res->encode_us = (double) best_enc/frames/1000.0;
+    res->decode_us = (double) best_dec/frames/1000.0;
+
+    len = frames*blockl;
+    res->delay = find_delay(amp, out, len);
+    res->seg_snr = seg_snr(amp, out + res->delay, len - res->delay);
+    res->bit_divergence = -1.0;
+    if (ref_bits)
+    {
+        differ = 0;
+        for (i = 0;  i < frames;  i++)
+        {
+            if (memcmp(bytes + i*no_of_bytes, ref_bits + i*no_of_bytes, no_of_bytes))
+                differ++;
+        }
+        res->bit_divergence = (double) differ/frames;
+    }
+    res->have_ref_snr = (ref_out != NULL);
+    if (ref_out)
+        res->ref_snr = snr(ref_out, out, len);
+    res->have_score = 0;
+    if (command)
+    {
+        /* The measure has to see the speech lined up with the input */
+        if (external_score(command, amp, out + res->delay, len - res->delay, &res->score) == 0)
+            res->have_score = 1;
+        else
+            fprintf(stderr, "No score from '%s'\n", command);
+    }
+}
+
+static double quality(const config_result_t *res)
+{
+    return (res->have_score)  ?  res->score  :  res->seg_snr;
+}
+
+static void mark_pareto(config_result_t res[], int n)
+{
+    double ci;
+    double cj;
+    double qi;
+    double qj;
+    int i;
+    int j;
+
+    for (i = 0;  i < n;  i++)
+    {
+        ci = res[i].encode_us + res[i].decode_us;
+        qi = quality(&res[i]);
+        res[i].pareto = 1;
+        for (j = 0;  j < n;  j++)
+        {
+            cj = res[j].encode_us + res[j].decode_us;
+            qj = quality(&res[j]);
+            if (j != i  &&  cj <= ci  &&  qj >= qi  &&  (cj < ci  ||  qj > qi))
+            {
+                res[i].pareto = 0;
+                break;
+            }
+        }
+    }
+}
+
+static void print_json(const config_result_t res[], int n, int mode, int last)
+{
+    int i;
+
+    printf("    \"%dms\": [\n", mode);
+    for (i = 0;  i < n;  i++)
+    {
+        printf("        {\"complexity\": %d, \"enhancer\": \"%s\", \"encode_us\": %.2f, \"decode_us\": %.2f, "
+               "\"delay\": %d, \"seg_snr_db\": %.2f",
+               res[i].complexity,
+               enhancer_names[res[i].enhancer],
+               res[i].encode_us,
+               res[i].decode_us,
+               res[i].delay,
+               res[i].seg_snr);
+        if (res[i].bit_divergence >= 0.0)
+            printf(", \"bit_divergence\": %.4f", res[i].bit_divergence);
+        if (res[i].have_ref_snr)
+            printf(", \"ref_snr_db\": %.2f", res[i].ref_snr);
+        if (res[i].have_score)
+            printf(", \"score\": %.3f", res[i].score);
+        printf(", \"pareto\": %s}%s\n", (res[i].pareto)  ?  "true"  :  "false", (i == n - 1)  ?  ""  :  ",");
+    }
+    printf("    ]%s\n", (last)  ?  ""  :  ",");
+}
+
+static void print_table(const config_result_t res[], int n, int mode)
+{
+    int i;
+
+    printf("%dms\n", mode);
+    printf("  cx  enhancer  enc us  dec us  segSNR  bits diff  ref SNR    score  pareto\n");
+    for (i = 0;  i < n;  i++)
+    {
+        printf("  %2d  %-8s %7.2f %7.2f  %6.2f", res[i].complexity, enhancer_names[res[i].enhancer],
+               res[i].encode_us, res[i].decode_us, res[i].seg_snr);
+        if (res[i].bit_divergence >= 0.0)
+            printf("  %8.2f%%", 100.0*res[i].bit_divergence);
+        else
+            printf("  %9s", "-");
+        if (res[i].have_ref_snr)
+            printf("  %7.2f", res[i].ref_snr);
+        else
+            printf("  %7s", "-");
+        if (res[i].have_score)
+            printf("  %7.3f", res[i].score);
+        else
+            printf("  %7s", "-");
+        printf("  %s\n", (res[i].pareto)  ?  "*"  :  "");
+    }
+    printf("\n");
+}
+
+/* Sort by the time taken, so the front reads from fastest to best */
+static int cmp_cost(const void *a, const void *b)
+{
+    const config_result_t *x;
+    const config_result_t *y;
+    double cx;
+    double cy;
+
+    x = (const config_result_t *) a;
+    y = (const config_result_t *) b;
+    cx = x->encode_us + x->decode_us;
+    cy = y->encode_us + y->decode_us;
+    return (cx > cy) - (cx < cy);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int modes[2] = {20, 30};
+    config_result_t res[CONFIGS];
+    const char *in_file_name;
+    const char *chn_file_name;
+    const char *command;
+    const char *chn_base;
+    const char *p;
+    char name[512];
+    int16_t *amp;
+    int16_t *out;
+    int16_t *chn;
+    int16_t *ref_out;
+    uint8_t *ref_bits;
+    uint8_t *bytes;
+    long len;
+    long ref_len;
+    int samples;
+    int chn_frames;
+    int repeats;
+    int table;
+    int frames;
+    int blockl;
+    int no_of_bytes;
+    int m;
+    int c;
+    int e;
+    int n;
+    int opt;
+
+    repeats = DEFAULT_REPEATS;
+    chn_file_name = NULL;
+    command = NULL;
+    table = 0;
+    while ((opt = getopt(argc, argv, "c:q:r:t")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            chn_file_name = optarg;
+            break;
+        case 'q':
+            command = optarg;
+            break;
+        case 'r':
+            repeats = atoi(optarg);
+            if (repeats < 1)
+            {
+                fprintf(stderr, "Bad repeat count '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 't':
+            table = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r <repeats>] [-c <channel file>] [-q <command>] [-t] [<infile>]\n", argv[0]);
+            exit(2);
+        }
+    }
+    in_file_name = (optind < argc)  ?  argv[optind]  :  IN_FILE_NAME;
+
+    if ((amp = (int16_t *) read_file(in_file_name, &len)) == NULL)
+    {
+        fprintf(stderr, "Cannot read speech file '%s'\n", in_file_name);
+        exit(2);
+    }
+    samples = (int) (len/sizeof(int16_t));
+    chn = NULL;
+    chn_frames = 0;
+    chn_base = "clean";
+    if (chn_file_name)
+    {
+        if ((chn = (int16_t *) read_file(chn_file_name, &len)) == NULL)
+        {
+            fprintf(stderr, "Cannot read channel file '%s'\n", chn_file_name);
+            exit(2);
+        }
+        chn_frames = (int) (len/sizeof(int16_t));
+        /* The reference outputs are named after the channel, as in iLBC_20ms_tlm05.OUT */
+        chn_base = ((p = strrchr(chn_file_name, '/')))  ?  (p + 1)  :  chn_file_name;
+    }
+    bytes = (uint8_t *) malloc((samples/ILBC_BLOCK_LEN_20MS + 1)*ILBC_NO_OF_BYTES_MAX);
+    out = (int16_t *) malloc((samples + 1)*sizeof(int16_t));
+    if (bytes == NULL  ||  out == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+
+    if (!table)
+    {
+        printf("{\n");
+        printf("    \"input\": \"%s\",\n", in_file_name);
+        if (chn_file_name)
+            printf("    \"channel\": \"%s\",\n", chn_file_name);
+        printf("    \"repeats\": %d,\n", repeats);
+        printf("    \"cpu_tier\": \"%s\",\n", ilbc_cpu_tier_name(ilbc_cpu_tier()));
+    }
+    for (m = 0;  m < 2;  m++)
+    {
+        blockl = (modes[m] == 20)  ?  ILBC_BLOCK_LEN_20MS  :  ILBC_BLOCK_LEN_30MS;
+        no_of_bytes = (modes[m] == 20)  ?  ILBC_NO_OF_BYTES_20MS  :  ILBC_NO_OF_BYTES_30MS;
+        frames = samples/blockl;
+        if (chn  &&  chn_frames < frames)
+            frames = chn_frames;
+
+        /* The reference files only match the reference input */
+        ref_bits = NULL;
+        ref_out = NULL;
+        if (optind >= argc)
+        {
+            snprintf(name, sizeof(name), "%s/iLBC_%dms.BIT", REF_DIR, modes[m]);
+            if ((ref_bits = (uint8_t *) read_file(name, &ref_len))  &&  ref_len < (long) frames*no_of_bytes)
+            {
+                free(ref_bits);
+                ref_bits = NULL;
+            }
+            snprintf(name, sizeof(name), "%s/iLBC_%dms_%.*s.OUT", REF_DIR, modes[m], (int) strcspn(chn_base, "."), chn_base);
+            if ((ref_out = (int16_t *) read_file(name, &ref_len))  &&  ref_len < (long) frames*blockl*(long) sizeof(int16_t))
+            {
+                free(ref_out);
+                ref_out = NULL;
+            }
+        }
+
+        n = 0;
+        for (c = 0;  c < COMPLEXITIES;  c++)
+        {
+            for (e = 0;  e < ENHANCERS;  e++)
+            {
+                res[n].complexity = c;
+                res[n].enhancer = e;
+                /* The reference output is only for the reference decoder */
+                run_config(&res[n],
+                           modes[m],
+                           amp,
+                           frames,
+                           chn,
+                           repeats,
+                           (c == ILBC_COMPLEXITY_FULL)  ?  ref_bits  :  NULL,
+                           (e == ILBC_ENHANCER_FULL)  ?  ref_out  :  NULL,
+                           command,
+                           bytes,
+                           out);
+                n++;
+            }
+        }
+        mark_pareto(res, n);
+        qsort(res, n, sizeof(res[0]), cmp_cost);
+        if (table)
+            print_table(res, n, modes[m]);
+        else
+            print_json(res, n, modes[m], m == 1);
+        free(ref_bits);
+        free(ref_out);
+    }
+    if (!table)
+        printf("}\n");
+
+    free(chn);
+    free(out);
+    free(bytes);
+    free(amp);
+    return 0;
+}
+/*- End of file ------------------------------------------------------------*/
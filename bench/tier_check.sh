@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# iLBC - a library for the iLBC codec
+#
+# tier_check.sh
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2, as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+
+# cpuDispatch prefers the AVX2 kernels wherever the CPU has them, so check
+# they really are faster than the SSE2 ones here. Mixing VEX and legacy SSE
+# code without a vzeroupper, for one, can make them much slower. The median
+# frame times of every test in ilbc_bench are added up for each tier, and
+# AVX2 fails if it is more than 3% slower, which is about the timing noise.
+# Run this from the bench directory of a built tree.
+
+REPEATS=${REPEATS:-10}
+IN_FILE=${1:-../localtests/iLBC.INP}
+
+total_p50()
+{
+    ILBC_CPU_TIER=$1 ./ilbc_bench -r $REPEATS $IN_FILE | awk '
+        /"cpu_tier"/ { gsub(/[",]/, "", $2); tier = $2 }
+        { while (match($0, /"p50_ns": [0-9]+/)) { s += substr($0, RSTART + 10, RLENGTH - 10); $0 = substr($0, RSTART + RLENGTH) } }
+        END { print tier, s }'
+}
+
+set -- `total_p50 sse2`
+SSE2_TIER=$1
+SSE2_NS=$2
+set -- `total_p50 avx2`
+AVX2_TIER=$1
+AVX2_NS=$2
+if [ "$SSE2_TIER" != sse2 ]  ||  [ "$AVX2_TIER" != avx2 ]
+then
+    echo This CPU does not have both SSE2 and AVX2, so there is nothing to compare
+    exit 0
+fi
+echo SSE2 ${SSE2_NS}ns, AVX2 ${AVX2_NS}ns, for one frame of every test
+if [ `expr $AVX2_NS \* 100` -gt `expr $SSE2_NS \* 103` ]
+then
+    echo The AVX2 kernels are slower than the SSE2 ones!
+    exit 1
+fi
+echo The AVX2 kernels are not slower than the SSE2 ones
@@ -33,22 +33,6 @@
 #include "constants.h"
 #include "LPCdecode.h"
 
-/*---------------------------------------------------------------*
- *  interpolation of lsf coefficients for the decoder
- *--------------------------------------------------------------*/
-
-void LSFinterpolate2a_dec(float *a,         /* (o) lpc coefficients for a sub-frame */
-                          float *lsf1,      /* (i) first lsf coefficient vector */
-                          float *lsf2,      /* (i) second lsf coefficient vector */
-                          float coef,       /* (i) interpolation weight */
-                          int length)       /* (i) length of lsf vectors */
-{
-    float  lsftmp[ILBC_LPC_FILTERORDER];
-
-    interpolate(lsftmp, lsf1, lsf2, coef, length);
-    lsf2a(a, lsftmp);
-}
-
 /*---------------------------------------------------------------*
  *  obtain dequantized lsf coefficients from quantization index
  *--------------------------------------------------------------*/
@@ -92,58 +76,20 @@ void SimplelsfDEQ(float *lsfdeq,        /* (o) dequantized lsf coefficients */
 }
 
 /*----------------------------------------------------------------*
- *  obtain synthesis and weighting filters form lsf coefficients
+ *  obtain the synthesis filters from the lsf coefficients. The
+ *  decoder has no use for the weighting filters.
  *---------------------------------------------------------------*/
 
 void DecoderInterpolateLSF(float *syntdenum,                    /* (o) synthesis filter coefficients */
-                           float *weightdenum,                  /* (o) weighting denumerator coefficients */
                            float *lsfdeq,                       /* (i) dequantized lsf coefficients */
                            int length,                          /* (i) length of lsf coefficient vector */
                            ilbc_decode_state_t *iLBCdec_inst)   /* (i) the decoder state structure */
 {
-    int i;
-    int pos;
-    int lp_length;
-    float lp[ILBC_LPC_FILTERORDER + 1];
-    float *lsfdeq2;
-
-    lsfdeq2 = lsfdeq + length;
-    lp_length = length + 1;
-
-    if (iLBCdec_inst->mode == 30)
-    {
-        /* sub-frame 1: Interpolation between old and first */
-
-        LSFinterpolate2a_dec(lp, iLBCdec_inst->lsfdeqold, lsfdeq,
-                             lsf_weightTbl_30ms[0], length);
-        memcpy(syntdenum,lp,lp_length*sizeof(float));
-        bwexpand(weightdenum, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-
-        /* sub-frames 2 to 6: interpolation between first and last LSF */
-        pos = lp_length;
-        for (i = 1;  i < 6;  i++)
-        {
-            LSFinterpolate2a_dec(lp, lsfdeq, lsfdeq2, lsf_weightTbl_30ms[i], length);
-            memcpy(syntdenum + pos,lp,lp_length*sizeof(float));
-            bwexpand(weightdenum + pos, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-            pos += lp_length;
-        }
-    }
-    else
-    {
-        pos = 0;
-        for (i = 0;  i < iLBCdec_inst->nsub;  i++)
-        {
-            LSFinterpolate2a_dec(lp, iLBCdec_inst->lsfdeqold, lsfdeq, lsf_weightTbl_20ms[i], length);
-            memcpy(syntdenum + pos, lp, lp_length*sizeof(float));
-            bwexpand(weightdenum + pos, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-            pos += lp_length;
-        }
-    }
+    lsfInterpolate2aFrame(syntdenum, iLBCdec_inst->lsfdeqold, lsfdeq, iLBCdec_inst->mode, &iLBCdec_inst->lsfdeq_memo);
 
     /* update memory */
     if (iLBCdec_inst->mode == 30)
-        memcpy(iLBCdec_inst->lsfdeqold, lsfdeq2, length*sizeof(float));
+        memcpy(iLBCdec_inst->lsfdeqold, lsfdeq + length, length*sizeof(float));
     else
         memcpy(iLBCdec_inst->lsfdeqold, lsfdeq, length*sizeof(float));
 }
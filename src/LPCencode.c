@@ -42,54 +42,36 @@ static void SimpleAnalysis(float *lsf,                         /* (o) lsf coeffi
 {
     int k;
     int is;
-    float temp[ILBC_BLOCK_LEN_MAX];
+    float refl[ILBC_LPC_FILTERORDER];
     float lp[ILBC_LPC_FILTERORDER + 1];
     float lp2[ILBC_LPC_FILTERORDER + 1];
-    float r[ILBC_LPC_FILTERORDER + 1];
+    float r[LPC_N_MAX][ILBC_LPC_FILTERORDER + 1];
 
+    /* The windows run from the end of the last frame, held in lpc_buffer,
+       on into the new data */
     is = LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - iLBCenc_inst->blockl;
-    memcpy(iLBCenc_inst->lpc_buffer + is, data, iLBCenc_inst->blockl*sizeof(float));
 
     /* No lookahead, last window is asymmetric */
+    if (iLBCenc_inst->lpc_n > 1)
+        windowAutocorrSplit(r[0], iLBCenc_inst->lpc_buffer, is, data, lpc_winTbl, ILBC_BLOCK_LEN_MAX);
+    windowAutocorrSplit(r[iLBCenc_inst->lpc_n - 1],
+                        iLBCenc_inst->lpc_buffer + LPC_LOOKBACK,
+                        is - LPC_LOOKBACK,
+                        data,
+                        lpc_asymwinTbl,
+                        ILBC_BLOCK_LEN_MAX);
 
     for (k = 0;  k < iLBCenc_inst->lpc_n;  k++)
     {
-        is = LPC_LOOKBACK;
-
-        if (k < (iLBCenc_inst->lpc_n - 1))
-            window(temp, lpc_winTbl, iLBCenc_inst->lpc_buffer, ILBC_BLOCK_LEN_MAX);
-        else
-            window(temp, lpc_asymwinTbl, iLBCenc_inst->lpc_buffer + is, ILBC_BLOCK_LEN_MAX);
+        window(r[k], r[k], lpc_lagwinTbl, ILBC_LPC_FILTERORDER + 1);
 
-        autocorr(r, temp, ILBC_BLOCK_LEN_MAX, ILBC_LPC_FILTERORDER);
-        window(r, r, lpc_lagwinTbl, ILBC_LPC_FILTERORDER + 1);
-
-        levdurb(lp, temp, r, ILBC_LPC_FILTERORDER);
+        levdurb(lp, refl, r[k], ILBC_LPC_FILTERORDER);
         bwexpand(lp2, lp, LPC_CHIRP_SYNTDENUM, ILBC_LPC_FILTERORDER + 1);
 
         a2lsf(lsf + k*ILBC_LPC_FILTERORDER, lp2);
     }
-    is = LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - iLBCenc_inst->blockl;
-    memmove(iLBCenc_inst->lpc_buffer,
-            iLBCenc_inst->lpc_buffer + LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - is,
-            is*sizeof(float));
-}
-
-/*----------------------------------------------------------------*
- *  lsf interpolator and conversion from lsf to a coefficients
- *  (subroutine to SimpleInterpolateLSF)
- *---------------------------------------------------------------*/
-
-static void LSFinterpolate2a_enc(float *a,     /* (o) lpc coefficients */
-                                 float *lsf1,  /* (i) first set of lsf coefficients */
-                                 float *lsf2,  /* (i) second set of lsf coefficients */
-                                 float coef,   /* (i) weighting coefficient to use between lsf1 and lsf2 */
-                                 long length)  /* (i) length of coefficient vectors */
-{
-    float  lsftmp[ILBC_LPC_FILTERORDER];
-
-    interpolate(lsftmp, lsf1, lsf2, coef, length);
-    lsf2a(a, lsftmp);
+    /* A frame is never shorter than the history, so it is all new data */
+    memcpy(iLBCenc_inst->lpc_buffer, data + iLBCenc_inst->blockl - is, is*sizeof(float));
 }
 
 /*----------------------------------------------------------------*
@@ -111,59 +93,18 @@ static void SimpleInterpolateLSF(float *syntdenum,                     /* (o) th
                                  int length,                           /* (i) should equate ILBC_LPC_FILTERORDER */
                                  ilbc_encode_state_t *iLBCenc_inst)    /* (i/o) the encoder state structure */
 {
-    int i;
-    int pos;
-    int lp_length;
-    float lp[ILBC_LPC_FILTERORDER + 1];
-    float *lsf2;
-    float *lsfdeq2;
+    float lp[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
 
-    lsf2 = lsf + length;
-    lsfdeq2 = lsfdeq + length;
-    lp_length = length + 1;
-
-    if (iLBCenc_inst->mode == 30)
-    {
-        /* sub-frame 1: Interpolation between old and first
-           set of lsf coefficients */
-
-        LSFinterpolate2a_enc(lp, lsfdeqold, lsfdeq, lsf_weightTbl_30ms[0], length);
-        memcpy(syntdenum,lp,lp_length*sizeof(float));
-        LSFinterpolate2a_enc(lp, lsfold, lsf, lsf_weightTbl_30ms[0], length);
-        bwexpand(weightdenum, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-
-        /* sub-frame 2 to 6: Interpolation between first
-           and second set of lsf coefficients */
-
-        pos = lp_length;
-        for (i = 1; i < iLBCenc_inst->nsub; i++)
-        {
-            LSFinterpolate2a_enc(lp, lsfdeq, lsfdeq2, lsf_weightTbl_30ms[i], length);
-            memcpy(syntdenum + pos,lp,lp_length*sizeof(float));
-            LSFinterpolate2a_enc(lp, lsf, lsf2, lsf_weightTbl_30ms[i], length);
-            bwexpand(weightdenum + pos, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-            pos += lp_length;
-        }
-    }
-    else
-    {
-        pos = 0;
-        for (i = 0; i < iLBCenc_inst->nsub; i++)
-        {
-            LSFinterpolate2a_enc(lp, lsfdeqold, lsfdeq, lsf_weightTbl_20ms[i], length);
-            memcpy(syntdenum + pos, lp, lp_length*sizeof(float));
-            LSFinterpolate2a_enc(lp, lsfold, lsf, lsf_weightTbl_20ms[i], length);
-            bwexpand(weightdenum + pos, lp, LPC_CHIRP_WEIGHTDENUM, lp_length);
-            pos += lp_length;
-        }
-    }
+    lsfInterpolate2aFrame(syntdenum, lsfdeqold, lsfdeq, iLBCenc_inst->mode, &iLBCenc_inst->lsfdeq_memo);
+    lsfInterpolate2aFrame(lp, lsfold, lsf, iLBCenc_inst->mode, &iLBCenc_inst->lsf_memo);
+    bwexpandFrame(weightdenum, lp, LPC_CHIRP_WEIGHTDENUM, length + 1, iLBCenc_inst->nsub);
 
     /* update memory */
 
     if (iLBCenc_inst->mode == 30)
     {
-        memcpy(lsfold, lsf2, length*sizeof(float));
-        memcpy(lsfdeqold, lsfdeq2, length*sizeof(float));
+        memcpy(lsfold, lsf + length, length*sizeof(float));
+        memcpy(lsfdeqold, lsfdeq + length, length*sizeof(float));
     }
     else
     {
@@ -182,7 +123,7 @@ static void SimplelsfQ(float *lsfdeq,  /* (o) dequantized lsf coefficients (dime
                        int lpc_n)      /* (i) number of lsf sets to quantize */
 {
     /* Quantize first LSF with memoryless split VQ */
-    SplitVQ(lsfdeq, index, lsf, lsfCbTbl, LSF_NSPLIT, dim_lsfCbTbl, size_lsfCbTbl);
+    SplitVQ(lsfdeq, index, lsf, lsfCbTransTbl, LSF_NSPLIT, dim_lsfCbTbl, size_lsfCbTbl);
 
     if (lpc_n == 2)
     {
@@ -190,7 +131,7 @@ static void SimplelsfQ(float *lsfdeq,  /* (o) dequantized lsf coefficients (dime
         SplitVQ(lsfdeq + ILBC_LPC_FILTERORDER,
                 index + LSF_NSPLIT,
                 lsf + ILBC_LPC_FILTERORDER,
-                lsfCbTbl,
+                lsfCbTransTbl,
                 LSF_NSPLIT,
                 dim_lsfCbTbl,
                 size_lsfCbTbl);
@@ -227,3 +168,32 @@ void LPCencode(float *syntdenum,                    /* (i/o) synthesis filter co
                          ILBC_LPC_FILTERORDER,
                          iLBCenc_inst);
 }
+
+/*----------------------------------------------------------------*
+ *  lpc analysis of a frame which is not coded, such as silence
+ *  sent as comfort noise. The history is kept up to date, so
+ *  coding picks up smoothly afterwards.
+ *---------------------------------------------------------------*/
+
+void LPCencodeSilence(float *k,                            /* (o) reflection coefficients */
+                      float *data,                         /* (i) new data vector */
+                      ilbc_encode_state_t *iLBCenc_inst)   /* (i/o) the encoder state structure */
+{
+    int is;
+    float lp[ILBC_LPC_FILTERORDER + 1];
+    float r[ILBC_LPC_FILTERORDER + 1];
+
+    is = LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - iLBCenc_inst->blockl;
+
+    /* One analysis, with the window used for the end of a coded frame */
+    windowAutocorrSplit(r,
+                        iLBCenc_inst->lpc_buffer + LPC_LOOKBACK,
+                        is - LPC_LOOKBACK,
+                        data,
+                        lpc_asymwinTbl,
+                        ILBC_BLOCK_LEN_MAX);
+    window(r, r, lpc_lagwinTbl, ILBC_LPC_FILTERORDER + 1);
+    levdurb(lp, k, r, ILBC_LPC_FILTERORDER);
+
+    memcpy(iLBCenc_inst->lpc_buffer, data + iLBCenc_inst->blockl - is, is*sizeof(float));
+}
@@ -28,4 +28,8 @@ void LPCencode(float *syntdenum,                    /* (i/o) synthesis filter co
                float *data,                         /* (i) lsf coefficients to quantize */
                ilbc_encode_state_t *iLBCenc_inst);  /* (i/o) the encoder state structure */
 
+void LPCencodeSilence(float *k,                            /* (o) reflection coefficients */
+                      float *data,                         /* (i) new data vector */
+                      ilbc_encode_state_t *iLBCenc_inst);  /* (i/o) the encoder state structure */
+
 #endif
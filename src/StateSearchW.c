@@ -30,16 +30,35 @@
 #include "ilbc2.h"
 #include "constants.h"
 #include "filter.h"
-#include "helpfun.h"
 #include "StateSearchW.h"
 
+/*----------------------------------------------------------------*
+ *  scalar quantization, by counting the decision thresholds below
+ *  the value. This gives the same index as sort_sq(), without a
+ *  search whose length depends on the value.
+ *---------------------------------------------------------------*/
+
+static int thresholdQuant(float x,                  /* (i) the value to quantize */
+                          const float *thresholds,  /* (i) the decision thresholds, in increasing order */
+                          int n)                    /* (i) the number of thresholds, including any padding */
+{
+    int index;
+    int i;
+
+    index = 0;
+    for (i = 0;  i < n;  i++)
+        index += (x > thresholds[i]);
+    return index;
+}
+
 /*----------------------------------------------------------------*
  *  predictive noise shaping encoding of scaled start state
  *  (subrutine for StateSearchW)
  *---------------------------------------------------------------*/
 
 void AbsQuantW(ilbc_encode_state_t *iLBCenc_inst,   /* (i) Encoder instance */
-               float *in,                           /* (i) vector to encode */
+               float *in,                           /* (i) vector to encode. in[-ILBC_LPC_FILTERORDER] to
+                                                           in[-1] are the weighting filter's state */
                float *syntDenum,                    /* (i) denominator of synthesis filter */
                float *weightDenum,                  /* (i) denominator of weighting filter */
                int *out,                            /* (o) vector of quantizer indexes */
@@ -47,65 +66,63 @@ void AbsQuantW(ilbc_encode_state_t *iLBCenc_inst,   /* (i) Encoder instance */
                                                            vector of quantizer indexes */
                int state_first)                     /* (i) position of start state in the 80 vec */
 {
-    float *syntOut;
-    float syntOutBuf[ILBC_LPC_FILTERORDER + STATE_SHORT_LEN_30MS];
-    float toQ;
+    float inMem[ILBC_LPC_FILTERORDER];
+    float outMem[ILBC_LPC_FILTERORDER];
+    float x;
+    float pred;
     float xq;
+    int split;
     int n;
+    int k;
     int index;
 
-    /* initialization of buffer for filtering */
-    memset(syntOutBuf, 0, ILBC_LPC_FILTERORDER*sizeof(float));
+    /* The weighting filter runs over the input, and over the synthesized
+       and weighted output fed back, a sample at a time. Both filters'
+       states are kept here, newest sample first. The input's filter does
+       not depend on the quantization, so its work overlaps the feedback
+       loop's. */
+    for (k = 0;  k < ILBC_LPC_FILTERORDER;  k++)
+        inMem[k] = in[-1 - k];
+    memset(outMem, 0, sizeof(outMem));
 
-    /* initialization of pointer for filtering */
-    syntOut = &syntOutBuf[ILBC_LPC_FILTERORDER];
-
-    /* synthesis and weighting filters on input */
-    if (state_first)
-    {
-        AllPoleFilter(in, weightDenum, SUBL, ILBC_LPC_FILTERORDER);
-    }
-    else
-    {
-        AllPoleFilter(in, weightDenum,
-                      iLBCenc_inst->state_short_len - SUBL,
-                      ILBC_LPC_FILTERORDER);
-    }
+    /* The filters change at the subframe boundary */
+    split = (state_first)  ?  SUBL  :  iLBCenc_inst->state_short_len - SUBL;
 
     /* encoding loop */
     for (n = 0;  n < len;  n++)
     {
         /* time update of filter coefficients */
-        if ((state_first)  &&  (n == SUBL))
+        if (n == split)
         {
             syntDenum += (ILBC_LPC_FILTERORDER + 1);
             weightDenum += (ILBC_LPC_FILTERORDER + 1);
-
-            /* synthesis and weighting filters on input */
-            AllPoleFilter(&in[n], weightDenum, len - n, ILBC_LPC_FILTERORDER);
         }
-        else if ((state_first == 0)
-                 &&
-                 (n == (iLBCenc_inst->state_short_len - SUBL)))
-        {
-            syntDenum += (ILBC_LPC_FILTERORDER + 1);
-            weightDenum += (ILBC_LPC_FILTERORDER + 1);
 
-            /* synthesis and weighting filters on input */
-            AllPoleFilter(&in[n], weightDenum, len - n, ILBC_LPC_FILTERORDER);
-        }
+        /* synthesis and weighting filters on input */
+        x = in[n];
+        for (k = 0;  k < ILBC_LPC_FILTERORDER;  k++)
+            x -= weightDenum[k + 1]*inMem[k];
+        for (k = ILBC_LPC_FILTERORDER - 1;  k > 0;  k--)
+            inMem[k] = inMem[k - 1];
+        inMem[0] = x;
+        in[n] = x;
+
         /* prediction of synthesized and weighted input */
-        syntOut[n] = 0.0f;
-        AllPoleFilter(&syntOut[n], weightDenum, 1, ILBC_LPC_FILTERORDER);
+        pred = 0.0f;
+        for (k = 0;  k < ILBC_LPC_FILTERORDER;  k++)
+            pred -= weightDenum[k + 1]*outMem[k];
 
         /* quantization */
-        toQ = in[n] - syntOut[n];
-        sort_sq(&xq, &index, toQ, state_sq3Tbl, 8);
+        index = thresholdQuant(x - pred, state_sq3ThrTbl, 8);
         out[n] = index;
-        syntOut[n] = state_sq3Tbl[out[n]];
 
         /* update of the prediction filter */
-        AllPoleFilter(&syntOut[n], weightDenum, 1, ILBC_LPC_FILTERORDER);
+        xq = state_sq3Tbl[index];
+        for (k = 0;  k < ILBC_LPC_FILTERORDER;  k++)
+            xq -= weightDenum[k + 1]*outMem[k];
+        for (k = ILBC_LPC_FILTERORDER - 1;  k > 0;  k--)
+            outMem[k] = outMem[k - 1];
+        outMem[0] = xq;
     }
 }
 
@@ -123,7 +140,6 @@ void StateSearchW(ilbc_encode_state_t *iLBCenc_inst,    /* (i) Encoder instance
                   int len,                              /* (i) length of all vectors */
                   int state_first)                      /* (i) position of start state in the 80 vec */
 {
-    float dtmp;
     float maxVal;
     float tmpbuf[ILBC_LPC_FILTERORDER + 2*STATE_SHORT_LEN_30MS];
     float *tmp;
@@ -164,7 +180,7 @@ void StateSearchW(ilbc_encode_state_t *iLBCenc_inst,    /* (i) Encoder instance
     if (maxVal < 10.0f)
         maxVal = 10.0f;
     maxVal = log10f(maxVal);
-    sort_sq(&dtmp, idxForMax, maxVal, state_frgqTbl, 64);
+    *idxForMax = thresholdQuant(maxVal, state_frgqThrTbl, 64);
 
     /* decoding of the maximum amplitude representation value,
        and corresponding scaling of start state */
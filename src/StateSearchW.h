@@ -21,7 +21,8 @@
 #define __iLBC_STATESEARCHW_H
 
 void AbsQuantW(ilbc_encode_state_t *iLBCenc_inst,   /* (i) Encoder instance */
-               float *in,                           /* (i) vector to encode */
+               float *in,                           /* (i) vector to encode. in[-ILBC_LPC_FILTERORDER] to
+                                                           in[-1] are the weighting filter's state */
                float *syntDenum,                    /* (i) denominator of synthesis filter */
                float *weightDenum,                  /* (i) denominator of weighting filter */
                int *out,                            /* (o) vector of quantizer indexes */
@@ -28,99 +28,25 @@
 #include "ilbc2.h"
 #include "constants.h"
 
-/* ULP bit allocation */
+/* The tables are grouped by when they are used, so the ones each stage of
+   the encoder or decoder needs sit together, and a table which is read
+   with vector loads, or is larger than a cache line, starts on a 64 byte
+   cache line. */
 
-/* 20 ms frame */
-const ilbc_ulp_inst_t ULP_20msTbl =
-{
-    /* LSF */
-    {
-        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0},
-        {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}
-    },
-    /* Start state location, gain and samples */
-    {2, 0, 0, 0, 0},
-    {1, 0, 0, 0, 0},
-    {6, 0, 0, 0, 0},
-    {0, 1, 2, 0, 0},
-    /* extra CB index and extra CB gain */
-    {{6, 0, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
-    {{2, 0, 3, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
-    /* CB index and CB gain */
-    {
-        {{7, 0, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
-        {{0, 0, 8, 0, 0}, {0, 0, 8, 0, 0}, {0, 0, 8, 0, 0}},
-        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
-        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}}
-    },
-    {
-        {{1, 2, 2, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
-        {{1, 1, 3, 0, 0}, {0, 2, 2, 0, 0}, {0, 0, 3, 0, 0}},
-        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
-        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}}
-    }
-};
+/*- Used by the encoder and the decoder for every frame -------------------*/
 
-/* 30 ms frame */
-const ilbc_ulp_inst_t ULP_30msTbl =
-{
-    /* LSF */
-    {
-        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0},
-        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0}
-    },
-    /* Start state location, gain and samples */
-    {3, 0, 0, 0, 0},
-    {1, 0, 0, 0, 0},
-    {6, 0, 0, 0, 0},
-    {0, 1, 2, 0, 0},
-    /* extra CB index and extra CB gain */
-    {{4, 2, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
-    {{1, 1, 3, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
-    /* CB index and CB gain */
-    {
-        {{6, 1, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0,7, 0, 0}},
-        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}},
-        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}},
-        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}}
-    },
-    {
-        {{1, 2, 2, 0, 0}, {1, 2, 1, 0, 0}, {0, 0, 3, 0, 0}},
-        {{0, 2, 3, 0, 0}, {0, 2, 2, 0, 0}, {0, 0, 3, 0, 0}},
-        {{0, 1, 4, 0, 0}, {0, 1, 3, 0, 0}, {0, 0, 3, 0, 0}},
-        {{0, 1, 4, 0, 0}, {0, 1, 3, 0, 0}, {0, 0, 3, 0, 0}}
-    }
-};
-
-/* HP Filters */
-
-const float hpi_zero_coefsTbl[3] =
-{
-    0.92727436f, -1.8544941f, 0.92727436f
-};
-
-const float hpi_pole_coefsTbl[3] =
-{
-    1.0f, -1.9059465f, 0.9114024f
-};
-
-const float hpo_zero_coefsTbl[3] =
-{
-    0.93980581f, -1.8795834f, 0.93980581f
-};
+/* LSF quantization */
 
-const float hpo_pole_coefsTbl[3] =
-{
-    1.0f, -1.9330735f, 0.93589199f
-};
+const int dim_lsfCbTbl[LSF_NSPLIT] = {3, 3, 4};
 
-/* LP Filter */
+const int size_lsfCbTbl[LSF_NSPLIT] = {64, 128, 128};
 
-const float lpFilt_coefsTbl[FILTERORDER_DS] =
+const float lsfmeanTbl[ILBC_LPC_FILTERORDER] =
 {
-    -0.066650f,  0.125000f, 0.316650f,
-     0.414063f,  0.316650f,
-     0.125000f, -0.066650f
+    0.281738f, 0.445801f, 0.663330f,
+    0.962524f, 1.251831f, 1.533081f,
+    1.850586f, 2.137817f, 2.481445f,
+    2.777344f
 };
 
 /* State quantization tables */
@@ -132,7 +58,7 @@ const float state_sq3Tbl[8] =
      2.436279f,  3.983887f
 };
 
-const float state_frgqTbl[64] =
+ILBC_ALIGN(64) const float state_frgqTbl[64] =
 {
     1.000085f, 1.071695f, 1.140395f,
     1.206868f, 1.277188f, 1.351503f,
@@ -170,6 +96,7 @@ const int search_rangeTbl[5][CB_NSTAGES] =
 };
 
 const int stMemLTbl = 85;
+
 const int memLfTbl[NASUB_MAX] = {147, 147, 147, 147};
 
 /* expansion filter(s) */
@@ -200,7 +127,7 @@ const float gain_sq4Tbl[16] =
      1.200012f
 };
 
-const float gain_sq5Tbl[32]=
+ILBC_ALIGN(64) const float gain_sq5Tbl[32]=
 {
     0.037476f, 0.075012f, 0.112488f,
     0.150024f, 0.187500f, 0.224976f,
@@ -215,58 +142,22 @@ const float gain_sq5Tbl[32]=
     1.162476f, 1.200012f
 };
 
-/* Enhancer - Upsamling a factor 4 (ENH_UPS0 = 4) */
-const float polyphaserTbl[ENH_UPS0*(2*ENH_FL0+1)] =
-{
-     0.000000f,  0.000000f,  0.000000f,
-     1.000000f,
-     0.000000f,  0.000000f,  0.000000f,
-     0.015625f, -0.076904f,  0.288330f,
-     0.862061f, 
-    -0.106445f,  0.018799f, -0.015625f,
-     0.023682f, -0.124268f,  0.601563f,
-     0.601563f,
-    -0.124268f,  0.023682f, -0.023682f,
-     0.018799f, -0.106445f,  0.862061f,
-     0.288330f,
-    -0.076904f,  0.015625f, -0.018799f
-};
+/*- Used only by the encoder ----------------------------------------------*/
 
-const float enh_plocsTbl[ENH_NBLOCKS_TOT] =
-{
-    40.0f, 120.0f,
-    200.0f, 280.0f, 360.0f,
-    440.0f, 520.0f, 600.0f
-};
-
-/* LPC analysis and quantization */
-
-const int dim_lsfCbTbl[LSF_NSPLIT] = {3, 3, 4};
-const int size_lsfCbTbl[LSF_NSPLIT] = {64, 128, 128};
+/* HP Filter */
 
-const float lsfmeanTbl[ILBC_LPC_FILTERORDER] =
-{
-    0.281738f, 0.445801f, 0.663330f,
-    0.962524f, 1.251831f, 1.533081f,
-    1.850586f, 2.137817f, 2.481445f,
-    2.777344f
-};
-
-const float lsf_weightTbl_30ms[6] =
+const float hpi_zero_coefsTbl[3] =
 {
-    1.0f/2.0f, 1.0f,
-    2.0f/3.0f,
-    1.0f/3.0f, 0.0f, 0.0f
+    0.92727436f, -1.8544941f, 0.92727436f
 };
 
-const float lsf_weightTbl_20ms[4] =
+const float hpi_pole_coefsTbl[3] =
 {
-    3.0f/4.0f, 2.0f/4.0f,
-    1.0f/4.0f, 0.0f
+    1.0f, -1.9059465f, 0.9114024f
 };
 
 /* Hanning LPC window */
-const float lpc_winTbl[ILBC_BLOCK_LEN_MAX] =
+ILBC_ALIGN(64) const float lpc_winTbl[ILBC_BLOCK_LEN_MAX] =
 {
     0.000183f, 0.000671f, 0.001526f,
     0.002716f, 0.004242f, 0.006104f,
@@ -351,7 +242,7 @@ const float lpc_winTbl[ILBC_BLOCK_LEN_MAX] =
 };
 
 /* Asymmetric LPC window */
-const float lpc_asymwinTbl[ILBC_BLOCK_LEN_MAX] =
+ILBC_ALIGN(64) const float lpc_asymwinTbl[ILBC_BLOCK_LEN_MAX] =
 {
     0.000061f, 0.000214f, 0.000458f,
     0.000824f, 0.001282f, 0.001831f,
@@ -444,8 +335,319 @@ const float lpc_lagwinTbl[ILBC_LPC_FILTERORDER + 1] =
     0.931405f, 0.913989f, 0.894909f
 };
 
-/* LSF quantization*/
-const float lsfCbTbl[64 * 3 + 128 * 3 + 128 * 4] =
+/* cos(2*pi*w) on the coarse grid of a2lsf(), where w runs from 0 in steps
+   of 0.00635, accumulated in single precision just as a2lsf() does. */
+ILBC_ALIGN(64) const float lsf_cosTbl[LSF_GRID_POINTS] =
+{
+    1.000000000e+00f, 9.992041588e-01f, 9.968179464e-01f, 9.928451180e-01f,
+    9.872920513e-01f, 9.801675677e-01f, 9.714829326e-01f, 9.612520933e-01f,
+    9.494912028e-01f, 9.362190962e-01f, 9.214568138e-01f, 9.052278996e-01f,
+    8.875582218e-01f, 8.684757352e-01f, 8.480110168e-01f, 8.261965513e-01f,
+    8.030670881e-01f, 7.786593437e-01f, 7.530122995e-01f, 7.261666656e-01f,
+    6.981652379e-01f, 6.690526009e-01f, 6.388750672e-01f, 6.076807380e-01f,
+    5.755190849e-01f, 5.424414277e-01f, 5.085003972e-01f, 4.737500548e-01f,
+    4.382455647e-01f, 4.020436406e-01f, 3.652018309e-01f, 3.277786076e-01f,
+    2.898337841e-01f, 2.514276505e-01f, 2.126211971e-01f, 1.734764576e-01f,
+    1.340554953e-01f, 9.442126006e-02f, 5.463675037e-02f, 1.476515923e-02f,
+    -2.512981556e-02f, -6.498491019e-02f, -1.047365740e-01f, -1.443215311e-01f,
+    -1.836768985e-01f, -2.227397859e-01f, -2.614481449e-01f, -2.997403741e-01f,
+    -3.375555277e-01f, -3.748334050e-01f, -4.115147591e-01f, -4.475410283e-01f,
+    -4.828548729e-01f, -5.174003839e-01f, -5.511223674e-01f, -5.839669108e-01f,
+    -6.158822179e-01f, -6.468170285e-01f, -6.767225266e-01f, -7.055506706e-01f,
+    -7.332561016e-01f, -7.597943544e-01f, -7.851231098e-01f, -8.092023730e-01f,
+    -8.319935799e-01f, -8.534606099e-01f, -8.735690713e-01f, -8.922872543e-01f,
+    -9.095852375e-01f, -9.254353642e-01f, -9.398125410e-01f, -9.526938200e-01f,
+    -9.640588164e-01f, -9.738893509e-01f, -9.821696877e-01f, -9.888868332e-01f,
+    -9.940299392e-01f, -9.975908995e-01f, -9.995640516e-01f, -9.999462366e-01f
+};
+
+const float lsf_weightTbl_30ms[6] =
+{
+    1.0f/2.0f, 1.0f,
+    2.0f/3.0f,
+    1.0f/3.0f, 0.0f, 0.0f
+};
+
+const float lsf_weightTbl_20ms[4] =
+{
+    3.0f/4.0f, 2.0f/4.0f,
+    1.0f/4.0f, 0.0f
+};
+
+/* The same codebook for the encoder's search, with each split stored a
+   dimension at a time, so the search can work across several codewords
+   at once. Element i of codeword j of a split of n codewords is at
+   [i*n + j] from the start of the split. */
+ILBC_ALIGN(64) const float lsfCbTransTbl[64 * 3 + 128 * 3 + 128 * 4] =
+{
+    0.155396f, 0.390503f, 0.440186f, 0.343628f, 0.318359f, 0.193115f, 0.364136f, 0.297485f,
+    0.227173f, 0.244995f, 0.169434f, 0.312866f, 0.248535f, 0.236206f, 0.334961f, 0.343018f,
+    0.372803f, 0.176880f, 0.416382f, 0.303223f, 0.203613f, 0.221191f, 0.199951f, 0.300781f,
+    0.226196f, 0.300049f, 0.312012f, 0.329956f, 0.373779f, 0.210571f, 0.271118f, 0.285522f,
+    0.246704f, 0.270508f, 0.361450f, 0.342651f, 0.340332f, 0.200439f, 0.407837f, 0.294678f,
+    0.193115f, 0.275757f, 0.380493f, 0.222778f, 0.407471f, 0.218384f, 0.313232f, 0.347412f,
+    0.238037f, 0.223877f, 0.395264f, 0.247925f, 0.229126f, 0.260132f, 0.337402f, 0.267822f,
+    0.250610f, 0.430054f, 0.382568f, 0.383545f, 0.271362f, 0.246826f, 0.266846f, 0.311523f,
+    0.273193f, 0.648071f, 0.692261f, 0.642334f, 0.491577f, 0.375488f, 0.510376f, 0.527588f,
+    0.365967f, 0.396729f, 0.300171f, 0.464478f, 0.429932f, 0.491333f, 0.625122f, 0.518555f,
+    0.659790f, 0.316528f, 0.625977f, 0.568726f, 0.351440f, 0.375000f, 0.323364f, 0.433350f,
+    0.354004f, 0.508179f, 0.492676f, 0.541016f, 0.604614f, 0.452026f, 0.473267f, 0.436890f,
+    0.565552f, 0.406250f, 0.578491f, 0.482788f, 0.549438f, 0.336304f, 0.644775f, 0.454834f,
+    0.344482f, 0.420776f, 0.608643f, 0.426147f, 0.700195f, 0.377197f, 0.454102f, 0.571533f,
+    0.405396f, 0.412964f, 0.582153f, 0.485596f, 0.496582f, 0.566895f, 0.611572f, 0.447632f,
+    0.381714f, 0.805054f, 0.544067f, 0.710327f, 0.529053f, 0.393555f, 0.422119f, 0.580688f,
+    0.451172f, 1.002075f, 0.955688f, 1.071533f, 0.670532f, 0.725708f, 0.658691f, 0.842529f,
+    0.563110f, 0.636475f, 0.520264f, 0.643188f, 0.626099f, 0.817139f, 0.895752f, 0.698608f,
+    0.945435f, 0.581421f, 0.805176f, 0.915039f, 0.588135f, 0.614746f, 0.476074f, 0.566895f,
+    0.507568f, 0.711670f, 0.763428f, 0.795776f, 0.928833f, 0.755249f, 0.662476f, 0.634399f,
+    0.859009f, 0.553589f, 0.813843f, 0.622437f, 0.743164f, 0.540894f, 0.895142f, 0.699097f,
+    0.643188f, 0.598755f, 0.861084f, 0.676514f, 1.053101f, 0.669922f, 0.600952f, 0.874146f,
+    0.729492f, 0.822021f, 0.743896f, 0.720581f, 0.907715f, 1.012695f, 0.978149f, 0.769287f,
+    0.530029f, 1.221924f, 0.701660f, 1.149170f, 0.775513f, 0.588623f, 0.676758f, 0.838623f,
+    1.331177f, 1.160034f, 1.161865f, 0.759521f, 0.947144f, 1.015015f, 1.172974f, 1.087524f,
+    0.899536f, 1.148438f, 0.785645f, 0.867798f, 0.922485f, 0.791260f, 0.788940f, 1.051147f,
+    0.866821f, 0.906738f, 1.244751f, 0.913940f, 0.680542f, 0.887207f, 0.912598f, 0.860474f,
+    1.005127f, 0.800781f, 0.781860f, 1.003662f, 0.981323f, 1.228760f, 0.734375f, 0.841797f,
+    0.920166f, 0.894409f, 1.283691f, 0.676025f, 0.821289f, 0.923218f, 1.057251f, 0.888672f,
+    0.942749f, 1.492310f, 1.070313f, 1.253296f, 0.647095f, 0.866699f, 1.063965f, 1.167847f,
+    0.956055f, 0.928711f, 1.088013f, 0.905029f, 1.057861f, 1.108276f, 0.979492f, 1.276001f,
+    0.993042f, 0.778198f, 1.223755f, 0.852661f, 1.134766f, 1.051392f, 0.803589f, 0.755737f,
+    0.700928f, 0.942749f, 0.993286f, 0.801025f, 0.739990f, 0.845703f, 0.915649f, 1.021973f,
+    0.999878f, 0.722290f, 0.673340f, 0.832397f, 0.962158f, 1.166748f, 0.946289f, 1.035034f,
+    1.393799f, 0.972656f, 1.028198f, 0.773560f, 1.080322f, 0.823975f, 0.859009f, 0.843994f,
+    1.189697f, 1.346680f, 0.980469f, 1.338135f, 1.223267f, 0.765747f, 1.042847f, 0.968750f,
+    0.826294f, 0.742310f, 1.054321f, 1.072998f, 0.859375f, 0.895752f, 0.805420f, 0.795654f,
+    1.105347f, 0.792236f, 1.170532f, 0.838257f, 0.968018f, 1.250122f, 0.711670f, 1.204834f,
+    1.137451f, 0.820435f, 0.798706f, 0.980713f, 1.112305f, 1.135498f, 1.101318f, 0.849854f,
+    1.377930f, 0.884888f, 1.289795f, 0.817505f, 1.446655f, 0.835815f, 0.916626f, 0.980103f,
+    1.576782f, 1.401978f, 1.525146f, 0.913940f, 1.121338f, 1.557007f, 1.402100f, 1.474243f,
+    1.105225f, 1.484741f, 1.209839f, 1.166504f, 1.229858f, 1.123291f, 0.966064f, 1.272827f,
+    1.181152f, 1.373535f, 1.581421f, 1.337280f, 0.959229f, 1.430542f, 1.433594f, 1.060303f,
+    1.381104f, 1.363892f, 1.124390f, 1.471436f, 1.309570f, 1.554321f, 0.895752f, 1.055664f,
+    1.119385f, 1.539063f, 1.543335f, 0.933105f, 1.491821f, 1.144653f, 1.345581f, 1.074951f,
+    1.195435f, 1.788086f, 1.634399f, 1.488892f, 0.864014f, 1.254883f, 1.532593f, 1.521484f,
+    1.502075f, 1.288574f, 1.380737f, 1.186768f, 1.421021f, 1.312500f, 1.416992f, 1.661011f,
+    1.168579f, 0.944946f, 1.491333f, 1.350464f, 1.593140f, 1.339722f, 1.271240f, 1.143555f,
+    0.837280f, 1.197876f, 1.378296f, 1.095337f, 1.032959f, 1.072266f, 1.072266f, 1.226196f,
+    1.204102f, 0.913940f, 0.835938f, 1.208374f, 1.576172f, 1.370850f, 1.138550f, 1.218262f,
+    1.717773f, 1.260986f, 1.288452f, 1.258057f, 1.328003f, 1.450806f, 1.016602f, 1.131104f,
+    1.702759f, 1.763184f, 1.253784f, 1.641968f, 1.424194f, 1.004150f, 1.269165f, 1.257568f,
+    0.993408f, 0.950439f, 1.439819f, 1.261719f, 1.036377f, 1.267212f, 0.962891f, 1.005493f,
+    1.313843f, 1.221802f, 1.467651f, 1.153198f, 1.198242f, 1.623535f, 1.058350f, 1.454468f,
+    1.421753f, 1.322754f, 1.005005f, 1.324951f, 1.438843f, 1.356689f, 1.387451f, 1.276978f,
+    1.627563f, 1.095459f, 1.505859f, 1.384155f, 1.702148f, 1.023071f, 1.139038f, 1.174072f,
+    1.779541f, 1.768188f, 1.715332f, 1.119873f, 1.282471f, 1.804932f, 1.692627f, 1.665405f,
+    1.406250f, 1.796265f, 1.567749f, 1.450684f, 1.420898f, 1.409546f, 1.340332f, 1.556641f,
+    1.538818f, 1.607910f, 1.933838f, 1.539673f, 1.662720f, 1.800781f, 1.683960f, 1.455322f,
+    1.706909f, 1.829102f, 1.505981f, 1.684692f, 1.618042f, 1.756470f, 1.225586f, 1.249268f,
+    1.486206f, 1.828979f, 1.858276f, 1.490845f, 1.739868f, 1.580566f, 1.635864f, 1.353149f,
+    1.505493f, 2.039673f, 1.860962f, 1.686035f, 1.401855f, 1.453369f, 1.731323f, 1.884033f,
+    1.745605f, 1.479614f, 1.570801f, 1.371948f, 1.617432f, 1.501465f, 1.624268f, 2.007935f,
+    1.331665f, 1.235962f, 1.815674f, 1.722290f, 1.787354f, 1.531006f, 1.652100f, 1.639404f,
+    1.130371f, 1.669800f, 1.566528f, 1.298950f, 1.383667f, 1.543823f, 1.224487f, 1.481323f,
+    1.555908f, 1.340210f, 1.259521f, 1.394165f, 1.912842f, 1.556763f, 1.400391f, 1.386475f,
+    2.000244f, 1.760620f, 1.484619f, 1.756714f, 1.742676f, 1.917725f, 1.191895f, 1.645020f,
+    1.894409f, 2.066040f, 1.441650f, 1.932739f, 1.626465f, 1.579102f, 1.647461f, 1.555786f,
+    1.275146f, 1.430542f, 1.828003f, 1.441895f, 1.314819f, 1.605591f, 1.142334f, 1.468506f,
+    1.584839f, 1.465698f, 1.664063f, 1.342163f, 1.391235f, 1.823608f, 1.512085f, 1.739136f,
+    1.620117f, 1.578247f, 1.213867f, 1.512939f, 1.735596f, 1.635742f, 1.686523f, 1.523438f,
+    1.858154f, 1.287476f, 1.756592f, 1.650513f, 1.931885f, 1.385376f, 1.335327f, 1.453735f,
+    1.705688f, 1.797119f, 1.990356f, 1.849365f, 1.657959f, 1.437744f, 2.028687f, 1.736938f,
+    1.521606f, 1.841431f, 1.590088f, 1.746826f, 1.734619f, 1.786255f, 1.861084f, 2.001465f,
+    1.784424f, 1.888794f, 2.301147f, 1.837769f, 2.012939f, 1.429565f, 1.622803f, 1.581543f,
+    1.419434f, 1.721924f, 1.911011f, 1.581177f, 1.870361f, 2.059692f, 1.815674f, 1.407959f,
+    2.168701f, 1.636230f, 1.878906f, 1.765381f, 2.164795f, 2.071899f, 2.026001f, 1.948975f,
+    1.881836f, 2.238159f, 1.897949f, 1.856445f, 1.695557f, 1.612671f, 1.568848f, 1.953369f,
+    1.388306f, 2.115356f, 1.905762f, 1.882568f, 1.683594f, 1.874023f, 1.861938f, 1.722168f,
+    1.926880f, 2.123901f, 1.588135f, 2.053955f, 2.210449f, 2.199463f, 1.960083f, 1.953735f,
+    1.615234f, 1.621094f, 1.824951f, 1.994263f, 1.746338f, 1.562866f, 1.748901f, 1.758057f,
+    2.071289f, 1.839600f, 1.882202f, 1.957886f, 1.992920f, 2.012817f, 2.025635f, 2.316040f,
+    1.741211f, 1.845337f, 1.679932f, 1.722534f, 1.829834f, 1.676636f, 1.791504f, 1.977051f,
+    1.800171f, 1.827759f, 1.918335f, 1.916748f, 1.761230f, 2.053711f, 1.595337f, 1.470581f,
+    1.801392f, 1.853638f, 1.956299f, 1.963623f, 1.887451f, 2.120117f, 1.506348f, 1.664551f,
+    1.720703f, 1.483398f, 1.769043f, 1.810791f, 1.788330f, 1.785156f, 1.695313f, 1.584106f,
+    1.894897f, 1.720581f, 1.619385f, 1.883179f, 1.447632f, 1.502686f, 1.711548f, 1.499756f,
+    1.916870f, 1.498047f, 1.808716f, 2.088501f, 1.545044f, 1.796021f, 1.786499f, 1.938232f,
+    2.153809f, 2.016846f, 2.219116f, 2.190918f, 1.854370f, 1.897705f, 2.247314f, 1.922119f,
+    1.870972f, 2.050659f, 2.067261f, 2.057373f, 1.940552f, 2.204468f, 2.170532f, 2.307617f,
+    2.124146f, 2.135864f, 2.531250f, 2.051270f, 2.221191f, 1.858276f, 1.897705f, 1.960449f,
+    1.933960f, 2.059570f, 2.220703f, 1.860840f, 2.098755f, 2.279785f, 2.181519f, 1.768311f,
+    2.394653f, 1.865723f, 2.139526f, 1.971802f, 2.410889f, 2.331055f, 2.311523f, 2.180786f,
+    2.130859f, 2.452759f, 2.101685f, 2.074585f, 2.199097f, 1.877075f, 1.786499f, 2.164551f,
+    1.725342f, 2.337769f, 2.111328f, 2.332031f, 2.088745f, 2.182129f, 2.070435f, 2.107422f,
+    2.184692f, 2.337280f, 1.911499f, 2.370850f, 2.519653f, 2.474731f, 2.175415f, 2.185181f,
+    2.036499f, 2.028198f, 2.267456f, 2.229126f, 2.011353f, 2.135986f, 2.083496f, 2.131470f,
+    2.299072f, 2.094360f, 2.088257f, 2.153198f, 2.351196f, 2.262451f, 2.254761f, 2.589355f,
+    2.279541f, 2.055786f, 1.926514f, 1.946899f, 2.043213f, 2.071655f, 2.113525f, 2.215088f,
+    2.106689f, 2.170166f, 2.132813f, 2.225098f, 1.976074f, 2.367432f, 2.000977f, 2.031250f,
+    2.128052f, 2.066650f, 2.163696f, 2.275757f, 2.105469f, 2.443359f, 1.766968f, 1.981079f,
+    1.978882f, 1.814819f, 2.136597f, 2.049316f, 2.005981f, 1.993164f, 2.022949f, 1.965576f,
+    2.249878f, 1.995728f, 2.173950f, 2.220459f, 2.045044f, 2.156616f, 1.944092f, 1.867554f,
+    2.135132f, 1.711182f, 1.997559f, 2.402710f, 1.819214f, 2.012573f, 2.041748f, 2.264404f,
+    2.398315f, 2.445679f, 2.576416f, 2.611572f, 2.159058f, 2.253174f, 2.542358f, 2.185913f,
+    2.526855f, 2.463623f, 2.427979f, 2.320190f, 2.306030f, 2.457520f, 2.414551f, 2.552734f,
+    2.381592f, 2.418579f, 2.724976f, 2.261963f, 2.440186f, 2.582275f, 2.367310f, 2.515869f,
+    2.394653f, 2.421753f, 2.461060f, 2.516968f, 2.432373f, 2.495605f, 2.451538f, 2.343018f,
+    2.604736f, 2.329102f, 2.376709f, 2.195435f, 2.673706f, 2.645874f, 2.594849f, 2.514893f,
+    2.478149f, 2.652832f, 2.524292f, 2.541016f, 2.506226f, 2.435425f, 2.194580f, 2.486938f,
+    2.384521f, 2.592896f, 2.363525f, 2.598267f, 2.361938f, 2.536133f, 2.309692f, 2.477295f,
+    2.442627f, 2.553101f, 2.212769f, 2.712158f, 2.770386f, 2.718262f, 2.608032f, 2.428223f,
+    2.576538f, 2.431030f, 2.514526f, 2.475220f, 2.588257f, 2.471680f, 2.460938f, 2.636597f,
+    2.550781f, 2.496460f, 2.636841f, 2.384399f, 2.654419f, 2.643799f, 2.508423f, 2.794189f,
+    2.578491f, 2.348511f, 2.499756f, 2.448486f, 2.580444f, 2.322510f, 2.469727f, 2.497437f,
+    2.357788f, 2.525879f, 2.488403f, 2.542603f, 2.507446f, 2.608032f, 2.307129f, 2.375854f,
+    2.399780f, 2.429199f, 2.394775f, 2.585327f, 2.331787f, 2.733887f, 2.400513f, 2.375732f,
+    2.391479f, 2.434448f, 2.563721f, 2.373901f, 2.359131f, 2.399780f, 2.522583f, 2.299927f,
+    2.655884f, 2.299438f, 2.574219f, 2.474365f, 2.555542f, 2.653320f, 2.282959f, 2.341064f,
+    2.568237f, 2.223267f, 2.256470f, 2.667358f, 2.324097f, 2.505737f, 2.290405f, 2.529053f,
+    2.743408f, 2.701904f, 2.813477f, 2.835083f, 2.726196f, 2.655396f, 2.875854f, 2.743408f,
+    2.786987f, 2.857666f, 2.794434f, 2.800781f, 2.826416f, 2.795288f, 2.763672f, 2.811890f,
+    2.645508f, 2.861206f, 2.913086f, 2.553223f, 2.678101f, 2.845703f, 2.621094f, 2.736450f,
+    2.746704f, 2.769653f, 2.740723f, 2.874634f, 2.656494f, 2.729370f, 2.680542f, 2.668091f,
+    2.829346f, 2.824219f, 2.679810f, 2.586914f, 2.903198f, 2.907104f, 2.863892f, 2.797852f,
+    2.804199f, 2.868286f, 2.880127f, 2.791748f, 2.742676f, 2.732910f, 2.768555f, 2.874023f,
+    2.771851f, 2.864014f, 2.789307f, 2.827637f, 2.608643f, 2.766968f, 2.700562f, 2.837646f,
+    2.663818f, 2.777466f, 2.543945f, 2.939941f, 2.958618f, 2.919922f, 2.888794f, 2.809570f,
+    2.834595f, 2.664673f, 2.747925f, 2.833984f, 2.826904f, 2.687256f, 2.686279f, 2.891602f,
+    2.814331f, 2.723999f, 2.923096f, 2.615234f, 2.889771f, 2.903076f, 2.784058f, 2.963623f,
+    2.816284f, 2.822021f, 2.835693f, 2.728760f, 2.867676f, 2.704834f, 2.784058f, 2.726929f,
+    2.738892f, 2.852417f, 2.728149f, 2.857666f, 2.884521f, 2.837646f, 2.578247f, 2.647583f,
+    2.822876f, 2.751465f, 2.734253f, 2.865234f, 2.587402f, 2.941406f, 2.851807f, 2.774414f,
+    2.640991f, 2.722290f, 2.774414f, 2.613647f, 2.723145f, 2.832520f, 2.745117f, 2.715576f,
+    2.897705f, 2.557007f, 2.787964f, 2.825073f, 2.744873f, 2.846558f, 2.685791f, 2.578857f,
+    2.826050f, 2.755127f, 2.758545f, 2.890259f, 2.692993f, 2.784912f, 2.650757f, 2.796143f
+};
+
+/* The decision thresholds of the state quantizers, half way between
+   neighbouring levels, computed as sort_sq() computes them. Each is
+   padded to a whole number of vectors with a threshold no value will
+   pass. */
+const float state_sq3ThrTbl[8] =
+{
+    -2.94866943f, -1.65374756f, -0.719848514f,
+     0.0672609955f,  0.88696301f,  1.88299561f,
+     3.21008301f, FLOAT_MAX
+};
+
+ILBC_ALIGN(64) const float state_frgqThrTbl[64] =
+{
+    1.03588998f, 1.10604501f, 1.17363155f,
+    1.242028f, 1.31434548f, 1.39044154f,
+    1.46505356f, 1.53488803f, 1.60432398f,
+    1.67333496f, 1.74430096f, 1.81116498f,
+    1.87117457f, 1.92912245f, 1.98172259f,
+    2.03111219f, 2.07913065f, 2.12280297f,
+    2.16320562f, 2.20077705f, 2.23756957f,
+    2.27645802f, 2.31435299f, 2.3511076f,
+    2.38601995f, 2.41893601f, 2.45183897f,
+    2.48599577f, 2.52133894f, 2.55611396f,
+    2.58898997f, 2.62068367f, 2.6526351f,
+    2.68385959f, 2.71394062f, 2.74444342f,
+    2.77480984f, 2.80425644f, 2.83337641f,
+    2.86277199f, 2.8921845f, 2.92177701f,
+    2.9522295f, 2.98395944f, 3.0167408f,
+    3.04986095f, 3.08529305f, 3.1228652f,
+    3.16225553f, 3.20298195f, 3.2441926f,
+    3.286937f, 3.32963181f, 3.37304902f,
+    3.419034f, 3.46679688f, 3.51665759f,
+    3.57328892f, 3.63505697f, 3.70352197f,
+    3.78587151f, 3.88475943f, 4.02026701f,
+    FLOAT_MAX
+};
+
+/* G.711 expansion, for the encoder's G.711 input. The levels are whole
+   numbers, so they are kept as 16 bit integers. */
+
+/* A-law, as sent on the line, with its even bits inverted, to linear */
+ILBC_ALIGN(64) const int16_t alaw_to_linearTbl[256] =
+{
+     -5504,  -5248,  -6016,  -5760,  -4480,  -4224,  -4992,  -4736,
+     -7552,  -7296,  -8064,  -7808,  -6528,  -6272,  -7040,  -6784,
+     -2752,  -2624,  -3008,  -2880,  -2240,  -2112,  -2496,  -2368,
+     -3776,  -3648,  -4032,  -3904,  -3264,  -3136,  -3520,  -3392,
+    -22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+    -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+    -11008, -10496, -12032, -11520,  -8960,  -8448,  -9984,  -9472,
+    -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+      -344,   -328,   -376,   -360,   -280,   -264,   -312,   -296,
+      -472,   -456,   -504,   -488,   -408,   -392,   -440,   -424,
+       -88,    -72,   -120,   -104,    -24,     -8,    -56,    -40,
+      -216,   -200,   -248,   -232,   -152,   -136,   -184,   -168,
+     -1376,  -1312,  -1504,  -1440,  -1120,  -1056,  -1248,  -1184,
+     -1888,  -1824,  -2016,  -1952,  -1632,  -1568,  -1760,  -1696,
+      -688,   -656,   -752,   -720,   -560,   -528,   -624,   -592,
+      -944,   -912,  -1008,   -976,   -816,   -784,   -880,   -848,
+      5504,   5248,   6016,   5760,   4480,   4224,   4992,   4736,
+      7552,   7296,   8064,   7808,   6528,   6272,   7040,   6784,
+      2752,   2624,   3008,   2880,   2240,   2112,   2496,   2368,
+      3776,   3648,   4032,   3904,   3264,   3136,   3520,   3392,
+     22016,  20992,  24064,  23040,  17920,  16896,  19968,  18944,
+     30208,  29184,  32256,  31232,  26112,  25088,  28160,  27136,
+     11008,  10496,  12032,  11520,   8960,   8448,   9984,   9472,
+     15104,  14592,  16128,  15616,  13056,  12544,  14080,  13568,
+       344,    328,    376,    360,    280,    264,    312,    296,
+       472,    456,    504,    488,    408,    392,    440,    424,
+        88,     72,    120,    104,     24,      8,     56,     40,
+       216,    200,    248,    232,    152,    136,    184,    168,
+      1376,   1312,   1504,   1440,   1120,   1056,   1248,   1184,
+      1888,   1824,   2016,   1952,   1632,   1568,   1760,   1696,
+       688,    656,    752,    720,    560,    528,    624,    592,
+       944,    912,   1008,    976,    816,    784,    880,    848
+};
+
+/* u-law to linear */
+ILBC_ALIGN(64) const int16_t ulaw_to_linearTbl[256] =
+{
+    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+    -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+    -15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+    -11900, -11388, -10876, -10364,  -9852,  -9340,  -8828,  -8316,
+     -7932,  -7676,  -7420,  -7164,  -6908,  -6652,  -6396,  -6140,
+     -5884,  -5628,  -5372,  -5116,  -4860,  -4604,  -4348,  -4092,
+     -3900,  -3772,  -3644,  -3516,  -3388,  -3260,  -3132,  -3004,
+     -2876,  -2748,  -2620,  -2492,  -2364,  -2236,  -2108,  -1980,
+     -1884,  -1820,  -1756,  -1692,  -1628,  -1564,  -1500,  -1436,
+     -1372,  -1308,  -1244,  -1180,  -1116,  -1052,   -988,   -924,
+      -876,   -844,   -812,   -780,   -748,   -716,   -684,   -652,
+      -620,   -588,   -556,   -524,   -492,   -460,   -428,   -396,
+      -372,   -356,   -340,   -324,   -308,   -292,   -276,   -260,
+      -244,   -228,   -212,   -196,   -180,   -164,   -148,   -132,
+      -120,   -112,   -104,    -96,    -88,    -80,    -72,    -64,
+       -56,    -48,    -40,    -32,    -24,    -16,     -8,      0,
+     32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
+     23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
+     15996,  15484,  14972,  14460,  13948,  13436,  12924,  12412,
+     11900,  11388,  10876,  10364,   9852,   9340,   8828,   8316,
+      7932,   7676,   7420,   7164,   6908,   6652,   6396,   6140,
+      5884,   5628,   5372,   5116,   4860,   4604,   4348,   4092,
+      3900,   3772,   3644,   3516,   3388,   3260,   3132,   3004,
+      2876,   2748,   2620,   2492,   2364,   2236,   2108,   1980,
+      1884,   1820,   1756,   1692,   1628,   1564,   1500,   1436,
+      1372,   1308,   1244,   1180,   1116,   1052,    988,    924,
+       876,    844,    812,    780,    748,    716,    684,    652,
+       620,    588,    556,    524,    492,    460,    428,    396,
+       372,    356,    340,    324,    308,    292,    276,    260,
+       244,    228,    212,    196,    180,    164,    148,    132,
+       120,    112,    104,     96,     88,     80,     72,     64,
+        56,     48,     40,     32,     24,     16,      8,      0
+};
+
+/*- Used only by the decoder ----------------------------------------------*/
+
+/* HP Filter */
+
+const float hpo_zero_coefsTbl[3] =
+{
+    0.93980581f, -1.8795834f, 0.93980581f
+};
+
+const float hpo_pole_coefsTbl[3] =
+{
+    1.0f, -1.9330735f, 0.93589199f
+};
+
+/* LSF quantization */
+ILBC_ALIGN(64) const float lsfCbTbl[64 * 3 + 128 * 3 + 128 * 4] =
 {
     0.155396f, 0.273193f, 0.451172f,
     0.390503f, 0.648071f, 1.002075f,
@@ -768,3 +970,220 @@ const float lsfCbTbl[64 * 3 + 128 * 3 + 128 * 4] =
     1.786499f, 2.041748f, 2.290405f, 2.650757f,
     1.938232f, 2.264404f, 2.529053f, 2.796143f
 };
+
+/* Enhancer - Upsamling a factor 4 (ENH_UPS0 = 4) */
+ILBC_ALIGN(64) const float polyphaserTbl[ENH_UPS0*(2*ENH_FL0+1)] =
+{
+     0.000000f,  0.000000f,  0.000000f,
+     1.000000f,
+     0.000000f,  0.000000f,  0.000000f,
+     0.015625f, -0.076904f,  0.288330f,
+     0.862061f, 
+    -0.106445f,  0.018799f, -0.015625f,
+     0.023682f, -0.124268f,  0.601563f,
+     0.601563f,
+    -0.124268f,  0.023682f, -0.023682f,
+     0.018799f, -0.106445f,  0.862061f,
+     0.288330f,
+    -0.076904f,  0.015625f, -0.018799f
+};
+
+const float enh_plocsTbl[ENH_NBLOCKS_TOT] =
+{
+    40.0f, 120.0f,
+    200.0f, 280.0f, 360.0f,
+    440.0f, 520.0f, 600.0f
+};
+
+/* Enhancer - waveform weighting for the surround shape,
+   0.5*(1 - cos(2*PI*i/(2*ENH_HL + 2))) for i = 1 .. 2*ENH_HL + 1, with the
+   centre (current waveform) weight, which is not used, set to zero */
+const float enh_wtTbl[2*ENH_HL + 1] =
+{
+    0.1464466155f, 0.5000000000f, 0.8535534143f,
+    0.0000000000f,
+    0.8535532951f, 0.5000000000f, 0.1464464962f
+};
+
+/* The same weighting, for ENH_HL_LITE and ENH_HL_MINIMAL */
+const float enh_wtTblLite[2*ENH_HL_LITE + 1] =
+{
+    0.2500000000f, 0.7500000000f,
+    0.0000000000f,
+    0.7500000000f, 0.2500000000f
+};
+
+const float enh_wtTblMinimal[2*ENH_HL_MINIMAL + 1] =
+{
+    0.5000000000f,
+    0.0000000000f,
+    0.5000000000f
+};
+
+/* LP Filter */
+
+const float lpFilt_coefsTbl[FILTERORDER_DS] =
+{
+    -0.066650f,  0.125000f, 0.316650f,
+     0.414063f,  0.316650f,
+     0.125000f, -0.066650f
+};
+
+/*- Used only by the 16, 32 and 48kHz front end ---------------------------*/
+
+/* Low pass filters for resampling between 8kHz and 2, 4 and 6 times that.
+   Each is a Kaiser windowed sinc (beta 5) cut off at 4kHz, flat to 3.4kHz
+   and at least 54dB down beyond 4.6kHz, with a gain of 1 at DC. */
+
+/* 2x, 48 taps */
+ILBC_ALIGN(64) const float resample_x2Tbl[RESAMPLE_TAPS*2] =
+{
+    -0.000351778f, -0.000585069f,  0.000887901f,  0.001271717f,
+    -0.001749057f, -0.002333764f,  0.003041286f,  0.003889147f,
+    -0.004897641f, -0.006090879f,  0.007498350f,  0.009157306f,
+    -0.011116448f, -0.013441765f,  0.016226137f,  0.019605742f,
+    -0.023789632f, -0.029116610f,  0.036174153f,  0.046075841f,
+    -0.061214263f, -0.087820687f,  0.148762985f,  0.449917027f,
+     0.449917027f,  0.148762985f, -0.087820687f, -0.061214263f,
+     0.046075841f,  0.036174153f, -0.029116610f, -0.023789632f,
+     0.019605742f,  0.016226137f, -0.013441765f, -0.011116448f,
+     0.009157306f,  0.007498350f, -0.006090879f, -0.004897641f,
+     0.003889147f,  0.003041286f, -0.002333764f, -0.001749057f,
+     0.001271717f,  0.000887901f, -0.000585069f, -0.000351778f
+};
+
+/* 4x, 96 taps */
+ILBC_ALIGN(64) const float resample_x4Tbl[RESAMPLE_TAPS*4] =
+{
+    -0.000094192f, -0.000296829f, -0.000376397f, -0.000193413f,
+     0.000235825f,  0.000684488f,  0.000813362f,  0.000396384f,
+    -0.000462394f, -0.001292556f, -0.001486836f, -0.000704325f,
+     0.000801311f,  0.002190673f,  0.002470307f,  0.001149470f,
+    -0.001286845f, -0.003467200f, -0.003858647f, -0.001774254f,
+     0.001965113f,  0.005243968f,  0.005786138f,  0.002640460f,
+    -0.002905293f, -0.007709539f, -0.008467522f, -0.003850284f,
+     0.004225876f,  0.011198713f,  0.012298446f,  0.005599355f,
+    -0.006162876f, -0.016406678f, -0.018137447f, -0.008332705f,
+     0.009281451f,  0.025095017f,  0.028302361f,  0.013341794f,
+    -0.015365168f, -0.043404786f, -0.051913898f, -0.026544729f,
+     0.034401141f,  0.116966267f,  0.195717843f,  0.243689049f,
+     0.243689049f,  0.195717843f,  0.116966267f,  0.034401141f,
+    -0.026544729f, -0.051913898f, -0.043404786f, -0.015365168f,
+     0.013341794f,  0.028302361f,  0.025095017f,  0.009281451f,
+    -0.008332705f, -0.018137447f, -0.016406678f, -0.006162876f,
+     0.005599355f,  0.012298446f,  0.011198713f,  0.004225876f,
+    -0.003850284f, -0.008467522f, -0.007709539f, -0.002905293f,
+     0.002640460f,  0.005786138f,  0.005243968f,  0.001965113f,
+    -0.001774254f, -0.003858647f, -0.003467200f, -0.001286845f,
+     0.001149470f,  0.002470307f,  0.002190673f,  0.000801311f,
+    -0.000704325f, -0.001486836f, -0.001292556f, -0.000462394f,
+     0.000396384f,  0.000813362f,  0.000684488f,  0.000235825f,
+    -0.000193413f, -0.000376397f, -0.000296829f, -0.000094192f
+};
+
+/* 6x, 144 taps */
+ILBC_ALIGN(64) const float resample_x6Tbl[RESAMPLE_TAPS*6] =
+{
+    -0.000042322f, -0.000138525f, -0.000223532f, -0.000261027f,
+    -0.000220994f, -0.000092785f,  0.000105678f,  0.000326801f,
+     0.000502543f,  0.000562967f,  0.000459652f,  0.000186906f,
+    -0.000206890f, -0.000623610f, -0.000937009f, -0.001027792f,
+    -0.000823168f, -0.000328855f,  0.000358133f,  0.001063349f,
+     0.001575575f,  0.001705928f,  0.001349870f,  0.000533222f,
+    -0.000574609f, -0.001689374f, -0.002480211f, -0.002662373f,
+    -0.002089786f, -0.000819314f,  0.000876731f,  0.002560836f,
+     0.003736880f,  0.003988879f,  0.003114855f,  0.001215430f,
+    -0.001295023f, -0.003768008f, -0.005479580f, -0.005831611f,
+    -0.004542246f, -0.001768720f,  0.001881531f,  0.005468505f,
+     0.007947965f,  0.008458477f,  0.006592177f,  0.002570107f,
+    -0.002739303f, -0.007982972f, -0.011643494f, -0.012446709f,
+    -0.009753878f, -0.003828196f,  0.004112967f,  0.012100802f,
+     0.017849817f,  0.019337574f,  0.015395051f,  0.006156331f,
+    -0.006763084f, -0.020434313f, -0.031125192f, -0.035063546f,
+    -0.029295927f, -0.012448983f,  0.014790009f,  0.049603103f,
+     0.087424284f,  0.122715503f,  0.149985276f,  0.164839247f,
+     0.164839247f,  0.149985276f,  0.122715503f,  0.087424284f,
+     0.049603103f,  0.014790009f, -0.012448983f, -0.029295927f,
+    -0.035063546f, -0.031125192f, -0.020434313f, -0.006763084f,
+     0.006156331f,  0.015395051f,  0.019337574f,  0.017849817f,
+     0.012100802f,  0.004112967f, -0.003828196f, -0.009753878f,
+    -0.012446709f, -0.011643494f, -0.007982972f, -0.002739303f,
+     0.002570107f,  0.006592177f,  0.008458477f,  0.007947965f,
+     0.005468505f,  0.001881531f, -0.001768720f, -0.004542246f,
+    -0.005831611f, -0.005479580f, -0.003768008f, -0.001295023f,
+     0.001215430f,  0.003114855f,  0.003988879f,  0.003736880f,
+     0.002560836f,  0.000876731f, -0.000819314f, -0.002089786f,
+    -0.002662373f, -0.002480211f, -0.001689374f, -0.000574609f,
+     0.000533222f,  0.001349870f,  0.001705928f,  0.001575575f,
+     0.001063349f,  0.000358133f, -0.000328855f, -0.000823168f,
+    -0.001027792f, -0.000937009f, -0.000623610f, -0.000206890f,
+     0.000186906f,  0.000459652f,  0.000562967f,  0.000502543f,
+     0.000326801f,  0.000105678f, -0.000092785f, -0.000220994f,
+    -0.000261027f, -0.000223532f, -0.000138525f, -0.000042322f
+};
+
+/*- Used only when an encoder or a decoder is initialised -----------------*/
+
+/* ULP bit allocation */
+
+/* 20 ms frame */
+const ilbc_ulp_inst_t ULP_20msTbl =
+{
+    /* LSF */
+    {
+        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0},
+        {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}
+    },
+    /* Start state location, gain and samples */
+    {2, 0, 0, 0, 0},
+    {1, 0, 0, 0, 0},
+    {6, 0, 0, 0, 0},
+    {0, 1, 2, 0, 0},
+    /* extra CB index and extra CB gain */
+    {{6, 0, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
+    {{2, 0, 3, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
+    /* CB index and CB gain */
+    {
+        {{7, 0, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
+        {{0, 0, 8, 0, 0}, {0, 0, 8, 0, 0}, {0, 0, 8, 0, 0}},
+        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
+        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}}
+    },
+    {
+        {{1, 2, 2, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
+        {{1, 1, 3, 0, 0}, {0, 2, 2, 0, 0}, {0, 0, 3, 0, 0}},
+        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}},
+        {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}}
+    }
+};
+
+/* 30 ms frame */
+const ilbc_ulp_inst_t ULP_30msTbl =
+{
+    /* LSF */
+    {
+        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0},
+        {6, 0, 0, 0, 0}, {7, 0, 0, 0, 0}, {7, 0, 0, 0, 0}
+    },
+    /* Start state location, gain and samples */
+    {3, 0, 0, 0, 0},
+    {1, 0, 0, 0, 0},
+    {6, 0, 0, 0, 0},
+    {0, 1, 2, 0, 0},
+    /* extra CB index and extra CB gain */
+    {{4, 2, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0, 7, 0, 0}},
+    {{1, 1, 3, 0, 0}, {1, 1, 2, 0, 0}, {0, 0, 3, 0, 0}},
+    /* CB index and CB gain */
+    {
+        {{6, 1, 1, 0, 0}, {0, 0, 7, 0, 0}, {0, 0,7, 0, 0}},
+        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}},
+        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}},
+        {{0, 7, 1, 0, 0}, {0, 0, 8, 0, 0}, {0, 0,8, 0, 0}}
+    },
+    {
+        {{1, 2, 2, 0, 0}, {1, 2, 1, 0, 0}, {0, 0, 3, 0, 0}},
+        {{0, 2, 3, 0, 0}, {0, 2, 2, 0, 0}, {0, 0, 3, 0, 0}},
+        {{0, 1, 4, 0, 0}, {0, 1, 3, 0, 0}, {0, 0, 3, 0, 0}},
+        {{0, 1, 4, 0, 0}, {0, 1, 3, 0, 0}, {0, 0, 3, 0, 0}}
+    }
+};
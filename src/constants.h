@@ -28,6 +28,11 @@
 extern const ilbc_ulp_inst_t ULP_20msTbl;
 extern const ilbc_ulp_inst_t ULP_30msTbl;
 
+/* G.711 expansion */
+
+extern const int16_t alaw_to_linearTbl[];
+extern const int16_t ulaw_to_linearTbl[];
+
 /* high pass filters */
 
 extern const float hpi_zero_coefsTbl[];
@@ -38,13 +43,21 @@ extern const float hpo_pole_coefsTbl[];
 /* low pass filters */
 extern const float lpFilt_coefsTbl[];
 
+/* resampling filters */
+
+extern const float resample_x2Tbl[];
+extern const float resample_x4Tbl[];
+extern const float resample_x6Tbl[];
+
 /* LPC analysis and quantization */
 
 extern const float lpc_winTbl[];
 extern const float lpc_asymwinTbl[];
 extern const float lpc_lagwinTbl[];
 extern const float lsfCbTbl[];
+extern const float lsfCbTransTbl[];
 extern const float lsfmeanTbl[];
+extern const float lsf_cosTbl[];
 extern const int   dim_lsfCbTbl[];
 extern const int   size_lsfCbTbl[];
 extern const float lsf_weightTbl_30ms[];
@@ -54,6 +67,8 @@ extern const float lsf_weightTbl_20ms[];
 
 extern const float state_sq3Tbl[];
 extern const float state_frgqTbl[];
+extern const float state_sq3ThrTbl[];
+extern const float state_frgqThrTbl[];
 
 /* gain quantization tables */
 
@@ -72,5 +87,8 @@ extern const float cbfiltersTbl[CB_FILTERLEN];
 
 extern const float polyphaserTbl[];
 extern const float enh_plocsTbl[];
+extern const float enh_wtTbl[];
+extern const float enh_wtTblLite[];
+extern const float enh_wtTblMinimal[];
 
 #endif
@@ -0,0 +1,120 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * cpuDispatch.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "cpuDispatch.h"
+
+/*
+ * One package has to run well on several generations of hardware, so the
+ * vector kernels are all built into the library, and chosen when they are
+ * first used. The CPU is examined once, here, and every kernel picks its
+ * version from the same answer. The ILBC_CPU_TIER environment variable
+ * can hold the choice down to a lower tier, to compare the versions or to
+ * rule one out while debugging. It can never raise the choice above what
+ * the CPU supports.
+ */
+
+static const char *tier_names[ILBC_CPU_TIERS] =
+{
+    "scalar",
+    "sse2",
+    "avx2",
+    "avx512",
+    "neon"
+};
+
+static int tier = -1;
+
+/*----------------------------------------------------------------*
+ *  The best tier this CPU supports
+ *---------------------------------------------------------------*/
+
+static int detect_tier(void)
+{
+#if defined(__GNUC__)  &&  (defined(__x86_64__)  ||  defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return ILBC_CPU_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return ILBC_CPU_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return ILBC_CPU_SSE2;
+    return ILBC_CPU_SCALAR;
+#elif defined(__ARM_NEON)  ||  defined(__ARM_NEON__)
+    return ILBC_CPU_NEON;
+#else
+    return ILBC_CPU_SCALAR;
+#endif
+}
+
+/*----------------------------------------------------------------*
+ *  The tier asked for by ILBC_CPU_TIER, limited to what the CPU
+ *  supports. NEON is not part of the x86 order, so it can only be
+ *  kept or turned off.
+ *---------------------------------------------------------------*/
+
+static int limit_tier(int best, const char *name)
+{
+    int i;
+
+    for (i = 0;  i < ILBC_CPU_TIERS;  i++)
+    {
+        if (strcmp(name, tier_names[i]) == 0)
+            break;
+    }
+    if (i >= ILBC_CPU_TIERS)
+        return best;
+    if (i == ILBC_CPU_SCALAR)
+        return ILBC_CPU_SCALAR;
+    if (best == ILBC_CPU_NEON  ||  i == ILBC_CPU_NEON)
+        return (i == best)  ?  best  :  ILBC_CPU_SCALAR;
+    return (i < best)  ?  i  :  best;
+}
+
+int cpuTier(void)
+{
+    const char *name;
+    int t;
+
+    /* The answer is always the same, so if two threads get here at once
+       they just store it twice */
+    if (tier < 0)
+    {
+        t = detect_tier();
+        if ((name = getenv("ILBC_CPU_TIER")))
+            t = limit_tier(t, name);
+        tier = t;
+    }
+    return tier;
+}
+
+int ilbc_cpu_tier(void)
+{
+    return cpuTier();
+}
+
+const char *ilbc_cpu_tier_name(int t)   /* (i) ILBC_CPU_xxx */
+{
+    if (t < 0  ||  t >= ILBC_CPU_TIERS)
+        return NULL;
+    return tier_names[t];
+}
@@ -0,0 +1,20 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * cpuDispatch.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_CPUDISPATCH_H
+#define __iLBC_CPUDISPATCH_H
+
+/* The kernels with vector versions use this to pick one. Each takes
+   the best version it has at or below the tier. */
+int cpuTier(void);
+
+#endif
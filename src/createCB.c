@@ -46,9 +46,8 @@ void filteredCBvecs(float *cbvectors,   /* (o) Codebook vectors for the
     int j;
     int k;
     const float *pp;
-    const float *pp1;
+    float coef;
     float tempbuff2[CB_MEML + CB_FILTERLEN];
-    float *pos;
 
     memset(tempbuff2, 0, (CB_HALFFILTERLEN - 1)*sizeof(float));
     memcpy(&tempbuff2[CB_HALFFILTERLEN - 1], mem, lMem*sizeof(float));
@@ -56,85 +55,79 @@ void filteredCBvecs(float *cbvectors,   /* (o) Codebook vectors for the
 
     /* Create codebook vector for higher section by filtering */
 
-    /* do filtering */
-    pos = cbvectors;
-    memset(pos, 0, lMem*sizeof(float));
-    for (k = 0;  k < lMem;  k++)
+    /* do filtering. The loop over the output samples is the inner one, so
+       it vectorizes, but each output still sums its taps in order. */
+    memset(cbvectors, 0, lMem*sizeof(float));
+    for (j = 0;  j < CB_FILTERLEN;  j++)
     {
-        pp = &tempbuff2[k];
-        pp1 = &cbfiltersTbl[CB_FILTERLEN - 1];
-        for (j = 0;  j < CB_FILTERLEN;  j++)
-            (*pos) += (*pp++)*(*pp1--);
-        pos++;
+        coef = cbfiltersTbl[CB_FILTERLEN - 1 - j];
+        pp = &tempbuff2[j];
+        for (k = 0;  k < lMem;  k++)
+            cbvectors[k] += pp[k]*coef;
     }
 }
 
 /*----------------------------------------------------------------*
- *  Search the augmented part of the codebook to find the best
- *  measure.
- *----------------------------------------------------------------*/
+ *  Build the augmented part of a codebook section, with the
+ *  energies of its vectors. The vectors only depend on the
+ *  codebook memory, so this is done once per sub-block, and
+ *  shared by all the stages of the search.
+ *---------------------------------------------------------------*/
 
-void searchAugmentedCB(int low,             /* (i) Start index for the search */
-                       int high,            /* (i) End index for the search */
-                       int stage,           /* (i) Current stage */
-                       int startIndex,      /* (i) Codebook index for the first
-                                                   aug vector */
-                       float *target,       /* (i) Target vector for encoding */
-                       float *buffer,       /* (i) Pointer to the end of the buffer for
+void augmentedCBvecs(float *augvecs,        /* (o) The augmented vectors, interleaved so
+                                                   augvecs[j*CB_AUG_VECS + k] is sample j
+                                                   of the vector for index k + 20 */
+                     float *buffer,         /* (i) Pointer to the end of the buffer for
                                                    augmented codebook construction */
-                       float *max_measure,  /* (i/o) Currently maximum measure */
-                       int *best_index,     /* (o) Currently the best index */
-                       float *gain,         /* (o) Currently the best gain */
-                       float *energy,       /* (o) Energy of augmented codebook
+                     int startIndex,        /* (i) Codebook index for the first
+                                                   aug vector */
+                     float *energy,         /* (o) Energy of augmented codebook
                                                    vectors */
-                       float *invenergy)    /* (o) Inv energy of augmented codebook
+                     float *invenergy)      /* (o) Inv energy of augmented codebook
                                                    vectors */
 {
     int icount;
     int ilow;
     int j;
+    int k;
     int tmpIndex;
     float *pp;
     float *ppo;
     float *ppi;
     float *ppe;
-    float crossDot;
+    float *pv;
     float alfa;
     float weighted;
-    float measure;
     float nrjRecursive;
-    float ftmp;
 
-    /* Compute the energy for the first (low-5)
-       noninterpolated samples */
+    /* Compute the energy for the first 15 noninterpolated samples */
     nrjRecursive = 0.0f;
-    pp = buffer - low + 1;
-    for (j = 0;  j < (low - 5);  j++)
+    pp = buffer - 20 + 1;
+    for (j = 0;  j < 15;  j++)
     {
         nrjRecursive += ((*pp)*(*pp));
         pp++;
     }
-    ppe = buffer - low;
+    ppe = buffer - 20;
 
-    for (icount = low;  icount <= high;  icount++)
+    for (icount = 20, k = 0;  icount < 20 + CB_AUG_VECS;  icount++, k++)
     {
         /* Index of the codebook vector used for retrieving
            energy values */
-        tmpIndex = startIndex+icount - 20;
+        tmpIndex = startIndex + icount - 20;
 
         ilow = icount - 4;
+        pv = augvecs + k;
 
         /* Update the energy recursively to save complexity */
         nrjRecursive = nrjRecursive + (*ppe)*(*ppe);
         ppe--;
         energy[tmpIndex] = nrjRecursive;
 
-        /* Compute cross dot product for the first (low - 5) samples */
-
-        crossDot = 0.0f;
+        /* The first (icount - 4) samples are copied */
         pp = buffer - icount;
         for (j = 0;  j < ilow;  j++)
-            crossDot += target[j]*(*pp++);
+            pv[j*CB_AUG_VECS] = *pp++;
 
         /* interpolation */
         alfa = 0.2f;
@@ -142,46 +135,90 @@ void searchAugmentedCB(int low,             /* (i) Start index for the search */
         ppi = buffer - icount - 4;
         for (j = ilow;  j < icount;  j++)
         {
-            weighted = (1.0f - alfa)*(*ppo) +alfa*(*ppi);
+            weighted = (1.0f - alfa)*(*ppo) + alfa*(*ppi);
             ppo++;
             ppi++;
             energy[tmpIndex] += weighted*weighted;
-            crossDot += target[j]*weighted;
+            pv[j*CB_AUG_VECS] = weighted;
             alfa += 0.2f;
         }
 
-        /* Compute energy and cross dot product for the
-           remaining samples */
+        /* The remaining samples repeat the end of the buffer */
         pp = buffer - icount;
         for (j = icount;  j < SUBL;  j++)
         {
             energy[tmpIndex] += (*pp)*(*pp);
-            crossDot += target[j]*(*pp++);
+            pv[j*CB_AUG_VECS] = *pp++;
         }
 
         if (energy[tmpIndex] > 0.0f)
-        {
             invenergy[tmpIndex] = 1.0f/(energy[tmpIndex] + EPS);
-        }
         else
-        {
             invenergy[tmpIndex] = 0.0f;
-        }
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Search the augmented part of the codebook to find the best
+ *  measure.
+ *----------------------------------------------------------------*/
+
+void searchAugmentedCB(int low,             /* (i) Start index for the search */
+                       int high,            /* (i) End index for the search */
+                       int stage,           /* (i) Current stage */
+                       int startIndex,      /* (i) Codebook index for the first
+                                                   aug vector */
+                       float *target,       /* (i) Target vector for encoding */
+                       const float *augvecs,    /* (i) The augmented vectors, from
+                                                       augmentedCBvecs() */
+                       float *max_measure,  /* (i/o) Currently maximum measure */
+                       int *best_index,     /* (o) Currently the best index */
+                       float *gain,         /* (o) Currently the best gain */
+                       const float *invenergy)  /* (i) Inv energy of augmented codebook
+                                                       vectors */
+{
+    int icount;
+    int j;
+    int k;
+    int tmpIndex;
+    const float *pv;
+    float crossDot[CB_AUG_VECS];
+    float measure;
+    float ftmp;
+
+    /* Cross dot products for all the vectors together. Each one is
+       still summed in sample order, but the inner loop runs across the
+       vectors, which vectorizes well. */
+    for (k = 0;  k < CB_AUG_VECS;  k++)
+        crossDot[k] = 0.0f;
+    for (j = 0;  j < SUBL;  j++)
+    {
+        pv = augvecs + j*CB_AUG_VECS;
+        for (k = 0;  k < CB_AUG_VECS;  k++)
+            crossDot[k] += target[j]*pv[k];
+    }
+
+    for (icount = low;  icount <= high;  icount++)
+    {
+        /* Index of the codebook vector used for retrieving
+           energy values */
+        tmpIndex = startIndex+icount - 20;
+        k = icount - 20;
 
         if (stage == 0)
         {
             measure = -10000000.0f;
 
-            if (crossDot > 0.0f)
-                measure = crossDot*crossDot*invenergy[tmpIndex];
+            if (crossDot[k] > 0.0f)
+                measure = crossDot[k]*crossDot[k]*invenergy[tmpIndex];
         }
         else
         {
-            measure = crossDot*crossDot*invenergy[tmpIndex];
+            measure = crossDot[k]*crossDot[k]*invenergy[tmpIndex];
         }
 
         /* check if measure is better */
-        ftmp = crossDot*invenergy[tmpIndex];
+        ftmp = crossDot[k]*invenergy[tmpIndex];
 
         if ((measure > *max_measure) && (fabsf(ftmp) < CB_MAXGAIN))
         {
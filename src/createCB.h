@@ -20,27 +20,39 @@
 #ifndef __iLBC_CREATECB_H
 #define __iLBC_CREATECB_H
 
+/* The number of interpolated vectors at the end of each codebook section */
+#define CB_AUG_VECS             20
+
 void filteredCBvecs(float *cbvectors,       /* (o) Codebook vector for the
                                                    higher section */
                     float *mem,             /* (i) Buffer to create codebook
                                                    vectors from */
                     int lMem);              /* (i) Length of buffer */
 
+void augmentedCBvecs(float *augvecs,        /* (o) The augmented vectors, interleaved so
+                                                   augvecs[j*CB_AUG_VECS + k] is sample j
+                                                   of the vector for index k + 20 */
+                     float *buffer,         /* (i) Pointer to the end of the
+                                                   buffer for augmented codebook
+                                                   construction */
+                     int startIndex,        /* (i) CB index for the first
+                                                   augmented vector */
+                     float *energy,         /* (o) Energy of augmented
+                                                   codebook vectors */
+                     float *invenergy);     /* (o) Inv energy of aug codebook vectors */
+
 void searchAugmentedCB(int low,             /* (i) Start index for the search */
                        int high,            /* (i) End index for the search */
                        int stage,           /* (i) Current stage */
                        int startIndex,      /* (i) CB index for the first
                                                    augmented vector */
                        float *target,       /* (i) Target vector for encoding */
-                       float *buffer,       /* (i) Pointer to the end of the
-                                                   buffer for augmented codebook
-                                                   construction */
+                       const float *augvecs,    /* (i) The augmented vectors, from
+                                                       augmentedCBvecs() */
                        float *max_measure,  /* (i/o) Currently maximum measure */
                        int *best_index,     /* (o) Currently the best index */
                        float *gain,         /* (o) Currently the best gain */
-                       float *energy,       /* (o) Energy of augmented
-                                                   codebook vectors */
-                       float *invenergy);   /* (o) Inv energy of aug codebook vectors */
+                       const float *invenergy); /* (i) Inv energy of aug codebook vectors */
 
 void createAugmentedVec(int index,          /* (i) Index for the aug vector to be created */
                         float *buffer,      /* (i) Pointer to the end of the
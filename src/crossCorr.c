@@ -0,0 +1,445 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * crossCorr.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+
+#if defined(__GNUC__)  &&  (defined(__x86_64__)  ||  defined(__i386__))
+#define ILBC_CROSSCORR_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)  ||  defined(__ARM_NEON__)
+#define ILBC_CROSSCORR_NEON
+#include <arm_neon.h>
+#endif
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "cpuDispatch.h"
+#include "crossCorr.h"
+
+/*
+ * All the kernels below put one lag in each vector lane, and step through
+ * the target one sample at a time. Every lane therefore accumulates its
+ * products in exactly the same order as the scalar code, so the results
+ * are bit exact with it whenever the compiler is not allowed to reorder
+ * floating point arithmetic (i.e. without -ffast-math).
+ */
+
+typedef void (*crossCorr_func_t)(float *corr, const float *target, const float *buf, int lTarget, int nLags);
+typedef void (*crossCorrEnergy_func_t)(float *corr, float *energy, const float *target, const float *buf, int lTarget, int nLags);
+
+/*----------------------------------------------------------------*
+ *  Plain C cross correlation, one lag at a time
+ *---------------------------------------------------------------*/
+
+static void crossCorr_scalar(float *corr,           /* (o) correlation for each lag */
+                             const float *target,   /* (i) target vector */
+                             const float *buf,      /* (i) window for lag 0 */
+                             int lTarget,           /* (i) length of target vector */
+                             int nLags)             /* (i) number of lags */
+{
+    int i;
+    int j;
+    float sum;
+    const float *pp;
+
+    for (i = 0;  i < nLags;  i++)
+    {
+        sum = 0.0f;
+        pp = buf - i;
+        for (j = 0;  j < lTarget;  j++)
+            sum += target[j]*pp[j];
+        corr[i] = sum;
+    }
+}
+
+static void crossCorrEnergy_scalar(float *corr,           /* (o) correlation for each lag */
+                                   float *energy,         /* (o) window energy for each lag */
+                                   const float *target,   /* (i) target vector */
+                                   const float *buf,      /* (i) window for lag 0 */
+                                   int lTarget,           /* (i) length of target vector */
+                                   int nLags)             /* (i) number of lags */
+{
+    int i;
+    int j;
+    float sum;
+    float en;
+    const float *pp;
+
+    for (i = 0;  i < nLags;  i++)
+    {
+        sum = 0.0f;
+        en = 0.0f;
+        pp = buf - i;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            sum += target[j]*pp[j];
+            en += pp[j]*pp[j];
+        }
+        corr[i] = sum;
+        energy[i] = en;
+    }
+}
+
+
+#if defined(ILBC_CROSSCORR_X86)
+/*----------------------------------------------------------------*
+ *  SSE2 cross correlation, 4 lags to a register
+ *---------------------------------------------------------------*/
+
+__attribute__((target("sse2")))
+static void crossCorr_sse2(float *corr,
+                           const float *target,
+                           const float *buf,
+                           int lTarget,
+                           int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    __m128 t;
+    __m128 acc0;
+    __m128 acc1;
+
+    i = 0;
+    for (  ;  i + 8 <= nLags;  i += 8)
+    {
+        acc0 = _mm_setzero_ps();
+        acc1 = _mm_setzero_ps();
+        /* Lane 0 of acc0 holds lag i + 3, lane 3 holds lag i */
+        pp = buf - i - 3;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            t = _mm_set1_ps(target[j]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(t, _mm_loadu_ps(pp + j)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(t, _mm_loadu_ps(pp + j - 4)));
+        }
+        _mm_storeu_ps(corr + i, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_ps(corr + i + 4, _mm_shuffle_ps(acc1, acc1, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    for (  ;  i + 4 <= nLags;  i += 4)
+    {
+        acc0 = _mm_setzero_ps();
+        pp = buf - i - 3;
+        for (j = 0;  j < lTarget;  j++)
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_set1_ps(target[j]), _mm_loadu_ps(pp + j)));
+        _mm_storeu_ps(corr + i, _mm_shuffle_ps(acc0, acc0, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    if (i < nLags)
+        crossCorr_scalar(corr + i, target, buf - i, lTarget, nLags - i);
+}
+
+__attribute__((target("sse2")))
+static void crossCorrEnergy_sse2(float *corr,
+                                 float *energy,
+                                 const float *target,
+                                 const float *buf,
+                                 int lTarget,
+                                 int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    __m128 v;
+    __m128 acc;
+    __m128 en;
+
+    i = 0;
+    for (  ;  i + 4 <= nLags;  i += 4)
+    {
+        acc = _mm_setzero_ps();
+        en = _mm_setzero_ps();
+        /* Lane 0 holds lag i + 3, lane 3 holds lag i */
+        pp = buf - i - 3;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            v = _mm_loadu_ps(pp + j);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(target[j]), v));
+            en = _mm_add_ps(en, _mm_mul_ps(v, v));
+        }
+        _mm_storeu_ps(corr + i, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(0, 1, 2, 3)));
+        _mm_storeu_ps(energy + i, _mm_shuffle_ps(en, en, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+    if (i < nLags)
+        crossCorrEnergy_scalar(corr + i, energy + i, target, buf - i, lTarget, nLags - i);
+}
+
+/*----------------------------------------------------------------*
+ *  AVX2 cross correlation, 8 lags to a register
+ *---------------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void crossCorr_avx2(float *corr,
+                           const float *target,
+                           const float *buf,
+                           int lTarget,
+                           int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    __m256 t;
+    __m256 acc0;
+    __m256 acc1;
+    __m256i rev;
+
+    rev = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    i = 0;
+    for (  ;  i + 16 <= nLags;  i += 16)
+    {
+        acc0 = _mm256_setzero_ps();
+        acc1 = _mm256_setzero_ps();
+        /* Lane 0 of acc0 holds lag i + 7, lane 7 holds lag i */
+        pp = buf - i - 7;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            t = _mm256_set1_ps(target[j]);
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(t, _mm256_loadu_ps(pp + j)));
+            acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(t, _mm256_loadu_ps(pp + j - 8)));
+        }
+        _mm256_storeu_ps(corr + i, _mm256_permutevar8x32_ps(acc0, rev));
+        _mm256_storeu_ps(corr + i + 8, _mm256_permutevar8x32_ps(acc1, rev));
+    }
+    for (  ;  i + 8 <= nLags;  i += 8)
+    {
+        acc0 = _mm256_setzero_ps();
+        pp = buf - i - 7;
+        for (j = 0;  j < lTarget;  j++)
+            acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_set1_ps(target[j]), _mm256_loadu_ps(pp + j)));
+        _mm256_storeu_ps(corr + i, _mm256_permutevar8x32_ps(acc0, rev));
+    }
+    if (i < nLags)
+    {
+        /* The SSE2 code is not VEX encoded, so it would run slowly, here
+           and in the rest of the library, with the upper halves dirty */
+        _mm256_zeroupper();
+        crossCorr_sse2(corr + i, target, buf - i, lTarget, nLags - i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void crossCorrEnergy_avx2(float *corr,
+                                 float *energy,
+                                 const float *target,
+                                 const float *buf,
+                                 int lTarget,
+                                 int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    __m256 v;
+    __m256 acc;
+    __m256 en;
+    __m256i rev;
+
+    rev = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    i = 0;
+    for (  ;  i + 8 <= nLags;  i += 8)
+    {
+        acc = _mm256_setzero_ps();
+        en = _mm256_setzero_ps();
+        /* Lane 0 holds lag i + 7, lane 7 holds lag i */
+        pp = buf - i - 7;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            v = _mm256_loadu_ps(pp + j);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(target[j]), v));
+            en = _mm256_add_ps(en, _mm256_mul_ps(v, v));
+        }
+        _mm256_storeu_ps(corr + i, _mm256_permutevar8x32_ps(acc, rev));
+        _mm256_storeu_ps(energy + i, _mm256_permutevar8x32_ps(en, rev));
+    }
+    if (i < nLags)
+    {
+        /* As for crossCorr_avx2() */
+        _mm256_zeroupper();
+        crossCorrEnergy_sse2(corr + i, energy + i, target, buf - i, lTarget, nLags - i);
+    }
+}
+#endif
+
+#if defined(ILBC_CROSSCORR_NEON)
+/*----------------------------------------------------------------*
+ *  NEON cross correlation, 4 lags to a register
+ *---------------------------------------------------------------*/
+
+static void crossCorr_neon(float *corr,
+                           const float *target,
+                           const float *buf,
+                           int lTarget,
+                           int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    float32x4_t t;
+    float32x4_t acc0;
+    float32x4_t acc1;
+
+    i = 0;
+    for (  ;  i + 8 <= nLags;  i += 8)
+    {
+        acc0 = vdupq_n_f32(0.0f);
+        acc1 = vdupq_n_f32(0.0f);
+        /* Lane 0 of acc0 holds lag i + 3, lane 3 holds lag i. Keep the
+           multiply and add separate, so we don't get a fused result. */
+        pp = buf - i - 3;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            t = vdupq_n_f32(target[j]);
+            acc0 = vaddq_f32(acc0, vmulq_f32(t, vld1q_f32(pp + j)));
+            acc1 = vaddq_f32(acc1, vmulq_f32(t, vld1q_f32(pp + j - 4)));
+        }
+        acc0 = vrev64q_f32(acc0);
+        acc1 = vrev64q_f32(acc1);
+        vst1q_f32(corr + i, vcombine_f32(vget_high_f32(acc0), vget_low_f32(acc0)));
+        vst1q_f32(corr + i + 4, vcombine_f32(vget_high_f32(acc1), vget_low_f32(acc1)));
+    }
+    if (i < nLags)
+        crossCorr_scalar(corr + i, target, buf - i, lTarget, nLags - i);
+}
+
+static void crossCorrEnergy_neon(float *corr,
+                                 float *energy,
+                                 const float *target,
+                                 const float *buf,
+                                 int lTarget,
+                                 int nLags)
+{
+    int i;
+    int j;
+    const float *pp;
+    float32x4_t v;
+    float32x4_t acc;
+    float32x4_t en;
+
+    i = 0;
+    for (  ;  i + 4 <= nLags;  i += 4)
+    {
+        acc = vdupq_n_f32(0.0f);
+        en = vdupq_n_f32(0.0f);
+        /* Lane 0 holds lag i + 3, lane 3 holds lag i */
+        pp = buf - i - 3;
+        for (j = 0;  j < lTarget;  j++)
+        {
+            v = vld1q_f32(pp + j);
+            acc = vaddq_f32(acc, vmulq_f32(vdupq_n_f32(target[j]), v));
+            en = vaddq_f32(en, vmulq_f32(v, v));
+        }
+        acc = vrev64q_f32(acc);
+        en = vrev64q_f32(en);
+        vst1q_f32(corr + i, vcombine_f32(vget_high_f32(acc), vget_low_f32(acc)));
+        vst1q_f32(energy + i, vcombine_f32(vget_high_f32(en), vget_low_f32(en)));
+    }
+    if (i < nLags)
+        crossCorrEnergy_scalar(corr + i, energy + i, target, buf - i, lTarget, nLags - i);
+}
+#endif
+
+/*----------------------------------------------------------------*
+ *  Pick the best kernel for this CPU the first time we are called
+ *---------------------------------------------------------------*/
+
+static void crossCorr_select(float *corr, const float *target, const float *buf, int lTarget, int nLags);
+
+static crossCorr_func_t crossCorr_impl = crossCorr_select;
+
+static void crossCorr_select(float *corr,
+                             const float *target,
+                             const float *buf,
+                             int lTarget,
+                             int nLags)
+{
+    crossCorr_func_t func;
+
+    func = crossCorr_scalar;
+#if defined(ILBC_CROSSCORR_X86)
+    if (cpuTier() >= ILBC_CPU_AVX2)
+        func = crossCorr_avx2;
+    else if (cpuTier() >= ILBC_CPU_SSE2)
+        func = crossCorr_sse2;
+#elif defined(ILBC_CROSSCORR_NEON)
+    if (cpuTier() == ILBC_CPU_NEON)
+        func = crossCorr_neon;
+#endif
+    crossCorr_impl = func;
+    func(corr, target, buf, lTarget, nLags);
+}
+
+static void crossCorrEnergy_select(float *corr, float *energy, const float *target, const float *buf, int lTarget, int nLags);
+
+static crossCorrEnergy_func_t crossCorrEnergy_impl = crossCorrEnergy_select;
+
+static void crossCorrEnergy_select(float *corr,
+                                   float *energy,
+                                   const float *target,
+                                   const float *buf,
+                                   int lTarget,
+                                   int nLags)
+{
+    crossCorrEnergy_func_t func;
+
+    func = crossCorrEnergy_scalar;
+#if defined(ILBC_CROSSCORR_X86)
+    if (cpuTier() >= ILBC_CPU_AVX2)
+        func = crossCorrEnergy_avx2;
+    else if (cpuTier() >= ILBC_CPU_SSE2)
+        func = crossCorrEnergy_sse2;
+#elif defined(ILBC_CROSSCORR_NEON)
+    if (cpuTier() == ILBC_CPU_NEON)
+        func = crossCorrEnergy_neon;
+#endif
+    crossCorrEnergy_impl = func;
+    func(corr, energy, target, buf, lTarget, nLags);
+}
+
+/*----------------------------------------------------------------*
+ *  Cross correlation of a target against a sliding window, for a
+ *  run of consecutive lags, in one call.
+ *---------------------------------------------------------------*/
+
+void crossCorr(float *corr,             /* (o) corr[i] is the dot product of target
+                                               and the window starting at buf - i */
+               const float *target,     /* (i) target vector */
+               const float *buf,        /* (i) start of the window for lag 0 */
+               int lTarget,             /* (i) length of target vector */
+               int nLags)               /* (i) number of lags to compute */
+{
+    if (nLags <= 0)
+        return;
+    crossCorr_impl(corr, target, buf, lTarget, nLags);
+}
+
+/*----------------------------------------------------------------*
+ *  As crossCorr(), also finding the energy of the window for each
+ *  lag.
+ *---------------------------------------------------------------*/
+
+void crossCorrEnergy(float *corr,           /* (o) corr[i] is the dot product of target
+                                                   and the window starting at buf - i */
+                     float *energy,         /* (o) energy[i] is the energy of the window
+                                                   starting at buf - i */
+                     const float *target,   /* (i) target vector */
+                     const float *buf,      /* (i) start of the window for lag 0 */
+                     int lTarget,           /* (i) length of target vector */
+                     int nLags)             /* (i) number of lags to compute */
+{
+    if (nLags <= 0)
+        return;
+    crossCorrEnergy_impl(corr, energy, target, buf, lTarget, nLags);
+}
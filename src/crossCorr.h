@@ -0,0 +1,37 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * crossCorr.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_CROSSCORR_H
+#define __iLBC_CROSSCORR_H
+
+void crossCorr(float *corr,             /* (o) corr[i] is the dot product of target
+                                               and the window starting at buf - i */
+               const float *target,     /* (i) target vector */
+               const float *buf,        /* (i) start of the window for lag 0. Samples
+                                               buf[-(nLags - 1)] to buf[lTarget - 1]
+                                               must be valid */
+               int lTarget,             /* (i) length of target vector, at most
+                                               ENH_BLOCKL */
+               int nLags);              /* (i) number of lags to compute. lTarget + nLags
+                                               must be no more than CB_MEML + SUBL + 1 */
+
+void crossCorrEnergy(float *corr,           /* (o) corr[i] is the dot product of target
+                                                   and the window starting at buf - i */
+                     float *energy,         /* (o) energy[i] is the energy of the window
+                                                   starting at buf - i */
+                     const float *target,   /* (i) target vector */
+                     const float *buf,      /* (i) start of the window for lag 0, with the
+                                                   same limits as for crossCorr() */
+                     int lTarget,           /* (i) length of target vector */
+                     int nLags);            /* (i) number of lags to compute */
+
+#endif
@@ -76,16 +76,36 @@ static void compCorr(float *cc,        /* (o) cross correlation coefficient */
     }
 }
 
+/*----------------------------------------------------------------*
+ *  Mix pitch repetition and noise into the concealed residual.
+ *  pitch must not overlap the part of out being written.
+ *---------------------------------------------------------------*/
+
+static void mixExcitation(float out[],          /* (o) concealed residual */
+                          const float pitch[],  /* (i) pitch repetition component */
+                          const float noise[],  /* (i) noise component */
+                          float gain,           /* (i) overall gain */
+                          float pitchfact,      /* (i) share of the pitch component */
+                          int len)              /* (i) number of samples */
+{
+    int i;
+    float noisefact;
+
+    noisefact = 1.0f - pitchfact;
+    for (i = 0;  i < len;  i++)
+        out[i] = gain*(pitchfact*pitch[i] + noisefact*noise[i]);
+}
+
 /*----------------------------------------------------------------*
  *  Packet loss concealment routine. Conceals a residual signal
  *  and LP parameters. If no packet loss, update state.
  *---------------------------------------------------------------*/
 
-void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
-              float *PLClpc,                        /* (o) concealed LP parameters */
+void doThePLC(float *PLCresidual,                   /* (o) concealed residual (only set for PL) */
+              float *PLClpc,                        /* (o) concealed LP parameters (only set for PL) */
               int PLI,                              /* (i) packet loss indicator
                                                            0 - no PL, 1 = PL */
-              float *decresidual,                   /* (i) decoded residual */
+              float *decresidual,                   /* (i) decoded residual (only used for no PL) */
               float *lpc,                           /* (i) decoded LPC (only used for no PL) */
               int inlag,                            /* (i) pitch lag */
               ilbc_decode_state_t *iLBCdec_inst)    /* (i/o) decoder instance */
@@ -103,6 +123,9 @@ void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
     float randvec[ILBC_BLOCK_LEN_MAX];
     float pitchfact;
     float energy;
+    float gain_scale;
+    const float *pitch;
+    int end;
 
     /* Packet Loss */
     if (PLI == 1)
@@ -172,11 +195,9 @@ void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
         if (lag < 80)
             use_lag = 2*lag;
 
-        /* compute concealed residual */
-        energy = 0.0f;
+        /* noise component, taken from random points in the history */
         for (i = 0;  i < iLBCdec_inst->blockl;  i++)
         {
-            /* noise component */
             iLBCdec_inst->seed = (iLBCdec_inst->seed*69069L + 1) & (0x80000000L - 1);
             randlag = 50 + ((signed long) iLBCdec_inst->seed)%70;
             pick = i - randlag;
@@ -185,25 +206,45 @@ void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
                 randvec[i] = iLBCdec_inst->prevResidual[iLBCdec_inst->blockl + pick];
             else
                 randvec[i] = randvec[pick];
+        }
 
-            /* pitch repeatition component */
-            pick = i - use_lag;
-
-            if (pick < 0)
-                PLCresidual[i] = iLBCdec_inst->prevResidual[iLBCdec_inst->blockl + pick];
-            else
-                PLCresidual[i] = PLCresidual[pick];
-
-            /* mix random and periodicity component */
+        /* pitch repeatition component, mixed with the noise. Each piece
+           is no longer than use_lag, so it only looks back at samples
+           already finished, and the mixing vectorises. */
+        for (i = 0;  i < iLBCdec_inst->blockl;  i = end)
+        {
+            end = i + use_lag;
+            if (i < use_lag)
+                end = use_lag;
             if (i < 80)
-                PLCresidual[i] = use_gain*(pitchfact*PLCresidual[i] + (1.0f - pitchfact) * randvec[i]);
+            {
+                gain_scale = use_gain;
+                if (end > 80)
+                    end = 80;
+            }
             else if (i < 160)
-                PLCresidual[i] = 0.95f*use_gain*(pitchfact*PLCresidual[i] + (1.0f - pitchfact) * randvec[i]);
+            {
+                gain_scale = 0.95f*use_gain;
+                if (end > 160)
+                    end = 160;
+            }
             else
-                PLCresidual[i] = 0.9f*use_gain*(pitchfact*PLCresidual[i] + (1.0f - pitchfact) * randvec[i]);
-            energy += PLCresidual[i] * PLCresidual[i];
+            {
+                gain_scale = 0.9f*use_gain;
+            }
+            if (end > iLBCdec_inst->blockl)
+                end = iLBCdec_inst->blockl;
+            if (i < use_lag)
+                pitch = iLBCdec_inst->prevResidual + iLBCdec_inst->blockl - use_lag + i;
+            else
+                pitch = PLCresidual + i - use_lag;
+            mixExcitation(PLCresidual + i, pitch, randvec + i, gain_scale, pitchfact, end - i);
         }
 
+        energy = 0.0f;
+        for (i = 0;  i < iLBCdec_inst->blockl;  i++)
+            energy += PLCresidual[i] * PLCresidual[i];
+
         /* less than 30 dB, use only noise */
         if (sqrt(energy/(float) iLBCdec_inst->blockl) < 30.0f)
         {
@@ -217,9 +258,10 @@ void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
     }
     else
     {
-        /* no packet loss, copy input */
-        memcpy(PLCresidual, decresidual, iLBCdec_inst->blockl*sizeof(float));
-        memcpy(PLClpc, lpc, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+        /* no packet loss. The decoded residual and LPC are kept as they
+           are, with no copy through the outputs. */
+        PLCresidual = decresidual;
+        PLClpc = lpc;
         iLBCdec_inst->consPLICount = 0;
     }
 
@@ -20,10 +20,10 @@
 #ifndef __iLBC_DOCLPC_H
 #define __iLBC_DOCLPC_H
 
-void doThePLC(float *PLCresidual,                   /* (o) concealed residual */
-              float *PLClpc,                        /* (o) concealed LP parameters */
+void doThePLC(float *PLCresidual,                   /* (o) concealed residual (only set for PL) */
+              float *PLClpc,                        /* (o) concealed LP parameters (only set for PL) */
               int PLI,                              /* (i) packet loss indicator, 0 - no PL, 1 = PL */
-              float *decresidual,                   /* (i) decoded residual */
+              float *decresidual,                   /* (i) decoded residual (only used for no PL) */
               float *lpc,                           /* (i) decoded LPC (only used for no PL) */
               int inlag,                            /* (i) pitch lag */
               ilbc_decode_state_t *iLBCdec_inst);   /* (i/o) decoder instance */
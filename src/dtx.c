@@ -0,0 +1,194 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * dtx.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "syntFilter.h"
+#include "dtx.h"
+
+/* Decoded reflection coefficients are kept inside this, so the comfort
+   noise filter is always stable */
+#define CNG_MAX_REFLECTION      0.99f
+/* Scales uniform noise in -1 to +1 to unit power */
+#define CNG_UNIFORM_SCALE       1.7320508f
+
+/*----------------------------------------------------------------*
+ *  Encoder side: decide if a frame is speech, from its energy
+ *  against a floor which follows the background noise.
+ *---------------------------------------------------------------*/
+
+int vadDetect(ilbc_encode_state_t *iLBCenc_inst,   /* (i/o) the encoder state structure */
+              float energy)                        /* (i) mean square of the frame */
+{
+    /* The floor drops at once to a quieter frame, but only rises slowly, so
+       it sits at the quiet parts between words */
+    if (energy < iLBCenc_inst->vad_noise*VAD_NOISE_RISE)
+        iLBCenc_inst->vad_noise = energy;
+    else
+        iLBCenc_inst->vad_noise *= VAD_NOISE_RISE;
+    if (iLBCenc_inst->vad_noise < 1.0f)
+        iLBCenc_inst->vad_noise = 1.0f;
+
+    if (energy > VAD_SILENCE_ENERGY  &&  energy > iLBCenc_inst->vad_noise*VAD_SPEECH_RATIO)
+    {
+        iLBCenc_inst->vad_hangover = VAD_HANGOVER;
+        return 1;
+    }
+    /* Carry on a little, so the ends of words are not clipped */
+    if (iLBCenc_inst->vad_hangover > 0)
+    {
+        iLBCenc_inst->vad_hangover -= iLBCenc_inst->blockl;
+        return 1;
+    }
+    return 0;
+}
+
+/*----------------------------------------------------------------*
+ *  Encoder side: decide if a silent frame needs a new SID. One is
+ *  sent at the start of a silence, when the level changes, and
+ *  now and then for steady noise.
+ *---------------------------------------------------------------*/
+
+int dtxSidDue(ilbc_encode_state_t *iLBCenc_inst,    /* (i/o) the encoder state structure */
+              float energy)                         /* (i) mean square of the frame */
+{
+    if (iLBCenc_inst->sid_age >= 0)
+    {
+        iLBCenc_inst->sid_age += iLBCenc_inst->blockl;
+        if (iLBCenc_inst->sid_age < DTX_SID_INTERVAL
+            &&
+            energy < iLBCenc_inst->sid_energy*DTX_SID_CHANGE
+            &&
+            energy*DTX_SID_CHANGE > iLBCenc_inst->sid_energy)
+        {
+            return 0;
+        }
+    }
+    iLBCenc_inst->sid_age = 0;
+    iLBCenc_inst->sid_energy = energy;
+    return 1;
+}
+
+/*----------------------------------------------------------------*
+ *  Encoder side: build a SID, as RFC 3389. The first byte is the
+ *  level, in -dBov, and then each reflection coefficient is
+ *  quantised uniformly to 8 bits over -1 to +1.
+ *---------------------------------------------------------------*/
+
+int sidEncode(uint8_t sid[],        /* (o) the SID */
+              float energy,         /* (i) mean square of the frame, no less than DTX_SID_FLOOR */
+              const float k[])      /* (i) reflection coefficients */
+{
+    int i;
+    int q;
+
+    q = (int) lrintf(-10.0f*log10f(energy/CNG_FULL_SCALE));
+    if (q < 0)
+        q = 0;
+    else if (q > 127)
+        q = 127;
+    sid[0] = (uint8_t) q;
+    for (i = 0;  i < ILBC_LPC_FILTERORDER;  i++)
+    {
+        q = (int) lrintf(k[i]*127.0f) + 127;
+        if (q < 0)
+            q = 0;
+        else if (q > 254)
+            q = 254;
+        sid[i + 1] = (uint8_t) q;
+    }
+    return ILBC_SID_LEN_MAX;
+}
+
+/*----------------------------------------------------------------*
+ *  Decoder side: take up the noise described by a SID. A SID may
+ *  carry fewer coefficients than the filter order, or none.
+ *---------------------------------------------------------------*/
+
+int cngUpdate(ilbc_decode_state_t *iLBCdec_inst,    /* (i/o) the decoder state structure */
+              const uint8_t sid[],                  /* (i) the SID */
+              int len)                              /* (i) length of the SID, in bytes */
+{
+    float k[ILBC_LPC_FILTERORDER];
+    float a[ILBC_LPC_FILTERORDER + 1];
+    float energy;
+    int order;
+    int m;
+    int i;
+
+    order = len - 1;
+    if (order < 0  ||  order > ILBC_LPC_FILTERORDER)
+        return -1;
+    energy = CNG_FULL_SCALE*powf(10.0f, -0.1f*(float) (sid[0] & 0x7F));
+    for (i = 0;  i < order;  i++)
+    {
+        k[i] = (float) (sid[i + 1] - 127)/127.0f;
+        if (k[i] > CNG_MAX_REFLECTION)
+            k[i] = CNG_MAX_REFLECTION;
+        else if (k[i] < -CNG_MAX_REFLECTION)
+            k[i] = -CNG_MAX_REFLECTION;
+    }
+
+    /* Step up from reflection coefficients to the filter, undoing levdurb(),
+       while working out how much the filter raises the level of white noise */
+    memset(iLBCdec_inst->cng_a, 0, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    iLBCdec_inst->cng_a[0] = 1.0f;
+    for (m = 0;  m < order;  m++)
+    {
+        for (i = 1;  i <= m;  i++)
+            a[i] = iLBCdec_inst->cng_a[i] + k[m]*iLBCdec_inst->cng_a[m + 1 - i];
+        for (i = 1;  i <= m;  i++)
+            iLBCdec_inst->cng_a[i] = a[i];
+        iLBCdec_inst->cng_a[m + 1] = k[m];
+        energy *= 1.0f - k[m]*k[m];
+    }
+    iLBCdec_inst->cng_target = sqrtf(energy)*CNG_UNIFORM_SCALE;
+    return 0;
+}
+
+/*----------------------------------------------------------------*
+ *  Decoder side: make a frame of comfort noise. The excitation is
+ *  drawn from the same random sequence as the packet loss
+ *  concealment's noise, and the level is ramped to that of the
+ *  latest SID over the frame.
+ *---------------------------------------------------------------*/
+
+void cngGenerate(float out[],                        /* (o) a frame of comfort noise */
+                 ilbc_decode_state_t *iLBCdec_inst)  /* (i/o) the decoder state structure */
+{
+    int i;
+    float gain;
+    float step;
+
+    gain = iLBCdec_inst->cng_gain;
+    step = (iLBCdec_inst->cng_target - gain)/(float) iLBCdec_inst->blockl;
+    for (i = 0;  i < iLBCdec_inst->blockl;  i++)
+    {
+        iLBCdec_inst->seed = (iLBCdec_inst->seed*69069L + 1) & (0x80000000L - 1);
+        gain += step;
+        out[i] = gain*((float) iLBCdec_inst->seed*(1.0f/1073741824.0f) - 1.0f);
+    }
+    iLBCdec_inst->cng_gain = iLBCdec_inst->cng_target;
+    /* syntFilter() works on at most a subframe at a time */
+    for (i = 0;  i < iLBCdec_inst->blockl;  i += SUBL)
+        syntFilter(&out[i], iLBCdec_inst->cng_a, SUBL, iLBCdec_inst->cng_mem);
+}
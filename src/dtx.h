@@ -0,0 +1,33 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * dtx.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_DTX_H
+#define __iLBC_DTX_H
+
+int vadDetect(ilbc_encode_state_t *iLBCenc_inst,   /* (i/o) the encoder state structure */
+              float energy);                       /* (i) mean square of the frame */
+
+int dtxSidDue(ilbc_encode_state_t *iLBCenc_inst,    /* (i/o) the encoder state structure */
+              float energy);                        /* (i) mean square of the frame */
+
+int sidEncode(uint8_t sid[],        /* (o) the SID */
+              float energy,         /* (i) mean square of the frame */
+              const float k[]);     /* (i) reflection coefficients */
+
+int cngUpdate(ilbc_decode_state_t *iLBCdec_inst,    /* (i/o) the decoder state structure */
+              const uint8_t sid[],                  /* (i) the SID */
+              int len);                             /* (i) length of the SID, in bytes */
+
+void cngGenerate(float out[],                        /* (o) a frame of comfort noise */
+                 ilbc_decode_state_t *iLBCdec_inst); /* (i/o) the decoder state structure */
+
+#endif
@@ -30,6 +30,7 @@
 #include "ilbc2.h"
 #include "constants.h"
 #include "filter.h"
+#include "crossCorr.h"
 #include "enhancer.h"
 
 /*----------------------------------------------------------------*
@@ -69,29 +70,32 @@ static void NearestNeighbor(int *index,            /* (o) index of array element
 
 static void mycorr1(float *corr,       /* (o) correlation of seq1 and seq2 */
                     float *seq1,       /* (i) first sequence */
-                    int dim1,          /* (i) dimension first seq1 */
+                    int dim1,          /* (i) dimension first seq1, at most ENH_VECTL */
                     const float *seq2, /* (i) second sequence */
                     int dim2)          /* (i) dimension seq2 */
 {
+    float rev[ENH_VECTL];
+    int n;
     int i;
-    int j;
 
-    for (i = 0;  i <= dim1 - dim2;  i++)
-    {
-        corr[i] = 0.0f;
-        for (j = 0;  j < dim2;  j++)
-            corr[i] += seq1[i + j]*seq2[j];
-    }
+    /* crossCorr() steps its window backwards, so it produces the lags in
+       reverse order */
+    n = dim1 - dim2 + 1;
+    crossCorr(rev, seq2, seq1 + n - 1, dim2, n);
+    for (i = 0;  i < n;  i++)
+        corr[i] = rev[n - 1 - i];
 }
 
 /*----------------------------------------------------------------*
- * upsample finite array assuming zeros outside bounds
+ * upsample finite array assuming zeros outside bounds. Only
+ * the phases 0, step, 2*step ... are produced.
  *---------------------------------------------------------------*/
 
 static void enh_upsample(float *useq1,     /* (o) upsampled output sequence */
                          float *seq1,      /* (i) unupsampled sequence */
                          int dim1,         /* (i) dimension seq1 */
-                         int hfl)          /* (i) polyphase filter length=2*hfl+1 */
+                         int hfl,          /* (i) polyphase filter length=2*hfl+1 */
+                         int step)         /* (i) use every step'th phase, for ENH_UPS0/step upsampling */
 {
     float *pu;
     float *ps;
@@ -126,7 +130,7 @@ static void enh_upsample(float *useq1,     /* (o) upsampled output sequence */
     pu = useq1;
     for (i = hfl;  i < filterlength;  i++)
     {
-        for (j = 0;  j < ENH_UPS0;  j++)
+        for (j = 0;  j < ENH_UPS0;  j += step)
         {
             *pu = 0.0f;
             pp = polyp[j];
@@ -140,7 +144,7 @@ static void enh_upsample(float *useq1,     /* (o) upsampled output sequence */
     /* filtering: simple convolution=inner products */
     for (i = filterlength;  i < dim1;  i++)
     {
-        for (j = 0;  j < ENH_UPS0;  j++)
+        for (j = 0;  j < ENH_UPS0;  j += step)
         {
             *pu = 0.0f;
             pp = polyp[j];
@@ -154,7 +158,7 @@ static void enh_upsample(float *useq1,     /* (o) upsampled output sequence */
     /* filtering: filter overhangs right side of sequence */
     for (q = 1;  q <= hfl;  q++)
     {
-        for (j = 0;  j < ENH_UPS0;  j++)
+        for (j = 0;  j < ENH_UPS0;  j += step)
         {
             *pu = 0.0f;
             pp = polyp[j] + q;
@@ -180,7 +184,8 @@ static void refiner(float *seg,            /* (o) segment array */
                     int idatal,            /* (i) dimension of idata */
                     int centerStartPos,    /* (i) beginning center segment */
                     float estSegPos,       /* (i) estimated beginning other segment */
-                    float period)          /* (i) estimated pitch period */
+                    float period,          /* (i) estimated pitch period */
+                    int step)              /* (i) search at ENH_UPS0/step times the sampling rate */
 {
     int estSegPosRounded;
     int searchSegStartPos;
@@ -192,6 +197,7 @@ static void refiner(float *seg,            /* (o) segment array */
     int st;
     int en;
     int fraction;
+    int phases;
     float vect[ENH_VECTL];
     float corrVec[ENH_CORRDIM];
     float maxv;
@@ -214,10 +220,11 @@ static void refiner(float *seg,            /* (o) segment array */
 
     /* compute upsampled correlation (corr33) and find location of max */
     mycorr1(corrVec, idata + searchSegStartPos, corrdim + ENH_BLOCKL - 1, idata + centerStartPos, ENH_BLOCKL);
-    enh_upsample(corrVecUps, corrVec, corrdim, ENH_FL0);
+    enh_upsample(corrVecUps, corrVec, corrdim, ENH_FL0, step);
+    phases = ENH_UPS0/step;
     tloc = 0;
     maxv = corrVecUps[0];
-    for (i = 1;  i < ENH_UPS0*corrdim;  i++)
+    for (i = 1;  i < phases*corrdim;  i++)
     {
         if (corrVecUps[i]>maxv)
         {
@@ -225,6 +232,8 @@ static void refiner(float *seg,            /* (o) segment array */
             maxv = corrVecUps[i];
         }
     }
+    /* Back to a position in units of 1/ENH_UPS0 samples */
+    tloc = (tloc/phases)*ENH_UPS0 + (tloc%phases)*step;
 
     /* make vector can be upsampled without ever running outside bounds */
     *updStartPos = (float) searchSegStartPos + (float) tloc/(float) ENH_UPS0 + 1.0f;
@@ -255,8 +264,13 @@ static void refiner(float *seg,            /* (o) segment array */
     }
     fraction = tloc2*ENH_UPS0 - tloc;
 
-    /* compute the segment (this is actually a convolution) */
-    mycorr1(seg, vect, ENH_VECTL, polyphaserTbl + (2*ENH_FL0 + 1)*fraction, 2*ENH_FL0 + 1);
+    /* compute the segment (this is actually a convolution). The first
+       phase of the filter is a unit impulse, so a whole sample position
+       just needs a copy. */
+    if (fraction == 0)
+        memcpy(seg, vect + ENH_FL0, ENH_BLOCKL*sizeof(float));
+    else
+        mycorr1(seg, vect, ENH_VECTL, polyphaserTbl + (2*ENH_FL0 + 1)*fraction, 2*ENH_FL0 + 1);
 }
 
 /*----------------------------------------------------------------*
@@ -266,7 +280,8 @@ static void refiner(float *seg,            /* (o) segment array */
 static void smath(float *odata,    /* (o) smoothed output */
                   float *sseq,     /* (i) said second sequence of waveforms */
                   int hl,          /* (i) 2*hl+1 is sseq dimension */
-                  float alpha0)    /* (i) max smoothing energy fraction */
+                  float alpha0,    /* (i) max smoothing energy fraction */
+                  const float *wt) /* (i) waveform weighting to get surround shape, 2*hl+1 long */
 {
     int i;
     int k;
@@ -279,15 +294,11 @@ static void smath(float *odata,    /* (o) smoothed output */
     float *psseq;
     float err,errs;
     float surround[ILBC_BLOCK_LEN_MAX]; /* shape contributed by other than current */
-    float wt[2*ENH_HL + 1];     /* waveform weighting to get surround shape */
     float denom;
 
     /* create shape of contribution from all waveforms except the
        current one */
 
-    for (i = 1;  i <= 2*hl + 1;  i++)
-        wt[i - 1] = 0.5f*(1.0f - cosf(2.0f*PI*i/(2.0f*hl + 2.0f)));
-    wt[hl] = 0.0f; /* for clarity, not used */
     for (i = 0;  i < ENH_BLOCKL;  i++)
         surround[i] = sseq[i]*wt[0];
 
@@ -369,7 +380,8 @@ static void getsseq(float *sseq,           /* (o) the pitch-synchronous sequence
                     float *period,         /* (i) rough-pitch-period array */
                     const float *plocs,    /* (i) where periods of period array are taken */
                     int periodl,           /* (i) dimension period array */
-                    int hl)                /* (i) 2*hl+1 is the number of sequences */
+                    int hl,                /* (i) 2*hl+1 is the number of sequences */
+                    int step)              /* (i) refine at ENH_UPS0/step times the sampling rate */
 {
     int i;
     int centerEndPos;
@@ -409,7 +421,8 @@ static void getsseq(float *sseq,           /* (o) the pitch-synchronous sequence
                     idatal,
                     centerStartPos,
                     blockStartPos[q],
-                    period[lagBlock[q + 1]]);
+                    period[lagBlock[q + 1]],
+                    step);
         }
         else
         {
@@ -434,7 +447,8 @@ static void getsseq(float *sseq,           /* (o) the pitch-synchronous sequence
                     idatal,
                     centerStartPos,
                     blockStartPos[q],
-                    period[lagBlock[q]]);
+                    period[lagBlock[q]],
+                    step);
         }
         else
         {
@@ -450,21 +464,23 @@ static void getsseq(float *sseq,           /* (o) the pitch-synchronous sequence
  *---------------------------------------------------------------*/
 
 static void enhancer(float *odata,         /* (o) smoothed block, dimension blockl */
+                     float *sseq,          /* (o) working space, dimension (2*ENH_HL + 1)*ENH_BLOCKL */
                      float *idata,         /* (i) data buffer used for enhancing */
                      int idatal,           /* (i) dimension idata */
                      int centerStartPos,   /* (i) first sample current block within idata */
                      float alpha0,         /* (i) max correction-energy-fraction (in [0,1]) */
                      float *period,        /* (i) pitch period array */
                      const float *plocs,   /* (i) locations where period array values valid */
-                     int periodl)          /* (i) dimension of period and plocs */
+                     int periodl,          /* (i) dimension of period and plocs */
+                     int hl,               /* (i) 2*hl+1 is the number of pitch cycles used */
+                     int step,             /* (i) refine at ENH_UPS0/step times the sampling rate */
+                     const float *wt)      /* (i) weighting of the cycles, 2*hl+1 long */
 {
-    float sseq[(2*ENH_HL + 1)*ENH_BLOCKL];
-
     /* get said second sequence of segments */
-    getsseq(sseq, idata, idatal, centerStartPos, period, plocs, periodl, ENH_HL);
+    getsseq(sseq, idata, idatal, centerStartPos, period, plocs, periodl, hl, step);
 
     /* compute the smoothed output from said second sequence */
-    smath(odata, sseq, ENH_HL, alpha0);
+    smath(odata, sseq, hl, alpha0, wt);
 }
 
 /*----------------------------------------------------------------*
@@ -492,13 +508,105 @@ float xCorrCoef(float *target,      /* (i) first array */
     return 0.0f;
 }
 
+/*----------------------------------------------------------------*
+ * find the lag, from minlag to minlag + nlags - 1, at which the
+ * regressor target - lag gives the largest xCorrCoef(). The lags
+ * are evaluated together, by crossCorrEnergy(), which forms each
+ * lag's sums in the same order as xCorrCoef() does, so the result
+ * is the same.
+ *---------------------------------------------------------------*/
+
+int xCorrCoefLags(float *target,    /* (i) first array */
+                  int subl,         /* (i) dimension of target */
+                  int minlag,       /* (i) the first lag */
+                  int nlags)        /* (i) number of lags */
+{
+    float dot[XCORRCOEF_MAX_LAGS];
+    float energy[XCORRCOEF_MAX_LAGS];
+    float cc;
+    float maxcc;
+    int lag;
+    int i;
+
+    /* dot[i] and energy[i] are for the regressor target - minlag - i */
+    crossCorrEnergy(dot, energy, target, target - minlag, subl, nlags);
+
+    lag = 0;
+    maxcc = 0.0f;
+    for (i = 0;  i < nlags;  i++)
+    {
+        cc = (dot[i] > 0.0f)  ?  (float) (dot[i]*dot[i]/energy[i])  :  0.0f;
+        if (i == 0  ||  cc > maxcc)
+        {
+            maxcc = cc;
+            lag = i;
+        }
+    }
+    return minlag + lag;
+}
+
+/*----------------------------------------------------------------*
+ * follow the pitch on from the last block, looking only a few lags
+ * either side of it. Returns the lag, or 0 if the pitch has moved
+ * too far, or is not clear enough, to follow this way.
+ *---------------------------------------------------------------*/
+
+static int trackLag(float *target,  /* (i) first array */
+                    int subl,       /* (i) dimension of target */
+                    int lastlag,    /* (i) the lag found for the last block */
+                    int minlag,     /* (i) the smallest lag allowed */
+                    int maxlag)     /* (i) the largest lag allowed */
+{
+    float dot[2*ENH_TRACK_SLOP + 1];
+    float energy[2*ENH_TRACK_SLOP + 1];
+    float cc;
+    float maxcc;
+    float tenergy;
+    int lo;
+    int hi;
+    int best;
+    int i;
+
+    lo = lastlag - ENH_TRACK_SLOP;
+    hi = lastlag + ENH_TRACK_SLOP;
+    if (lo < minlag)
+        lo = minlag;
+    if (hi > maxlag)
+        hi = maxlag;
+    if (lo > hi)
+        return 0;
+    crossCorrEnergy(dot, energy, target, target - lo, subl, hi - lo + 1);
+    best = -1;
+    maxcc = 0.0f;
+    for (i = 0;  i <= hi - lo;  i++)
+    {
+        cc = (dot[i] > 0.0f)  ?  dot[i]*dot[i]/energy[i]  :  0.0f;
+        if (cc > maxcc)
+        {
+            maxcc = cc;
+            best = i;
+        }
+    }
+    /* A best lag at the edge of the window may just be the side of a
+       peak beyond it */
+    if (best < 0  ||  (best == 0  &&  lo > minlag)  ||  (best == hi - lo  &&  hi < maxlag))
+        return 0;
+    tenergy = 0.0f;
+    for (i = 0;  i < subl;  i++)
+        tenergy += target[i]*target[i];
+    if (maxcc < ENH_TRACK_MIN_CORR*ENH_TRACK_MIN_CORR*tenergy)
+        return 0;
+    return lo + best;
+}
+
 /*----------------------------------------------------------------*
  * interface for enhancer
  *---------------------------------------------------------------*/
 
 int enhancerInterface(float *out,                         /* (o) enhanced signal */
                       float *in,                          /* (i) unenhanced signal */
-                      ilbc_decode_state_t *iLBCdec_inst)  /* (i) buffers etc */
+                      ilbc_decode_state_t *iLBCdec_inst,  /* (i) buffers etc */
+                      enhancer_scratch_t *scratch)        /* (i/o) working space */
 {
     float *enh_buf;
     float *enh_period;
@@ -515,15 +623,39 @@ int enhancerInterface(float *out,                         /* (o) enhanced signal
     float *inPtr;
     float *enh_bufPtr1;
     float *enh_bufPtr2;
-    float plc_pred[ENH_BLOCKL];
+    float *plc_pred;
 
     float lpState[6];
-    float downsampled[(ENH_NBLOCKS*ENH_BLOCKL + 120)/2];
+    float *downsampled;
     int inLen = ENH_NBLOCKS*ENH_BLOCKL + 120;
     int start;
     int plc_blockl;
     int inlag;
+    int hl;
+    int step;
+    const float *wt;
+
+    switch (iLBCdec_inst->use_enhancer)
+    {
+    case ILBC_ENHANCER_LITE:
+        hl = ENH_HL_LITE;
+        step = ENH_UPS_STEP_LITE;
+        wt = enh_wtTblLite;
+        break;
+    case ILBC_ENHANCER_MINIMAL:
+        hl = ENH_HL_MINIMAL;
+        step = ENH_UPS_STEP_LITE;
+        wt = enh_wtTblMinimal;
+        break;
+    default:
+        hl = ENH_HL;
+        step = 1;
+        wt = enh_wtTbl;
+        break;
+    }
 
+    plc_pred = scratch->plc_pred;
+    downsampled = scratch->downsampled;
     enh_buf = iLBCdec_inst->enh_buf;
     enh_period = iLBCdec_inst->enh_period;
 
@@ -565,21 +697,19 @@ int enhancerInterface(float *out,                         /* (o) enhanced signal
     /* Estimate the pitch in the down sampled domain. */
     for (iblock = 0; iblock<ENH_NBLOCKS-ioffset; iblock++)
     {
-        lag = 10;
-        maxcc = xCorrCoef(downsampled + 60 + iblock*ENH_BLOCKL_HALF,
-                          downsampled + 60 + iblock*ENH_BLOCKL_HALF - lag,
-                          ENH_BLOCKL_HALF);
-        for (ilag = 11;  ilag < 60;  ilag++)
+        /* The lighter tiers just follow a steady pitch on from the block
+           before, and only search the whole range when it changes */
+        lag = 0;
+        if (iLBCdec_inst->use_enhancer != ILBC_ENHANCER_FULL)
         {
-            cc = xCorrCoef(downsampled + 60 + iblock*ENH_BLOCKL_HALF,
-                           downsampled + 60 + iblock*ENH_BLOCKL_HALF - ilag,
-                           ENH_BLOCKL_HALF);
-            if (cc > maxcc)
-            {
-                maxcc = cc;
-                lag = ilag;
-            }
+            lag = trackLag(downsampled + 60 + iblock*ENH_BLOCKL_HALF,
+                           ENH_BLOCKL_HALF,
+                           (int) (0.5f*enh_period[iblock + ENH_NBLOCKS_EXTRA + ioffset - 1] + 0.5f),
+                           10,
+                           59);
         }
+        if (lag == 0)
+            lag = xCorrCoefLags(downsampled + 60 + iblock*ENH_BLOCKL_HALF, ENH_BLOCKL_HALF, 10, 50);
 
         /* Store the estimated lag in the non-downsampled domain */
         enh_period[iblock + ENH_NBLOCKS_EXTRA + ioffset] = (float) lag*2.0f;
@@ -657,13 +787,17 @@ int enhancerInterface(float *out,                         /* (o) enhanced signal
         for (iblock = 0;  iblock < 2;  iblock++)
         {
             enhancer(out + iblock*ENH_BLOCKL,
+                     scratch->sseq,
                      enh_buf,
                      ENH_BUFL,
                      (5 + iblock)*ENH_BLOCKL + 40,
                      ENH_ALPHA0,
                      enh_period,
                      enh_plocsTbl,
-                     ENH_NBLOCKS_TOT);
+                     ENH_NBLOCKS_TOT,
+                     hl,
+                     step,
+                     wt);
         }
     }
     else if (iLBCdec_inst->mode == 30)
@@ -672,13 +806,17 @@ int enhancerInterface(float *out,                         /* (o) enhanced signal
         for (iblock = 0;  iblock < 3;  iblock++)
         {
             enhancer(out + iblock*ENH_BLOCKL,
+                     scratch->sseq,
                      enh_buf,
                      ENH_BUFL,
                      (4 + iblock)*ENH_BLOCKL,
                      ENH_ALPHA0,
                      enh_period,
                      enh_plocsTbl,
-                     ENH_NBLOCKS_TOT);
+                     ENH_NBLOCKS_TOT,
+                     hl,
+                     step,
+                     wt);
         }
     }
 
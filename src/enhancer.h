@@ -20,12 +20,30 @@
 #ifndef __ENHANCER_H
 #define __ENHANCER_H
 
+/* Working space for enhancerInterface(). This needs iLBC_define.h */
+typedef struct
+{
+    float downsampled[(ENH_NBLOCKS*ENH_BLOCKL + 120)/2];
+    float plc_pred[ENH_BLOCKL];
+    float sseq[(2*ENH_HL + 1)*ENH_BLOCKL];
+} enhancer_scratch_t;
+
+/* The most lags xCorrCoefLags() can search in one call */
+#define XCORRCOEF_MAX_LAGS      100
+
 float xCorrCoef(float *target,                              /* (i) first array */
                 float *regressor,                           /* (i) second array */
                 int subl);                                  /* (i) dimension arrays */
 
+int xCorrCoefLags(float *target,                            /* (i) first array */
+                  int subl,                                 /* (i) dimension of target */
+                  int minlag,                               /* (i) the first lag */
+                  int nlags);                               /* (i) number of lags, at most
+                                                                   XCORRCOEF_MAX_LAGS */
+
 int enhancerInterface(float *out,                           /* (o) the enhanced recidual signal */
                       float *in,                            /* (i) the recidual signal to enhance */
-                      ilbc_decode_state_t *iLBCdec_inst);   /* (i/o) the decoder state structure */
+                      ilbc_decode_state_t *iLBCdec_inst,    /* (i/o) the decoder state structure */
+                      enhancer_scratch_t *scratch);         /* (i/o) working space */
 
 #endif
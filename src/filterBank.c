@@ -0,0 +1,176 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * filterBank.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "filterBank.h"
+
+/* The recursive filters cannot be vectorised along the signal, as each
+   output sample needs the one before. Here each lane holds a separate
+   channel, and the inner loops run across the lanes. Each lane sees
+   the arithmetic of the single channel filters, in the same order. This
+   file and those filters are built without fast math, so the results are
+   bit exact with them. */
+
+/*----------------------------------------------------------------*
+ *  Move one channel's values into, or out of, a lane of the bank
+ *---------------------------------------------------------------*/
+
+void filterBankPut(float *bank,         /* (o) the bank's signal, coefficients or state */
+                   int lane,            /* (i) the lane to fill */
+                   const float *x,      /* (i) one channel's values */
+                   int len)             /* (i) number of values */
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        bank[i*FILTER_BANK_LANES + lane] = x[i];
+}
+
+void filterBankGet(float *x,            /* (o) one channel's values */
+                   const float *bank,   /* (i) the bank's signal, coefficients or state */
+                   int lane,            /* (i) the lane to read */
+                   int len)             /* (i) number of values */
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+        x[i] = bank[i*FILTER_BANK_LANES + lane];
+}
+
+/*----------------------------------------------------------------*
+ *  High-pass filters, as hpInput() and hpOutput()
+ *---------------------------------------------------------------*/
+
+void hpFilterBank(const float *In,          /* (i) signal to filter */
+                  int len,                  /* (i) samples per lane */
+                  float *Out,               /* (o) the filtered signal, which may be In */
+                  float *mem,               /* (i/o) the filter state, 4 values per lane */
+                  const float *zero_coefs,  /* (i) the 3 all-zero section coefficients */
+                  const float *pole_coefs)  /* (i) the 3 all-pole section coefficients,
+                                                   pole_coefs[0] is assumed to be 1.0 */
+{
+    int i;
+    int c;
+    float x;
+    float y;
+    float m0[FILTER_BANK_LANES];
+    float m1[FILTER_BANK_LANES];
+    float m2[FILTER_BANK_LANES];
+    float m3[FILTER_BANK_LANES];
+
+    memcpy(m0, &mem[0*FILTER_BANK_LANES], sizeof(m0));
+    memcpy(m1, &mem[1*FILTER_BANK_LANES], sizeof(m1));
+    memcpy(m2, &mem[2*FILTER_BANK_LANES], sizeof(m2));
+    memcpy(m3, &mem[3*FILTER_BANK_LANES], sizeof(m3));
+    /* all-zero section */
+    for (i = 0;  i < len;  i++)
+    {
+        for (c = 0;  c < FILTER_BANK_LANES;  c++)
+        {
+            x = In[i*FILTER_BANK_LANES + c];
+            y = zero_coefs[0]*x;
+            y += zero_coefs[1]*m0[c];
+            y += zero_coefs[2]*m1[c];
+            m1[c] = m0[c];
+            m0[c] = x;
+            Out[i*FILTER_BANK_LANES + c] = y;
+        }
+    }
+
+    /* all-pole section */
+    for (i = 0;  i < len;  i++)
+    {
+        for (c = 0;  c < FILTER_BANK_LANES;  c++)
+        {
+            y = Out[i*FILTER_BANK_LANES + c];
+            y -= pole_coefs[1]*m2[c];
+            y -= pole_coefs[2]*m3[c];
+            m3[c] = m2[c];
+            m2[c] = y;
+            Out[i*FILTER_BANK_LANES + c] = y;
+        }
+    }
+    memcpy(&mem[0*FILTER_BANK_LANES], m0, sizeof(m0));
+    memcpy(&mem[1*FILTER_BANK_LANES], m1, sizeof(m1));
+    memcpy(&mem[2*FILTER_BANK_LANES], m2, sizeof(m2));
+    memcpy(&mem[3*FILTER_BANK_LANES], m3, sizeof(m3));
+}
+
+/*----------------------------------------------------------------*
+ *  LP analysis filter, as anaFilter()
+ *---------------------------------------------------------------*/
+
+void anaFilterBank(const float *In,     /* (i) signal to filter. In[-ILBC_LPC_FILTERORDER*FILTER_BANK_LANES]
+                                               onwards holds the filter state */
+                   const float *a,      /* (i) LP parameters, ILBC_LPC_FILTERORDER + 1 per lane */
+                   int len,             /* (i) samples per lane */
+                   float *Out)          /* (o) the filtered signal */
+{
+    int i;
+    int j;
+    int c;
+    const float *pi;
+    float acc[FILTER_BANK_LANES];
+
+    for (i = 0;  i < len;  i++)
+    {
+        pi = &In[i*FILTER_BANK_LANES];
+        for (c = 0;  c < FILTER_BANK_LANES;  c++)
+            acc[c] = 0.0f;
+        for (j = 0;  j < ILBC_LPC_FILTERORDER + 1;  j++)
+        {
+            for (c = 0;  c < FILTER_BANK_LANES;  c++)
+                acc[c] += a[j*FILTER_BANK_LANES + c]*pi[c];
+            pi -= FILTER_BANK_LANES;
+        }
+        memcpy(&Out[i*FILTER_BANK_LANES], acc, sizeof(acc));
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  LP synthesis filter, as syntFilter()
+ *---------------------------------------------------------------*/
+
+void syntFilterBank(float *InOut,       /* (i/o) signal to filter, in place. InOut[-ILBC_LPC_FILTERORDER*FILTER_BANK_LANES]
+                                                 onwards holds the filter state */
+                    const float *a,     /* (i) LP parameters, ILBC_LPC_FILTERORDER + 1 per lane */
+                    int len)            /* (i) samples per lane, at most SUBL */
+{
+    int i;
+    int j;
+    int c;
+    const float *pi;
+    float acc[FILTER_BANK_LANES];
+
+    for (i = 0;  i < len;  i++)
+    {
+        memcpy(acc, &InOut[i*FILTER_BANK_LANES], sizeof(acc));
+        pi = &InOut[(i - 1)*FILTER_BANK_LANES];
+        for (j = 1;  j < ILBC_LPC_FILTERORDER + 1;  j++)
+        {
+            for (c = 0;  c < FILTER_BANK_LANES;  c++)
+                acc[c] -= a[j*FILTER_BANK_LANES + c]*pi[c];
+            pi -= FILTER_BANK_LANES;
+        }
+        memcpy(&InOut[i*FILTER_BANK_LANES], acc, sizeof(acc));
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * filterBank.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_FILTERBANK_H
+#define __iLBC_FILTERBANK_H
+
+/* The bank filters FILTER_BANK_LANES channels at once. Sample i of the
+   channel in lane c is at x[i*FILTER_BANK_LANES + c], and so are the
+   filter coefficients and state. */
+
+void filterBankPut(float *bank,         /* (o) the bank's signal, coefficients or state */
+                   int lane,            /* (i) the lane to fill */
+                   const float *x,      /* (i) one channel's values */
+                   int len);            /* (i) number of values */
+
+void filterBankGet(float *x,            /* (o) one channel's values */
+                   const float *bank,   /* (i) the bank's signal, coefficients or state */
+                   int lane,            /* (i) the lane to read */
+                   int len);            /* (i) number of values */
+
+void hpFilterBank(const float *In,          /* (i) signal to filter */
+                  int len,                  /* (i) samples per lane */
+                  float *Out,               /* (o) the filtered signal, which may be In */
+                  float *mem,               /* (i/o) the filter state, 4 values per lane */
+                  const float *zero_coefs,  /* (i) the 3 all-zero section coefficients */
+                  const float *pole_coefs); /* (i) the 3 all-pole section coefficients,
+                                                   pole_coefs[0] is assumed to be 1.0 */
+
+void anaFilterBank(const float *In,     /* (i) signal to filter. In[-ILBC_LPC_FILTERORDER*FILTER_BANK_LANES]
+                                               onwards holds the filter state */
+                   const float *a,      /* (i) LP parameters, ILBC_LPC_FILTERORDER + 1 per lane */
+                   int len,             /* (i) samples per lane */
+                   float *Out);         /* (o) the filtered signal */
+
+void syntFilterBank(float *InOut,       /* (i/o) signal to filter, in place. InOut[-ILBC_LPC_FILTERORDER*FILTER_BANK_LANES]
+                                                 onwards holds the filter state */
+                    const float *a,     /* (i) LP parameters, ILBC_LPC_FILTERORDER + 1 per lane */
+                    int len);           /* (i) samples per lane, at most SUBL */
+
+#endif
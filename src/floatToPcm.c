@@ -0,0 +1,364 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * floatToPcm.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <math.h>
+
+#if defined(__GNUC__)  &&  (defined(__x86_64__)  ||  defined(__i386__))
+#define ILBC_FLOATTOPCM_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+/* vcvtnq_s32_f32() rounds to nearest, like rint(). 32 bit ARM only has a
+   truncating conversion, so it uses the plain C code. */
+#define ILBC_FLOATTOPCM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "cpuDispatch.h"
+#include "floatToPcm.h"
+
+#if (defined(WIN32) || defined(_WIN32)) && (_MSC_VER < 1800)
+#if (defined(WIN32)  ||  defined(_WIN32)) && !defined(_WIN64)
+    __inline long int rint(double dbl)
+    {
+        _asm 
+    	{
+            fld dbl
+            frndint
+            fstp dbl
+        }
+        return (long int) dbl;
+    }
+#elif defined (_WIN64)
+#include <intrin.h>
+    __inline__ long int rint(double x)
+    {
+#ifdef _M_X64
+		return (long int)_mm_cvtsd_si64x( _mm_loadu_pd ((const double*)&x) );
+#else
+#warning "Not Supported: Replacing with a simple C cast."
+	return (long int) (x);
+#endif
+    }
+#endif
+#endif
+
+/*
+ * All the versions clamp to the int16_t range before converting, and then
+ * round to nearest, with ties to even, in the default rounding mode. They
+ * therefore give exactly the same samples as the plain C code.
+ */
+
+typedef void (*floatToPcm16_func_t)(int16_t amp[], const float in[], int len);
+typedef void (*floatMix_func_t)(float bus[], const float in[], float gain, int len);
+
+/*----------------------------------------------------------------*
+ *  Plain C conversion, one sample at a time
+ *---------------------------------------------------------------*/
+
+static void floatToPcm16_scalar(int16_t amp[],      /* (o) the samples */
+                                const float in[],   /* (i) the signal */
+                                int len)            /* (i) number of samples */
+{
+    int k;
+    float dtmp;
+
+    for (k = 0;  k < len;  k++)
+    {
+        dtmp = in[k];
+        if (dtmp < MIN_SAMPLE)
+            dtmp = MIN_SAMPLE;
+        else if (dtmp > MAX_SAMPLE)
+            dtmp = MAX_SAMPLE;
+        amp[k] = (int16_t) rint(dtmp);
+    }
+}
+
+static void floatMix_scalar(float bus[],         /* (i/o) the mix */
+                            const float in[],   /* (i) the signal */
+                            float gain,         /* (i) gain applied to the signal */
+                            int len)            /* (i) number of samples */
+{
+    int k;
+
+    for (k = 0;  k < len;  k++)
+        bus[k] += gain*in[k];
+}
+
+#if defined(ILBC_FLOATTOPCM_X86)
+/*----------------------------------------------------------------*
+ *  SSE2 conversion, 8 samples at a time
+ *---------------------------------------------------------------*/
+
+__attribute__((target("sse2")))
+static void floatToPcm16_sse2(int16_t amp[],
+                              const float in[],
+                              int len)
+{
+    int k;
+    __m128 lo;
+    __m128 hi;
+    __m128 x0;
+    __m128 x1;
+
+    lo = _mm_set1_ps((float) MIN_SAMPLE);
+    hi = _mm_set1_ps((float) MAX_SAMPLE);
+    for (k = 0;  k + 8 <= len;  k += 8)
+    {
+        x0 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + k), lo), hi);
+        x1 = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + k + 4), lo), hi);
+        _mm_storeu_si128((__m128i *) (amp + k), _mm_packs_epi32(_mm_cvtps_epi32(x0), _mm_cvtps_epi32(x1)));
+    }
+    if (k < len)
+        floatToPcm16_scalar(amp + k, in + k, len - k);
+}
+
+/*----------------------------------------------------------------*
+ *  AVX2 conversion, 16 samples at a time
+ *---------------------------------------------------------------*/
+
+__attribute__((target("avx2")))
+static void floatToPcm16_avx2(int16_t amp[],
+                              const float in[],
+                              int len)
+{
+    int k;
+    __m256 lo;
+    __m256 hi;
+    __m256 x0;
+    __m256 x1;
+    __m256i y;
+
+    lo = _mm256_set1_ps((float) MIN_SAMPLE);
+    hi = _mm256_set1_ps((float) MAX_SAMPLE);
+    for (k = 0;  k + 16 <= len;  k += 16)
+    {
+        x0 = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + k), lo), hi);
+        x1 = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + k + 8), lo), hi);
+        /* The pack works within each 128 bit half, so put the quarters back in order */
+        y = _mm256_packs_epi32(_mm256_cvtps_epi32(x0), _mm256_cvtps_epi32(x1));
+        _mm256_storeu_si256((__m256i *) (amp + k), _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    if (k < len)
+    {
+        /* The SSE2 code is not VEX encoded, so it would run slowly, here
+           and in the rest of the library, with the upper halves dirty */
+        _mm256_zeroupper();
+        floatToPcm16_sse2(amp + k, in + k, len - k);
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  SSE2 and AVX2 mixing, 8 and 16 samples at a time
+ *---------------------------------------------------------------*/
+
+__attribute__((target("sse2")))
+static void floatMix_sse2(float bus[],
+                          const float in[],
+                          float gain,
+                          int len)
+{
+    int k;
+    __m128 g;
+
+    g = _mm_set1_ps(gain);
+    for (k = 0;  k + 8 <= len;  k += 8)
+    {
+        _mm_storeu_ps(bus + k, _mm_add_ps(_mm_loadu_ps(bus + k), _mm_mul_ps(g, _mm_loadu_ps(in + k))));
+        _mm_storeu_ps(bus + k + 4, _mm_add_ps(_mm_loadu_ps(bus + k + 4), _mm_mul_ps(g, _mm_loadu_ps(in + k + 4))));
+    }
+    if (k < len)
+        floatMix_scalar(bus + k, in + k, gain, len - k);
+}
+
+__attribute__((target("avx2")))
+static void floatMix_avx2(float bus[],
+                          const float in[],
+                          float gain,
+                          int len)
+{
+    int k;
+    __m256 g;
+
+    g = _mm256_set1_ps(gain);
+    for (k = 0;  k + 16 <= len;  k += 16)
+    {
+        _mm256_storeu_ps(bus + k, _mm256_add_ps(_mm256_loadu_ps(bus + k), _mm256_mul_ps(g, _mm256_loadu_ps(in + k))));
+        _mm256_storeu_ps(bus + k + 8, _mm256_add_ps(_mm256_loadu_ps(bus + k + 8), _mm256_mul_ps(g, _mm256_loadu_ps(in + k + 8))));
+    }
+    if (k < len)
+    {
+        /* As for floatToPcm16_avx2() */
+        _mm256_zeroupper();
+        floatMix_sse2(bus + k, in + k, gain, len - k);
+    }
+}
+#endif
+
+#if defined(ILBC_FLOATTOPCM_NEON)
+/*----------------------------------------------------------------*
+ *  NEON conversion, 8 samples at a time
+ *---------------------------------------------------------------*/
+
+static void floatToPcm16_neon(int16_t amp[],
+                              const float in[],
+                              int len)
+{
+    int k;
+    float32x4_t lo;
+    float32x4_t hi;
+    int32x4_t x0;
+    int32x4_t x1;
+
+    lo = vdupq_n_f32((float) MIN_SAMPLE);
+    hi = vdupq_n_f32((float) MAX_SAMPLE);
+    for (k = 0;  k + 8 <= len;  k += 8)
+    {
+        x0 = vcvtnq_s32_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + k), lo), hi));
+        x1 = vcvtnq_s32_f32(vminq_f32(vmaxq_f32(vld1q_f32(in + k + 4), lo), hi));
+        vst1q_s16(amp + k, vcombine_s16(vqmovn_s32(x0), vqmovn_s32(x1)));
+    }
+    if (k < len)
+        floatToPcm16_scalar(amp + k, in + k, len - k);
+}
+
+static void floatMix_neon(float bus[],
+                          const float in[],
+                          float gain,
+                          int len)
+{
+    int k;
+
+    for (k = 0;  k + 8 <= len;  k += 8)
+    {
+        vst1q_f32(bus + k, vmlaq_n_f32(vld1q_f32(bus + k), vld1q_f32(in + k), gain));
+        vst1q_f32(bus + k + 4, vmlaq_n_f32(vld1q_f32(bus + k + 4), vld1q_f32(in + k + 4), gain));
+    }
+    if (k < len)
+        floatMix_scalar(bus + k, in + k, gain, len - k);
+}
+#endif
+
+/*----------------------------------------------------------------*
+ *  Pick the best version for this CPU the first time we are called
+ *---------------------------------------------------------------*/
+
+static void floatToPcm16_select(int16_t amp[], const float in[], int len);
+
+static floatToPcm16_func_t floatToPcm16_impl = floatToPcm16_select;
+
+static void floatToPcm16_select(int16_t amp[],
+                                const float in[],
+                                int len)
+{
+    floatToPcm16_func_t func;
+
+    func = floatToPcm16_scalar;
+#if defined(ILBC_FLOATTOPCM_X86)
+    if (cpuTier() >= ILBC_CPU_AVX2)
+        func = floatToPcm16_avx2;
+    else if (cpuTier() >= ILBC_CPU_SSE2)
+        func = floatToPcm16_sse2;
+#elif defined(ILBC_FLOATTOPCM_NEON)
+    if (cpuTier() == ILBC_CPU_NEON)
+        func = floatToPcm16_neon;
+#endif
+    floatToPcm16_impl = func;
+    func(amp, in, len);
+}
+
+static void floatMix_select(float bus[], const float in[], float gain, int len);
+
+static floatMix_func_t floatMix_impl = floatMix_select;
+
+static void floatMix_select(float bus[],
+                            const float in[],
+                            float gain,
+                            int len)
+{
+    floatMix_func_t func;
+
+    func = floatMix_scalar;
+#if defined(ILBC_FLOATTOPCM_X86)
+    if (cpuTier() >= ILBC_CPU_AVX2)
+        func = floatMix_avx2;
+    else if (cpuTier() >= ILBC_CPU_SSE2)
+        func = floatMix_sse2;
+#elif defined(ILBC_FLOATTOPCM_NEON)
+    if (cpuTier() == ILBC_CPU_NEON)
+        func = floatMix_neon;
+#endif
+    floatMix_impl = func;
+    func(bus, in, gain, len);
+}
+
+/*----------------------------------------------------------------*
+ *  Convert a decoded signal to 16 bit samples, rounding, and
+ *  saturating at the limits of the int16_t range.
+ *---------------------------------------------------------------*/
+
+void floatToPcm16(int16_t amp[],        /* (o) the samples */
+                  const float in[],     /* (i) the signal */
+                  int len)              /* (i) number of samples */
+{
+    if (len <= 0)
+        return;
+    floatToPcm16_impl(amp, in, len);
+}
+
+/*----------------------------------------------------------------*
+ *  Convert a decoded signal to 16 bit samples, as floatToPcm16(),
+ *  writing every stride'th sample of an interleaved buffer. The
+ *  stores do not pack into vectors, so this is plain C.
+ *---------------------------------------------------------------*/
+
+void floatToPcm16Strided(int16_t amp[],     /* (o) the first sample */
+                         int stride,        /* (i) distance between samples, in samples */
+                         const float in[],  /* (i) the signal */
+                         int len)           /* (i) number of samples */
+{
+    int k;
+    float dtmp;
+
+    for (k = 0;  k < len;  k++)
+    {
+        dtmp = in[k];
+        if (dtmp < MIN_SAMPLE)
+            dtmp = MIN_SAMPLE;
+        else if (dtmp > MAX_SAMPLE)
+            dtmp = MAX_SAMPLE;
+        amp[k*stride] = (int16_t) rint(dtmp);
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Add a decoded signal, scaled, into a mix, with no rounding or
+ *  saturation
+ *---------------------------------------------------------------*/
+
+void floatMix(float bus[],          /* (i/o) the mix */
+              const float in[],     /* (i) the signal */
+              float gain,           /* (i) gain applied to the signal */
+              int len)              /* (i) number of samples */
+{
+    if (len <= 0)
+        return;
+    floatMix_impl(bus, in, gain, len);
+}
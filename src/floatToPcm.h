@@ -0,0 +1,31 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * floatToPcm.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_FLOATTOPCM_H
+#define __iLBC_FLOATTOPCM_H
+
+void floatToPcm16(int16_t amp[],        /* (o) the samples */
+                  const float in[],     /* (i) the signal, nominally in the range
+                                               MIN_SAMPLE to MAX_SAMPLE */
+                  int len);             /* (i) number of samples */
+
+void floatToPcm16Strided(int16_t amp[],     /* (o) the first sample */
+                         int stride,        /* (i) distance between samples, in samples */
+                         const float in[],  /* (i) the signal */
+                         int len);          /* (i) number of samples */
+
+void floatMix(float bus[],          /* (i/o) the mix */
+              const float in[],     /* (i) the signal */
+              float gain,           /* (i) gain applied to the signal */
+              int len);             /* (i) number of samples */
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * g711.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+
+#include "constants.h"
+#include "g711.h"
+
+/* The u-law bias, which makes the segments line up, and the largest
+   magnitude which can be coded, both for 14 bit samples */
+#define ULAW_BIAS               0x21
+#define ULAW_CLIP               8159
+/* A-law inverts the even bits of each code, to help line clock recovery */
+#define ALAW_AMI_MASK           0x55
+
+/*----------------------------------------------------------------*
+ *  bit number of the most significant 1 in a non-zero value
+ *---------------------------------------------------------------*/
+
+static __inline__ int top_bit(unsigned int bits)
+{
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(bits);
+#else
+    int i;
+
+    i = 0;
+    while (bits >>= 1)
+        i++;
+    return i;
+#endif
+}
+
+/*----------------------------------------------------------------*
+ *  expansion of G.711 codes to a float signal
+ *---------------------------------------------------------------*/
+
+void alawToFloat(float out[],               /* (o) the signal */
+                 const uint8_t alaw[],      /* (i) A-law codes */
+                 int len)                   /* (i) number of samples */
+{
+    int k;
+
+    for (k = 0;  k < len;  k++)
+        out[k] = (float) alaw_to_linearTbl[alaw[k]];
+}
+
+void ulawToFloat(float out[],               /* (o) the signal */
+                 const uint8_t ulaw[],      /* (i) u-law codes */
+                 int len)                   /* (i) number of samples */
+{
+    int k;
+
+    for (k = 0;  k < len;  k++)
+        out[k] = (float) ulaw_to_linearTbl[ulaw[k]];
+}
+
+/*----------------------------------------------------------------*
+ *  compression of 16 bit samples to G.711 codes
+ *---------------------------------------------------------------*/
+
+void pcm16ToAlaw(uint8_t alaw[],            /* (o) A-law codes */
+                 const int16_t amp[],       /* (i) the samples */
+                 int len)                   /* (i) number of samples */
+{
+    int k;
+    int linear;
+    int mask;
+    int seg;
+
+    for (k = 0;  k < len;  k++)
+    {
+        linear = amp[k];
+        if (linear >= 0)
+        {
+            mask = ALAW_AMI_MASK | 0x80;
+        }
+        else
+        {
+            mask = ALAW_AMI_MASK;
+            linear = -linear - 1;
+        }
+        /* Segment 0 and segment 1 have the same step size */
+        seg = top_bit(linear | 0xFF) - 7;
+        alaw[k] = (uint8_t) (((seg << 4) | ((linear >> ((seg)  ?  (seg + 3)  :  4)) & 0x0F)) ^ mask);
+    }
+}
+
+void pcm16ToUlaw(uint8_t ulaw[],            /* (o) u-law codes */
+                 const int16_t amp[],       /* (i) the samples */
+                 int len)                   /* (i) number of samples */
+{
+    int k;
+    int linear;
+    int mask;
+    int seg;
+
+    for (k = 0;  k < len;  k++)
+    {
+        /* u-law works on 14 bit samples */
+        linear = amp[k] >> 2;
+        if (linear < 0)
+        {
+            linear = -linear;
+            mask = 0x7F;
+        }
+        else
+        {
+            mask = 0xFF;
+        }
+        if (linear > ULAW_CLIP)
+            linear = ULAW_CLIP;
+        linear += ULAW_BIAS;
+        seg = top_bit(linear | 0x3F) - 5;
+        if (seg >= 8)
+            ulaw[k] = (uint8_t) (0x7F ^ mask);
+        else
+            ulaw[k] = (uint8_t) (((seg << 4) | ((linear >> (seg + 1)) & 0x0F)) ^ mask);
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * g711.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_G711_H
+#define __iLBC_G711_H
+
+void alawToFloat(float out[],               /* (o) the signal */
+                 const uint8_t alaw[],      /* (i) A-law codes */
+                 int len);                  /* (i) number of samples */
+
+void ulawToFloat(float out[],               /* (o) the signal */
+                 const uint8_t ulaw[],      /* (i) u-law codes */
+                 int len);                  /* (i) number of samples */
+
+void pcm16ToAlaw(uint8_t alaw[],            /* (o) A-law codes */
+                 const int16_t amp[],       /* (i) the samples */
+                 int len);                  /* (i) number of samples */
+
+void pcm16ToUlaw(uint8_t ulaw[],            /* (o) u-law codes */
+                 const int16_t amp[],       /* (i) the samples */
+                 int len);                  /* (i) number of samples */
+
+#endif
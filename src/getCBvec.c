@@ -27,31 +27,127 @@
 #include <string.h>
 
 #include "ilbc2.h"
+#include "iLBC_define.h"
 #include "constants.h"
 #include "getCBvec.h"
 
+/* What buildCBvec() does with each sample of the vector */
+#define CB_COPY             0
+#define CB_SCALE            1
+#define CB_SCALE_ADD        2
+
+static ILBC_ALWAYS_INLINE void putSample(float *out, float x, float gain, int op)
+{
+    if (op == CB_COPY)
+        *out = x;
+    else if (op == CB_SCALE)
+        *out = gain*x;
+    else
+        *out += gain*x;
+}
+
 /*----------------------------------------------------------------*
- *  Construct codebook vector for given index.
+ *  Filter just the part of the codebook buffer from start to
+ *  start + len - 1 through cbfiltersTbl, into the same places in
+ *  out. The buffer is taken as zero beyond its ends.
  *---------------------------------------------------------------*/
 
-void getCBvec(float *cbvec,     /* (o) Constructed codebook vector */
-              float *mem,       /* (i) Codebook buffer */
-              int index,        /* (i) Codebook index */
-              int lMem,         /* (i) Length of codebook buffer */
-              int cbveclen)     /* (i) Codebook vector length */
+static void filterCBmem(float *out,         /* (o) Filtered buffer, at the same positions as mem */
+                        const float *mem,   /* (i) Codebook buffer */
+                        int lMem,           /* (i) Length of codebook buffer */
+                        int start,          /* (i) First sample to filter */
+                        int len)            /* (i) Number of samples to filter */
 {
-    int j;
-    int k;
+    float tempbuff2[CB_MEML + CB_FILTERLEN + 1];
+    const float *pp;
+    const float *pp1;
+    float acc;
+    int first;
+    int lo;
+    int hi;
     int n;
-    int memInd;
-    int sFilt;
-    float tmpbuf[CB_MEML];
-    int base_size;
-    int ilow;
+    int j;
+
+    /* Only the samples the filter reaches for this part are copied */
+    first = start + 1 - CB_HALFFILTERLEN;
+    lo = (first < 0)  ?  0  :  first;
+    hi = start + len + CB_HALFFILTERLEN;
+    if (hi > lMem)
+        hi = lMem;
+    memset(tempbuff2, 0, (len + CB_FILTERLEN - 1)*sizeof(float));
+    memcpy(&tempbuff2[lo - first], mem + lo, (hi - lo)*sizeof(float));
+
+    for (n = 0;  n < len;  n++)
+    {
+        pp = &tempbuff2[n];
+        pp1 = &cbfiltersTbl[CB_FILTERLEN - 1];
+        acc = 0.0f;
+        for (j = 0;  j < CB_FILTERLEN;  j++)
+            acc += (*pp++)*(*pp1--);
+        out[start + n] = acc;
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Form a vector which blends the smoothed end of one stretch
+ *  of a buffer into the start of another, from the last k
+ *  samples of the buffer
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void interpolateCBvec(float *out,
+                                                const float *buf,
+                                                int lBuf,
+                                                int k,
+                                                int cbveclen,
+                                                float gain,
+                                                int op)
+{
+    int j;
     int ihigh;
+    int ilow;
     float alfa;
     float alfa1;
 
+    ihigh = k/2;
+    ilow = ihigh - 5;
+
+    /* First noninterpolated part */
+    for (j = 0;  j < ilow;  j++)
+        putSample(&out[j], buf[lBuf - k/2 + j], gain, op);
+
+    /* Interpolation */
+    alfa1 = 0.2f;
+    alfa = 0.0f;
+    for (j = ilow;  j < ihigh;  j++)
+    {
+        putSample(&out[j], (1.0f - alfa)*buf[lBuf - k/2 + j] + alfa*buf[lBuf - k + j], gain, op);
+        alfa += alfa1;
+    }
+
+    /* Second noninterpolated part */
+    for (j = ihigh;  j < cbveclen;  j++)
+        putSample(&out[j], buf[lBuf - k + j], gain, op);
+}
+
+/*----------------------------------------------------------------*
+ *  Construct the codebook vector for an index, doing only the
+ *  filtering that index needs
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void buildCBvec(float *out,
+                                          const float *mem,
+                                          int index,
+                                          int lMem,
+                                          int cbveclen,
+                                          float gain,
+                                          int op)
+{
+    float tmpbuf[CB_MEML];
+    int base_size;
+    int sFilt;
+    int k;
+    int j;
+
     /* Determine size of codebook sections */
     base_size = lMem - cbveclen + 1;
 
@@ -63,107 +159,64 @@ void getCBvec(float *cbvec,     /* (o) Constructed codebook vector */
     {
         /* First non-interpolated vectors */
         k = index + cbveclen;
-        /* Get vector */
-        memcpy(cbvec, mem + lMem - k, cbveclen*sizeof(float));
+        for (j = 0;  j < cbveclen;  j++)
+            putSample(&out[j], mem[lMem - k + j], gain, op);
     }
     else if (index < base_size)
     {
         k = 2*(index - (lMem - cbveclen + 1)) + cbveclen;
-
-        ihigh = k/2;
-        ilow = ihigh - 5;
-
-        /* Copy first noninterpolated part */
-        memcpy(cbvec, mem + lMem - k/2, ilow*sizeof(float));
-
-        /* Interpolation */
-        alfa1 = 0.2f;
-        alfa = 0.0f;
-        for (j = ilow;  j < ihigh;  j++)
-        {
-            cbvec[j] = (1.0f - alfa)*mem[lMem - k/2 + j] + alfa*mem[lMem - k + j];
-            alfa += alfa1;
-        }
-
-        /* Copy second noninterpolated part */
-        memcpy(cbvec + ihigh, mem + lMem - k + ihigh, (cbveclen - ihigh)*sizeof(float));
+        interpolateCBvec(out, mem, lMem, k, cbveclen, gain, op);
     }
     /* Higher codebook section based on filtering */
+    else if (index - base_size < lMem - cbveclen + 1)
+    {
+        /* Non-interpolated vectors */
+        k = index - base_size + cbveclen;
+        sFilt = lMem - k;
+        filterCBmem(tmpbuf, mem, lMem, sFilt, cbveclen);
+        for (j = 0;  j < cbveclen;  j++)
+            putSample(&out[j], tmpbuf[sFilt + j], gain, op);
+    }
     else
     {
-        if (index - base_size < lMem - cbveclen + 1)
-        {
-            float tempbuff2[CB_MEML + CB_FILTERLEN + 1];
-            float *pos;
-            const float *pp;
-            const float *pp1;
-
-            /* Non-interpolated vectors */
-            memset(tempbuff2, 0, CB_HALFFILTERLEN*sizeof(float));
-            memcpy(&tempbuff2[CB_HALFFILTERLEN], mem, lMem*sizeof(float));
-            memset(&tempbuff2[lMem + CB_HALFFILTERLEN], 0, (CB_HALFFILTERLEN + 1)*sizeof(float));
-
-            k = index - base_size + cbveclen;
-            sFilt = lMem - k;
-            memInd = sFilt + 1 - CB_HALFFILTERLEN;
-
-            /* do filtering */
-            pos = cbvec;
-            memset(pos, 0, cbveclen*sizeof(float));
-            for (n = 0;  n < cbveclen;  n++)
-            {
-                pp = &tempbuff2[memInd + n + CB_HALFFILTERLEN];
-                pp1 = &cbfiltersTbl[CB_FILTERLEN - 1];
-                for (j = 0;  j < CB_FILTERLEN;  j++)
-                    (*pos) += (*pp++)*(*pp1--);
-                pos++;
-            }
-        }
-        else
-        {
-            float tempbuff2[CB_MEML + CB_FILTERLEN + 1];
-            float *pos;
-            const float *pp;
-            const float *pp1;
-            int i;
-
-            /* Interpolated vectors */
-            memset(tempbuff2, 0, CB_HALFFILTERLEN*sizeof(float));
-            memcpy(&tempbuff2[CB_HALFFILTERLEN], mem, lMem*sizeof(float));
-            memset(&tempbuff2[lMem + CB_HALFFILTERLEN], 0, (CB_HALFFILTERLEN + 1)*sizeof(float));
-
-            k = 2*(index-base_size - (lMem - cbveclen + 1)) + cbveclen;
-            sFilt = lMem - k;
-            memInd = sFilt + 1 - CB_HALFFILTERLEN;
-
-            /* do filtering */
-            pos = &tmpbuf[sFilt];
-            memset(pos, 0, k*sizeof(float));
-            for (i = 0;  i < k;  i++)
-            {
-                pp = &tempbuff2[memInd + i + CB_HALFFILTERLEN];
-                pp1 = &cbfiltersTbl[CB_FILTERLEN - 1];
-                for (j = 0;  j < CB_FILTERLEN;  j++)
-                    (*pos) += (*pp++)*(*pp1--);
-                pos++;
-            }
-
-            ihigh = k/2;
-            ilow = ihigh - 5;
-
-            /* Copy first noninterpolated part */
-            memcpy(cbvec, tmpbuf + lMem - k/2, ilow*sizeof(float));
-
-            /* interpolation */
-            alfa1 = 0.2f;
-            alfa = 0.0f;
-            for (j = ilow;  j < ihigh;  j++)
-            {
-                cbvec[j] = (1.0f - alfa)*tmpbuf[lMem - k/2 + j]+alfa*tmpbuf[lMem - k + j];
-                alfa += alfa1;
-            }
-            /* Copy second noninterpolated part */
-            memcpy(cbvec + ihigh, tmpbuf + lMem - k + ihigh, (cbveclen - ihigh)*sizeof(float));
-        }
+        /* Interpolated vectors. These only use the filtered buffer from
+           k/2 - 5 samples into the last k, to its end. */
+        k = 2*(index - base_size - (lMem - cbveclen + 1)) + cbveclen;
+        sFilt = lMem - k + k/2 - 5;
+        filterCBmem(tmpbuf, mem, lMem, sFilt, lMem - sFilt);
+        interpolateCBvec(out, tmpbuf, lMem, k, cbveclen, gain, op);
     }
 }
+
+/*----------------------------------------------------------------*
+ *  Construct codebook vector for given index.
+ *---------------------------------------------------------------*/
+
+void getCBvec(float *cbvec,     /* (o) Constructed codebook vector */
+              float *mem,       /* (i) Codebook buffer */
+              int index,        /* (i) Codebook index */
+              int lMem,         /* (i) Length of codebook buffer */
+              int cbveclen)     /* (i) Codebook vector length */
+{
+    buildCBvec(cbvec, mem, index, lMem, cbveclen, 1.0f, CB_COPY);
+}
+
+/*----------------------------------------------------------------*
+ *  Construct the codebook vector for given index, scaled by a
+ *  gain, straight into a decoded vector. The first stage sets
+ *  the vector, and the others add to it.
+ *---------------------------------------------------------------*/
+
+void addCBvec(float *decvector, /* (i/o) Decoded vector */
+              const float *mem, /* (i) Codebook buffer */
+              int index,        /* (i) Codebook index */
+              int lMem,         /* (i) Length of codebook buffer */
+              int cbveclen,     /* (i) Codebook vector length */
+              float gain,       /* (i) Gain for this stage */
+              int first)        /* (i) Set the vector, rather than add to it */
+{
+    if (first)
+        buildCBvec(decvector, mem, index, lMem, cbveclen, gain, CB_SCALE);
+    else
+        buildCBvec(decvector, mem, index, lMem, cbveclen, gain, CB_SCALE_ADD);
+}
@@ -26,4 +26,12 @@ void getCBvec(float *cbvec,   /* (o) Constructed codebook vector */
               int lMem,       /* (i) Length of codebook buffer */
               int cbveclen);  /* (i) Codebook vector length */
 
+void addCBvec(float *decvector,   /* (i/o) Decoded vector */
+              const float *mem,   /* (i) Codebook buffer */
+              int index,          /* (i) Codebook index */
+              int lMem,           /* (i) Length of codebook buffer */
+              int cbveclen,       /* (i) Codebook vector length */
+              float gain,         /* (i) Gain for this stage */
+              int first);         /* (i) Set the vector, rather than add to it */
+
 #endif
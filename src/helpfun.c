@@ -25,6 +25,7 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <string.h>
 
 #include "ilbc2.h"
 #include "constants.h"
@@ -52,6 +53,68 @@ void autocorr(float *r,         /* (o) autocorrelation vector */
     }
 }
 
+/*----------------------------------------------------------------*
+ *  windowing and autocorrelation, for the LPC analysis, in one
+ *  pass over the data. The data is windowed a short strip at a
+ *  time, and each strip is worked into all the lags' sums while
+ *  it is still in cache. The lags are side by side in the inner
+ *  loop, padded to a whole number of vectors. Each lag's sum is
+ *  built in the same order as autocorr() builds it. The data may
+ *  be in two pieces, such as the end of the last frame and the
+ *  new one, so it need not be copied together first.
+ *---------------------------------------------------------------*/
+
+#define AUTOCORR_STRIP      40
+#define AUTOCORR_LAGS       12  /* ILBC_LPC_FILTERORDER + 1, padded */
+
+void windowAutocorrSplit(float *r,          /* (o) autocorrelation vector, ILBC_LPC_FILTERORDER + 1 lags */
+                         const float *x1,   /* (i) the start of the data vector */
+                         int len1,          /* (i) length of the start */
+                         const float *x2,   /* (i) the rest of the data vector */
+                         const float *win,  /* (i) the window */
+                         int N)             /* (i) length of data vector */
+{
+    /* w[0] to w[AUTOCORR_LAGS - 1] holds the end of the last strip */
+    float w[AUTOCORR_LAGS + AUTOCORR_STRIP];
+    float acc[AUTOCORR_LAGS];
+    const float *pw;
+    float v;
+    int len;
+    int lag;
+    int i;
+    int m;
+    int n;
+
+    memset(w, 0, AUTOCORR_LAGS*sizeof(float));
+    memset(acc, 0, sizeof(acc));
+    for (n = 0;  n < N;  n += len)
+    {
+        len = (N - n < AUTOCORR_STRIP)  ?  (N - n)  :  AUTOCORR_STRIP;
+        for (i = 0;  i < len;  i++)
+        {
+            m = n + i;
+            w[AUTOCORR_LAGS + i] = ((m < len1)  ?  x1[m]  :  x2[m - len1])*win[m];
+        }
+        for (i = 0;  i < len;  i++)
+        {
+            pw = &w[AUTOCORR_LAGS + i];
+            v = pw[0];
+            for (lag = 0;  lag < AUTOCORR_LAGS;  lag++)
+                acc[lag] += pw[-lag]*v;
+        }
+        memmove(w, w + len, AUTOCORR_LAGS*sizeof(float));
+    }
+    memcpy(r, acc, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+}
+
+void windowAutocorr(float *r,           /* (o) autocorrelation vector, ILBC_LPC_FILTERORDER + 1 lags */
+                    const float *x,     /* (i) data vector */
+                    const float *win,   /* (i) the window */
+                    int N)              /* (i) length of data vector */
+{
+    windowAutocorrSplit(r, x, N, NULL, win, N);
+}
+
 /*----------------------------------------------------------------*
  *  window multiplication
  *---------------------------------------------------------------*/
@@ -158,47 +221,110 @@ void bwexpand(float *out,   /* (o) the bandwidth expanded lpc coefficients */
     }
 }
 
+/*----------------------------------------------------------------*
+ *  lpc bandwidth expansion of a run of coefficient vectors, such
+ *  as the sub-frames of a frame. The chirp powers are found once,
+ *  just as bwexpand() finds them, so the result is the same.
+ *---------------------------------------------------------------*/
+
+void bwexpandFrame(float *out,  /* (o) the bandwidth expanded lpc coefficients */
+                   float *in,   /* (i) the lpc coefficients before bandwidth expansion */
+                   float coef,  /* (i) the bandwidth expansion factor */
+                   int length,  /* (i) the length of each lpc coefficient vector */
+                   int n)       /* (i) the number of vectors */
+{
+    int i;
+    int j;
+    float chirp[ILBC_LPC_FILTERORDER + 1];
+
+    chirp[0] = 1.0f;
+    chirp[1] = coef;
+    for (i = 2;  i < length;  i++)
+        chirp[i] = chirp[i - 1]*coef;
+    for (j = 0;  j < n;  j++)
+    {
+        out[j*length] = in[j*length];
+        for (i = 1;  i < length;  i++)
+            out[j*length + i] = chirp[i]*in[j*length + i];
+    }
+}
+
 /*----------------------------------------------------------------*
  *  vector quantization
  *---------------------------------------------------------------*/
 
 void vq(float *Xq,          /* (o) the quantized vector */
         int *index,         /* (o) the quantization index */
-        const float *CB,    /* (i) the vector quantization codebook */
+        const float *CB,    /* (i) the vector quantization codebook, a dimension
+                                   at a time. Element i of codeword j is CB[i*n_cb + j] */
         float *X,           /* (i) the vector to quantize */
-        int n_cb,           /* (i) the number of vectors in the codebook */
-        int dim)            /* (i) the dimension of all vectors */
+        int n_cb,           /* (i) the number of vectors in the codebook, a multiple
+                                   of LSF_VQ_BLOCK */
+        int dim)            /* (i) the dimension of all vectors, at least 2 */
 {
     int i;
     int j;
-    int pos;
+    int k;
     int minindex;
-    float dist;
+    float dist[LSF_VQ_BLOCK];
     float tmp;
+    float lowest;
     float mindist;
 
-    pos = 0;
     mindist = FLOAT_MAX;
     minindex = 0;
-    for (j = 0;  j < n_cb;  j++)
+    /* Work through the codebook a block of codewords at a time, which the
+       compiler can do in SIMD registers. Each codeword's distance is summed
+       in the same order as a codeword at a time search, so the index found
+       is the same. */
+    for (j = 0;  j < n_cb;  j += LSF_VQ_BLOCK)
     {
-        dist = X[0] - CB[pos];
-        dist *= dist;
-        for (i = 1;  i < dim;  i++)
+        for (k = 0;  k < LSF_VQ_BLOCK;  k++)
+        {
+            dist[k] = X[0] - CB[j + k];
+            dist[k] *= dist[k];
+        }
+        for (k = 0;  k < LSF_VQ_BLOCK;  k++)
         {
-            tmp = X[i] - CB[pos + i];
-            dist += tmp*tmp;
+            tmp = X[1] - CB[n_cb + j + k];
+            dist[k] += tmp*tmp;
         }
 
-        if (dist < mindist)
+        /* Partial distance elimination. The distances can only grow, so
+           if no codeword in the block is already closer than the best so
+           far, the other dimensions are not needed. */
+        lowest = dist[0];
+        for (k = 1;  k < LSF_VQ_BLOCK;  k++)
+            lowest = (dist[k] < lowest)  ?  dist[k]  :  lowest;
+        if (lowest >= mindist)
+            continue;
+
+        for (i = 2;  i < dim;  i++)
         {
-            mindist = dist;
-            minindex = j;
+            for (k = 0;  k < LSF_VQ_BLOCK;  k++)
+            {
+                tmp = X[i] - CB[i*n_cb + j + k];
+                dist[k] += tmp*tmp;
+            }
+        }
+
+        /* Most of the blocks which get this far still hold nothing closer */
+        lowest = dist[0];
+        for (k = 1;  k < LSF_VQ_BLOCK;  k++)
+            lowest = (dist[k] < lowest)  ?  dist[k]  :  lowest;
+        if (lowest >= mindist)
+            continue;
+        for (k = 0;  k < LSF_VQ_BLOCK;  k++)
+        {
+            if (dist[k] < mindist)
+            {
+                mindist = dist[k];
+                minindex = j + k;
+            }
         }
-        pos += dim;
     }
     for (i = 0;  i < dim;  i++)
-        Xq[i] = CB[minindex*dim + i];
+        Xq[i] = CB[i*n_cb + minindex];
     *index = minindex;
 }
 
@@ -210,7 +336,8 @@ void SplitVQ(float *qX,         /* (o) the quantized vector */
              int *index,        /* (o) a vector of indexes for all vector
                                        codebooks in the split */
              float *X,          /* (i) the vector to quantize */
-             const float *CB,   /* (i) the quantizer codebook */
+             const float *CB,   /* (i) the quantizer codebook, each split stored
+                                       a dimension at a time, as vq() wants */
              int nsplit,        /* the number of vector splits */
              const int *dim,    /* the dimension of X and qX */
              const int *cbsize) /* the number of vectors in the codebook */
@@ -26,6 +26,18 @@ void autocorr(float *r,         /* (o) autocorrelation vector */
               int order);       /* largest lag for calculated
                                  autocorrelations */
 
+void windowAutocorrSplit(float *r,          /* (o) autocorrelation vector, ILBC_LPC_FILTERORDER + 1 lags */
+                         const float *x1,   /* (i) the start of the data vector */
+                         int len1,          /* (i) length of the start */
+                         const float *x2,   /* (i) the rest of the data vector */
+                         const float *win,  /* (i) the window */
+                         int N);            /* (i) length of data vector */
+
+void windowAutocorr(float *r,           /* (o) autocorrelation vector, ILBC_LPC_FILTERORDER + 1 lags */
+                    const float *x,     /* (i) data vector */
+                    const float *win,   /* (i) the window */
+                    int N);             /* (i) length of data vector */
+
 void window(float *z,           /* (o) the windowed data */
             const float *x,     /* (i) the original data vector */
             const float *y,     /* (i) the window */
@@ -50,18 +62,27 @@ void bwexpand(float *out,       /* (o) the bandwidth expanded lpc coefficients *
               float coef,       /* (i) the bandwidth expansion factor */
               int length);      /* (i) the length of lpc coefficient vectors */
 
+void bwexpandFrame(float *out,  /* (o) the bandwidth expanded lpc coefficients */
+                   float *in,   /* (i) the lpc coefficients before bandwidth expansion */
+                   float coef,  /* (i) the bandwidth expansion factor */
+                   int length,  /* (i) the length of each lpc coefficient vector */
+                   int n);      /* (i) the number of vectors */
+
 void vq(float *Xq,              /* (o) the quantized vector */
         int *index,             /* (o) the quantization index */
-        const float *CB,        /* (i) the vector quantization codebook */
+        const float *CB,        /* (i) the vector quantization codebook, a dimension
+                                       at a time. Element i of codeword j is CB[i*n_cb + j] */
         float *X,               /* (i) the vector to quantize */
-        int n_cb,               /* (i) the number of vectors in the codebook */
-        int dim);               /* (i) the dimension of all vectors */
+        int n_cb,               /* (i) the number of vectors in the codebook, a multiple
+                                       of LSF_VQ_BLOCK */
+        int dim);               /* (i) the dimension of all vectors, at least 2 */
 
 void SplitVQ(float *qX,             /* (o) the quantized vector */
              int *index,            /* (o) a vector of indexes for all vector
                                            codebooks in the split */
              float *X,              /* (i) the vector to quantize */
-             const float *CB,       /* (i) the quantizer codebook */
+             const float *CB,       /* (i) the quantizer codebook, each split stored
+                                           a dimension at a time, as vq() wants */
              int nsplit,            /* the number of vector splits */
              const int *dim,        /* the dimension of X and qX */
              const int *cbsize);    /* the number of vectors in the codebook */
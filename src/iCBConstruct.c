@@ -89,10 +89,8 @@ void iCBConstruct(float *decvector, /* (o) Decoded vector */
                   int veclen,       /* (i) Length of vector */
                   int nStages)      /* (i) Number of codebook stages */
 {
-    int j;
     int k;
     float gain[CB_NSTAGES];
-    float cbvec[SUBL];
 
     /* Gain de-quantization */
     gain[0] = gaindequant(gain_index[0], 1.0, 32);
@@ -101,17 +99,8 @@ void iCBConstruct(float *decvector, /* (o) Decoded vector */
     if (nStages > 2)
         gain[2] = gaindequant(gain_index[2], fabsf(gain[1]), 8);
 
-    /* Codebook vector construction and construction of total vector */
-    getCBvec(cbvec, mem, index[0], lMem, veclen);
-    for (j = 0;  j < veclen;  j++)
-        decvector[j] = gain[0]*cbvec[j];
-    if (nStages > 1)
-    {
-        for (k = 1;  k < nStages;  k++)
-        {
-            getCBvec(cbvec, mem, index[k], lMem, veclen);
-            for (j = 0;  j < veclen;  j++)
-                decvector[j] += gain[k]*cbvec[j];
-        }
-    }
+    /* Codebook vector construction and construction of total vector,
+       each stage scaled and added in as it is built */
+    for (k = 0;  k < nStages;  k++)
+        addCBvec(decvector, mem, index[k], lMem, veclen, gain[k], k == 0);
 }
@@ -31,9 +31,31 @@
 #include "gainquant.h"
 #include "createCB.h"
 #include "filter.h"
+#include "crossCorr.h"
 #include "constants.h"
 #include "iCBSearch.h"
 
+/*
+ * The complexity levels cut the search down like this:
+ *
+ *  0 - the full search of RFC3951.
+ *  1 - the second and third stages only search the base section, and not
+ *      the augmented and filtered sections.
+ *  2 - as 1, and the remaining stages are dropped once the target has been
+ *      matched to within 8dB.
+ *  3 - every stage only searches the base section, and the remaining stages
+ *      are dropped once the target has been matched to within 5dB.
+ */
+
+/* For each complexity level, the fraction of the target's energy below
+   which the remaining codebook stages are not searched. After the first
+   stage, what is left of the target is rarely below 10% of it, so smaller
+   thresholds would hardly ever prune. */
+static const float prune_thresholdTbl[ILBC_COMPLEXITY_LOWEST + 1] =
+{
+    0.0f, 0.0f, 0.15f, 0.3f
+};
+
 /*----------------------------------------------------------------*
  *  Search routine for codebook encoding and gain quantization.
  *---------------------------------------------------------------*/
@@ -48,7 +70,8 @@ void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state str
                int nStages,         /* (i) Number of codebook stages */
                float *weightDenum,  /* (i) weighting filter coefficients */
                float *weightState,  /* (i) weighting filter state */
-               int block)           /* (i) the sub-block number */
+               int block,           /* (i) the sub-block number */
+               icbsearch_scratch_t *scratch)    /* (i/o) working space */
 {
     int i;
     int j;
@@ -70,20 +93,33 @@ void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state str
     int base_size;
     int sIndAug = 0;
     int eIndAug = 0;
-    float buf[CB_MEML + SUBL + 2*ILBC_LPC_FILTERORDER];
-    float invenergy[CB_EXPAND*128];
-    float energy[CB_EXPAND*128];
+    float *buf;
+    float *invenergy;
+    float *energy;
     float *pp;
     float *ppi = 0;
     float *ppo = 0;
     float *ppe = 0;
-    float cbvectors[CB_MEML];
+    float *cbvectors;
+    float *cdots;
     float tene;
     float cene;
     float cvec[SUBL];
     float aug_vec[SUBL];
-
+    float *augvecs;
+    float *faugvecs;
+    int pruned;
+    int faug_ready;
+
+    buf = scratch->buf;
+    invenergy = scratch->invenergy;
+    energy = scratch->energy;
+    cbvectors = scratch->cbvectors;
+    cdots = scratch->cdots;
+    augvecs = scratch->augvecs;
+    faugvecs = scratch->faugvecs;
     memset(cvec, 0, SUBL*sizeof(float));
+    pruned = 0;
 
     /* Determine size of codebook sections */
     base_size = lMem - lTarget + 1;
@@ -109,7 +145,16 @@ void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state str
     /* Prepare search over one more codebook section. This section
        is created by filtering the original buffer with a filter. */
 
-    filteredCBvecs(cbvectors, buf + ILBC_LPC_FILTERORDER, lMem);
+    if (iLBCenc_inst->complexity < 3)
+        filteredCBvecs(cbvectors, buf + ILBC_LPC_FILTERORDER, lMem);
+
+    /* The augmented vectors, and their energies, are the same for every
+       stage, so build them once here */
+    if (lTarget == SUBL)
+        augmentedCBvecs(augvecs, buf + ILBC_LPC_FILTERORDER + lMem, base_size - lTarget/2, energy, invenergy);
+    /* The filtered section's are often not needed, so they are built on
+       first use */
+    faug_ready = 0;
 
     /* The Main Loop over stages */
     for (stage = 0;  stage < nStages;  stage++)
@@ -121,270 +166,286 @@ void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state str
         gain = 0.0f;
         best_index = 0;
 
-        /* Compute cross dot product between the target and the CB memory */
-
-        crossDot = 0.0f;
-        pp = buf + ILBC_LPC_FILTERORDER + lMem - lTarget;
-        for (j = 0;  j < lTarget;  j++)
+        /* At the lower complexity levels, give up on the remaining stages
+           once what is left of the target is too small to matter */
+        if (stage > 0  &&  prune_thresholdTbl[iLBCenc_inst->complexity] > 0.0f  &&  !pruned)
         {
-            crossDot += target[j]*(*pp++);
-        }
-
-        if (stage == 0)
-        {
-            /* Calculate energy in the first block of 'lTarget' samples. */
-            ppe = energy;
-            ppi = buf + ILBC_LPC_FILTERORDER + lMem - lTarget - 1;
-            ppo = buf + ILBC_LPC_FILTERORDER + lMem - 1;
-
-            *ppe = 0.0f;
-            pp = buf + ILBC_LPC_FILTERORDER + lMem - lTarget;
-            for (j = 0;  j < lTarget;  j++, pp++)
-                *ppe += (*pp)*(*pp);
-
-            if (*ppe > 0.0)
-            {
-                invenergy[0] = 1.0f/(*ppe + EPS);
-            }
-            else
-            {
-                invenergy[0] = 0.0f;
-            }
-            ppe++;
-
-            measure = -10000000.0f;
-
-            if (crossDot > 0.0f)
-                measure = crossDot*crossDot*invenergy[0];
-        }
-        else
-        {
-            measure = crossDot*crossDot*invenergy[0];
-        }
-
-        /* Check if measure is better */
-        ftmp = crossDot*invenergy[0];
-
-        if ((measure>max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
-        {
-            best_index = 0;
-            max_measure = measure;
-            gain = ftmp;
+            ftmp = 0.0f;
+            for (j = 0;  j < lTarget;  j++)
+                ftmp += target[j]*target[j];
+            if (ftmp < prune_thresholdTbl[iLBCenc_inst->complexity]*tene)
+                pruned = 1;
         }
 
-        /* loop over the main first codebook section, full search */
-        for (icount = 1;  icount < range;  icount++)
+        if (!pruned)
         {
-            /* calculate measure */
-            crossDot = 0.0f;
-            pp = buf + ILBC_LPC_FILTERORDER + lMem - lTarget - icount;
-
-            for (j = 0;  j < lTarget;  j++)
-                crossDot += target[j]*(*pp++);
+            /* Compute cross dot products between the target and the CB memory,
+               for every vector in the first codebook section, in one go */
+            crossCorr(cdots, target, buf + ILBC_LPC_FILTERORDER + lMem - lTarget, lTarget, range);
+            crossDot = cdots[0];
 
             if (stage == 0)
             {
-                *ppe++ = energy[icount-1] + (*ppi)*(*ppi) - (*ppo)*(*ppo);
-                ppo--;
-                ppi--;
+                /* Calculate energy in the first block of 'lTarget' samples. */
+                ppe = energy;
+                ppi = buf + ILBC_LPC_FILTERORDER + lMem - lTarget - 1;
+                ppo = buf + ILBC_LPC_FILTERORDER + lMem - 1;
 
-                if (energy[icount] > 0.0f)
+                *ppe = 0.0f;
+                pp = buf + ILBC_LPC_FILTERORDER + lMem - lTarget;
+                for (j = 0;  j < lTarget;  j++, pp++)
+                    *ppe += (*pp)*(*pp);
+
+                if (*ppe > 0.0)
                 {
-                    invenergy[icount] = 1.0f/(energy[icount] + EPS);
+                    invenergy[0] = 1.0f/(*ppe + EPS);
                 }
                 else
                 {
-                    invenergy[icount] = 0.0f;
+                    invenergy[0] = 0.0f;
                 }
+                ppe++;
+
                 measure = -10000000.0f;
 
                 if (crossDot > 0.0f)
-                    measure = crossDot*crossDot*invenergy[icount];
+                    measure = crossDot*crossDot*invenergy[0];
             }
             else
             {
-                measure = crossDot*crossDot*invenergy[icount];
+                measure = crossDot*crossDot*invenergy[0];
             }
 
-            /* check if measure is better */
-            ftmp = crossDot*invenergy[icount];
+            /* Check if measure is better */
+            ftmp = crossDot*invenergy[0];
 
-            if ((measure > max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
+            if ((measure>max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
             {
-                best_index = icount;
+                best_index = 0;
                 max_measure = measure;
                 gain = ftmp;
             }
-        }
 
-        /* Loop over augmented part in the first codebook
-         * section, full search.
-         * The vectors are interpolated.
-         */
-        if (lTarget == SUBL)
-        {
-            /* Search for best possible cb vector and compute the CB-vectors' energy. */
-            searchAugmentedCB(20, 39, stage, base_size - lTarget/2,
-                              target, buf + ILBC_LPC_FILTERORDER + lMem,
-                              &max_measure, &best_index, &gain, energy,
-                              invenergy);
-        }
+            /* loop over the main first codebook section, full search */
+            for (icount = 1;  icount < range;  icount++)
+            {
+                /* calculate measure */
+                crossDot = cdots[icount];
 
-        /* set search range for following codebook sections */
-        base_index = best_index;
+                if (stage == 0)
+                {
+                    *ppe++ = energy[icount-1] + (*ppi)*(*ppi) - (*ppo)*(*ppo);
+                    ppo--;
+                    ppi--;
 
-        /* unrestricted search */
-        if (CB_RESRANGE == -1)
-        {
-            sInd = 0;
-            eInd = range - 1;
-            sIndAug = 20;
-            eIndAug = 39;
-        }
-        /* restricted search around best index from first codebook section */
-        else
-        {
-            /* Initialize search indices */
-            sIndAug = 0;
-            eIndAug = 0;
-            sInd = base_index - CB_RESRANGE/2;
-            eInd = sInd + CB_RESRANGE;
+                    if (energy[icount] > 0.0f)
+                    {
+                        invenergy[icount] = 1.0f/(energy[icount] + EPS);
+                    }
+                    else
+                    {
+                        invenergy[icount] = 0.0f;
+                    }
+                    measure = -10000000.0f;
+
+                    if (crossDot > 0.0f)
+                        measure = crossDot*crossDot*invenergy[icount];
+                }
+                else
+                {
+                    measure = crossDot*crossDot*invenergy[icount];
+                }
+
+                /* check if measure is better */
+                ftmp = crossDot*invenergy[icount];
 
-            if (lTarget == SUBL)
+                if ((measure > max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
+                {
+                    best_index = icount;
+                    max_measure = measure;
+                    gain = ftmp;
+                }
+            }
+
+            /* Search the augmented and filtered sections */
+            if (iLBCenc_inst->complexity == ILBC_COMPLEXITY_FULL
+                ||
+                (stage == 0  &&  iLBCenc_inst->complexity < 3))
             {
-                if (sInd < 0)
+                /* Loop over augmented part in the first codebook
+                 * section, full search.
+                 * The vectors are interpolated.
+                 */
+                if (lTarget == SUBL)
                 {
-                    sIndAug = 40 + sInd;
-                    eIndAug = 39;
-                    sInd=0;
+                    /* Search for best possible cb vector */
+                    searchAugmentedCB(20, 39, stage, base_size - lTarget/2,
+                                      target, augvecs,
+                                      &max_measure, &best_index, &gain,
+                                      invenergy);
                 }
-                else if (base_index < (base_size - 20))
+
+                /* set search range for following codebook sections */
+                base_index = best_index;
+
+                /* unrestricted search */
+                if (CB_RESRANGE == -1)
                 {
-                    if (eInd > range)
-                    {
-                        sInd -= (eInd-range);
-                        eInd = range;
-                    }
+                    sInd = 0;
+                    eInd = range - 1;
+                    sIndAug = 20;
+                    eIndAug = 39;
                 }
+                /* restricted search around best index from first codebook section */
                 else
                 {
-                    /* base_index >= (base_size-20) */
-                    if (sInd < (base_size - 20))
-                    {
-                        sIndAug = 20;
-                        sInd = 0;
-                        eInd = 0;
-                        eIndAug = 19 + CB_RESRANGE;
+                    /* Initialize search indices */
+                    sIndAug = 0;
+                    eIndAug = 0;
+                    sInd = base_index - CB_RESRANGE/2;
+                    eInd = sInd + CB_RESRANGE;
 
-                        if (eIndAug > 39)
+                    if (lTarget == SUBL)
+                    {
+                        if (sInd < 0)
                         {
-                            eInd = eIndAug - 39;
+                            sIndAug = 40 + sInd;
                             eIndAug = 39;
+                            sInd=0;
+                        }
+                        else if (base_index < (base_size - 20))
+                        {
+                            if (eInd > range)
+                            {
+                                sInd -= (eInd-range);
+                                eInd = range;
+                            }
+                        }
+                        else
+                        {
+                            /* base_index >= (base_size-20) */
+                            if (sInd < (base_size - 20))
+                            {
+                                sIndAug = 20;
+                                sInd = 0;
+                                eInd = 0;
+                                eIndAug = 19 + CB_RESRANGE;
+
+                                if (eIndAug > 39)
+                                {
+                                    eInd = eIndAug - 39;
+                                    eIndAug = 39;
+                                }
+                            }
+                            else
+                            {
+                                sIndAug = 20 + sInd - (base_size - 20);
+                                eIndAug = 39;
+                                sInd = 0;
+                                eInd = CB_RESRANGE - (eIndAug - sIndAug + 1);
+                            }
                         }
+
                     }
                     else
                     {
-                        sIndAug = 20 + sInd - (base_size - 20);
-                        eIndAug = 39;
-                        sInd = 0;
-                        eInd = CB_RESRANGE - (eIndAug - sIndAug + 1);
-                    }
-                }
+                        /* lTarget = 22 or 23 */
+                        if (sInd < 0)
+                        {
+                            eInd -= sInd;
+                            sInd = 0;
+                        }
 
-            }
-            else
-            {
-                /* lTarget = 22 or 23 */
-                if (sInd < 0)
-                {
-                    eInd -= sInd;
-                    sInd = 0;
+                        if (eInd > range)
+                        {
+                            sInd -= (eInd - range);
+                            eInd = range;
+                        }
+                    }
                 }
 
-                if (eInd > range)
-                {
-                    sInd -= (eInd - range);
-                    eInd = range;
-                }
-            }
-        }
+                /* search of higher codebook section */
 
-        /* search of higher codebook section */
+                /* index search range */
+                counter = sInd;
+                sInd += base_size;
+                eInd += base_size;
 
-        /* index search range */
-        counter = sInd;
-        sInd += base_size;
-        eInd += base_size;
 
+                if (stage == 0)
+                {
+                    ppe = energy+base_size;
+                    *ppe = 0.0f;
+                    pp = cbvectors + lMem - lTarget;
+                    for (j = 0;  j < lTarget;  j++, pp++)
+                        *ppe += (*pp)*(*pp);
 
-        if (stage == 0)
-        {
-            ppe = energy+base_size;
-            *ppe = 0.0f;
-            pp = cbvectors + lMem - lTarget;
-            for (j = 0;  j < lTarget;  j++, pp++)
-                *ppe += (*pp)*(*pp);
+                    ppi = cbvectors + lMem - 1 - lTarget;
+                    ppo = cbvectors + lMem - 1;
 
-            ppi = cbvectors + lMem - 1 - lTarget;
-            ppo = cbvectors + lMem - 1;
+                    for (j = 0;  j < (range - 1);  j++)
+                    {
+                        *(ppe+1) = *ppe + (*ppi)*(*ppi) - (*ppo)*(*ppo);
+                        ppo--;
+                        ppi--;
+                        ppe++;
+                    }
+                }
 
-            for (j = 0;  j < (range - 1);  j++)
-            {
-                *(ppe+1) = *ppe + (*ppi)*(*ppi) - (*ppo)*(*ppo);
-                ppo--;
-                ppi--;
-                ppe++;
-            }
-        }
+                /* Cross dot products for the whole search range */
+                crossCorr(cdots, target, cbvectors + lMem - lTarget - counter, lTarget, eInd - sInd);
 
-        /* loop over search range */
-        for (icount = sInd;  icount < eInd;  icount++)
-        {
-            /* calculate measure */
-            crossDot = 0.0f;
-            pp = cbvectors + lMem - (counter++) - lTarget;
+                /* loop over search range */
+                for (icount = sInd;  icount < eInd;  icount++)
+                {
+                    /* calculate measure */
+                    crossDot = cdots[icount - sInd];
 
-            for (j = 0;  j < lTarget;  j++)
-                crossDot += target[j]*(*pp++);
+                    if (energy[icount] > 0.0f)
+                        invenergy[icount] = 1.0f/(energy[icount] + EPS);
+                    else
+                        invenergy[icount] = 0.0f;
 
-            if (energy[icount] > 0.0f)
-                invenergy[icount] = 1.0f/(energy[icount] + EPS);
-            else
-                invenergy[icount] = 0.0f;
+                    if (stage == 0)
+                    {
 
-            if (stage == 0)
-            {
+                        measure = -10000000.0f;
 
-                measure = -10000000.0f;
+                        if (crossDot > 0.0f)
+                            measure = crossDot*crossDot*invenergy[icount];
+                    }
+                    else
+                    {
+                        measure = crossDot*crossDot*invenergy[icount];
+                    }
 
-                if (crossDot > 0.0f)
-                    measure = crossDot*crossDot*invenergy[icount];
-            }
-            else
-            {
-                measure = crossDot*crossDot*invenergy[icount];
-            }
+                    /* check if measure is better */
+                    ftmp = crossDot*invenergy[icount];
 
-            /* check if measure is better */
-            ftmp = crossDot*invenergy[icount];
+                    if ((measure > max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
+                    {
+                        best_index = icount;
+                        max_measure = measure;
+                        gain = ftmp;
+                    }
+                }
 
-            if ((measure > max_measure)  &&  (fabs(ftmp) < CB_MAXGAIN))
-            {
-                best_index = icount;
-                max_measure = measure;
-                gain = ftmp;
+                /* Search the augmented CB inside the limited range. */
+                if ((lTarget == SUBL)  &&  (sIndAug != 0))
+                {
+                    if (!faug_ready)
+                    {
+                        augmentedCBvecs(faugvecs, cbvectors + lMem, 2*base_size - 20, energy, invenergy);
+                        faug_ready = 1;
+                    }
+                    searchAugmentedCB(sIndAug, eIndAug, stage,
+                                      2*base_size-20, target, faugvecs,
+                                      &max_measure, &best_index, &gain,
+                                      invenergy);
+                }
             }
         }
 
-        /* Search the augmented CB inside the limited range. */
-        if ((lTarget == SUBL)  &&  (sIndAug != 0))
-        {
-            searchAugmentedCB(sIndAug, eIndAug, stage,
-                              2*base_size-20, target, cbvectors + lMem,
-                              &max_measure, &best_index, &gain, energy,
-                              invenergy);
-        }
-
         /* record best index */
         index[stage] = best_index;
 
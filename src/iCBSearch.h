@@ -20,6 +20,18 @@
 #ifndef __iLBC_ICBSEARCH_H
 #define __iLBC_ICBSEARCH_H
 
+/* Working space for iCBSearch(). This needs iLBC_define.h and createCB.h */
+typedef struct
+{
+    float buf[CB_MEML + SUBL + 2*ILBC_LPC_FILTERORDER];
+    float invenergy[CB_EXPAND*128];
+    float energy[CB_EXPAND*128];
+    float cbvectors[CB_MEML];
+    float cdots[CB_MEML];
+    float augvecs[SUBL*CB_AUG_VECS];
+    float faugvecs[SUBL*CB_AUG_VECS];
+} icbsearch_scratch_t;
+
 void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state structure */
                int *index,                          /* (o) Codebook indices */
                int *gain_index,                     /* (o) Gain quantization indices */
@@ -30,6 +42,7 @@ void iCBSearch(ilbc_encode_state_t *iLBCenc_inst,   /* (i) the encoder state str
                int nStages,                         /* (i) Number of codebook stages */
                float *weightDenum,                  /* (i) weighting filter coefficients */
                float *weightState,                  /* (i) weighting filter state */
-               int block);                          /* (i) the sub-block number */
+               int block,                           /* (i) the sub-block number */
+               icbsearch_scratch_t *scratch);       /* (i/o) working space */
 
 #endif
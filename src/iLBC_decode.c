@@ -25,11 +25,13 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 
 #include "ilbc2.h"
 #include "StateConstructW.h"
 #include "LPCdecode.h"
+#include "lsf.h"
 #include "iCBConstruct.h"
 #include "doCPLC.h"
 #include "helpfun.h"
@@ -38,55 +40,72 @@
 #include "string.h"
 #include "enhancer.h"
 #include "hpOutput.h"
+#include "floatToPcm.h"
+#include "resample.h"
+#include "g711.h"
+#include "dtx.h"
+#include "timeScale.h"
 #include "syntFilter.h"
+#include "filterBank.h"
+#include "ilbc_profile.h"
 
-#if (defined(WIN32) || defined(_WIN32)) && (_MSC_VER < 1800)
-#if (defined(WIN32)  ||  defined(_WIN32)) && !defined(_WIN64)
-    __inline long int rint(double dbl)
-    {
-        _asm 
-    	{
-            fld dbl
-            frndint
-            fstp dbl
-        }
-        return (long int) dbl;
-    }
-#elif defined (_WIN64)
-#include <intrin.h>
-    __inline__ long int rint(double x)
-    {
-#ifdef _M_X64
-		return (long int)_mm_cvtsd_si64x( _mm_loadu_pd ((const double*)&x) );
-#else
-#warning "Not Supported: Replacing with a simple C cast."
-	return (long int) (x);
-#endif
-    }
-#endif
-#endif
+/* The number of channels ilbc_decode_batch() synthesises together.
+   Each channel of a chunk is a lane of the filter bank. */
+#define DECODE_BATCH_CHUNK      FILTER_BANK_LANES
 
 /*----------------------------------------------------------------*
- *  frame residual decoder function (subrutine to iLBC_decode)
+ *  Working space for decoding a frame, which is what the scratch
+ *  area passed to ilbc_decode_ex() and ilbc_fillin_ex() holds.
  *---------------------------------------------------------------*/
 
-static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder state structure */
-                   float *decresidual,                 /* (o) decoded residual frame */
-                   int start,                          /* (i) location of start state */
-                   int idxForMax,                      /* (i) codebook index for the maximum value */
-                   int *idxVec,                        /* (i) codebook indexes for the samples in the
-                                                              start state */
-                   float *syntdenum,                   /* (i) the decoded synthesis filter coefficients */
-                   int *cb_index,                      /* (i) the indexes for the adaptive codebook */
-                   int *gain_index,                    /* (i) the indexes for the corresponding gains */
-                   int *extra_cb_index,                /* (i) the indexes for the adaptive codebook part
-                                                              of start state */
-                   int *extra_gain_index,              /* (i) the indexes for the corresponding gains */
-                   int state_first)                    /* (i) 1 if non adaptive part of start state comes
-                                                              first. 0 if that part comes last */
+typedef struct
 {
+    float decblock[ILBC_BLOCK_LEN_MAX];
+    float data[ILBC_BLOCK_LEN_MAX];
+    float PLCresidual[ILBC_BLOCK_LEN_MAX];
+    float decresidual[ILBC_BLOCK_LEN_MAX];
     float reverseDecresidual[ILBC_BLOCK_LEN_MAX];
     float mem[CB_MEML];
+    float syntdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
+    enhancer_scratch_t enh;
+} decode_scratch_t;
+
+/* Working space for ilbc_decode_batch(), which runs the synthesis and
+   output high pass filters for a chunk of channels in the lanes of a
+   filter bank */
+typedef struct
+{
+    /* The signal, after the synthesis filter's state */
+    float x[(ILBC_LPC_FILTERORDER + ILBC_BLOCK_LEN_MAX)*FILTER_BANK_LANES];
+    float a[(ILBC_LPC_FILTERORDER + 1)*FILTER_BANK_LANES];
+    float hpmem[4*FILTER_BANK_LANES];
+    /* The decoded residual and synthesis filters of each lane */
+    float decresidual[DECODE_BATCH_CHUNK][ILBC_BLOCK_LEN_MAX];
+    float syntdenum[DECODE_BATCH_CHUNK][ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
+} decode_batch_scratch_t;
+
+/*----------------------------------------------------------------*
+ *  frame residual decoder function (subrutine to iLBC_decode)
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void Decode(float *decresidual,           /* (o) decoded residual frame */
+                                      int start,                    /* (i) location of start state */
+                                      int idxForMax,                /* (i) codebook index for the maximum value */
+                                      int *idxVec,                  /* (i) codebook indexes for the samples in the
+                                                                           start state */
+                                      float *syntdenum,             /* (i) the decoded synthesis filter coefficients */
+                                      int *cb_index,                /* (i) the indexes for the adaptive codebook */
+                                      int *gain_index,              /* (i) the indexes for the corresponding gains */
+                                      int *extra_cb_index,          /* (i) the indexes for the adaptive codebook part
+                                                                           of start state */
+                                      int *extra_gain_index,        /* (i) the indexes for the corresponding gains */
+                                      int state_first,              /* (i) 1 if non adaptive part of start state comes
+                                                                           first. 0 if that part comes last */
+                                      decode_scratch_t *t,          /* (i/o) working space */
+                                      int frame_mode)               /* (i) the frame size mode, as a constant */
+{
+    float *reverseDecresidual;
+    float *mem;
     int k;
     int meml_gotten;
     int Nfor;
@@ -96,8 +115,14 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
     int start_pos;
     int subcount;
     int subframe;
+    int nsub;
+    int state_short_len;
 
-    diff = STATE_LEN - iLBCdec_inst->state_short_len;
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
+    state_short_len = (frame_mode == 30)  ?  STATE_SHORT_LEN_30MS  :  STATE_SHORT_LEN_20MS;
+    reverseDecresidual = t->reverseDecresidual;
+    mem = t->mem;
+    diff = STATE_LEN - state_short_len;
 
     if (state_first == 1)
         start_pos = (start - 1)*SUBL;
@@ -109,20 +134,20 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
                     idxVec,
                     &syntdenum[(start - 1)*(ILBC_LPC_FILTERORDER + 1)],
                     &decresidual[start_pos],
-                    iLBCdec_inst->state_short_len);
+                    state_short_len);
 
     if (state_first)
     {
         /* put adaptive part in the end */
 
         /* setup memory */
-        memset(mem, 0, (CB_MEML - iLBCdec_inst->state_short_len)*sizeof(float));
-        memcpy(&mem[CB_MEML - iLBCdec_inst->state_short_len],
+        memset(mem, 0, (CB_MEML - state_short_len)*sizeof(float));
+        memcpy(&mem[CB_MEML - state_short_len],
                decresidual + start_pos,
-               iLBCdec_inst->state_short_len*sizeof(float));
+               state_short_len*sizeof(float));
 
         /* construct decoded vector */
-        iCBConstruct(&decresidual[start_pos+iLBCdec_inst->state_short_len],
+        iCBConstruct(&decresidual[start_pos+state_short_len],
                      extra_cb_index, extra_gain_index, mem+CB_MEML-stMemLTbl,
                      stMemLTbl,
                      diff,
@@ -136,12 +161,12 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
         for (k = 0;  k < diff;  k++)
         {
             reverseDecresidual[k] =
-                decresidual[(start + 1)*SUBL - 1 - (k + iLBCdec_inst->state_short_len)];
+                decresidual[(start + 1)*SUBL - 1 - (k + state_short_len)];
         }
 
         /* Setup memory */
 
-        meml_gotten = iLBCdec_inst->state_short_len;
+        meml_gotten = state_short_len;
         for (k = 0;  k < meml_gotten;  k++)
             mem[CB_MEML - 1 - k] = decresidual[start_pos + k];
         memset(mem, 0, (CB_MEML - k)*sizeof(float));
@@ -163,7 +188,7 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
     subcount = 0;
 
     /* Forward prediction of sub-frames */
-    Nfor = iLBCdec_inst->nsub-start - 1;
+    Nfor = nsub-start - 1;
 
     if (Nfor > 0)
     {
@@ -199,7 +224,7 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
     if (Nback > 0)
     {
         /* Setup memory */
-        meml_gotten = SUBL*(iLBCdec_inst->nsub + 1 - start);
+        meml_gotten = SUBL*(nsub + 1 - start);
 
         if (meml_gotten > CB_MEML)
             meml_gotten = CB_MEML;
@@ -235,217 +260,211 @@ static void Decode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder stat
 }
 
 /*----------------------------------------------------------------*
- *  main decoder function
+ *  Decode or conceal a frame. This is built separately for each
+ *  frame size mode.
+ *---------------------------------------------------------------*/
+
+/*----------------------------------------------------------------*
+ *  The first stage of decoding a frame: unpack the parameters,
+ *  check them, and dequantize the LSFs. This uses nothing from
+ *  the decoder's history. Returns 1 if the frame should be
+ *  decoded, or 0 if it is empty or corrupt, and should be
+ *  concealed.
  *---------------------------------------------------------------*/
 
-static void ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst, /* (i/o) the decoder state structure */
-                              float decblock[],                  /* (o) decoded signal block */
-                              const uint8_t bytes[],             /* (i) encoded signal bits */
-                              int mode)                          /* (i) 0: bad packet, PLC, 1: normal */
+static int parse_frame(ilbc_frame_params_t *fp,    /* (o) the checked parameters */
+                       const uint8_t bytes[],      /* (i) encoded signal bits */
+                       int frame_mode)             /* (i) the frame size mode */
 {
-    float data[ILBC_BLOCK_LEN_MAX];
-    float lsfdeq[ILBC_LPC_FILTERORDER*LPC_N_MAX];
-    float PLCresidual[ILBC_BLOCK_LEN_MAX];
+    frame_params_t params;
+    int nsub;
+    int lpc_n;
+
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
+    lpc_n = (frame_mode == 30)  ?  LPC_N_30MS  :  LPC_N_20MS;
+    fp->mode = frame_mode;
+    unpack_frame(&params, bytes, frame_mode);
+
+    /* Check for bit errors or empty/lost frames */
+    fp->valid = 1;
+    if (params.start < 1)
+        fp->valid = 0;
+    if (params.start > nsub - 1)
+        fp->valid = 0;
+    if (params.last_bit == 1)
+        fp->valid = 0;
+    if (!fp->valid)
+        return 0;
+
+    /* Adjust index */
+    index_conv_dec(params.cb_index);
+
+    /* Decode the LSF */
+    SimplelsfDEQ(fp->lsfdeq, params.lsf_i, lpc_n);
+    LSF_check(fp->lsfdeq, ILBC_LPC_FILTERORDER, lpc_n);
+
+    fp->start = params.start;
+    fp->state_first = params.state_first;
+    fp->idxForMax = params.idxForMax;
+    memcpy(fp->idxVec, params.idxVec, sizeof(fp->idxVec));
+    memcpy(fp->extra_cb_index, params.extra_cb_index, sizeof(fp->extra_cb_index));
+    memcpy(fp->extra_gain_index, params.extra_gain_index, sizeof(fp->extra_gain_index));
+    memcpy(fp->cb_index, params.cb_index, sizeof(fp->cb_index));
+    memcpy(fp->gain_index, params.gain_index, sizeof(fp->gain_index));
+    return 1;
+}
+
+/*----------------------------------------------------------------*
+ *  Decode a good frame's residual and synthesis filters, and keep
+ *  them as the history for concealing a later loss.
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void decode_residual(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder state structure */
+                                              float decresidual[],              /* (o) the decoded residual */
+                                              float syntdenum[],                /* (o) the synthesis filters */
+                                              const ilbc_frame_params_t *fp,    /* (i) the frame's parameters */
+                                              decode_scratch_t *t,              /* (i/o) working space */
+                                              int frame_mode)                   /* (i) the frame size mode, as a constant */
+{
+    ilbc_frame_params_t params;
     float PLClpc[ILBC_LPC_FILTERORDER + 1];
-    float zeros[ILBC_BLOCK_LEN_MAX];
-    float one[ILBC_LPC_FILTERORDER + 1];
-    int k;
-    int i;
-    int start;
-    int idxForMax;
-    int pos;
-    int lastpart;
-    int ulp;
-    int lag;
-    int ilag;
-    float cc;
-    float maxcc;
-    int idxVec[STATE_LEN];
-    int gain_index[NASUB_MAX*CB_NSTAGES];
-    int extra_gain_index[CB_NSTAGES];
-    int cb_index[CB_NSTAGES*NASUB_MAX];
-    int extra_cb_index[CB_NSTAGES];
-    int lsf_i[LSF_NSPLIT*LPC_N_MAX];
-    int state_first;
-    int last_bit;
-    const uint8_t *pbytes;
-    float weightdenum[(ILBC_LPC_FILTERORDER + 1)*ILBC_NUM_SUB_MAX];
-    int order_plus_one;
-    float syntdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
-    float decresidual[ILBC_BLOCK_LEN_MAX];
+    int nsub;
 
-    if (mode > 0)
-    {
-        /* The data is good. decode it. */
-        pbytes = bytes;
-        pos = 0;
-
-        /* Set everything to zero before decoding */
-        for (k = 0;  k < LSF_NSPLIT*LPC_N_MAX;  k++)
-            lsf_i[k] = 0;
-        start = 0;
-        state_first = 0;
-        idxForMax = 0;
-        for (k = 0;  k < iLBCdec_inst->state_short_len;  k++)
-            idxVec[k] = 0;
-        for (k = 0;  k < CB_NSTAGES;  k++)
-        {
-            extra_cb_index[k] = 0;
-            extra_gain_index[k] = 0;
-        }
-        for (i = 0;  i < iLBCdec_inst->nasub;  i++)
-        {
-            for (k = 0;  k < CB_NSTAGES;  k++)
-            {
-                cb_index[i*CB_NSTAGES + k] = 0;
-                gain_index[i*CB_NSTAGES + k] = 0;
-            }
-        }
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
 
-        /* Loop over ULP classes */
-        for (ulp = 0;  ulp < 3;  ulp++)
-        {
-            /* LSF */
-            for (k = 0;  k < LSF_NSPLIT*iLBCdec_inst->lpc_n;  k++)
-            {
-                unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->lsf_bits[k][ulp], &pos);
-                packcombine(&lsf_i[k], lastpart, iLBCdec_inst->ULP_inst->lsf_bits[k][ulp]);
-            }
+    /* Decode() takes the indexes as plain arrays, so work from a copy of
+       the parameters. */
+    params = *fp;
+    DecoderInterpolateLSF(syntdenum, params.lsfdeq, ILBC_LPC_FILTERORDER, iLBCdec_inst);
 
-            /* Start block info */
-            unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->start_bits[ulp], &pos);
-            packcombine(&start, lastpart, iLBCdec_inst->ULP_inst->start_bits[ulp]);
+    Decode(decresidual,
+           params.start,
+           params.idxForMax,
+           params.idxVec,
+           syntdenum,
+           params.cb_index,
+           params.gain_index,
+           params.extra_cb_index,
+           params.extra_gain_index,
+           params.state_first,
+           t,
+           frame_mode);
+
+    /* Preparing the plc for a future loss! */
+    doThePLC(t->PLCresidual,
+             PLClpc,
+             0,
+             decresidual,
+             syntdenum + (ILBC_LPC_FILTERORDER + 1)*(nsub - 1),
+             (*iLBCdec_inst).last_lag,
+             iLBCdec_inst);
+}
 
-            unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->startfirst_bits[ulp], &pos);
-            packcombine(&state_first, lastpart, iLBCdec_inst->ULP_inst->startfirst_bits[ulp]);
+/*----------------------------------------------------------------*
+ *  Find the pitch lag at the end of a decoded residual, for the
+ *  concealment to use if the next frame is lost. The regressor of
+ *  the longest lag has to stay within the frame, so a 20ms frame
+ *  correlates over a shorter target, as compCorr() does.
+ *---------------------------------------------------------------*/
 
-            unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->scale_bits[ulp], &pos);
-            packcombine(&idxForMax, lastpart, iLBCdec_inst->ULP_inst->scale_bits[ulp]);
+static int find_last_lag(float decresidual[],    /* (i) the decoded residual */
+                         int blockl)             /* (i) the frame length */
+{
+    int subl;
 
-            for (k = 0;  k < iLBCdec_inst->state_short_len;  k++)
-            {
-                unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->state_bits[ulp], &pos);
-                packcombine(idxVec + k, lastpart, iLBCdec_inst->ULP_inst->state_bits[ulp]);
-            }
+    subl = blockl - (20 + 100 - 1);
+    if (subl > ENH_BLOCKL)
+        subl = ENH_BLOCKL;
+    return xCorrCoefLags(&decresidual[blockl - subl], subl, 20, 100);
+}
 
-            /* 23/22 (20ms/30ms) sample block */
-            for (k = 0;  k < CB_NSTAGES;  k++)
-            {
-                unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->extra_cb_index[k][ulp], &pos);
-                packcombine(extra_cb_index + k, lastpart, iLBCdec_inst->ULP_inst->extra_cb_index[k][ulp]);
-            }
-            for (k = 0;  k < CB_NSTAGES;  k++)
-            {
-                unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->extra_cb_gain[k][ulp], &pos);
-                packcombine(extra_gain_index + k, lastpart, iLBCdec_inst->ULP_inst->extra_cb_gain[k][ulp]);
-            }
+/*----------------------------------------------------------------*
+ *  The second stage of decoding a frame: synthesis from the
+ *  parameters parse_frame() found, or concealment when there are
+ *  none. Returns 1 if the frame was decoded, or 0 if it was
+ *  concealed.
+ *---------------------------------------------------------------*/
 
-            /* The two/four (20ms/30ms) 40 sample sub-blocks */
-            for (i = 0;  i < iLBCdec_inst->nasub;  i++)
-            {
-                for (k = 0;  k < CB_NSTAGES;  k++)
-                {
-                    unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->cb_index[i][k][ulp], &pos);
-                    packcombine(cb_index + i*CB_NSTAGES + k, lastpart, iLBCdec_inst->ULP_inst->cb_index[i][k][ulp]);
-                }
-            }
-            for (i = 0;  i < iLBCdec_inst->nasub;  i++)
-            {
-                for (k = 0;  k < CB_NSTAGES;  k++)
-                {
-                    unpack(&pbytes, &lastpart, iLBCdec_inst->ULP_inst->cb_gain[i][k][ulp], &pos);
-                    packcombine(gain_index + i*CB_NSTAGES + k, lastpart, iLBCdec_inst->ULP_inst->cb_gain[i][k][ulp]);
-                }
-            }
-        }
-        /* Extract last bit. If it is 1 this indicates an empty/lost frame */
-        unpack(&pbytes, &last_bit, 1, &pos);
-
-        /* Check for bit errors or empty/lost frames */
-        if (start < 1)
-            mode = 0;
-        if (iLBCdec_inst->mode == 20  &&  start > 3)
-            mode = 0;
-        if (iLBCdec_inst->mode == 30  &&  start > 5)
-            mode = 0;
-        if (last_bit == 1)
-            mode = 0;
-
-        if (mode == 1)
-        {
-            /* No bit errors was detected, continue decoding */
-
-            /* Adjust index */
-            index_conv_dec(cb_index);
-
-            /* Decode the LSF */
-            SimplelsfDEQ(lsfdeq, lsf_i, iLBCdec_inst->lpc_n);
-            LSF_check(lsfdeq, ILBC_LPC_FILTERORDER, iLBCdec_inst->lpc_n);
-            DecoderInterpolateLSF(syntdenum, weightdenum, lsfdeq, ILBC_LPC_FILTERORDER, iLBCdec_inst);
-
-            Decode(iLBCdec_inst,
-                   decresidual,
-                   start,
-                   idxForMax,
-                   idxVec,
-                   syntdenum,
-                   cb_index,
-                   gain_index,
-                   extra_cb_index,
-                   extra_gain_index,
-                   state_first);
-
-            /* Preparing the plc for a future loss! */
-            doThePLC(PLCresidual,
-                     PLClpc,
-                     0,
-                     decresidual,
-                     syntdenum + (ILBC_LPC_FILTERORDER + 1)*(iLBCdec_inst->nsub - 1),
-                     (*iLBCdec_inst).last_lag,
-                     iLBCdec_inst);
-
-            memcpy(decresidual, PLCresidual, iLBCdec_inst->blockl*sizeof(float));
-        }
+static ILBC_ALWAYS_INLINE int decode_frame(ilbc_decode_state_t *iLBCdec_inst,   /* (i/o) the decoder state structure */
+                                           float decblock[],                /* (o) decoded signal block */
+                                           const ilbc_frame_params_t *fp,   /* (i) the frame's parameters, or NULL
+                                                                                   to conceal */
+                                           decode_scratch_t *t,             /* (i/o) working space */
+                                           int frame_mode)                  /* (i) the frame size mode, as a constant */
+{
+    float *data;
+    float *PLCresidual;
+    float PLClpc[ILBC_LPC_FILTERORDER + 1];
+    int i;
+    int lag;
+    int mode;
+    int order_plus_one;
+    float *syntdenum;
+    float *decresidual;
+    int nsub;
+    int blockl;
+
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
+    blockl = (frame_mode == 30)  ?  ILBC_BLOCK_LEN_30MS  :  ILBC_BLOCK_LEN_20MS;
+    data = t->data;
+    PLCresidual = t->PLCresidual;
+    syntdenum = t->syntdenum;
+    decresidual = t->decresidual;
+    ILBC_PROFILE_START(iLBCdec_inst, ILBC_PROF_DECODE);
+    mode = (fp  &&  fp->valid)  ?  1  :  0;
+    if (mode > 0)
+    {
+        /* The data is good. decode it. */
+        decode_residual(iLBCdec_inst, decresidual, syntdenum, fp, t, frame_mode);
     }
+    ILBC_PROFILE_STOP(iLBCdec_inst, ILBC_PROF_DECODE);
 
     if (mode == 0)
     {
         /* The data is bad (either a PLC call
          * was made or a severe bit error was detected)
          */
+        ILBC_PROFILE_START(iLBCdec_inst, ILBC_PROF_PLC);
+        ILBC_STATS_COUNT(iLBCdec_inst, lost_frames);
+#if defined(ILBC_STATS)
+        if (iLBCdec_inst->prevPLI != 1)
+            iLBCdec_inst->stats.plc_runs++;
+#endif
 
-        /* Apply packet loss concealmeant */
-        memset(zeros, 0, ILBC_BLOCK_LEN_MAX*sizeof(float));
-
-        one[0] = 1;
-        memset(one + 1, 0, ILBC_LPC_FILTERORDER*sizeof(float));
-
-        start = 0;
- 
-        doThePLC(PLCresidual, PLClpc, 1, zeros, one, (*iLBCdec_inst).last_lag, iLBCdec_inst);
-        memcpy(decresidual, PLCresidual, iLBCdec_inst->blockl*sizeof(float));
+        /* Apply packet loss concealmeant. This works only from the
+           decoder's history, so there is no decoded residual or LPC to give it. */
+        doThePLC(PLCresidual, PLClpc, 1, NULL, NULL, (*iLBCdec_inst).last_lag, iLBCdec_inst);
+        decresidual = PLCresidual;
 
         order_plus_one = ILBC_LPC_FILTERORDER + 1;
-        for (i = 0;  i < iLBCdec_inst->nsub;  i++)
+        for (i = 0;  i < nsub;  i++)
             memcpy(&syntdenum[i*order_plus_one], PLClpc, order_plus_one*sizeof(float));
+#if defined(ILBC_STATS)
+        if ((uint32_t) iLBCdec_inst->consPLICount > iLBCdec_inst->stats.longest_plc_run)
+            iLBCdec_inst->stats.longest_plc_run = iLBCdec_inst->consPLICount;
+#endif
+        ILBC_PROFILE_STOP(iLBCdec_inst, ILBC_PROF_PLC);
     }
 
-    if (iLBCdec_inst->use_enhancer == 1)
+    if (iLBCdec_inst->use_enhancer != ILBC_ENHANCER_OFF)
     {
         /* Post filtering */
-        iLBCdec_inst->last_lag = enhancerInterface(data, decresidual, iLBCdec_inst);
+        ILBC_STATS_COUNT(iLBCdec_inst, enhanced_frames);
+        ILBC_PROFILE_START(iLBCdec_inst, ILBC_PROF_ENHANCER);
+        iLBCdec_inst->last_lag = enhancerInterface(data, decresidual, iLBCdec_inst, &t->enh);
+        ILBC_PROFILE_STOP(iLBCdec_inst, ILBC_PROF_ENHANCER);
 
         /* Synthesis filtering */
-        if (iLBCdec_inst->mode == 20)
+        if (frame_mode == 20)
         {
             /* Enhancer has 40 samples delay */
             i = 0;
             syntFilter(data + i*SUBL,
-                       iLBCdec_inst->old_syntdenum + (i + iLBCdec_inst->nsub - 1)*(ILBC_LPC_FILTERORDER + 1),
+                       iLBCdec_inst->old_syntdenum + (i + nsub - 1)*(ILBC_LPC_FILTERORDER + 1),
                        SUBL,
                        iLBCdec_inst->syntMem);
 
-            for (i = 1;  i < iLBCdec_inst->nsub;  i++)
+            for (i = 1;  i < nsub;  i++)
             {
                 syntFilter(data + i*SUBL,
                            syntdenum + (i - 1)*(ILBC_LPC_FILTERORDER + 1),
@@ -453,17 +472,17 @@ static void ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst, /* (i/o) the de
                            iLBCdec_inst->syntMem);
             }
         }
-        else if (iLBCdec_inst->mode == 30)
+        else
         {
             /* Enhancer has 80 samples delay */
             for (i = 0;  i < 2;  i++)
             {
                 syntFilter(data + i*SUBL,
-                           iLBCdec_inst->old_syntdenum + (i + iLBCdec_inst->nsub - 2)*(ILBC_LPC_FILTERORDER+1),
+                           iLBCdec_inst->old_syntdenum + (i + nsub - 2)*(ILBC_LPC_FILTERORDER+1),
                            SUBL,
                            iLBCdec_inst->syntMem);
             }
-            for (i = 2;  i < iLBCdec_inst->nsub;  i++)
+            for (i = 2;  i < nsub;  i++)
             {
                 syntFilter(data + i*SUBL,
                            syntdenum + (i - 2)*(ILBC_LPC_FILTERORDER + 1),
@@ -474,28 +493,18 @@ static void ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst, /* (i/o) the de
     }
     else
     {
-        /* Find last lag */
-        lag = 20;
-        maxcc = xCorrCoef(&decresidual[ILBC_BLOCK_LEN_MAX - ENH_BLOCKL],
-                          &decresidual[ILBC_BLOCK_LEN_MAX - ENH_BLOCKL - lag],
-                          ENH_BLOCKL);
-
-        for (ilag = 21;  ilag < 120;  ilag++)
-        {
-            cc = xCorrCoef(&decresidual[ILBC_BLOCK_LEN_MAX - ENH_BLOCKL],
-                           &decresidual[ILBC_BLOCK_LEN_MAX - ENH_BLOCKL - ilag],
-                           ENH_BLOCKL);
-            if (cc > maxcc)
-            {
-                maxcc = cc;
-                lag = ilag;
-            }
-        }
+        /* Find last lag. The concealment only looks at this after a good
+           frame, so for a concealed one just keep the lag it repeated,
+           saving the search on every frame of a burst. */
+        if (mode == 0)
+            lag = iLBCdec_inst->prevLag;
+        else
+            lag = find_last_lag(decresidual, blockl);
         iLBCdec_inst->last_lag = lag;
 
         /* Copy data and run synthesis filter */
-        memcpy(data, decresidual, iLBCdec_inst->blockl*sizeof(float));
-        for (i = 0;  i < iLBCdec_inst->nsub;  i++)
+        memcpy(data, decresidual, blockl*sizeof(float));
+        for (i = 0;  i < nsub;  i++)
         {
             syntFilter(data + i*SUBL,
                        syntdenum + i*(ILBC_LPC_FILTERORDER + 1),
@@ -505,12 +514,12 @@ static void ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst, /* (i/o) the de
     }
 
     /* High pass filtering on output if desired, otherwise copy to out */
-    hpOutput(data, iLBCdec_inst->blockl, decblock, iLBCdec_inst->hpomem);
+    hpOutput(data, blockl, decblock, iLBCdec_inst->hpomem);
 
-    /* memcpy(decblock, data, iLBCdec_inst->blockl*sizeof(float));*/
+    /* memcpy(decblock, data, blockl*sizeof(float));*/
     memcpy(iLBCdec_inst->old_syntdenum,
            syntdenum,
-           iLBCdec_inst->nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+           nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
 
     iLBCdec_inst->prev_enh_pl = 0;
 
@@ -519,6 +528,169 @@ static void ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst, /* (i/o) the de
         /* PLC was used */
         iLBCdec_inst->prev_enh_pl = 1;
     }
+    iLBCdec_inst->frames++;
+    ILBC_STATS_COUNT(iLBCdec_inst, frames);
+    iLBCdec_inst->repeat_settled = 0;
+    return mode;
+}
+
+/*----------------------------------------------------------------*
+ *  main decoder function. Returns 1 if the frame was decoded,
+ *  or 0 if it was concealed. A copy of the frame decoder is built
+ *  here for each frame size mode, so its loops have constant trip
+ *  counts. The mode is chosen on each call, rather than through a
+ *  pointer set up by ilbc_decode_init(), so a state stays valid
+ *  when it is copied, exported or rewound.
+ *---------------------------------------------------------------*/
+
+static int decode_frame_mode(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder state structure */
+                             float decblock[],                  /* (o) decoded signal block */
+                             const uint8_t bytes[],             /* (i) encoded signal bits */
+                             int mode,                          /* (i) 0: bad packet, PLC, 1: normal */
+                             decode_scratch_t *t)               /* (i/o) working space */
+{
+    ilbc_frame_params_t fp;
+
+    if (iLBCdec_inst->mode == 30)
+    {
+        if (mode > 0)
+            parse_frame(&fp, bytes, 30);
+        return decode_frame(iLBCdec_inst, decblock, (mode > 0)  ?  &fp  :  NULL, t, 30);
+    }
+    if (mode > 0)
+        parse_frame(&fp, bytes, 20);
+    return decode_frame(iLBCdec_inst, decblock, (mode > 0)  ?  &fp  :  NULL, t, 20);
+}
+
+/* The parts of the decoder state which decoding a frame reads and changes,
+   except the output high pass filter's state. The frame count, between them,
+   changes on every frame. */
+#define PLC_STATE_START         offsetof(ilbc_decode_state_t, last_lag)
+#define PLC_STATE_LEN           (offsetof(ilbc_decode_state_t, frames) - PLC_STATE_START)
+#define LPC_STATE_START         offsetof(ilbc_decode_state_t, lsfdeqold)
+#define LPC_STATE_LEN           (offsetof(ilbc_decode_state_t, lsfdeq_memo) - LPC_STATE_START)
+#define ENH_STATE_START         offsetof(ilbc_decode_state_t, enh_period)
+#define ENH_STATE_LEN           (sizeof(ilbc_decode_state_t) - ENH_STATE_START)
+
+static int ilbc_decode_frame(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) the decoder state structure */
+                             float decblock[],                  /* (o) decoded signal block */
+                             const uint8_t bytes[],             /* (i) encoded signal bits */
+                             int mode,                          /* (i) 0: bad packet, PLC, 1: normal */
+                             decode_scratch_t *t)               /* (i/o) working space */
+{
+    uint8_t plc[PLC_STATE_LEN];
+    uint8_t lpc[LPC_STATE_LEN];
+    uint8_t enh[ENH_STATE_LEN];
+    float syntMem[ILBC_LPC_FILTERORDER];
+    uint8_t *state;
+    int repeat;
+    int decoded;
+
+    if (mode <= 0)
+        return decode_frame_mode(iLBCdec_inst, decblock, NULL, 0, t);
+    /* A compact state has no room to keep a repeated frame */
+    if (!iLBCdec_inst->full_state)
+        return decode_frame_mode(iLBCdec_inst, decblock, bytes, mode, t);
+
+    /* A repeated frame, such as the canonical frame of digital silence. The
+       decoding is deterministic, so once a copy of the frame has left the state
+       as it found it, the next one synthesises the same signal and leaves the
+       state alone too. All that is left to run is the output high pass filter,
+       whose state can go round a small limit cycle on a repeated signal, rather
+       than settle. */
+    state = (uint8_t *) iLBCdec_inst;
+    repeat = (memcmp(bytes, iLBCdec_inst->repeat_frame, iLBCdec_inst->no_of_bytes) == 0);
+    if (repeat  &&  iLBCdec_inst->repeat_settled)
+    {
+        hpOutput(iLBCdec_inst->repeat_block, iLBCdec_inst->blockl, decblock, iLBCdec_inst->hpomem);
+        iLBCdec_inst->frames++;
+        ILBC_STATS_COUNT(iLBCdec_inst, frames);
+        if (iLBCdec_inst->use_enhancer != ILBC_ENHANCER_OFF)
+            ILBC_STATS_COUNT(iLBCdec_inst, enhanced_frames);
+        return 1;
+    }
+    if (repeat)
+    {
+        memcpy(plc, state + PLC_STATE_START, PLC_STATE_LEN);
+        memcpy(syntMem, iLBCdec_inst->syntMem, sizeof(syntMem));
+        memcpy(lpc, state + LPC_STATE_START, LPC_STATE_LEN);
+        memcpy(enh, state + ENH_STATE_START, ENH_STATE_LEN);
+    }
+
+    decoded = decode_frame_mode(iLBCdec_inst, decblock, bytes, mode, t);
+    if (!decoded)
+        return decoded;
+    if (!repeat)
+    {
+        memcpy(iLBCdec_inst->repeat_frame, bytes, iLBCdec_inst->no_of_bytes);
+        return decoded;
+    }
+    if (memcmp(plc, state + PLC_STATE_START, PLC_STATE_LEN) == 0
+        &&
+        memcmp(syntMem, iLBCdec_inst->syntMem, sizeof(syntMem)) == 0
+        &&
+        memcmp(lpc, state + LPC_STATE_START, LPC_STATE_LEN) == 0
+        &&
+        memcmp(enh, state + ENH_STATE_START, ENH_STATE_LEN) == 0)
+    {
+        /* Keep the signal from before the high pass filter */
+        iLBCdec_inst->repeat_settled = 1;
+        memcpy(iLBCdec_inst->repeat_block, t->data, iLBCdec_inst->blockl*sizeof(float));
+    }
+    return decoded;
+}
+
+int ilbc_decode_parse(ilbc_frame_params_t *params,  /* (o) the checked parameters */
+                      const uint8_t bytes[],        /* (i) one encoded frame */
+                      int len)                      /* (i) number of bytes */
+{
+    if (len == ILBC_NO_OF_BYTES_30MS)
+        return parse_frame(params, bytes, 30);
+    if (len == ILBC_NO_OF_BYTES_20MS)
+        return parse_frame(params, bytes, 20);
+    return -1;
+}
+
+int ilbc_decode_synth(ilbc_decode_state_t *s,          /* (i/o) the decoder state structure */
+                      int16_t amp[],                    /* (o) decoded signal block */
+                      const ilbc_frame_params_t *params)    /* (i) the frame, or NULL to conceal */
+{
+    decode_scratch_t scratch;
+
+    if (params  &&  params->mode != s->mode)
+        return -1;
+    if (s->mode == 30)
+        decode_frame(s, scratch.decblock, params, &scratch, 30);
+    else
+        decode_frame(s, scratch.decblock, params, &scratch, 20);
+    floatToPcm16(amp, scratch.decblock, s->blockl);
+    return s->blockl;
+}
+
+size_t ilbc_decode_scratch_size(void)
+{
+    return sizeof(decode_scratch_t);
+}
+
+int ilbc_decode_ex(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                   int16_t amp[],           /* (o) decoded signal block */
+                   const uint8_t bytes[],   /* (i) encoded signal bits */
+                   int len,                 /* (i) number of bytes */
+                   void *scratch)           /* (i/o) working space */
+{
+    decode_scratch_t *t;
+    int i;
+    int j;
+
+    ILBC_STACK_WATCH_START();
+    t = (decode_scratch_t *) scratch;
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        ilbc_decode_frame(s, t->decblock, bytes + j, 1, t);
+        floatToPcm16(amp + i, t->decblock, s->blockl);
+    }
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_DECODE_EX);
+    return i;
 }
 
 int ilbc_decode(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
@@ -526,27 +698,189 @@ int ilbc_decode(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure
                 const uint8_t bytes[],      /* (i) encoded signal bits */
                 int len)
 {
+    decode_scratch_t scratch;
     int i;
-    int j;
+
+    ILBC_STACK_WATCH_START();
+    i = ilbc_decode_ex(s, amp, bytes, len, &scratch);
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_DECODE);
+    return i;
+}
+
+/*----------------------------------------------------------------*
+ *  Decode one frame for a chunk of channels in ilbc_decode_batch().
+ *  The residual of each good frame is decoded channel by channel,
+ *  and then the synthesis and output high pass filters run in the
+ *  lanes of a filter bank. Lost frames, repeated frames and
+ *  channels using the enhancer go through ilbc_decode_frame()
+ *  instead, as they would for ilbc_decode().
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void decode_batch_chunk(ilbc_decode_state_t *s[],    /* (i/o) the chunk's decoder states */
+                                                  int16_t *amp[],              /* (o) the chunk's decoded signals */
+                                                  const uint8_t *bytes[],      /* (i) the chunk's encoded signal bits */
+                                                  int offset,                  /* (i) where the frame starts in amp */
+                                                  int byte_offset,             /* (i) where the frame starts in bytes */
+                                                  int n,                       /* (i) number of channels in the chunk */
+                                                  decode_batch_scratch_t *b,   /* (i/o) working space */
+                                                  decode_scratch_t *t,         /* (i/o) working space */
+                                                  int frame_mode)              /* (i) the frame size mode, as a constant */
+{
+    ilbc_frame_params_t fp;
+    ilbc_decode_state_t *st;
+    const uint8_t *frame;
+    int lane[DECODE_BATCH_CHUNK];
+    float *x;
+    int lanes;
+    int nsub;
+    int blockl;
+    int no_of_bytes;
+    int c;
     int k;
-    float decblock[ILBC_BLOCK_LEN_MAX];
-    float dtmp;
+    int i;
 
-    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
+    blockl = (frame_mode == 30)  ?  ILBC_BLOCK_LEN_30MS  :  ILBC_BLOCK_LEN_20MS;
+    no_of_bytes = (frame_mode == 30)  ?  ILBC_NO_OF_BYTES_30MS  :  ILBC_NO_OF_BYTES_20MS;
+
+    lanes = 0;
+    for (c = 0;  c < n;  c++)
+    {
+        st = s[c];
+        frame = (bytes[c])  ?  bytes[c] + byte_offset  :  NULL;
+        if (frame
+            &&
+            st->use_enhancer == ILBC_ENHANCER_OFF
+            &&
+            (!st->full_state  ||  memcmp(frame, st->repeat_frame, no_of_bytes) != 0)
+            &&
+            parse_frame(&fp, frame, frame_mode))
+        {
+            ILBC_PROFILE_START(st, ILBC_PROF_DECODE);
+            decode_residual(st, b->decresidual[lanes], b->syntdenum[lanes], &fp, t, frame_mode);
+            ILBC_PROFILE_STOP(st, ILBC_PROF_DECODE);
+            if (st->full_state)
+                memcpy(st->repeat_frame, frame, no_of_bytes);
+            lane[lanes++] = c;
+            continue;
+        }
+        ilbc_decode_frame(st, t->decblock, frame, (frame)  ?  1  :  0, t);
+        floatToPcm16(amp[c] + offset, t->decblock, blockl);
+    }
+    if (lanes == 0)
+        return;
+
+    x = b->x + ILBC_LPC_FILTERORDER*FILTER_BANK_LANES;
+    /* Any unused lanes filter silence */
+    if (lanes < FILTER_BANK_LANES)
+    {
+        memset(b->x, 0, sizeof(b->x));
+        memset(b->a, 0, sizeof(b->a));
+        memset(b->hpmem, 0, sizeof(b->hpmem));
+    }
+    for (k = 0;  k < lanes;  k++)
+    {
+        st = s[lane[k]];
+        filterBankPut(b->x, k, st->syntMem, ILBC_LPC_FILTERORDER);
+        filterBankPut(x, k, b->decresidual[k], blockl);
+        filterBankPut(b->hpmem, k, st->hpomem, 4);
+    }
+
+    /* Synthesis filtering */
+    for (i = 0;  i < nsub;  i++)
+    {
+        for (k = 0;  k < lanes;  k++)
+            filterBankPut(b->a, k, &b->syntdenum[k][i*(ILBC_LPC_FILTERORDER + 1)], ILBC_LPC_FILTERORDER + 1);
+        syntFilterBank(&x[i*SUBL*FILTER_BANK_LANES], b->a, SUBL);
+    }
+
+    for (k = 0;  k < lanes;  k++)
+        filterBankGet(s[lane[k]]->syntMem, &b->x[blockl*FILTER_BANK_LANES], k, ILBC_LPC_FILTERORDER);
+
+    /* High pass filtering on output */
+    hpFilterBank(x, blockl, x, b->hpmem, hpo_zero_coefsTbl, hpo_pole_coefsTbl);
+
+    for (k = 0;  k < lanes;  k++)
+    {
+        st = s[lane[k]];
+        filterBankGet(st->hpomem, b->hpmem, k, 4);
+        filterBankGet(t->decblock, x, k, blockl);
+        floatToPcm16(amp[lane[k]] + offset, t->decblock, blockl);
+
+        /* Find last lag, and keep what decode_frame() would for the next frame */
+        st->last_lag = find_last_lag(b->decresidual[k], blockl);
+        memcpy(st->old_syntdenum, b->syntdenum[k], nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+        st->prev_enh_pl = 0;
+        st->frames++;
+        ILBC_STATS_COUNT(st, frames);
+        st->repeat_settled = 0;
+    }
+}
+
+int ilbc_decode_batch(ilbc_decode_state_t *s[],    /* (i/o) the decoder states, one per channel */
+                      int16_t *amp[],               /* (o) decoded signals, one buffer per channel */
+                      const uint8_t *bytes[],       /* (i) encoded signal bits, one buffer per channel,
+                                                           or NULL for a channel whose frames were lost */
+                      int len,                      /* (i) number of bytes per channel */
+                      int channels)                 /* (i) number of channels */
+{
+    int i;
+    int j;
+    int c;
+    int c0;
+    int n;
+    int blockl;
+    int no_of_bytes;
+    decode_scratch_t t;
+    decode_batch_scratch_t b;
+
+    if (channels <= 0)
+        return 0;
+    /* Every channel in a batch must use the same frame size, so the channels
+       stay in step from one frame to the next */
+    blockl = s[0]->blockl;
+    no_of_bytes = s[0]->no_of_bytes;
+    for (c = 1;  c < channels;  c++)
     {
-        ilbc_decode_frame(s, decblock, bytes + j, 1);
-        /* Convert to int16_t */
-        for (k = 0;  k < s->blockl;  k++)
+        if (s[c]->mode != s[0]->mode)
+            return -1;
+    }
+
+    ILBC_STACK_WATCH_START();
+    for (i = 0, j = 0;  j < len;  i += blockl, j += no_of_bytes)
+    {
+        for (c0 = 0;  c0 < channels;  c0 += DECODE_BATCH_CHUNK)
         {
-            dtmp = decblock[k];
-    
-            if (dtmp < MIN_SAMPLE)
-                dtmp = MIN_SAMPLE;
-            else if (dtmp > MAX_SAMPLE)
-                dtmp = MAX_SAMPLE;
-            amp[i + k] = (int16_t) rint(dtmp);
+            n = channels - c0;
+            if (n > DECODE_BATCH_CHUNK)
+                n = DECODE_BATCH_CHUNK;
+            if (s[0]->mode == 30)
+                decode_batch_chunk(&s[c0], &amp[c0], &bytes[c0], i, j, n, &b, &t, 30);
+            else
+                decode_batch_chunk(&s[c0], &amp[c0], &bytes[c0], i, j, n, &b, &t, 20);
         }
     }
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_DECODE_BATCH);
+    return i;
+}
+
+int ilbc_fillin_ex(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                   int16_t amp[],           /* (o) decoded signal block */
+                   int len,                 /* (i) number of bytes the lost frames would have used */
+                   void *scratch)           /* (i/o) working space */
+{
+    decode_scratch_t *t;
+    int i;
+    int j;
+
+    ILBC_STACK_WATCH_START();
+    t = (decode_scratch_t *) scratch;
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        ilbc_decode_frame(s, t->decblock, NULL, 0, t);
+        floatToPcm16(amp + i, t->decblock, s->blockl);
+    }
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_FILLIN_EX);
     return i;
 }
 
@@ -554,39 +888,561 @@ int ilbc_fillin(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure
                 int16_t amp[],              /* (o) decoded signal block */
                 int len)
 {
+    decode_scratch_t scratch;
+    int i;
+
+    ILBC_STACK_WATCH_START();
+    i = ilbc_fillin_ex(s, amp, len, &scratch);
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_FILLIN);
+    return i;
+}
+
+int ilbc_decode_resampled(ilbc_decode_state_t *s, /* (i/o) the decoder state structure */
+                          int16_t amp[],          /* (o) decoded signal, at rate */
+                          const uint8_t bytes[],  /* (i) encoded signal bits, or NULL to conceal */
+                          int len,                /* (i) number of bytes, or that the lost frames
+                                                         would have used */
+                          int rate)               /* (i) sample rate, in samples per second */
+{
+    decode_scratch_t scratch;
+    int factor;
     int i;
     int j;
+
+    if ((factor = resampleFactor(rate)) < 0  ||  len%s->no_of_bytes != 0)
+        return -1;
+    /* A compact state has no room for the interpolator's history */
+    if (factor > 1  &&  !s->full_state)
+        return -1;
+    if (rate != s->resample_rate)
+    {
+        if (s->full_state)
+            memset(s->resample_hist, 0, sizeof(s->resample_hist));
+        s->resample_rate = rate;
+    }
+    for (i = 0, j = 0;  j < len;  i += factor*s->blockl, j += s->no_of_bytes)
+    {
+        if (bytes)
+            ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+        else
+            ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        if (factor == 1)
+            floatToPcm16(amp + i, scratch.decblock, s->blockl);
+        else
+            interpolatePcm(amp + i, scratch.decblock, s->blockl, factor, s->resample_hist);
+    }
+    return i;
+}
+
+int ilbc_decode_mix(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                    float bus[],             /* (i/o) the mix the decoded signal is added into */
+                    const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                    int len,                 /* (i) number of bytes, or that the lost frames
+                                                    would have used */
+                    float gain)              /* (i) gain applied to the decoded signal */
+{
+    decode_scratch_t scratch;
+    int i;
+    int j;
+
+    if (len%s->no_of_bytes != 0)
+        return -1;
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        if (bytes)
+            ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+        else
+            ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        floatMix(bus + i, scratch.decblock, gain, s->blockl);
+    }
+    return i;
+}
+
+/*----------------------------------------------------------------*
+ *  Gather the side information for a frame ilbc_decode_frame() has
+ *  just decoded. The filters are taken from the state, as the
+ *  short cut for a repeated frame leaves the scratch area alone.
+ *---------------------------------------------------------------*/
+
+static void decode_info(ilbc_decode_state_t *iLBCdec_inst,  /* (i) the decoder state structure */
+                        ilbc_decode_info_t *info,           /* (o) the side information */
+                        const float decblock[],             /* (i) the decoded signal block */
+                        int decoded)                        /* (i) 1 if the frame was decoded, 0 if concealed */
+{
+    const float *x;
+    float en;
+    int n;
     int k;
-    float decblock[ILBC_BLOCK_LEN_MAX];
-    float dtmp;
 
+    info->subframes = iLBCdec_inst->nsub;
+    info->concealed = !decoded;
+    info->lag = iLBCdec_inst->last_lag;
+    for (n = 0;  n < iLBCdec_inst->nsub;  n++)
+    {
+        memcpy(info->lpc[n], &iLBCdec_inst->old_syntdenum[n*(ILBC_LPC_FILTERORDER + 1)], sizeof(info->lpc[n]));
+        x = &decblock[n*SUBL];
+        en = 0.0f;
+        for (k = 0;  k < SUBL;  k++)
+            en += x[k]*x[k];
+        info->energy[n] = en;
+    }
+    if (iLBCdec_inst->use_enhancer != ILBC_ENHANCER_OFF)
+        memcpy(info->enh_period, iLBCdec_inst->enh_period, sizeof(info->enh_period));
+    else
+        memset(info->enh_period, 0, sizeof(info->enh_period));
+}
+
+int ilbc_decode_info(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                     int16_t amp[],              /* (o) decoded signal block */
+                     const uint8_t bytes[],      /* (i) encoded signal bits, or NULL to conceal */
+                     int len,                    /* (i) number of bytes, or that the lost frames
+                                                        would have used */
+                     ilbc_decode_info_t info[])  /* (o) side information, one per frame */
+{
+    decode_scratch_t scratch;
+    int decoded;
+    int i;
+    int j;
+
+    if (len%s->no_of_bytes != 0)
+        return -1;
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        if (bytes)
+            decoded = ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+        else
+            decoded = ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        decode_info(s, &info[j/s->no_of_bytes], scratch.decblock, decoded);
+        floatToPcm16(amp + i, scratch.decblock, s->blockl);
+    }
+    return i;
+}
+
+int ilbc_decode_strided(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                        int16_t amp[],           /* (o) where the channel's first sample goes */
+                        int stride,              /* (i) distance between the channel's samples, in samples */
+                        const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                        int len)                 /* (i) number of bytes, or that the lost frames
+                                                        would have used */
+{
+    decode_scratch_t scratch;
+    int i;
+    int j;
+
+    if (len%s->no_of_bytes != 0)
+        return -1;
     for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
     {
-        ilbc_decode_frame(s, decblock, NULL, 0);
-        /* Convert to int16_t */
-        for (k = 0;  k < s->blockl;  k++)
+        if (bytes)
+            ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+        else
+            ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        floatToPcm16Strided(amp + i*stride, stride, scratch.decblock, s->blockl);
+    }
+    return i;
+}
+
+/*----------------------------------------------------------------*
+ *  Decode a burst of frames, some of which may be lost. The frames
+ *  are decoded a number at a time into one float block, which is
+ *  then converted to PCM in one pass. A lost frame is one with a
+ *  NULL pointer in frames[], or, when frames is NULL, one whose bit
+ *  is set in loss_mask, with the rest taken in turn from bytes.
+ *---------------------------------------------------------------*/
+
+static int decode_burst(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                        int16_t amp[],              /* (o) decoded signal */
+                        const uint8_t *const frames[],  /* (i) the frames, or NULL to use bytes */
+                        const uint8_t bytes[],      /* (i) the frames received, one after another */
+                        uint32_t loss_mask,         /* (i) bit n set if frame n was lost */
+                        int n,                      /* (i) number of frames */
+                        uint32_t *lost)             /* (o) frames which were concealed, or NULL */
+{
+    decode_scratch_t scratch;
+    float out[DECODE_BURST_FRAMES*ILBC_BLOCK_LEN_MAX];
+    const uint8_t *frame;
+    uint32_t mask;
+    int chunk;
+    int i;
+    int j;
+
+    mask = 0;
+    for (i = 0;  i < n;  i += chunk)
+    {
+        chunk = (n - i < DECODE_BURST_FRAMES)  ?  (n - i)  :  DECODE_BURST_FRAMES;
+        for (j = 0;  j < chunk;  j++)
         {
-            dtmp = decblock[k];
-    
-            if (dtmp < MIN_SAMPLE)
-                dtmp = MIN_SAMPLE;
-            else if (dtmp > MAX_SAMPLE)
-                dtmp = MAX_SAMPLE;
-            amp[i + k] = (int16_t) rint(dtmp);
+            if (frames)
+            {
+                frame = frames[i + j];
+            }
+            else if (i + j < 32  &&  (loss_mask & ((uint32_t) 1 << (i + j))))
+            {
+                frame = NULL;
+            }
+            else
+            {
+                frame = bytes;
+                bytes += s->no_of_bytes;
+            }
+            if (!ilbc_decode_frame(s, out + j*s->blockl, frame, (frame)  ?  1  :  0, &scratch)  &&  i + j < 32)
+                mask |= (uint32_t) 1 << (i + j);
         }
+        floatToPcm16(amp + i*s->blockl, out, chunk*s->blockl);
     }
+    if (lost)
+        *lost = mask;
+    return n*s->blockl;
+}
+
+int ilbc_decode_frames(ilbc_decode_state_t *s,      /* (i/o) the decoder state structure */
+                       int16_t amp[],               /* (o) decoded signal */
+                       const uint8_t *const frames[],   /* (i) the frames, with NULL for each lost one */
+                       int n,                       /* (i) number of frames */
+                       uint32_t *lost)              /* (o) frames which were concealed, or NULL */
+{
+    return decode_burst(s, amp, frames, NULL, 0, n, lost);
+}
+
+int ilbc_decode_frames_masked(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                              int16_t amp[],            /* (o) decoded signal */
+                              const uint8_t bytes[],    /* (i) the frames received, one after another */
+                              int n,                    /* (i) number of frames, received and lost */
+                              uint32_t loss_mask,       /* (i) bit n set if frame n was lost */
+                              uint32_t *lost)           /* (o) frames which were concealed, or NULL */
+{
+    return decode_burst(s, amp, NULL, bytes, loss_mask, n, lost);
+}
+
+int ilbc_decode_float(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      float amp[],              /* (o) decoded signal block */
+                      const uint8_t bytes[],    /* (i) encoded signal bits */
+                      int len)                  /* (i) number of bytes */
+{
+    decode_scratch_t scratch;
+    int i;
+    int j;
+
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+        ilbc_decode_frame(s, amp + i, bytes + j, 1, &scratch);
     return i;
 }
 
-ilbc_decode_state_t *ilbc_decode_init(ilbc_decode_state_t *iLBCdec_inst,   /* (i/o) Decoder instance */
-                                      int mode,                            /* (i) frame size mode */
-                                      int use_enhancer)                    /* (i) 1 to use enhancer
-                                                                                  0 to run without enhancer */
+int ilbc_fillin_float(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      float amp[],              /* (o) decoded signal block */
+                      int len)                  /* (i) number of bytes the lost frames would have used */
 {
+    decode_scratch_t scratch;
     int i;
+    int j;
 
-    iLBCdec_inst->mode = mode;
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+        ilbc_decode_frame(s, amp + i, NULL, 0, &scratch);
+    return i;
+}
+
+int ilbc_decode_stream(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                       int16_t amp[],           /* (o) decoded signal */
+                       int samples,             /* (i) number of samples wanted, which may be any number */
+                       const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                       int len,                 /* (i) number of bytes */
+                       int *used)               /* (o) number of bytes used, or NULL */
+{
+    decode_scratch_t scratch;
+    int i;
+    int j;
+    int n;
+
+    if (!s->full_state)
+        return -1;
+    /* First, whatever is left of the last frame */
+    n = s->stream_len - s->stream_pos;
+    if (n > samples)
+        n = samples;
+    memcpy(amp, s->stream_buf + s->stream_pos, n*sizeof(int16_t));
+    s->stream_pos += n;
+    for (i = n, j = 0;  i < samples;  )
+    {
+        if (bytes)
+        {
+            if (j + s->no_of_bytes > len)
+                break;
+            ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+            j += s->no_of_bytes;
+        }
+        else
+        {
+            ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        }
+        if (samples - i >= s->blockl)
+        {
+            /* The whole frame goes straight to the caller */
+            floatToPcm16(amp + i, scratch.decblock, s->blockl);
+            i += s->blockl;
+        }
+        else
+        {
+            /* Only part of the frame is wanted, so keep the rest */
+            floatToPcm16(s->stream_buf, scratch.decblock, s->blockl);
+            n = samples - i;
+            memcpy(amp + i, s->stream_buf, n*sizeof(int16_t));
+            s->stream_pos = n;
+            s->stream_len = s->blockl;
+            i += n;
+        }
+    }
+    if (used)
+        *used = j;
+    return i;
+}
+
+int ilbc_decode_stream_pending(ilbc_decode_state_t *s)     /* (i) the decoder state structure */
+{
+    return s->stream_len - s->stream_pos;
+}
+
+/*----------------------------------------------------------------*
+ *  Decode, or conceal when bytes is NULL, straight to G.711
+ *---------------------------------------------------------------*/
+
+static int decode_g711(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                       uint8_t out[],              /* (o) G.711 codes */
+                       const uint8_t bytes[],      /* (i) encoded signal bits, or NULL */
+                       int len,                    /* (i) number of bytes */
+                       void (*compand)(uint8_t g711[], const int16_t amp[], int len))
+{
+    decode_scratch_t scratch;
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    int i;
+    int j;
+
+    for (i = 0, j = 0;  j < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        if (bytes)
+            ilbc_decode_frame(s, scratch.decblock, bytes + j, 1, &scratch);
+        else
+            ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        /* One block of samples, still in L1 cache, between the two steps */
+        floatToPcm16(amp, scratch.decblock, s->blockl);
+        compand(out + i, amp, s->blockl);
+    }
+    return i;
+}
+
+int ilbc_decode_alaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t alaw[],            /* (o) decoded signal block, as A-law */
+                     const uint8_t bytes[],     /* (i) encoded signal bits */
+                     int len)                   /* (i) number of bytes */
+{
+    return decode_g711(s, alaw, bytes, len, pcm16ToAlaw);
+}
+
+int ilbc_decode_ulaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t ulaw[],            /* (o) decoded signal block, as u-law */
+                     const uint8_t bytes[],     /* (i) encoded signal bits */
+                     int len)                   /* (i) number of bytes */
+{
+    return decode_g711(s, ulaw, bytes, len, pcm16ToUlaw);
+}
+
+int ilbc_fillin_alaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t alaw[],            /* (o) decoded signal block, as A-law */
+                     int len)                   /* (i) number of bytes the lost frames would have used */
+{
+    return decode_g711(s, alaw, NULL, len, pcm16ToAlaw);
+}
+
+int ilbc_fillin_ulaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t ulaw[],            /* (o) decoded signal block, as u-law */
+                     int len)                   /* (i) number of bytes the lost frames would have used */
+{
+    return decode_g711(s, ulaw, NULL, len, pcm16ToUlaw);
+}
+
+int ilbc_payload_mode(int len,  /* (i) payload length, in bytes */
+                      int mode)  /* (i) the mode to choose if the length suits both */
+{
+    if (len > 0  &&  len%ILBC_NO_OF_BYTES_20MS == 0)
+    {
+        if (len%ILBC_NO_OF_BYTES_30MS == 0  &&  mode == 30)
+            return 30;
+        return 20;
+    }
+    if (len > 0  &&  len%ILBC_NO_OF_BYTES_30MS == 0)
+        return 30;
+    return -1;
+}
+
+int ilbc_decode_payload(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                        int16_t amp[],              /* (o) decoded signal */
+                        int max_samples,            /* (i) room in amp, in samples */
+                        const uint8_t payload[],    /* (i) the payload, or NULL for a lost packet */
+                        int len,                    /* (i) payload length, in bytes */
+                        uint32_t *lost)             /* (o) frames which were concealed, or NULL */
+{
+    decode_scratch_t scratch;
+    uint32_t mask;
+    int mode;
+    int frames;
+    int decoded;
+    int i;
+
+    if ((mode = ilbc_payload_mode(len, s->mode)) < 0)
+        return -1;
+    if (mode != s->mode)
+        ilbc_decode_set_mode(s, mode);
+    frames = len/s->no_of_bytes;
+    if (frames*s->blockl > max_samples)
+        return -1;
+    mask = 0;
+    for (i = 0;  i < frames;  i++)
+    {
+        if (payload)
+            decoded = ilbc_decode_frame(s, scratch.decblock, payload + i*s->no_of_bytes, 1, &scratch);
+        else
+            decoded = ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+        if (!decoded  &&  i < 32)
+            mask |= (uint32_t) 1 << i;
+        floatToPcm16(amp + i*s->blockl, scratch.decblock, s->blockl);
+    }
+    if (lost)
+        *lost = mask;
+    return frames*s->blockl;
+}
+
+int ilbc_frame_info(const uint8_t bytes[],          /* (i) one encoded frame */
+                    int len,                        /* (i) number of bytes */
+                    ilbc_frame_info_t *info)        /* (o) what was found */
+{
+    frame_params_t params;
+    int nsub;
+
+    if (len == ILBC_NO_OF_BYTES_30MS)
+    {
+        info->mode = 30;
+        nsub = NSUB_30MS;
+    }
+    else if (len == ILBC_NO_OF_BYTES_20MS)
+    {
+        info->mode = 20;
+        nsub = NSUB_20MS;
+    }
+    else
+    {
+        return -1;
+    }
+    unpack_frame_info(&params, bytes, info->mode);
+    /* The same checks as decode_frame() makes */
+    info->valid = (params.start >= 1  &&  params.start <= nsub - 1  &&  params.last_bit == 0);
+    info->start = params.start;
+    info->idx_for_max = params.idxForMax;
+    info->excitation_peak = powf(10.0f, state_frgqTbl[params.idxForMax])/4.5f;
+    return 0;
+}
+
+int ilbc_decode_tsm(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                    int16_t amp[],              /* (o) decoded signal, with room for two frames */
+                    const uint8_t bytes[],      /* (i) one frame of encoded signal bits, or NULL to conceal */
+                    int len,                    /* (i) number of bytes */
+                    int action)                 /* (i) ILBC_TSM_NORMAL, ILBC_TSM_ACCELERATE or ILBC_TSM_EXPAND */
+{
+    decode_scratch_t scratch;
+    float scaled[2*ILBC_BLOCK_LEN_MAX];
+    int n;
+
+    if (bytes  &&  len != s->no_of_bytes)
+        return -1;
+    if (bytes)
+        ilbc_decode_frame(s, scratch.decblock, bytes, 1, &scratch);
+    else
+        ilbc_decode_frame(s, scratch.decblock, NULL, 0, &scratch);
+    n = timeScale(scaled, scratch.decblock, s->blockl, s->last_lag, action);
+    floatToPcm16(amp, scaled, n);
+    return n;
+}
+
+int ilbc_decode_cng(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                    int16_t amp[],              /* (o) a frame of comfort noise */
+                    const uint8_t sid[],        /* (i) a SID, or NULL to carry on with the last one */
+                    int len)                    /* (i) length of the SID, in bytes */
+{
+    float noise[ILBC_BLOCK_LEN_MAX];
+
+    if (!s->full_state)
+        return -1;
+    if (sid  &&  cngUpdate(s, sid, len) < 0)
+        return -1;
+    /* The noise moves the seed the concealment shares */
+    s->repeat_settled = 0;
+    ILBC_STATS_COUNT(s, frames);
+    ILBC_STATS_COUNT(s, dtx_frames);
+    cngGenerate(noise, s);
+    floatToPcm16(amp, noise, s->blockl);
+    return s->blockl;
+}
+
+void ilbc_decode_checkpoint(const ilbc_decode_state_t *s,   /* (i) the decoder state structure */
+                            ilbc_decode_checkpoint_t *cp)   /* (o) the checkpoint */
+{
+    cp->mode = s->mode;
+    cp->frames = s->frames;
+    cp->last_lag = s->last_lag;
+    cp->prevLag = s->prevLag;
+    cp->consPLICount = s->consPLICount;
+    cp->prevPLI = s->prevPLI;
+    cp->prev_enh_pl = s->prev_enh_pl;
+    cp->per = s->per;
+    cp->seed = s->seed;
+    memcpy(cp->syntMem, s->syntMem, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(cp->hpomem, s->hpomem, 4*sizeof(float));
+    memcpy(cp->lsfdeqold, s->lsfdeqold, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(cp->prevLpc, s->prevLpc, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    memcpy(cp->old_syntdenum, s->old_syntdenum, s->nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    memcpy(cp->prevResidual, s->prevResidual, s->blockl*sizeof(float));
+    if (s->use_enhancer)
+    {
+        /* The next frame shifts the buffer down by a block, and the concealment
+           smoothing may change up to ENH_BLOCKL samples before the new block */
+        memcpy(cp->enh_head, s->enh_buf, s->blockl*sizeof(float));
+        memcpy(cp->enh_tail, s->enh_buf + ENH_BUFL - ENH_BLOCKL, ENH_BLOCKL*sizeof(float));
+        memcpy(cp->enh_period, s->enh_period, ENH_NBLOCKS_TOT*sizeof(float));
+    }
+}
 
+int ilbc_decode_rewind(ilbc_decode_state_t *s,              /* (i/o) the decoder state structure */
+                       const ilbc_decode_checkpoint_t *cp)  /* (i) the checkpoint */
+{
+    if (cp->mode != s->mode  ||  cp->frames + 1 != s->frames)
+        return -1;
+    s->frames = cp->frames;
+    s->repeat_settled = 0;
+    s->last_lag = cp->last_lag;
+    s->prevLag = cp->prevLag;
+    s->consPLICount = cp->consPLICount;
+    s->prevPLI = cp->prevPLI;
+    s->prev_enh_pl = cp->prev_enh_pl;
+    s->per = cp->per;
+    s->seed = cp->seed;
+    memcpy(s->syntMem, cp->syntMem, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(s->hpomem, cp->hpomem, 4*sizeof(float));
+    memcpy(s->lsfdeqold, cp->lsfdeqold, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(s->prevLpc, cp->prevLpc, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    memcpy(s->old_syntdenum, cp->old_syntdenum, s->nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    memcpy(s->prevResidual, cp->prevResidual, s->blockl*sizeof(float));
+    if (s->use_enhancer)
+    {
+        memmove(s->enh_buf + s->blockl, s->enh_buf, (ENH_BUFL - s->blockl)*sizeof(float));
+        memcpy(s->enh_buf, cp->enh_head, s->blockl*sizeof(float));
+        memcpy(s->enh_buf + ENH_BUFL - ENH_BLOCKL, cp->enh_tail, ENH_BLOCKL*sizeof(float));
+        memcpy(s->enh_period, cp->enh_period, ENH_NBLOCKS_TOT*sizeof(float));
+    }
+    return 0;
+}
+
+/* Set the parameters which follow from the frame size mode */
+static int set_mode_params(ilbc_decode_state_t *iLBCdec_inst,  /* (i/o) Decoder instance */
+                           int mode)                           /* (i) frame size mode */
+{
     if (mode == 30)
     {
         iLBCdec_inst->blockl = ILBC_BLOCK_LEN_30MS;
@@ -611,8 +1467,25 @@ ilbc_decode_state_t *ilbc_decode_init(ilbc_decode_state_t *iLBCdec_inst,   /* (i
     }
     else
     {
-        return NULL;
+        return -1;
     }
+    iLBCdec_inst->mode = mode;
+    return 0;
+}
+
+static ilbc_decode_state_t *decode_init(ilbc_decode_state_t *iLBCdec_inst,    /* (i/o) Decoder instance */
+                                        int mode,                             /* (i) frame size mode */
+                                        int use_enhancer,                     /* (i) ILBC_ENHANCER_xxx */
+                                        int full_state)                       /* (i) 0 for a compact state */
+{
+    int i;
+
+    if (use_enhancer < ILBC_ENHANCER_OFF  ||  use_enhancer > ILBC_ENHANCER_MINIMAL)
+        return NULL;
+    if (!full_state  &&  use_enhancer != ILBC_ENHANCER_OFF)
+        return NULL;
+    if (set_mode_params(iLBCdec_inst, mode))
+        return NULL;
 
     memset(iLBCdec_inst->syntMem, 0, ILBC_LPC_FILTERORDER*sizeof(float));
     memcpy((*iLBCdec_inst).lsfdeqold, lsfmeanTbl, ILBC_LPC_FILTERORDER*sizeof(float));
@@ -636,11 +1509,223 @@ ilbc_decode_state_t *ilbc_decode_init(ilbc_decode_state_t *iLBCdec_inst,   /* (i
     memset(iLBCdec_inst->hpomem, 0, 4*sizeof(float));
 
     iLBCdec_inst->use_enhancer = use_enhancer;
-    memset(iLBCdec_inst->enh_buf, 0, ENH_BUFL*sizeof(float));
-    for (i = 0;  i < ENH_NBLOCKS_TOT;  i++)
-        iLBCdec_inst->enh_period[i] = 40.0f;
-
     iLBCdec_inst->prev_enh_pl = 0;
 
+    iLBCdec_inst->stream_pos = 0;
+    iLBCdec_inst->stream_len = 0;
+    iLBCdec_inst->resample_rate = 8000;
+    iLBCdec_inst->frames = 0;
+    iLBCdec_inst->repeat_settled = 0;
+    lsfMemoInit(&iLBCdec_inst->lsfdeq_memo);
+    memset(&iLBCdec_inst->stats, 0, sizeof(iLBCdec_inst->stats));
+
+    /* A compact state stops here */
+    iLBCdec_inst->full_state = full_state;
+    if (full_state)
+    {
+        memset(iLBCdec_inst->resample_hist, 0, sizeof(iLBCdec_inst->resample_hist));
+        memset(iLBCdec_inst->cng_a, 0, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+        iLBCdec_inst->cng_a[0] = 1.0f;
+        memset(iLBCdec_inst->cng_mem, 0, ILBC_LPC_FILTERORDER*sizeof(float));
+        iLBCdec_inst->cng_gain = 0.0f;
+        iLBCdec_inst->cng_target = 0.0f;
+        memset(iLBCdec_inst->repeat_frame, 0, sizeof(iLBCdec_inst->repeat_frame));
+        memset(iLBCdec_inst->enh_buf, 0, ENH_BUFL*sizeof(float));
+        for (i = 0;  i < ENH_NBLOCKS_TOT;  i++)
+            iLBCdec_inst->enh_period[i] = 40.0f;
+    }
+
     return iLBCdec_inst;
 }
+
+ilbc_decode_state_t *ilbc_decode_init(ilbc_decode_state_t *iLBCdec_inst,   /* (i/o) Decoder instance */
+                                      int mode,                            /* (i) frame size mode */
+                                      int use_enhancer)                    /* (i) ILBC_ENHANCER_xxx */
+{
+    return decode_init(iLBCdec_inst, mode, use_enhancer, 1);
+}
+
+/* The enhancer holds back 40 samples in 20ms mode, and 80 in 30ms mode.
+   Changing mode with it running would repeat or drop the difference, so the
+   residual it holds is stretched or shrunk by ENH_SWITCH samples, to hold
+   back just what the new mode will. Each new stretch of samples is a
+   crossfade between two copies of what it replaces, aligned so the join
+   at each end is smooth. */
+#define ENH_SWITCH      (ENH_BLOCKL - ENH_BLOCKL_HALF)
+
+static void enhancer_switch(ilbc_decode_state_t *s, int mode)
+{
+    float bridge[ENH_SWITCH];
+    float *held;
+    float w;
+    int lag;
+    int i;
+
+    lag = s->last_lag;
+    if (lag < ENH_SWITCH)
+        lag = ENH_SWITCH;
+    if (mode == 30)
+    {
+        /* 40 samples held back, and 80 needed. Insert a bridge before the
+           held samples, which starts as a pitch period's continuation of
+           what went before, and ends as the 40 samples before the held
+           ones, which lead into them. */
+        held = s->enh_buf + ENH_BUFL - ENH_SWITCH;
+        for (i = 0;  i < ENH_SWITCH;  i++)
+        {
+            w = (float) (i + 1)/(float) (ENH_SWITCH + 1);
+            bridge[i] = (1.0f - w)*held[i - lag] + w*held[i - ENH_SWITCH];
+        }
+        memmove(s->enh_buf, s->enh_buf + ENH_SWITCH, (ENH_BUFL - 2*ENH_SWITCH)*sizeof(float));
+        memcpy(held - ENH_SWITCH, bridge, ENH_SWITCH*sizeof(float));
+    }
+    else
+    {
+        /* 80 samples held back, and 40 needed. Merge them into 40 which
+           start like the first of them, and end like the last. */
+        held = s->enh_buf + ENH_BUFL - 2*ENH_SWITCH;
+        for (i = 0;  i < ENH_SWITCH;  i++)
+        {
+            w = (float) (i + 1)/(float) (ENH_SWITCH + 1);
+            bridge[i] = (1.0f - w)*held[i] + w*held[i + ENH_SWITCH];
+        }
+        memmove(s->enh_buf + ENH_SWITCH, s->enh_buf, (ENH_BUFL - 2*ENH_SWITCH)*sizeof(float));
+        memcpy(s->enh_buf + ENH_BUFL - ENH_SWITCH, bridge, ENH_SWITCH*sizeof(float));
+    }
+}
+
+int ilbc_decode_set_mode(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                         int mode)                  /* (i) the new frame size mode */
+{
+    float *a;
+    int old_blockl;
+    int old_nsub;
+    int lag;
+    int i;
+
+    if (mode != 20  &&  mode != 30)
+        return -1;
+    if (mode == s->mode)
+        return 0;
+    old_blockl = s->blockl;
+    old_nsub = s->nsub;
+    set_mode_params(s, mode);
+
+    /* The synthesis and high pass filters, and the LSFs at the end of the
+       last frame, mean the same in both modes. What is kept of the last
+       frame's residual and filters is indexed by its sub-frames, so move
+       the end of each to where the new mode looks for it. */
+    a = s->old_syntdenum;
+    if (s->nsub > old_nsub)
+    {
+        memmove(a + (s->nsub - old_nsub)*(ILBC_LPC_FILTERORDER + 1), a, old_nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+        for (i = 0;  i < s->nsub - old_nsub;  i++)
+            memcpy(a + i*(ILBC_LPC_FILTERORDER + 1), a + (s->nsub - old_nsub)*(ILBC_LPC_FILTERORDER + 1), (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    }
+    else
+    {
+        memmove(a, a + (old_nsub - s->nsub)*(ILBC_LPC_FILTERORDER + 1), s->nsub*(ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    }
+    if (s->blockl < old_blockl)
+    {
+        memmove(s->prevResidual, s->prevResidual + old_blockl - s->blockl, s->blockl*sizeof(float));
+    }
+    else
+    {
+        /* The concealment wants a longer history than there is. Extend it
+           backwards by whole pitch periods. */
+        memmove(s->prevResidual + s->blockl - old_blockl, s->prevResidual, old_blockl*sizeof(float));
+        lag = s->last_lag;
+        if (lag < 20)
+            lag = 20;
+        else if (lag > old_blockl)
+            lag = old_blockl;
+        for (i = s->blockl - old_blockl - 1;  i >= 0;  i--)
+            s->prevResidual[i] = s->prevResidual[i + lag];
+    }
+    if (s->use_enhancer != ILBC_ENHANCER_OFF)
+        enhancer_switch(s, mode);
+    /* The repeated frame is only good for the mode it was decoded in */
+    s->repeat_settled = 0;
+    return 0;
+}
+
+ilbc_decode_state_t *ilbc_decode_reset(ilbc_decode_state_t *s)     /* (i/o) Decoder instance */
+{
+    ilbc_stats_t stats;
+
+    stats = s->stats;
+    decode_init(s, s->mode, s->use_enhancer, s->full_state);
+    s->stats = stats;
+    return s;
+}
+
+size_t ilbc_decode_state_size(void)
+{
+    return sizeof(ilbc_decode_state_t) + ILBC_STATE_ALIGNMENT - 1;
+}
+
+ilbc_decode_state_t *ilbc_decode_init_at(void *mem,         /* (i/o) at least ilbc_decode_state_size() bytes */
+                                         int mode,          /* (i) frame size mode */
+                                         int use_enhancer)  /* (i) ILBC_ENHANCER_xxx */
+{
+    ilbc_decode_state_t *s;
+
+    s = (ilbc_decode_state_t *) (((uintptr_t) mem + ILBC_STATE_ALIGNMENT - 1) & ~((uintptr_t) ILBC_STATE_ALIGNMENT - 1));
+    s->alloc_base = NULL;
+    return ilbc_decode_init(s, mode, use_enhancer);
+}
+
+ilbc_decode_state_t *ilbc_decode_alloc(int mode,            /* (i) frame size mode */
+                                       int use_enhancer)    /* (i) ILBC_ENHANCER_xxx */
+{
+    ilbc_decode_state_t *s;
+    void *mem;
+
+    if ((mem = malloc(ilbc_decode_state_size())) == NULL)
+        return NULL;
+    if ((s = ilbc_decode_init_at(mem, mode, use_enhancer)) == NULL)
+    {
+        free(mem);
+        return NULL;
+    }
+    s->alloc_base = mem;
+    return s;
+}
+
+size_t ilbc_decode_compact_size(void)
+{
+    return offsetof(ilbc_decode_state_t, stream_buf) + ILBC_STATE_ALIGNMENT - 1;
+}
+
+ilbc_decode_state_t *ilbc_decode_init_compact_at(void *mem, /* (i/o) at least ilbc_decode_compact_size() bytes */
+                                                 int mode)  /* (i) frame size mode */
+{
+    ilbc_decode_state_t *s;
+
+    s = (ilbc_decode_state_t *) (((uintptr_t) mem + ILBC_STATE_ALIGNMENT - 1) & ~((uintptr_t) ILBC_STATE_ALIGNMENT - 1));
+    s->alloc_base = NULL;
+    return decode_init(s, mode, ILBC_ENHANCER_OFF, 0);
+}
+
+ilbc_decode_state_t *ilbc_decode_alloc_compact(int mode)    /* (i) frame size mode */
+{
+    ilbc_decode_state_t *s;
+    void *mem;
+
+    if ((mem = malloc(ilbc_decode_compact_size())) == NULL)
+        return NULL;
+    if ((s = ilbc_decode_init_compact_at(mem, mode)) == NULL)
+    {
+        free(mem);
+        return NULL;
+    }
+    s->alloc_base = mem;
+    return s;
+}
+
+void ilbc_decode_free(ilbc_decode_state_t *s)
+{
+    if (s)
+        free(s->alloc_base);
+}
@@ -24,6 +24,16 @@
 
 #include <string.h>
 
+/* For the bodies of functions which are built once for each frame size
+   mode, so the mode's sizes become constants */
+#if defined(__GNUC__)
+#define ILBC_ALWAYS_INLINE      __inline__ __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define ILBC_ALWAYS_INLINE      __forceinline
+#else
+#define ILBC_ALWAYS_INLINE
+#endif
+
 #define FS                      8000.0f
 #define NSUB_20MS               4
 #define NSUB_30MS               6
@@ -51,7 +61,22 @@
 #define LPC_WN                  1.0001f
 #define LSF_NSPLIT              3
 #define LSF_NUMBER_OF_STEPS     4
+#define LSF_GRID_POINTS         80
 #define LPC_HALFORDER           (ILBC_LPC_FILTERORDER/2)
+#define LSF_VQ_BLOCK            4   /* codewords the LSF search compares at once */
+
+/* multi-channel filter bank */
+
+#define FILTER_BANK_LANES       8   /* channels filtered side by side */
+
+/* frames ilbc_decode_frames() decodes before converting them to PCM */
+
+#define DECODE_BURST_FRAMES     8
+
+/* resampling front end, for ilbc_encode_resampled() and ilbc_decode_resampled() */
+
+#define RESAMPLE_TAPS           24  /* filter taps for each 8kHz sample */
+#define RESAMPLE_FACTOR_MAX     6   /* 48kHz */
 
 /* cb settings */
 
@@ -82,12 +107,40 @@
 #define ENH_BUFL                (ENH_NBLOCKS_TOT*ENH_BLOCKL)
 #define ENH_ALPHA0              0.05f
 
+/* The lighter enhancer tiers use fewer neighbouring pitch cycles, search
+   for them at half the resolution, and follow the pitch from one block to
+   the next with a narrow search while it is steady */
+#define ENH_HL_LITE             2   /* blocks either side of the current one for ILBC_ENHANCER_LITE */
+#define ENH_HL_MINIMAL          1   /* and for ILBC_ENHANCER_MINIMAL */
+#define ENH_UPS_STEP_LITE       2   /* use every second phase of the upsampling filter, for 2x */
+#define ENH_TRACK_SLOP          4   /* downsampled lags either side of the last block's pitch */
+#define ENH_TRACK_MIN_CORR      0.8f    /* normalised correlation needed to keep following the pitch */
+
 /* Down sampling */
 
 #define FILTERORDER_DS          7
 #define DELAY_DS                3
 #define FACTOR_DS               2
 
+/* time scale modification */
+
+#define TSM_MIN_LAG             20
+#define TSM_SLOP                3
+#define TSM_MIN_CORR            0.6f
+#define TSM_QUIET_ENERGY        100.0f  /* mean square, below which a period is silence */
+
+/* voice activity detection, discontinuous transmission and comfort noise.
+   Energies are mean squares, where full scale (0 dBov) is 32768^2. */
+
+#define VAD_SILENCE_ENERGY      1073.7f     /* -60 dBov, below which a frame is always silence */
+#define VAD_SPEECH_RATIO        4.0f        /* 6 dB above the noise floor is speech */
+#define VAD_NOISE_RISE          1.12f       /* fastest rise of the noise floor, 0.5 dB per frame */
+#define VAD_HANGOVER            960         /* samples sent as speech after the level drops */
+#define DTX_SID_INTERVAL        3200        /* samples between SIDs for steady noise */
+#define DTX_SID_CHANGE          2.0f        /* energy ratio, 3 dB, which sends a new SID at once */
+#define DTX_SID_FLOOR           1.0737418f  /* -90 dBov, below which levels are not told apart */
+#define CNG_FULL_SCALE          1.0737418e9f    /* 32768^2 */
+
 /* bit stream defs */
 
 #define STATE_BITS              3
@@ -25,156 +25,339 @@
 
 #include <inttypes.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ilbc2.h"
+#include "iLBC_define.h"
 #include "LPCencode.h"
+#include "lsf.h"
 #include "FrameClassify.h"
 #include "StateSearchW.h"
 #include "StateConstructW.h"
 #include "helpfun.h"
 #include "constants.h"
 #include "packing.h"
+#include "createCB.h"
 #include "iCBSearch.h"
 #include "iCBConstruct.h"
 #include "hpInput.h"
+#include "resample.h"
 #include "anaFilter.h"
+#include "filterBank.h"
 #include "syntFilter.h"
+#include "g711.h"
+#include "dtx.h"
+#include "ilbc_profile.h"
 
 /*----------------------------------------------------------------*
  *  Initiation of encoder instance.
  *---------------------------------------------------------------*/
 
 /*----------------------------------------------------------------*
- *  main encoder function
+ *  Per frame working data, handed from one encoding stage to the
+ *  next.
  *---------------------------------------------------------------*/
 
-static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the general encoder state */
-                             uint8_t bytes[],                       /* (o) encoded data bits iLBC */
-                             const float block[])                   /* (o) speech vector to encode */
+typedef struct
 {
-    float data[ILBC_BLOCK_LEN_MAX];
     float residual[ILBC_BLOCK_LEN_MAX];
+    float decresidual[ILBC_BLOCK_LEN_MAX];
+    float syntdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
+    float weightdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
+    int start_pos;
+    /* The parameters which go into the frame */
+    frame_params_t params;
+} encode_frame_work_t;
+
+/*----------------------------------------------------------------*
+ *  Working space for the encoding stages. Nothing in here lives
+ *  beyond the stage using it.
+ *---------------------------------------------------------------*/
+
+typedef struct
+{
+    float data[ILBC_BLOCK_LEN_MAX];
     float reverseResidual[ILBC_BLOCK_LEN_MAX];
-    int start;
-    int idxForMax;
-    int idxVec[STATE_LEN];
     float reverseDecresidual[ILBC_BLOCK_LEN_MAX];
     float mem[CB_MEML];
-    int n;
-    int k;
-    int meml_gotten;
-    int Nfor;
-    int Nback;
-    int i;
-    int pos;
-    int gain_index[CB_NSTAGES*NASUB_MAX],
-    extra_gain_index[CB_NSTAGES];
-    int cb_index[CB_NSTAGES*NASUB_MAX];
-    int extra_cb_index[CB_NSTAGES];
-    int lsf_i[LSF_NSPLIT*LPC_N_MAX];
-    uint8_t *pbytes;
-    int diff;
-    int start_pos;
-    int state_first;
-    float en1;
-    int en2;
-    int index;
-    int ulp;
-    int firstpart;
-    int subcount;
-    int subframe;
-    float weightState[ILBC_LPC_FILTERORDER];
-    float syntdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
-    float weightdenum[ILBC_NUM_SUB_MAX*(ILBC_LPC_FILTERORDER + 1)];
-    float decresidual[ILBC_BLOCK_LEN_MAX];
+    icbsearch_scratch_t cb;
+} encode_stage_scratch_t;
+
+/* Everything ilbc_encode_ex() needs, which is what its scratch area holds */
+typedef struct
+{
+    float block[ILBC_BLOCK_LEN_MAX];
+    encode_frame_work_t w;
+    encode_stage_scratch_t t;
+} encode_scratch_t;
+
+/* The number of channels ilbc_encode_batch() takes through each stage together.
+   Each channel of a chunk is a lane of the filter bank. */
+#define ENCODE_BATCH_CHUNK      FILTER_BANK_LANES
+
+/* The part of the encoder state which coding a frame changes, from the
+   analysis filter's memory to the end of the LPC buffer */
+#define CODING_STATE_START      offsetof(ilbc_encode_state_t, anaMem)
+#define CODING_STATE_LEN        (offsetof(ilbc_encode_state_t, stream_fill) - CODING_STATE_START)
+
+/* Working space for the first stage of ilbc_encode_batch(), which runs the
+   filters for a whole chunk of channels in the lanes of a filter bank */
+typedef struct
+{
+    /* The signal, after the analysis filter's state */
+    float x[(ILBC_LPC_FILTERORDER + ILBC_BLOCK_LEN_MAX)*FILTER_BANK_LANES];
+    float residual[ILBC_BLOCK_LEN_MAX*FILTER_BANK_LANES];
+    float a[(ILBC_LPC_FILTERORDER + 1)*FILTER_BANK_LANES];
+    float hpmem[4*FILTER_BANK_LANES];
+    /* The high pass filtered signal of each channel, for the LPC analysis */
+    float data[ENCODE_BATCH_CHUNK][ILBC_BLOCK_LEN_MAX];
+    uint64_t ticks;
+} encode_batch_scratch_t;
 
+/*----------------------------------------------------------------*
+ *  Stage 1: high pass filtering, LPC analysis and inverse filtering
+ *---------------------------------------------------------------*/
+
+static void encode_frame_highpass(ilbc_encode_state_t *iLBCenc_inst,    /* (i/o) the general encoder state */
+                                  encode_stage_scratch_t *t,            /* (o) working space, with the filtered data */
+                                  const float block[])                  /* (i) speech vector to encode */
+{
     /* High pass filtering of input signal if such is not done
        prior to calling this function */
-    hpInput(block, iLBCenc_inst->blockl, data, (*iLBCenc_inst).hpimem);
+    hpInput(block, iLBCenc_inst->blockl, t->data, (*iLBCenc_inst).hpimem);
 
     /* Otherwise simply copy */
-    /*memcpy(data, block, iLBCenc_inst->blockl*sizeof(float));*/
+    /*memcpy(t->data, block, iLBCenc_inst->blockl*sizeof(float));*/
+}
 
-    /* LPC of hp filtered input data */
-    LPCencode(syntdenum, weightdenum, lsf_i, data, iLBCenc_inst);
+static void encode_frame_lpc(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the general encoder state */
+                             encode_frame_work_t *w,                /* (o) frame working data */
+                             encode_stage_scratch_t *t)             /* (i/o) working space, with the filtered data */
+{
+    float *data;
+    int n;
 
+    data = t->data;
+
+    /* LPC of hp filtered input data */
+    LPCencode(w->syntdenum, w->weightdenum, w->params.lsf_i, data, iLBCenc_inst);
 
     /* Inverse filter to get residual */
     for (n = 0;  n < iLBCenc_inst->nsub;  n++)
-        anaFilter(&data[n*SUBL], &syntdenum[n*(ILBC_LPC_FILTERORDER + 1)], SUBL, &residual[n*SUBL], iLBCenc_inst->anaMem);
+        anaFilter(&data[n*SUBL], &w->syntdenum[n*(ILBC_LPC_FILTERORDER + 1)], SUBL, &w->residual[n*SUBL], iLBCenc_inst->anaMem);
+}
+
+static void encode_frame_analysis(ilbc_encode_state_t *iLBCenc_inst,    /* (i/o) the general encoder state */
+                                  encode_frame_work_t *w,               /* (o) frame working data */
+                                  encode_stage_scratch_t *t,            /* (i/o) working space */
+                                  const float block[])                  /* (i) speech vector to encode */
+{
+    encode_frame_highpass(iLBCenc_inst, t, block);
+    encode_frame_lpc(iLBCenc_inst, w, t);
+}
+
+/*----------------------------------------------------------------*
+ *  Stage 1 for a chunk of channels in ilbc_encode_batch(). The high
+ *  pass and inverse filters run in the lanes of a filter bank.
+ *---------------------------------------------------------------*/
+
+static void encode_batch_analysis(ilbc_encode_state_t *s[], /* (i/o) the chunk's encoder states */
+                                  encode_frame_work_t w[],  /* (o) the chunk's frame working data */
+                                  encode_batch_scratch_t *b,/* (i/o) working space */
+                                  const int16_t *amp[],     /* (i) the chunk's speech vectors */
+                                  int offset,               /* (i) where the frame starts in amp */
+                                  int n)                    /* (i) number of channels in the chunk */
+{
+    float *x;
+    int blockl;
+    int c;
+    int i;
+
+    blockl = s[0]->blockl;
+    x = b->x + ILBC_LPC_FILTERORDER*FILTER_BANK_LANES;
+    /* Any unused lanes filter silence */
+    if (n < FILTER_BANK_LANES)
+    {
+        memset(b->x, 0, sizeof(b->x));
+        memset(b->a, 0, sizeof(b->a));
+        memset(b->hpmem, 0, sizeof(b->hpmem));
+    }
+
+    /* Convert signal to float */
+    for (c = 0;  c < n;  c++)
+    {
+        for (i = 0;  i < blockl;  i++)
+            x[i*FILTER_BANK_LANES + c] = (float) amp[c][offset + i];
+        filterBankPut(b->hpmem, c, s[c]->hpimem, 4);
+    }
+    hpFilterBank(x, blockl, x, b->hpmem, hpi_zero_coefsTbl, hpi_pole_coefsTbl);
+
+    /* LPC of hp filtered input data */
+    for (c = 0;  c < n;  c++)
+    {
+        filterBankGet(s[c]->hpimem, b->hpmem, c, 4);
+        filterBankGet(b->data[c], x, c, blockl);
+        LPCencode(w[c].syntdenum, w[c].weightdenum, w[c].params.lsf_i, b->data[c], s[c]);
+        filterBankPut(b->x, c, s[c]->anaMem, ILBC_LPC_FILTERORDER);
+    }
+
+    /* Inverse filter to get residual */
+    for (i = 0;  i < s[0]->nsub;  i++)
+    {
+        for (c = 0;  c < n;  c++)
+            filterBankPut(b->a, c, &w[c].syntdenum[i*(ILBC_LPC_FILTERORDER + 1)], ILBC_LPC_FILTERORDER + 1);
+        anaFilterBank(&x[i*SUBL*FILTER_BANK_LANES], b->a, SUBL, &b->residual[i*SUBL*FILTER_BANK_LANES]);
+    }
+    for (c = 0;  c < n;  c++)
+    {
+        filterBankGet(w[c].residual, b->residual, c, blockl);
+        filterBankGet(s[c]->anaMem, &b->x[blockl*FILTER_BANK_LANES], c, ILBC_LPC_FILTERORDER);
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Stage 2: locate and scalar quantize the start state
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void frame_state(ilbc_encode_state_t *iLBCenc_inst,  /* (i/o) the general encoder state */
+                                           encode_frame_work_t *w,             /* (i/o) frame working data */
+                                           int frame_mode)                     /* (i) the frame size mode, as a constant */
+{
+    int diff;
+    float en1;
+    int en2;
+    int index;
+    int i;
+    int state_short_len;
+
+    state_short_len = (frame_mode == 30)  ?  STATE_SHORT_LEN_30MS  :  STATE_SHORT_LEN_20MS;
 
     /* Find state location */
-    start = FrameClassify(iLBCenc_inst, residual);
+    w->params.start = FrameClassify(iLBCenc_inst, w->residual);
 
     /* Check if state should be in first or last part of the two subframes */
-    diff = STATE_LEN - iLBCenc_inst->state_short_len;
+    diff = STATE_LEN - state_short_len;
     en1 = 0;
-    index = (start - 1)*SUBL;
+    index = (w->params.start - 1)*SUBL;
 
-    for (i = 0;  i < iLBCenc_inst->state_short_len;  i++)
-        en1 += residual[index + i]*residual[index + i];
+    for (i = 0;  i < state_short_len;  i++)
+        en1 += w->residual[index + i]*w->residual[index + i];
     en2 = 0;
-    index = (start - 1)*SUBL+diff;
-    for (i = 0;  i < iLBCenc_inst->state_short_len;  i++)
-        en2 = (int)(en2 + residual[index + i]*residual[index + i]);
+    index = (w->params.start - 1)*SUBL+diff;
+    for (i = 0;  i < state_short_len;  i++)
+        en2 = (int)(en2 + w->residual[index + i]*w->residual[index + i]);
 
     if (en1 > en2)
     {
-        state_first = 1;
-        start_pos = (start - 1)*SUBL;
+        w->params.state_first = 1;
+        w->start_pos = (w->params.start - 1)*SUBL;
     }
     else
     {
-        state_first = 0;
-        start_pos = (start - 1)*SUBL + diff;
+        w->params.state_first = 0;
+        w->start_pos = (w->params.start - 1)*SUBL + diff;
     }
 
     /* Scalar quantization of state */
     StateSearchW(iLBCenc_inst,
-                 &residual[start_pos],
-                 &syntdenum[(start - 1)*(ILBC_LPC_FILTERORDER + 1)],
-                 &weightdenum[(start - 1)*(ILBC_LPC_FILTERORDER + 1)],
-                 &idxForMax,
-                 idxVec,
-                 iLBCenc_inst->state_short_len,
-                 state_first);
-
-    StateConstructW(idxForMax,
-                    idxVec,
-                    &syntdenum[(start - 1)*(ILBC_LPC_FILTERORDER + 1)],
-                    &decresidual[start_pos],
-                    iLBCenc_inst->state_short_len);
+                 &w->residual[w->start_pos],
+                 &w->syntdenum[(w->params.start - 1)*(ILBC_LPC_FILTERORDER + 1)],
+                 &w->weightdenum[(w->params.start - 1)*(ILBC_LPC_FILTERORDER + 1)],
+                 &w->params.idxForMax,
+                 w->params.idxVec,
+                 state_short_len,
+                 w->params.state_first);
+
+    StateConstructW(w->params.idxForMax,
+                    w->params.idxVec,
+                    &w->syntdenum[(w->params.start - 1)*(ILBC_LPC_FILTERORDER + 1)],
+                    &w->decresidual[w->start_pos],
+                    state_short_len);
+}
+
+static void encode_frame_state(ilbc_encode_state_t *iLBCenc_inst,   /* (i/o) the general encoder state */
+                               encode_frame_work_t *w)              /* (i/o) frame working data */
+{
+    /* A copy is built for each frame size mode */
+    if (iLBCenc_inst->mode == 30)
+        frame_state(iLBCenc_inst, w, 30);
+    else
+        frame_state(iLBCenc_inst, w, 20);
+}
+
+/*----------------------------------------------------------------*
+ *  Stage 3: codebook search for the rest of the frame
+ *---------------------------------------------------------------*/
+
+static ILBC_ALWAYS_INLINE void frame_cb(ilbc_encode_state_t *iLBCenc_inst, /* (i/o) the general encoder state */
+                                        encode_frame_work_t *w,            /* (i/o) frame working data */
+                                        encode_stage_scratch_t *t,         /* (i/o) working space */
+                                        int frame_mode)                    /* (i) the frame size mode, as a constant */
+{
+    float *reverseResidual;
+    float *reverseDecresidual;
+    float *mem;
+    float weightState[ILBC_LPC_FILTERORDER];
+    float *residual;
+    float *decresidual;
+    float *weightdenum;
+    int start;
+    int start_pos;
+    int diff;
+    int n;
+    int k;
+    int i;
+    int meml_gotten;
+    int Nfor;
+    int Nback;
+    int subcount;
+    int subframe;
+    int nsub;
+    int state_short_len;
+
+    nsub = (frame_mode == 30)  ?  NSUB_30MS  :  NSUB_20MS;
+    state_short_len = (frame_mode == 30)  ?  STATE_SHORT_LEN_30MS  :  STATE_SHORT_LEN_20MS;
+    reverseResidual = t->reverseResidual;
+    reverseDecresidual = t->reverseDecresidual;
+    mem = t->mem;
+    residual = w->residual;
+    decresidual = w->decresidual;
+    weightdenum = w->weightdenum;
+    start = w->params.start;
+    start_pos = w->start_pos;
+    diff = STATE_LEN - state_short_len;
 
     /* predictive quantization in state */
-    if (state_first)
+    if (w->params.state_first)
     {
         /* Put adaptive part in the end */
 
         /* Setup memory */
 
-        memset(mem, 0, (CB_MEML - iLBCenc_inst->state_short_len)*sizeof(float));
-        memcpy(&mem[CB_MEML - iLBCenc_inst->state_short_len], &decresidual[start_pos], iLBCenc_inst->state_short_len*sizeof(float));
+        memset(mem, 0, (CB_MEML - state_short_len)*sizeof(float));
+        memcpy(&mem[CB_MEML - state_short_len], &decresidual[start_pos], state_short_len*sizeof(float));
         memset(weightState, 0, ILBC_LPC_FILTERORDER*sizeof(float));
 
         /* Encode sub-frames */
         iCBSearch(iLBCenc_inst,
-                  extra_cb_index,
-                  extra_gain_index,
-                  &residual[start_pos + iLBCenc_inst->state_short_len],
+                  w->params.extra_cb_index,
+                  w->params.extra_gain_index,
+                  &residual[start_pos + state_short_len],
                   mem + CB_MEML - stMemLTbl,
                   stMemLTbl,
                   diff,
                   CB_NSTAGES,
                   &weightdenum[start*(ILBC_LPC_FILTERORDER + 1)],
                   weightState,
-                  0);
+                  0,
+                  &t->cb);
 
         /* Construct decoded vector */
-        iCBConstruct(&decresidual[start_pos + iLBCenc_inst->state_short_len],
-                     extra_cb_index,
-                     extra_gain_index,
+        iCBConstruct(&decresidual[start_pos + state_short_len],
+                     w->params.extra_cb_index,
+                     w->params.extra_gain_index,
                      &mem[CB_MEML - stMemLTbl],
                      stMemLTbl,
                      diff,
@@ -186,10 +369,10 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
 
         /* Create reversed vectors for prediction */
         for (k = 0;  k < diff;  k++)
-            reverseResidual[k] = residual[(start + 1)*SUBL - 1 - (k + iLBCenc_inst->state_short_len)];
+            reverseResidual[k] = residual[(start + 1)*SUBL - 1 - (k + state_short_len)];
 
         /* Setup memory */
-        meml_gotten = iLBCenc_inst->state_short_len;
+        meml_gotten = state_short_len;
         for (k = 0;  k < meml_gotten;  k++)
             mem[CB_MEML - 1 - k] = decresidual[start_pos + k];
         memset(mem, 0, (CB_MEML - k)*sizeof(float));
@@ -197,8 +380,8 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
 
         /* Encode sub-frames */
         iCBSearch(iLBCenc_inst,
-                  extra_cb_index,
-                  extra_gain_index,
+                  w->params.extra_cb_index,
+                  w->params.extra_gain_index,
                   reverseResidual,
                   mem + CB_MEML - stMemLTbl,
                   stMemLTbl,
@@ -206,12 +389,13 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
                   CB_NSTAGES,
                   &weightdenum[(start - 1)*(ILBC_LPC_FILTERORDER + 1)],
                   weightState,
-                  0);
+                  0,
+                  &t->cb);
 
         /* Construct decoded vector */
         iCBConstruct(reverseDecresidual,
-                     extra_cb_index,
-                     extra_gain_index,
+                     w->params.extra_cb_index,
+                     w->params.extra_gain_index,
                      &mem[CB_MEML - stMemLTbl],
                      stMemLTbl,
                      diff,
@@ -226,7 +410,7 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
     subcount = 0;
 
     /* Forward prediction of sub-frames */
-    Nfor = iLBCenc_inst->nsub-start - 1;
+    Nfor = nsub-start - 1;
 
     if (Nfor > 0)
     {
@@ -240,8 +424,8 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
         {
             /* Encode sub-frame */
             iCBSearch(iLBCenc_inst,
-                      &cb_index[subcount*CB_NSTAGES],
-                      &gain_index[subcount*CB_NSTAGES],
+                      &w->params.cb_index[subcount*CB_NSTAGES],
+                      &w->params.gain_index[subcount*CB_NSTAGES],
                       &residual[(start + 1 + subframe)*SUBL],
                       &mem[CB_MEML - memLfTbl[subcount]],
                       memLfTbl[subcount],
@@ -249,12 +433,13 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
                       CB_NSTAGES,
                       &weightdenum[(start + 1 + subframe)*(ILBC_LPC_FILTERORDER + 1)],
                       weightState,
-                      subcount + 1);
+                      subcount + 1,
+                      &t->cb);
 
             /* Construct decoded vector */
             iCBConstruct(&decresidual[(start + 1 + subframe)*SUBL],
-                         &cb_index[subcount*CB_NSTAGES],
-                         &gain_index[subcount*CB_NSTAGES],
+                         &w->params.cb_index[subcount*CB_NSTAGES],
+                         &w->params.gain_index[subcount*CB_NSTAGES],
                          &mem[CB_MEML - memLfTbl[subcount]],
                          memLfTbl[subcount],
                          SUBL,
@@ -284,7 +469,7 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
         }
 
         /* Setup memory */
-        meml_gotten = SUBL*(iLBCenc_inst->nsub + 1 - start);
+        meml_gotten = SUBL*(nsub + 1 - start);
 
 
         if (meml_gotten > CB_MEML)
@@ -299,8 +484,8 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
         {
             /* Encode sub-frame */
             iCBSearch(iLBCenc_inst,
-                      &cb_index[subcount*CB_NSTAGES],
-                      &gain_index[subcount*CB_NSTAGES],
+                      &w->params.cb_index[subcount*CB_NSTAGES],
+                      &w->params.gain_index[subcount*CB_NSTAGES],
                       &reverseResidual[subframe*SUBL],
                       &mem[CB_MEML - memLfTbl[subcount]],
                       memLfTbl[subcount],
@@ -308,12 +493,13 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
                       CB_NSTAGES,
                       &weightdenum[(start - 2 - subframe)*(ILBC_LPC_FILTERORDER + 1)],
                       weightState,
-                      subcount + 1);
+                      subcount + 1,
+                      &t->cb);
 
             /* Construct decoded vector */
             iCBConstruct(&reverseDecresidual[subframe*SUBL],
-                         &cb_index[subcount*CB_NSTAGES],
-                         &gain_index[subcount*CB_NSTAGES],
+                         &w->params.cb_index[subcount*CB_NSTAGES],
+                         &w->params.gain_index[subcount*CB_NSTAGES],
                          &mem[CB_MEML - memLfTbl[subcount]],
                          memLfTbl[subcount],
                          SUBL,
@@ -335,154 +521,592 @@ static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the
     }
 
     /* Adjust index */
-    index_conv_enc(cb_index);
+    index_conv_enc(w->params.cb_index);
+}
+
+static void encode_frame_cb(ilbc_encode_state_t *iLBCenc_inst,  /* (i/o) the general encoder state */
+                            encode_frame_work_t *w,             /* (i/o) frame working data */
+                            encode_stage_scratch_t *t)          /* (i/o) working space */
+{
+    /* A copy is built for each frame size mode */
+    if (iLBCenc_inst->mode == 30)
+        frame_cb(iLBCenc_inst, w, t, 30);
+    else
+        frame_cb(iLBCenc_inst, w, t, 20);
+}
+
+/*----------------------------------------------------------------*
+ *  Stage 4: pack the encoded parameters into bytes
+ *---------------------------------------------------------------*/
+
+static int encode_frame_pack(ilbc_encode_state_t *iLBCenc_inst,    /* (i/o) the general encoder state */
+                             encode_frame_work_t *w,               /* (i/o) frame working data */
+                             uint8_t bytes[])                      /* (o) encoded data bits iLBC */
+{
+    /* The last bit must be zero, otherwise the decoder will treat the frame as lost */
+    w->params.last_bit = 0;
+    return pack_frame(bytes, &w->params, iLBCenc_inst->mode);
+}
+
+/*----------------------------------------------------------------*
+ *  the stages after the analysis, shared by full and DTX coding
+ *---------------------------------------------------------------*/
+
+static int encode_frame_coding(ilbc_encode_state_t *iLBCenc_inst,   /* (i/o) the general encoder state */
+                               uint8_t bytes[],                     /* (o) encoded data bits iLBC */
+                               encode_scratch_t *scratch)           /* (i/o) working space */
+{
+    int len;
+
+    ILBC_PROFILE_START(iLBCenc_inst, ILBC_PROF_STATESEARCH);
+    encode_frame_state(iLBCenc_inst, &scratch->w);
+    ILBC_PROFILE_STOP(iLBCenc_inst, ILBC_PROF_STATESEARCH);
+    ILBC_PROFILE_START(iLBCenc_inst, ILBC_PROF_CBSEARCH);
+    encode_frame_cb(iLBCenc_inst, &scratch->w, &scratch->t);
+    ILBC_PROFILE_STOP(iLBCenc_inst, ILBC_PROF_CBSEARCH);
+    ILBC_PROFILE_START(iLBCenc_inst, ILBC_PROF_PACKING);
+    len = encode_frame_pack(iLBCenc_inst, &scratch->w, bytes);
+    ILBC_PROFILE_STOP(iLBCenc_inst, ILBC_PROF_PACKING);
+    return len;
+}
+
+/*----------------------------------------------------------------*
+ *  main encoder function
+ *---------------------------------------------------------------*/
 
-    /* Pack bytes */
-    pbytes = bytes;
-    pos = 0;
+static int block_is_silent(const float block[],  /* (i) speech vector */
+                           int len)                 /* (i) number of samples */
+{
+    int k;
 
-    /* Loop over the 3 ULP classes */
-    for (ulp = 0;  ulp < 3;  ulp++)
+    for (k = 0;  k < len;  k++)
     {
-        /* LSF */
-        for (k = 0;  k < LSF_NSPLIT*iLBCenc_inst->lpc_n;  k++)
-        {
-            packsplit(&lsf_i[k],
-                      &firstpart,
-                      &lsf_i[k],
-                      iLBCenc_inst->ULP_inst->lsf_bits[k][ulp],
-                      iLBCenc_inst->ULP_inst->lsf_bits[k][ulp]
-                    + iLBCenc_inst->ULP_inst->lsf_bits[k][ulp + 1]
-                    + iLBCenc_inst->ULP_inst->lsf_bits[k][ulp + 2]);
-            dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->lsf_bits[k][ulp], &pos);
-        }
+        if (block[k] != 0.0f)
+            return 0;
+    }
+    return 1;
+}
+
+static int ilbc_encode_frame(ilbc_encode_state_t *iLBCenc_inst,     /* (i/o) the general encoder state */
+                             uint8_t bytes[],                       /* (o) encoded data bits iLBC */
+                             const float block[],                   /* (i) speech vector to encode */
+                             encode_scratch_t *scratch)             /* (i/o) working space */
+{
+    uint8_t before[CODING_STATE_LEN];
+    uint8_t *state;
+    int silent;
+    int len;
+
+    /* Digital silence. The coding is deterministic, so once a frame of zeros
+       has left the state as it found it, the next one codes to the same bytes
+       and leaves it alone too. There is nothing to do but copy them. */
+    silent = block_is_silent(block, iLBCenc_inst->blockl);
+    if (silent  &&  iLBCenc_inst->silence_settled)
+    {
+        ILBC_STATS_COUNT(iLBCenc_inst, frames);
+        memcpy(bytes, iLBCenc_inst->silence_frame, iLBCenc_inst->no_of_bytes);
+        return iLBCenc_inst->no_of_bytes;
+    }
+    state = (uint8_t *) iLBCenc_inst + CODING_STATE_START;
+    if (silent)
+        memcpy(before, state, CODING_STATE_LEN);
+
+    ILBC_PROFILE_START(iLBCenc_inst, ILBC_PROF_LPCENCODE);
+    encode_frame_analysis(iLBCenc_inst, &scratch->w, &scratch->t, block);
+    ILBC_PROFILE_STOP(iLBCenc_inst, ILBC_PROF_LPCENCODE);
+    ILBC_STATS_COUNT(iLBCenc_inst, frames);
+    len = encode_frame_coding(iLBCenc_inst, bytes, scratch);
+
+    iLBCenc_inst->silence_settled = 0;
+    if (silent  &&  memcmp(before, state, CODING_STATE_LEN) == 0)
+    {
+        iLBCenc_inst->silence_settled = 1;
+        memcpy(iLBCenc_inst->silence_frame, bytes, len);
+    }
+    return len;
+}
+
+size_t ilbc_encode_scratch_size(void)
+{
+    return sizeof(encode_scratch_t);
+}
+
+int ilbc_encode_ex(ilbc_encode_state_t *s,  /* (i/o) the general encoder state */
+                   uint8_t bytes[],         /* (o) encoded data bits iLBC */
+                   const int16_t amp[],     /* (i) speech vector to encode */
+                   int len,                 /* (i) number of samples */
+                   void *scratch)           /* (i/o) working space */
+{
+    encode_scratch_t *t;
+    int i;
+    int j;
+    int k;
+
+    ILBC_STACK_WATCH_START();
+    t = (encode_scratch_t *) scratch;
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        /* Convert signal to float */
+        for (k = 0;  k < s->blockl;  k++)
+            t->block[k] = (float) amp[i + k];
+        ilbc_encode_frame(s, bytes + j, t->block, t);
+    }
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_ENCODE_EX);
+    return j;
+}
+
+int ilbc_encode(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
+                uint8_t bytes[],            /* (o) encoded data bits iLBC */
+                const int16_t amp[],        /* (o) speech vector to encode */
+                int len)
+{
+    encode_scratch_t scratch;
+    int j;
+
+    ILBC_STACK_WATCH_START();
+    j = ilbc_encode_ex(s, bytes, amp, len, &scratch);
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_ENCODE);
+    return j;
+}
+
+/*----------------------------------------------------------------*
+ *  Gather the side information for a frame ilbc_encode_frame() has
+ *  just coded, from what it left in the scratch area and the state
+ *---------------------------------------------------------------*/
 
-        /* Start block info */
-        packsplit(&start,
-                  &firstpart,
-                  &start,
-                  iLBCenc_inst->ULP_inst->start_bits[ulp],
-                  iLBCenc_inst->ULP_inst->start_bits[ulp]
-                + iLBCenc_inst->ULP_inst->start_bits[ulp + 1]
-                + iLBCenc_inst->ULP_inst->start_bits[ulp + 2]);
-        dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->start_bits[ulp], &pos);
-
-        packsplit(&state_first,
-                  &firstpart,
-                  &state_first,
-                  iLBCenc_inst->ULP_inst->startfirst_bits[ulp],
-                  iLBCenc_inst->ULP_inst->startfirst_bits[ulp]
-                + iLBCenc_inst->ULP_inst->startfirst_bits[ulp + 1]
-                + iLBCenc_inst->ULP_inst->startfirst_bits[ulp + 2]);
-        dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->startfirst_bits[ulp], &pos);
-
-        packsplit(&idxForMax,
-                  &firstpart,
-                  &idxForMax,
-                  iLBCenc_inst->ULP_inst->scale_bits[ulp],
-                  iLBCenc_inst->ULP_inst->scale_bits[ulp]
-                + iLBCenc_inst->ULP_inst->scale_bits[ulp + 1]
-                + iLBCenc_inst->ULP_inst->scale_bits[ulp + 2]);
-        dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->scale_bits[ulp], &pos);
-
-        for (k = 0;  k < iLBCenc_inst->state_short_len;  k++)
+static void encode_info(ilbc_encode_state_t *iLBCenc_inst,    /* (i) the general encoder state */
+                        ilbc_encode_info_t *info,             /* (o) the side information */
+                        const encode_scratch_t *scratch,      /* (i) working space, as the frame left it */
+                        int silent,                           /* (i) 1 if the frame was digital silence */
+                        int settled)                          /* (i) 1 if the frame was settled digital silence,
+                                                                     which left the scratch area alone */
+{
+    float lsf[ILBC_LPC_FILTERORDER];
+    const float *x;
+    const float *r;
+    float en;
+    float ren;
+    int n;
+    int k;
+
+    info->subframes = iLBCenc_inst->nsub;
+    info->silent = silent;
+    memcpy(info->lsf, iLBCenc_inst->lsfdeqold, sizeof(info->lsf));
+    if (settled)
+    {
+        /* The state, and so the LSFs, are the same at both ends of the frame,
+           so every subframe has the filter of the last LSFs. lsf2a() works
+           on its input in place. */
+        info->start = 0;
+        memcpy(lsf, info->lsf, sizeof(lsf));
+        lsf2a(info->lpc[0], lsf);
+        for (n = 0;  n < iLBCenc_inst->nsub;  n++)
         {
-            packsplit(idxVec + k,
-                      &firstpart,
-                      idxVec + k,
-                      iLBCenc_inst->ULP_inst->state_bits[ulp],
-                      iLBCenc_inst->ULP_inst->state_bits[ulp]
-                    + iLBCenc_inst->ULP_inst->state_bits[ulp + 1]
-                    + iLBCenc_inst->ULP_inst->state_bits[ulp + 2]);
-            dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->state_bits[ulp], &pos);
+            if (n > 0)
+                memcpy(info->lpc[n], info->lpc[0], sizeof(info->lpc[n]));
+            info->energy[n] = 0.0f;
+            info->residual_energy[n] = 0.0f;
         }
-
-        /* 23/22 (20ms/30ms) sample block */
-        for (k = 0;  k < CB_NSTAGES;  k++)
+        return;
+    }
+    info->start = scratch->w.params.start;
+    for (n = 0;  n < iLBCenc_inst->nsub;  n++)
+    {
+        memcpy(info->lpc[n], &scratch->w.syntdenum[n*(ILBC_LPC_FILTERORDER + 1)], sizeof(info->lpc[n]));
+        x = &scratch->t.data[n*SUBL];
+        r = &scratch->w.residual[n*SUBL];
+        en = 0.0f;
+        ren = 0.0f;
+        for (k = 0;  k < SUBL;  k++)
         {
-            packsplit(extra_cb_index + k,
-                      &firstpart,
-                      extra_cb_index + k,
-                      iLBCenc_inst->ULP_inst->extra_cb_index[k][ulp],
-                      iLBCenc_inst->ULP_inst->extra_cb_index[k][ulp]
-                    + iLBCenc_inst->ULP_inst->extra_cb_index[k][ulp + 1]
-                    + iLBCenc_inst->ULP_inst->extra_cb_index[k][ulp + 2]);
-            dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->extra_cb_index[k][ulp], &pos);
+            en += x[k]*x[k];
+            ren += r[k]*r[k];
         }
+        info->energy[n] = en;
+        info->residual_energy[n] = ren;
+    }
+}
+
+int ilbc_encode_info(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const int16_t amp[],       /* (i) speech vector to encode */
+                     int len,                   /* (i) number of samples */
+                     ilbc_encode_info_t info[]) /* (o) side information, one per frame */
+{
+    encode_scratch_t scratch;
+    int silent;
+    int settled;
+    int i;
+    int j;
+    int k;
+
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        /* Convert signal to float */
+        for (k = 0;  k < s->blockl;  k++)
+            scratch.block[k] = (float) amp[i + k];
+        silent = block_is_silent(scratch.block, s->blockl);
+        settled = silent  &&  s->silence_settled;
+        ilbc_encode_frame(s, bytes + j, scratch.block, &scratch);
+        encode_info(s, &info[i/s->blockl], &scratch, silent, settled);
+    }
+    return j;
+}
+
+int ilbc_encode_strided(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                        uint8_t bytes[],        /* (o) encoded data bits iLBC */
+                        const int16_t amp[],    /* (i) the channel's first sample */
+                        int stride,             /* (i) distance between the channel's samples, in samples */
+                        int len)                /* (i) number of samples in the channel */
+{
+    encode_scratch_t scratch;
+    int i;
+    int j;
+    int k;
+
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        /* Convert signal to float, picking the channel out as we go */
+        for (k = 0;  k < s->blockl;  k++)
+            scratch.block[k] = (float) amp[(i + k)*stride];
+        ilbc_encode_frame(s, bytes + j, scratch.block, &scratch);
+    }
+    return j;
+}
+
+int ilbc_encode_stream(ilbc_encode_state_t *s,  /* (i/o) the general encoder state */
+                       uint8_t bytes[],         /* (o) encoded data bits iLBC */
+                       const int16_t amp[],     /* (i) speech to encode */
+                       int len)                 /* (i) number of samples, which may be any number */
+{
+    encode_scratch_t scratch;
+    int i;
+    int j;
+    int k;
+    int n;
+
+    i = 0;
+    j = 0;
+    if (s->stream_fill > 0)
+    {
+        /* Top up the partial frame left from the last call */
+        n = s->blockl - s->stream_fill;
+        if (n > len)
+            n = len;
+        for (k = 0;  k < n;  k++)
+            s->stream_block[s->stream_fill + k] = (float) amp[k];
+        s->stream_fill += n;
+        i = n;
+        if (s->stream_fill < s->blockl)
+            return 0;
+        ilbc_encode_frame(s, bytes, s->stream_block, &scratch);
+        s->stream_fill = 0;
+        j = s->no_of_bytes;
+    }
+    /* Whole frames are taken straight from the caller's samples */
+    for (  ;  i + s->blockl <= len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        for (k = 0;  k < s->blockl;  k++)
+            scratch.block[k] = (float) amp[i + k];
+        ilbc_encode_frame(s, bytes + j, scratch.block, &scratch);
+    }
+    /* Keep anything left over for next time */
+    for (k = 0;  i + k < len;  k++)
+        s->stream_block[k] = (float) amp[i + k];
+    s->stream_fill = k;
+    return j;
+}
+
+int ilbc_encode_stream_pending(ilbc_encode_state_t *s)     /* (i) the general encoder state */
+{
+    return s->stream_fill;
+}
+
+int ilbc_encode_resampled(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                          uint8_t bytes[],        /* (o) encoded data bits iLBC */
+                          const int16_t amp[],    /* (i) speech to encode, at rate */
+                          int len,                /* (i) number of samples */
+                          int rate)               /* (i) sample rate, in samples per second */
+{
+    encode_scratch_t scratch;
+    int factor;
+    int i;
+    int j;
+
+    if ((factor = resampleFactor(rate)) < 0  ||  len%(factor*s->blockl) != 0)
+        return -1;
+    if (rate != s->resample_rate)
+    {
+        /* Don't filter the start of this signal with the end of another */
+        memset(s->resample_hist, 0, sizeof(s->resample_hist));
+        s->resample_rate = rate;
+    }
+    if (factor == 1)
+        return ilbc_encode_ex(s, bytes, amp, len, &scratch);
+    /* These frames go past ilbc_encode_frame(), so it can't track silence */
+    s->silence_settled = 0;
+    for (i = 0, j = 0;  i < len;  i += factor*s->blockl, j += s->no_of_bytes)
+    {
+        ILBC_PROFILE_START(s, ILBC_PROF_LPCENCODE);
+        decimateHp(scratch.t.data, amp + i, s->blockl, factor, s->resample_hist, s->hpimem);
+        encode_frame_lpc(s, &scratch.w, &scratch.t);
+        ILBC_PROFILE_STOP(s, ILBC_PROF_LPCENCODE);
+        ILBC_STATS_COUNT(s, frames);
+        encode_frame_coding(s, bytes + j, &scratch);
+    }
+    return j;
+}
+
+int ilbc_encode_alaw(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const uint8_t alaw[],      /* (i) A-law speech to encode */
+                     int len)                   /* (i) number of samples */
+{
+    encode_scratch_t scratch;
+    int i;
+    int j;
+
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        alawToFloat(scratch.block, alaw + i, s->blockl);
+        ilbc_encode_frame(s, bytes + j, scratch.block, &scratch);
+    }
+    return j;
+}
+
+int ilbc_encode_ulaw(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const uint8_t ulaw[],      /* (i) u-law speech to encode */
+                     int len)                   /* (i) number of samples */
+{
+    encode_scratch_t scratch;
+    int i;
+    int j;
+
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        ulawToFloat(scratch.block, ulaw + i, s->blockl);
+        ilbc_encode_frame(s, bytes + j, scratch.block, &scratch);
+    }
+    return j;
+}
 
-        for (k = 0;  k < CB_NSTAGES;  k++)
+int ilbc_encode_dtx(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                    uint8_t bytes[],        /* (o) a frame, a SID, or nothing */
+                    const int16_t amp[],    /* (i) one frame of speech to encode */
+                    int len)                /* (i) number of samples */
+{
+    encode_scratch_t scratch;
+    float k[ILBC_LPC_FILTERORDER];
+    float energy;
+    int i;
+
+    if (len != s->blockl)
+        return -1;
+    ILBC_STATS_COUNT(s, frames);
+    /* This works on the coding state directly, passing ilbc_encode_frame() by */
+    s->silence_settled = 0;
+    for (i = 0;  i < s->blockl;  i++)
+        scratch.block[i] = (float) amp[i];
+    ILBC_PROFILE_START(s, ILBC_PROF_LPCENCODE);
+    encode_frame_highpass(s, &scratch.t, scratch.block);
+    energy = 0.0f;
+    for (i = 0;  i < s->blockl;  i++)
+        energy += scratch.t.data[i]*scratch.t.data[i];
+    energy /= (float) s->blockl;
+    if (vadDetect(s, energy))
+    {
+        s->sid_age = -1;
+        encode_frame_lpc(s, &scratch.w, &scratch.t);
+        ILBC_PROFILE_STOP(s, ILBC_PROF_LPCENCODE);
+        return encode_frame_coding(s, bytes, &scratch);
+    }
+    /* Silence. Only the LPC analysis is needed, for the comfort noise. The
+       coded frame history is left as it was, as the decoder's will be. */
+    LPCencodeSilence(k, scratch.t.data, s);
+    ILBC_PROFILE_STOP(s, ILBC_PROF_LPCENCODE);
+    ILBC_STATS_COUNT(s, dtx_frames);
+    /* Digital silence, and the dying tail of the high pass filter, would
+       otherwise look like a new level on every frame, and a denormal level
+       can't be put in dBov */
+    if (energy < DTX_SID_FLOOR)
+        energy = DTX_SID_FLOOR;
+    if (!dtxSidDue(s, energy))
+        return 0;
+    return sidEncode(bytes, energy, k);
+}
+
+int ilbc_encode_payload_iov(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
+                            const ilbc_iovec_t iov[],   /* (o) the packet buffer pieces */
+                            int iovcnt,                 /* (i) number of pieces */
+                            size_t offset,              /* (i) where the payload starts in the buffer */
+                            const int16_t amp[],        /* (i) speech to encode */
+                            int len)                    /* (i) number of samples */
+{
+    encode_scratch_t scratch;
+    uint8_t frame[ILBC_NO_OF_BYTES_MAX];
+    uint8_t *out;
+    size_t room;
+    size_t n;
+    int piece;
+    int i;
+    int j;
+    int k;
+
+    if (len <= 0  ||  len%s->blockl)
+        return -1;
+    /* Check the whole payload fits, before touching the encoder state */
+    room = 0;
+    for (piece = 0;  piece < iovcnt;  piece++)
+        room += iov[piece].len;
+    if (offset > room  ||  room - offset < (size_t) (len/s->blockl)*s->no_of_bytes)
+        return -1;
+    /* Find the piece the payload starts in */
+    for (piece = 0;  offset >= iov[piece].len;  piece++)
+        offset -= iov[piece].len;
+
+    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    {
+        for (k = 0;  k < s->blockl;  k++)
+            scratch.block[k] = (float) amp[i + k];
+        if (iov[piece].len - offset >= (size_t) s->no_of_bytes)
         {
-            packsplit(extra_gain_index + k,
-                      &firstpart,
-                      extra_gain_index + k,
-                      iLBCenc_inst->ULP_inst->extra_cb_gain[k][ulp],
-                      iLBCenc_inst->ULP_inst->extra_cb_gain[k][ulp]
-                    + iLBCenc_inst->ULP_inst->extra_cb_gain[k][ulp + 1]
-                    + iLBCenc_inst->ULP_inst->extra_cb_gain[k][ulp + 2]);
-            dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->extra_cb_gain[k][ulp], &pos);
+            /* The usual case. The frame goes straight into the packet */
+            ilbc_encode_frame(s, (uint8_t *) iov[piece].base + offset, scratch.block, &scratch);
+            offset += s->no_of_bytes;
         }
-
-        /* The two/four (20ms/30ms) 40 sample sub-blocks */
-        for (i = 0;  i < iLBCenc_inst->nasub;  i++)
+        else
         {
-            for (k = 0;  k < CB_NSTAGES;  k++)
+            /* The frame straddles pieces */
+            ilbc_encode_frame(s, frame, scratch.block, &scratch);
+            for (k = 0;  k < s->no_of_bytes;  k += (int) n)
             {
-                packsplit(cb_index + i*CB_NSTAGES+k,
-                          &firstpart,
-                          cb_index + i*CB_NSTAGES + k,
-                          iLBCenc_inst->ULP_inst->cb_index[i][k][ulp],
-                          iLBCenc_inst->ULP_inst->cb_index[i][k][ulp]
-                        + iLBCenc_inst->ULP_inst->cb_index[i][k][ulp + 1]
-                        + iLBCenc_inst->ULP_inst->cb_index[i][k][ulp + 2]);
-                dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->cb_index[i][k][ulp], &pos);
+                while (offset >= iov[piece].len)
+                {
+                    offset = 0;
+                    piece++;
+                }
+                out = (uint8_t *) iov[piece].base + offset;
+                n = iov[piece].len - offset;
+                if (n > (size_t) (s->no_of_bytes - k))
+                    n = s->no_of_bytes - k;
+                memcpy(out, frame + k, n);
+                offset += n;
             }
         }
-
-        for (i = 0;  i < iLBCenc_inst->nasub;  i++)
+        while (offset >= iov[piece].len  &&  piece < iovcnt - 1)
         {
-            for (k = 0;  k < CB_NSTAGES;  k++)
-            {
-                packsplit(gain_index + i*CB_NSTAGES + k,
-                          &firstpart,
-                          gain_index + i*CB_NSTAGES + k,
-                          iLBCenc_inst->ULP_inst->cb_gain[i][k][ulp],
-                          iLBCenc_inst->ULP_inst->cb_gain[i][k][ulp]
-                        + iLBCenc_inst->ULP_inst->cb_gain[i][k][ulp + 1]
-                        + iLBCenc_inst->ULP_inst->cb_gain[i][k][ulp + 2]);
-                dopack(&pbytes, firstpart, iLBCenc_inst->ULP_inst->cb_gain[i][k][ulp], &pos);
-            }
+            offset = 0;
+            piece++;
         }
     }
+    return j;
+}
 
-    /* Set the last bit to zero (otherwise the decoder will treat it as a lost frame) */
-    dopack(&pbytes, 0, 1, &pos);
-    return iLBCenc_inst->no_of_bytes;
+int ilbc_encode_payload(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
+                        uint8_t buf[],              /* (o) the packet buffer */
+                        int buf_len,                /* (i) length of the packet buffer */
+                        int offset,                 /* (i) where the payload starts in the buffer */
+                        const int16_t amp[],        /* (i) speech to encode */
+                        int len)                    /* (i) number of samples */
+{
+    ilbc_iovec_t iov;
+
+    if (offset < 0  ||  buf_len < 0)
+        return -1;
+    iov.base = buf;
+    iov.len = buf_len;
+    return ilbc_encode_payload_iov(s, &iov, 1, offset, amp, len);
 }
 
-int ilbc_encode(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
-                uint8_t bytes[],            /* (o) encoded data bits iLBC */
-                const int16_t amp[],        /* (o) speech vector to encode */
-                int len)
+int ilbc_encode_batch(ilbc_encode_state_t *s[],    /* (i/o) the encoder states, one per channel */
+                      uint8_t *bytes[],             /* (o) encoded data bits iLBC, one buffer per channel */
+                      const int16_t *amp[],         /* (i) speech vectors to encode, one per channel */
+                      int len,                      /* (i) samples per channel */
+                      int channels)                 /* (i) number of channels */
 {
     int i;
     int j;
-    int k;
-    float block[ILBC_BLOCK_LEN_MAX];
+    int c;
+    int c0;
+    int n;
+    int blockl;
+    int no_of_bytes;
+    encode_frame_work_t w[ENCODE_BATCH_CHUNK];
+    encode_stage_scratch_t t;
+    encode_batch_scratch_t b;
 
-    for (i = 0, j = 0;  i < len;  i += s->blockl, j += s->no_of_bytes)
+    if (channels <= 0)
+        return 0;
+    /* Every channel in a batch must use the same frame size, so the channels
+       stay in step from one frame to the next */
+    blockl = s[0]->blockl;
+    no_of_bytes = s[0]->no_of_bytes;
+    for (c = 1;  c < channels;  c++)
     {
-        /* Convert signal to float */
-        for (k = 0;  k < s->blockl;  k++)
-            block[k] = (float) amp[i + k];
-        ilbc_encode_frame(s, bytes + j, block);
+        if (s[c]->mode != s[0]->mode)
+            return -1;
+    }
+    /* The batch stages work on the coding states directly, passing
+       ilbc_encode_frame() by */
+    for (c = 0;  c < channels;  c++)
+        s[c]->silence_settled = 0;
+
+    ILBC_STACK_WATCH_START();
+    for (i = 0, j = 0;  i < len;  i += blockl, j += no_of_bytes)
+    {
+        /* Take a chunk of channels through each stage of the encoder in turn,
+           so each stage's tables stay in cache for the whole chunk */
+        for (c0 = 0;  c0 < channels;  c0 += ENCODE_BATCH_CHUNK)
+        {
+            n = channels - c0;
+            if (n > ENCODE_BATCH_CHUNK)
+                n = ENCODE_BATCH_CHUNK;
+            /* The channels share the filter bank, so they share its time equally */
+            ILBC_PROFILE_GLOBAL_START(ILBC_PROF_LPCENCODE);
+            ILBC_STATS_SHARED_START(b.ticks);
+            encode_batch_analysis(&s[c0], w, &b, &amp[c0], i, n);
+            ILBC_STATS_SHARED_STOP(b.ticks, n);
+            for (c = 0;  c < n;  c++)
+            {
+                ILBC_STATS_ADD(s[c0 + c], ILBC_PROF_LPCENCODE, b.ticks);
+                ILBC_STATS_COUNT(s[c0 + c], frames);
+            }
+            ILBC_PROFILE_GLOBAL_STOP(ILBC_PROF_LPCENCODE);
+            ILBC_PROFILE_GLOBAL_START(ILBC_PROF_STATESEARCH);
+            for (c = 0;  c < n;  c++)
+            {
+                ILBC_STATS_START(s[c0 + c], ILBC_PROF_STATESEARCH);
+                encode_frame_state(s[c0 + c], &w[c]);
+                ILBC_STATS_STOP(s[c0 + c], ILBC_PROF_STATESEARCH);
+            }
+            ILBC_PROFILE_GLOBAL_STOP(ILBC_PROF_STATESEARCH);
+            ILBC_PROFILE_GLOBAL_START(ILBC_PROF_CBSEARCH);
+            for (c = 0;  c < n;  c++)
+            {
+                ILBC_STATS_START(s[c0 + c], ILBC_PROF_CBSEARCH);
+                encode_frame_cb(s[c0 + c], &w[c], &t);
+                ILBC_STATS_STOP(s[c0 + c], ILBC_PROF_CBSEARCH);
+            }
+            ILBC_PROFILE_GLOBAL_STOP(ILBC_PROF_CBSEARCH);
+            ILBC_PROFILE_GLOBAL_START(ILBC_PROF_PACKING);
+            for (c = 0;  c < n;  c++)
+            {
+                ILBC_STATS_START(s[c0 + c], ILBC_PROF_PACKING);
+                encode_frame_pack(s[c0 + c], &w[c], bytes[c0 + c] + j);
+                ILBC_STATS_STOP(s[c0 + c], ILBC_PROF_PACKING);
+            }
+            ILBC_PROFILE_GLOBAL_STOP(ILBC_PROF_PACKING);
+        }
     }
+    ILBC_STACK_WATCH_STOP(ILBC_STACK_ENCODE_BATCH);
     return j;
 }
 
-ilbc_encode_state_t *ilbc_encode_init(ilbc_encode_state_t *iLBCenc_inst, /* (i/o) Encoder instance */
-                                      int mode)                          /* (i) frame size mode */
+/* Set the parameters which follow from the frame size mode */
+static int set_mode_params(ilbc_encode_state_t *iLBCenc_inst,  /* (i/o) Encoder instance */
+                           int mode)                           /* (i) frame size mode */
 {
-    iLBCenc_inst->mode = mode;
     if (mode == 30)
     {
         iLBCenc_inst->blockl = ILBC_BLOCK_LEN_30MS;
@@ -507,14 +1131,120 @@ ilbc_encode_state_t *ilbc_encode_init(ilbc_encode_state_t *iLBCenc_inst, /* (i/o
     }
     else
     {
-        return NULL;
+        return -1;
     }
+    iLBCenc_inst->mode = mode;
+    return 0;
+}
+
+ilbc_encode_state_t *ilbc_encode_init(ilbc_encode_state_t *iLBCenc_inst, /* (i/o) Encoder instance */
+                                      int mode)                          /* (i) frame size mode */
+{
+    if (set_mode_params(iLBCenc_inst, mode))
+        return NULL;
 
     memset((*iLBCenc_inst).anaMem, 0, ILBC_LPC_FILTERORDER*sizeof(float));
     memcpy((*iLBCenc_inst).lsfold, lsfmeanTbl, ILBC_LPC_FILTERORDER*sizeof(float));
     memcpy((*iLBCenc_inst).lsfdeqold, lsfmeanTbl, ILBC_LPC_FILTERORDER*sizeof(float));
-    memset((*iLBCenc_inst).lpc_buffer, 0, (LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX)*sizeof(float));
+    memset((*iLBCenc_inst).lpc_buffer, 0, sizeof(iLBCenc_inst->lpc_buffer));
+    iLBCenc_inst->stream_fill = 0;
+    iLBCenc_inst->resample_rate = 8000;
+    memset(iLBCenc_inst->resample_hist, 0, sizeof(iLBCenc_inst->resample_hist));
     memset((*iLBCenc_inst).hpimem, 0, 4*sizeof(float));
+    iLBCenc_inst->complexity = ILBC_COMPLEXITY_FULL;
+    iLBCenc_inst->vad_noise = VAD_SILENCE_ENERGY;
+    iLBCenc_inst->vad_hangover = 0;
+    iLBCenc_inst->sid_age = -1;
+    iLBCenc_inst->sid_energy = 0.0f;
+    iLBCenc_inst->silence_settled = 0;
+    lsfMemoInit(&iLBCenc_inst->lsfdeq_memo);
+    lsfMemoInit(&iLBCenc_inst->lsf_memo);
+    memset(&iLBCenc_inst->stats, 0, sizeof(iLBCenc_inst->stats));
 
     return iLBCenc_inst;
 }
+
+size_t ilbc_encode_state_size(void)
+{
+    return sizeof(ilbc_encode_state_t) + ILBC_STATE_ALIGNMENT - 1;
+}
+
+ilbc_encode_state_t *ilbc_encode_init_at(void *mem,     /* (i/o) at least ilbc_encode_state_size() bytes */
+                                         int mode)      /* (i) frame size mode */
+{
+    ilbc_encode_state_t *s;
+
+    s = (ilbc_encode_state_t *) (((uintptr_t) mem + ILBC_STATE_ALIGNMENT - 1) & ~((uintptr_t) ILBC_STATE_ALIGNMENT - 1));
+    s->alloc_base = NULL;
+    return ilbc_encode_init(s, mode);
+}
+
+ilbc_encode_state_t *ilbc_encode_alloc(int mode)        /* (i) frame size mode */
+{
+    ilbc_encode_state_t *s;
+    void *mem;
+
+    if ((mem = malloc(ilbc_encode_state_size())) == NULL)
+        return NULL;
+    if ((s = ilbc_encode_init_at(mem, mode)) == NULL)
+    {
+        free(mem);
+        return NULL;
+    }
+    s->alloc_base = mem;
+    return s;
+}
+
+void ilbc_encode_free(ilbc_encode_state_t *s)
+{
+    if (s)
+        free(s->alloc_base);
+}
+
+int ilbc_encode_set_mode(ilbc_encode_state_t *s,   /* (i/o) Encoder instance */
+                         int mode)                  /* (i) the new frame size mode */
+{
+    int old_is;
+    int is;
+
+    if (mode != 20  &&  mode != 30)
+        return -1;
+    if (mode == s->mode)
+        return 0;
+    /* The partial frame held by ilbc_encode_stream() must still be partial */
+    if (s->stream_fill >= ((mode == 30)  ?  ILBC_BLOCK_LEN_30MS  :  ILBC_BLOCK_LEN_20MS))
+        return -1;
+    /* The filter memories and the LSFs at the end of the last frame mean the
+       same in both modes. Only the analysis history has a length which
+       depends on the mode. It ends at the end of the last frame, and 20ms
+       mode keeps 80 samples more than 30ms mode. Going to 20ms mode, those
+       older samples are gone, so they are taken as silence. They only fall
+       under the start of the first frame's symmetric window. */
+    old_is = LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - s->blockl;
+    set_mode_params(s, mode);
+    is = LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - s->blockl;
+    if (is < old_is)
+    {
+        memmove(s->lpc_buffer, s->lpc_buffer + old_is - is, is*sizeof(float));
+    }
+    else
+    {
+        memmove(s->lpc_buffer + is - old_is, s->lpc_buffer, old_is*sizeof(float));
+        memset(s->lpc_buffer, 0, (is - old_is)*sizeof(float));
+    }
+    /* The silence frame is only good for the mode it was coded in */
+    s->silence_settled = 0;
+    return 0;
+}
+
+int ilbc_encode_set_complexity(ilbc_encode_state_t *s,     /* (i/o) Encoder instance */
+                               int level)                  /* (i) complexity level */
+{
+    if (level < ILBC_COMPLEXITY_FULL  ||  level > ILBC_COMPLEXITY_LOWEST)
+        return -1;
+    /* The silence frame may be coded differently at another level */
+    if (level != s->complexity)
+        s->silence_settled = 0;
+    s->complexity = level;
+    return 0;
+}
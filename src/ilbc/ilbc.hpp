@@ -0,0 +1,266 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc.hpp - A C++ interface to the iLBC codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#if !defined(_ILBC_ILBC_HPP_)
+#define _ILBC_ILBC_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#if __cplusplus >= 202002L  &&  defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+#include <ilbc2.h>
+
+/*! \page ilbc_hpp_page The C++ interface
+\section ilbc_hpp_page_sec_1 What does it do?
+It wraps the encoder and decoder states in classes which own them, so a
+channel is freed when its object goes, and which can be moved but not
+copied. The frame size mode is a template parameter, so the frame sizes
+are constants, and a frame can be passed as a fixed size array, or as a
+fixed extent std::span, with nothing to check at run time.
+
+\section ilbc_hpp_page_sec_2 How is it used?
+    ilbc::encoder<20> enc;
+    ilbc::decoder<20> dec;
+    ilbc::encoder<20>::bit_frame bits;
+    ilbc::decoder<20>::pcm_frame speech;
+
+    enc.encode(bits, speech_in);
+    dec.decode(speech, bits);
+    dec.conceal(speech);
+
+The std::span forms need C++20. The rest needs C++11.
+*/
+
+namespace ilbc
+{
+
+/*! The sizes of a frame in each frame size mode */
+template <int Mode> struct frame_traits;
+
+template <> struct frame_traits<20>
+{
+    static constexpr std::size_t samples = ILBC_BLOCK_LEN_20MS;
+    static constexpr std::size_t bytes = ILBC_NO_OF_BYTES_20MS;
+};
+
+template <> struct frame_traits<30>
+{
+    static constexpr std::size_t samples = ILBC_BLOCK_LEN_30MS;
+    static constexpr std::size_t bytes = ILBC_NO_OF_BYTES_30MS;
+};
+
+template <int Mode>
+class encoder
+{
+public:
+    static constexpr int mode = Mode;
+    static constexpr std::size_t samples_per_frame = frame_traits<Mode>::samples;
+    static constexpr std::size_t bytes_per_frame = frame_traits<Mode>::bytes;
+
+    typedef std::array<int16_t, samples_per_frame> pcm_frame;
+    typedef std::array<uint8_t, bytes_per_frame> bit_frame;
+
+    /*! Allocate an encoder, which throws std::bad_alloc if there is no memory. */
+    encoder()
+    :   s_(ilbc_encode_alloc(Mode))
+    {
+        if (s_ == nullptr)
+            throw std::bad_alloc();
+    }
+
+    encoder(const encoder &) = delete;
+    encoder &operator=(const encoder &) = delete;
+
+    encoder(encoder &&other) noexcept
+    :   s_(other.s_)
+    {
+        other.s_ = nullptr;
+    }
+
+    encoder &operator=(encoder &&other) noexcept
+    {
+        std::swap(s_, other.s_);
+        return *this;
+    }
+
+    ~encoder()
+    {
+        if (s_)
+            ilbc_encode_free(s_);
+    }
+
+    /*! Encode one frame. */
+    void encode(bit_frame &bytes, const pcm_frame &amp)
+    {
+        ilbc_encode(s_, bytes.data(), amp.data(), samples_per_frame);
+    }
+
+    /*! Encode one frame, and return its bits. */
+    bit_frame encode(const pcm_frame &amp)
+    {
+        bit_frame bytes;
+
+        ilbc_encode(s_, bytes.data(), amp.data(), samples_per_frame);
+        return bytes;
+    }
+
+#if defined(__cpp_lib_span)
+    /*! Encode one frame. */
+    void encode(std::span<std::byte, bytes_per_frame> bytes, std::span<const int16_t, samples_per_frame> amp)
+    {
+        ilbc_encode(s_, reinterpret_cast<uint8_t *>(bytes.data()), amp.data(), samples_per_frame);
+    }
+
+    /*! Encode any number of whole frames.
+        \return The number of bytes produced. Throws std::invalid_argument
+                if the speech is not whole frames, or does not fit. */
+    std::size_t encode(std::span<std::byte> bytes, std::span<const int16_t> amp)
+    {
+        std::size_t frames;
+
+        frames = amp.size()/samples_per_frame;
+        if (frames*samples_per_frame != amp.size()  ||  bytes.size() < frames*bytes_per_frame)
+            throw std::invalid_argument("ilbc::encoder::encode: not whole frames, or no room for the bits");
+        return static_cast<std::size_t>(ilbc_encode(s_, reinterpret_cast<uint8_t *>(bytes.data()), amp.data(), static_cast<int>(amp.size())));
+    }
+#endif
+
+    /*! Set the complexity of the codebook search.
+        \return 0 for OK, or -1 for a bad level. */
+    int set_complexity(int level)
+    {
+        return ilbc_encode_set_complexity(s_, level);
+    }
+
+    /*! The C state, for the rest of the C interface. */
+    ilbc_encode_state_t *native_handle() noexcept
+    {
+        return s_;
+    }
+
+private:
+    ilbc_encode_state_t *s_;
+};
+
+template <int Mode>
+class decoder
+{
+public:
+    static constexpr int mode = Mode;
+    static constexpr std::size_t samples_per_frame = frame_traits<Mode>::samples;
+    static constexpr std::size_t bytes_per_frame = frame_traits<Mode>::bytes;
+
+    typedef std::array<int16_t, samples_per_frame> pcm_frame;
+    typedef std::array<uint8_t, bytes_per_frame> bit_frame;
+
+    /*! Allocate a decoder, which throws std::bad_alloc if there is no memory.
+        A decoder without the enhancer is a compact one. */
+    explicit decoder(int use_enhancer = ILBC_ENHANCER_FULL)
+    :   s_((use_enhancer == ILBC_ENHANCER_OFF)  ?  ilbc_decode_alloc_compact(Mode)  :  ilbc_decode_alloc(Mode, use_enhancer))
+    {
+        if (s_ == nullptr)
+            throw std::bad_alloc();
+    }
+
+    decoder(const decoder &) = delete;
+    decoder &operator=(const decoder &) = delete;
+
+    decoder(decoder &&other) noexcept
+    :   s_(other.s_)
+    {
+        other.s_ = nullptr;
+    }
+
+    decoder &operator=(decoder &&other) noexcept
+    {
+        std::swap(s_, other.s_);
+        return *this;
+    }
+
+    ~decoder()
+    {
+        if (s_)
+            ilbc_decode_free(s_);
+    }
+
+    /*! Decode one frame. */
+    void decode(pcm_frame &amp, const bit_frame &bytes)
+    {
+        ilbc_decode(s_, amp.data(), bytes.data(), bytes_per_frame);
+    }
+
+    /*! Decode one frame, and return its speech. */
+    pcm_frame decode(const bit_frame &bytes)
+    {
+        pcm_frame amp;
+
+        ilbc_decode(s_, amp.data(), bytes.data(), bytes_per_frame);
+        return amp;
+    }
+
+    /*! Conceal one lost frame. */
+    void conceal(pcm_frame &amp)
+    {
+        ilbc_fillin(s_, amp.data(), bytes_per_frame);
+    }
+
+#if defined(__cpp_lib_span)
+    /*! Decode one frame. */
+    void decode(std::span<int16_t, samples_per_frame> amp, std::span<const std::byte, bytes_per_frame> bytes)
+    {
+        ilbc_decode(s_, amp.data(), reinterpret_cast<const uint8_t *>(bytes.data()), bytes_per_frame);
+    }
+
+    /*! Decode any number of whole frames.
+        \return The number of samples produced. Throws std::invalid_argument
+                if the bits are not whole frames, or the speech does not fit. */
+    std::size_t decode(std::span<int16_t> amp, std::span<const std::byte> bytes)
+    {
+        std::size_t frames;
+
+        frames = bytes.size()/bytes_per_frame;
+        if (frames*bytes_per_frame != bytes.size()  ||  amp.size() < frames*samples_per_frame)
+            throw std::invalid_argument("ilbc::decoder::decode: not whole frames, or no room for the speech");
+        return static_cast<std::size_t>(ilbc_decode(s_, amp.data(), reinterpret_cast<const uint8_t *>(bytes.data()), static_cast<int>(bytes.size())));
+    }
+
+    /*! Conceal one lost frame. */
+    void conceal(std::span<int16_t, samples_per_frame> amp)
+    {
+        ilbc_fillin(s_, amp.data(), bytes_per_frame);
+    }
+#endif
+
+    /*! The C state, for the rest of the C interface. */
+    ilbc_decode_state_t *native_handle() noexcept
+    {
+        return s_;
+    }
+
+private:
+    ilbc_decode_state_t *s_;
+};
+
+}
+
+#endif
+/*- End of file ------------------------------------------------------------*/
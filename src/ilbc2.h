@@ -31,6 +31,11 @@
 #include <time.h>
 #include <math.h>
 
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
 #if !defined(_ILBC_ILBC_H_)
 #define _ILBC_ILBC_H_
 
@@ -54,11 +59,42 @@
 #define LPC_LOOKBACK            60
 
 #define CB_NSTAGES              3
+#define NASUB_MAX               4
+#define STATE_LEN               80
+#define LPC_N_MAX               2
+
+#define RESAMPLE_TAPS           24  /* filter taps for each 8kHz sample */
+#define RESAMPLE_FACTOR_MAX     6   /* 48kHz */
 
 #define STATE_BITS              3
 #define BYTE_LEN                8
 #define ILBC_ULP_CLASSES        3
 
+/* Encoder complexity levels. Level 0 is the full codebook search of
+   RFC3951. Each higher level trades a little more quality for speed. */
+#define ILBC_COMPLEXITY_FULL    0
+#define ILBC_COMPLEXITY_LOWEST  3
+
+/* Decoder enhancer settings, for the use_enhancer argument of
+   ilbc_decode_init(). The lighter tiers give most of the full enhancer's
+   improvement for a fraction of its cost. */
+#define ILBC_ENHANCER_OFF       0
+#define ILBC_ENHANCER_FULL      1   /* the enhancer of RFC3951 */
+#define ILBC_ENHANCER_LITE      2   /* 5 pitch cycles, at half the resolution */
+#define ILBC_ENHANCER_MINIMAL   3   /* 3 pitch cycles, at half the resolution */
+
+/* Time scale actions for ilbc_decode_tsm() */
+#define ILBC_TSM_NORMAL         0
+#define ILBC_TSM_ACCELERATE     1
+#define ILBC_TSM_EXPAND         2
+
+/* The longest comfort noise (SID) frame from ilbc_encode_dtx(), which is
+   a level byte and a byte per reflection coefficient (RFC 3389) */
+#define ILBC_SID_LEN_MAX        (1 + ILBC_LPC_FILTERORDER)
+
+/* Options for ilbc_encode_state_export() and ilbc_decode_state_export() */
+#define ILBC_EXPORT_QUANTISED   0x01
+
 typedef struct
 {
     int lsf_bits[6][ILBC_ULP_CLASSES + 2];
@@ -72,7 +108,117 @@ typedef struct
     int cb_gain[ILBC_NUM_SUB_MAX][CB_NSTAGES][ILBC_ULP_CLASSES + 2];
 } ilbc_ulp_inst_t;
 
-/* Type definition encoder instance */
+/* The last LSF vector converted to LPC coefficients, with its coefficients,
+   so a sub-frame with the same LSFs can skip the conversion */
+typedef struct
+{
+    float lsf[ILBC_LPC_FILTERORDER];
+    float a[ILBC_LPC_FILTERORDER + 1];
+} ilbc_lsf_memo_t;
+
+/* The filter memories and larger buffers in the codec states are aligned
+   to this many bytes, so they can be used with aligned vector loads, and
+   do not share cache lines with unrelated data. */
+#define ILBC_STATE_ALIGNMENT    64
+
+#if defined(__GNUC__)
+#define ILBC_ALIGN(n)           __attribute__((aligned(n)))
+#elif defined(_MSC_VER)
+#define ILBC_ALIGN(n)           __declspec(align(n))
+#else
+#define ILBC_ALIGN(n)
+#endif
+
+/* The tiers of vector kernels, chosen for the CPU the library runs on */
+#define ILBC_CPU_SCALAR         0   /* plain C */
+#define ILBC_CPU_SSE2           1
+#define ILBC_CPU_AVX2           2
+#define ILBC_CPU_AVX512         3   /* AVX-512F. The kernels fall back to AVX2 versions */
+#define ILBC_CPU_NEON           4
+#define ILBC_CPU_TIERS          5
+
+/* The stages of the codec which are timed separately, by the benchmark
+   program's profiling and by the per instance statistics */
+#define ILBC_PROF_LPCENCODE     0   /* high pass filter, LPC analysis and inverse filter */
+#define ILBC_PROF_STATESEARCH   1   /* start state location and quantisation */
+#define ILBC_PROF_CBSEARCH      2   /* codebook search and reconstruction */
+#define ILBC_PROF_PACKING       3   /* packing of the encoded parameters */
+#define ILBC_PROF_DECODE        4   /* unpacking and decoding of the residual */
+#define ILBC_PROF_PLC           5   /* concealment of lost frames */
+#define ILBC_PROF_ENHANCER      6   /* decoder enhancer */
+#define ILBC_PROF_STAGES        7
+
+/* The entry points whose stack use is recorded, when the library is built
+   with --enable-stack-watch. A call to one entry point from inside another
+   is counted as part of the outer one. */
+#define ILBC_STACK_ENCODE       0   /* ilbc_encode() */
+#define ILBC_STACK_ENCODE_EX    1   /* ilbc_encode_ex() */
+#define ILBC_STACK_ENCODE_BATCH 2   /* ilbc_encode_batch() */
+#define ILBC_STACK_DECODE       3   /* ilbc_decode() */
+#define ILBC_STACK_DECODE_EX    4   /* ilbc_decode_ex() */
+#define ILBC_STACK_FILLIN       5   /* ilbc_fillin() */
+#define ILBC_STACK_FILLIN_EX    6   /* ilbc_fillin_ex() */
+#define ILBC_STACK_DECODE_BATCH 7   /* ilbc_decode_batch() */
+#define ILBC_STACK_ENTRIES      8
+
+/*! Counters kept by each encoder and decoder, when the library is built
+    with --enable-stats. A counter which makes no sense for one side is
+    left at zero. */
+typedef struct
+{
+    uint64_t frames;            /* frames encoded, or decoded and concealed */
+    uint64_t lost_frames;       /* frames concealed */
+    uint64_t plc_runs;          /* bursts of one or more consecutive concealed frames */
+    uint32_t longest_plc_run;   /* frames in the longest burst so far */
+    uint64_t enhanced_frames;   /* frames passed through the enhancer */
+    uint64_t dtx_frames;        /* frames sent as silence by ilbc_encode_dtx(), or
+                                   generated by ilbc_decode_cng() */
+    uint64_t ticks[ILBC_PROF_STAGES];   /* time in each stage, ILBC_PROF_xxx. On x86
+                                           these are time stamp counter ticks,
+                                           elsewhere nanoseconds */
+} ilbc_stats_t;
+
+/*! Side information about an encoded frame, from ilbc_encode_info(). This
+    is the encoder's own analysis of the frame, which it does anyway, so it
+    can stand in for a separate analysis of the same signal for voice
+    activity detection, level metering and the like. */
+typedef struct
+{
+    int subframes;              /* subframes in the frame, 4 for 20ms or 6 for 30ms */
+    int start;                  /* the start state is in subframes start - 1 and start,
+                                   which hold the most residual energy, or 0 for
+                                   digital silence the encoder did not need to
+                                   analyse again */
+    int silent;                 /* 1 if the frame was digital silence */
+    float lsf[ILBC_LPC_FILTERORDER];    /* the quantised LSFs for the end of the frame, in
+                                           radians */
+    float lpc[ILBC_NUM_SUB_MAX][ILBC_LPC_FILTERORDER + 1];  /* the quantised synthesis filter
+                                                               of each subframe, with
+                                                               lpc[n][0] = 1.0 */
+    float energy[ILBC_NUM_SUB_MAX];     /* energy of each subframe of the input, after the
+                                           high pass filter */
+    float residual_energy[ILBC_NUM_SUB_MAX];    /* energy of each subframe of the LPC residual.
+                                                   Its ratio to energy is the prediction gain,
+                                                   which is high for voiced speech. */
+} ilbc_encode_info_t;
+
+/*! Side information about a decoded frame, from ilbc_decode_info(). */
+typedef struct
+{
+    int subframes;              /* subframes in the frame, 4 for 20ms or 6 for 30ms */
+    int concealed;              /* 1 if the frame was lost or corrupt, and was concealed */
+    int lag;                    /* the pitch lag at the end of the frame, in samples */
+    float lpc[ILBC_NUM_SUB_MAX][ILBC_LPC_FILTERORDER + 1];  /* the synthesis filter of each
+                                                               subframe, from the frame or
+                                                               the concealment */
+    float energy[ILBC_NUM_SUB_MAX];     /* energy of each subframe of the output, before it is
+                                           rounded to int16_t */
+    float enh_period[ENH_NBLOCKS_TOT];  /* the pitch period the enhancer found for each of its
+                                           blocks, in samples, or all 0 with the enhancer off */
+} ilbc_decode_info_t;
+
+/* Type definition encoder instance. The fields used for every frame come
+   first, so they share as few cache lines as possible. */
 typedef struct
 {
     /* flag for frame size mode */
@@ -87,21 +233,55 @@ typedef struct
     int state_short_len;
     const ilbc_ulp_inst_t *ULP_inst;
 
+    /* codebook search complexity level, ILBC_COMPLEXITY_xxx */
+    int complexity;
+
     /* analysis filter state */
-    float anaMem[ILBC_LPC_FILTERORDER];
+    ILBC_ALIGN(32) float anaMem[ILBC_LPC_FILTERORDER];
+
+    /* state of input HP filter */
+    float hpimem[4];
 
     /* old lsf parameters for interpolation */
-    float lsfold[ILBC_LPC_FILTERORDER];
+    ILBC_ALIGN(32) float lsfold[ILBC_LPC_FILTERORDER];
     float lsfdeqold[ILBC_LPC_FILTERORDER];
 
-    /* signal buffer for LP analysis */
-    float lpc_buffer[LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX];
+    /* the end of the last frame, for the LP analysis windows, which run on
+       into the next frame. 20ms mode keeps the most. */
+    ILBC_ALIGN(ILBC_STATE_ALIGNMENT) float lpc_buffer[LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - ILBC_BLOCK_LEN_20MS];
 
-    /* state of input HP filter */
-    float hpimem[4];
+    /* the partial frame held by ilbc_encode_stream() */
+    int stream_fill;
+    ILBC_ALIGN(ILBC_STATE_ALIGNMENT) float stream_block[ILBC_BLOCK_LEN_MAX];
+
+    /* the decimator's input history, for ilbc_encode_resampled() */
+    int resample_rate;
+    float resample_hist[RESAMPLE_TAPS*RESAMPLE_FACTOR_MAX - 1];
+
+    /* voice activity detection and DTX, for ilbc_encode_dtx() */
+    float vad_noise;        /* tracked background noise energy */
+    int vad_hangover;       /* samples still to be sent as speech after the level drops */
+    int sid_age;            /* samples since the last SID was sent, or -1 in speech */
+    float sid_energy;       /* the energy sent in the last SID */
+
+    /* digital silence. Once a frame of zeros has left the coding state just
+       as it found it, every later frame of zeros codes to silence_frame */
+    int silence_settled;
+    uint8_t silence_frame[ILBC_NO_OF_BYTES_MAX];
+
+    /* the last conversions of the quantised and unquantised LSFs */
+    ilbc_lsf_memo_t lsfdeq_memo;
+    ilbc_lsf_memo_t lsf_memo;
+
+    /* counters, for ilbc_encode_stats() */
+    ilbc_stats_t stats;
+
+    /* the block of memory from ilbc_encode_alloc(), or NULL */
+    void *alloc_base;
 } ilbc_encode_state_t;
 
-/* Type definition decoder instance */
+/* Type definition decoder instance. The fields used for every frame come
+   first, so they share as few cache lines as possible. */
 typedef struct
 {
     /* Flag for frame size mode */
@@ -116,58 +296,867 @@ typedef struct
     int state_short_len;
     const ilbc_ulp_inst_t *ULP_inst;
 
-    /* Synthesis filter state */
-    float syntMem[ILBC_LPC_FILTERORDER];
-
-    /* Old LSF for interpolation */
-    float lsfdeqold[ILBC_LPC_FILTERORDER];
-
     /* Pitch lag estimated in enhancer and used in PLC */
     int last_lag;
 
     /* PLC state information */
     int prevLag, consPLICount, prevPLI, prev_enh_pl;
-    float prevLpc[ILBC_LPC_FILTERORDER + 1];
-    float prevResidual[ILBC_NUM_SUB_MAX*SUBL];
     float per;
     unsigned long seed;
 
-    /* Previous synthesis filter parameters */
-    float old_syntdenum[(ILBC_LPC_FILTERORDER + 1)*ILBC_NUM_SUB_MAX];
+    int use_enhancer;
+
+    /* Frames decoded or concealed since initialisation, so ilbc_decode_rewind()
+       can check a checkpoint is just one frame old */
+    uint32_t frames;
+
+    /* Synthesis filter state */
+    ILBC_ALIGN(32) float syntMem[ILBC_LPC_FILTERORDER];
 
     /* State of output HP filter */
     float hpomem[4];
 
-    /* Enhancer state information */
-    int use_enhancer;
-    float enh_buf[ENH_BUFL];
+    /* Old LSF for interpolation */
+    ILBC_ALIGN(32) float lsfdeqold[ILBC_LPC_FILTERORDER];
+
+    float prevLpc[ILBC_LPC_FILTERORDER + 1];
+
+    /* Previous synthesis filter parameters */
+    ILBC_ALIGN(ILBC_STATE_ALIGNMENT) float old_syntdenum[(ILBC_LPC_FILTERORDER + 1)*ILBC_NUM_SUB_MAX];
+
+    ILBC_ALIGN(ILBC_STATE_ALIGNMENT) float prevResidual[ILBC_NUM_SUB_MAX*SUBL];
+
+    /* The last conversion of the LSFs */
+    ilbc_lsf_memo_t lsfdeq_memo;
+
+    /* Counters, for ilbc_decode_stats() */
+    ilbc_stats_t stats;
+
+    /* The block of memory from ilbc_decode_alloc(), or NULL */
+    void *alloc_base;
+
+    /* Decoded samples not yet taken by ilbc_decode_stream(), which are
+       stream_buf[stream_pos] to stream_buf[stream_len - 1] */
+    int stream_pos;
+    int stream_len;
+
+    /* The rate of the last ilbc_decode_resampled() */
+    int resample_rate;
+
+    /* Set once repeat_frame has been decoded without changing the decoding
+       state */
+    int repeat_settled;
+
+    /* 0 for a compact state, from ilbc_decode_alloc_compact(), which stops
+       here. A compact state has none of the buffers below, so it can not
+       stream, resample, generate comfort noise, take the shortcut for
+       repeated frames, or run the enhancer. */
+    int full_state;
+
+    ILBC_ALIGN(32) int16_t stream_buf[ILBC_BLOCK_LEN_MAX];
+
+    /* The interpolator's 8kHz history, for ilbc_decode_resampled() */
+    float resample_hist[RESAMPLE_TAPS - 1];
+
+    /* Comfort noise generation, for ilbc_decode_cng() */
+    ILBC_ALIGN(32) float cng_a[ILBC_LPC_FILTERORDER + 1];
+    float cng_mem[ILBC_LPC_FILTERORDER];
+    float cng_gain;         /* excitation level now */
+    float cng_target;       /* excitation level the last SID asked for */
+
+    /* Repeated frames. Once repeat_frame has been decoded without changing the
+       decoding state, every later copy of it synthesises repeat_block, which
+       only needs the output high pass filter */
+    uint8_t repeat_frame[ILBC_NO_OF_BYTES_MAX];
+    float repeat_block[ILBC_BLOCK_LEN_MAX];
+
+    /* Enhancer state information. The periods come first, so the buffer
+       stays aligned. */
     float enh_period[ENH_NBLOCKS_TOT];
+    ILBC_ALIGN(ILBC_STATE_ALIGNMENT) float enh_buf[ENH_BUFL];
 } ilbc_decode_state_t;
 
+/*! The parts of a decoder's state which one frame changes, saved by
+    ilbc_decode_checkpoint(). Each frame pushes the oldest part of the
+    enhancer's buffer out, and may smooth the newest part, so only those
+    are kept, and the rest is shifted back on a rewind. */
+typedef struct
+{
+    int mode;
+    uint32_t frames;
+    int last_lag;
+    int prevLag, consPLICount, prevPLI, prev_enh_pl;
+    float per;
+    unsigned long seed;
+    float syntMem[ILBC_LPC_FILTERORDER];
+    float hpomem[4];
+    float lsfdeqold[ILBC_LPC_FILTERORDER];
+    float prevLpc[ILBC_LPC_FILTERORDER + 1];
+    float old_syntdenum[(ILBC_LPC_FILTERORDER + 1)*ILBC_NUM_SUB_MAX];
+    float prevResidual[ILBC_NUM_SUB_MAX*SUBL];
+    float enh_head[ILBC_BLOCK_LEN_MAX];
+    float enh_tail[ENH_BLOCKL];
+    float enh_period[ENH_NBLOCKS_TOT];
+} ilbc_decode_checkpoint_t;
+
+/*! What ilbc_frame_info() finds in a frame, without decoding it */
+typedef struct
+{
+    int mode;               /* the frame size mode, 20 or 30 */
+    int valid;              /* 1 if the frame would be decoded, or 0 if it is marked
+                               as empty, or is corrupt, and would be concealed */
+    int start;              /* the subframe pair holding the start state */
+    int idx_for_max;        /* the scale index of the start state, 0 to 63 */
+    float excitation_peak;  /* the peak of the start state's excitation, found from
+                               idx_for_max as the decoder finds it */
+} ilbc_frame_info_t;
+
+/*! A frame unpacked and checked by ilbc_decode_parse(), ready for
+    ilbc_decode_synth(). Apart from mode and valid, the members are only
+    for the library's use. */
+typedef struct
+{
+    int mode;               /* the frame size mode, 20 or 30 */
+    int valid;              /* 1 if the frame can be decoded, or 0 if it is marked
+                               as empty, or is corrupt, and will be concealed */
+    float lsfdeq[ILBC_LPC_FILTERORDER*LPC_N_MAX];
+    int start;
+    int state_first;
+    int idxForMax;
+    int idxVec[STATE_LEN];
+    int extra_cb_index[CB_NSTAGES];
+    int extra_gain_index[CB_NSTAGES];
+    int cb_index[CB_NSTAGES*NASUB_MAX];
+    int gain_index[CB_NSTAGES*NASUB_MAX];
+} ilbc_frame_params_t;
+
+/*! One piece of a scattered buffer. This has the same layout as the POSIX
+    struct iovec, so an array of those may be cast to an array of these. */
+typedef struct
+{
+    void *base;
+    size_t len;
+} ilbc_iovec_t;
+
 ilbc_encode_state_t *ilbc_encode_init(ilbc_encode_state_t *s,    /* (i/o) Encoder instance */
                                       int mode);                 /* (i) frame size mode */
 
+/*! Find how much memory ilbc_encode_init_at() needs for an encoder. This
+    allows for aligning the state, wherever the memory is.
+    \return The size, in bytes. */
+size_t ilbc_encode_state_size(void);
+
+/*! Initialise an encoder in a block of memory supplied by the caller, which
+    may have any alignment. The state is placed at the first point in the
+    block aligned to ILBC_STATE_ALIGNMENT bytes.
+    \return The encoder, or NULL for a bad mode. */
+ilbc_encode_state_t *ilbc_encode_init_at(void *mem,             /* (i/o) at least ilbc_encode_state_size() bytes */
+                                         int mode);             /* (i) frame size mode */
+
+/*! Allocate and initialise an encoder, aligned to ILBC_STATE_ALIGNMENT bytes.
+    \return The encoder, or NULL for a bad mode or no memory. */
+ilbc_encode_state_t *ilbc_encode_alloc(int mode);               /* (i) frame size mode */
+
+/*! Free an encoder from ilbc_encode_alloc(). */
+void ilbc_encode_free(ilbc_encode_state_t *s);
+
+/*! Set the complexity of the codebook search. The level may be changed
+    at any time.
+    \return 0 for OK, or -1 for a bad level. */
+int ilbc_encode_set_complexity(ilbc_encode_state_t *s,     /* (i/o) Encoder instance */
+                               int level);                 /* (i) ILBC_COMPLEXITY_FULL (the default) to
+                                                                  ILBC_COMPLEXITY_LOWEST */
+
+/*! Change the frame size mode of an encoder, without starting it again.
+    Its filter memories and LSF history carry on into the next frame, so
+    the change is not heard, as it is with ilbc_encode_init(). A partial
+    frame held by ilbc_encode_stream() is kept, and completed to the new
+    frame length.
+    \return 0 for OK, or -1 for a bad mode, or if ilbc_encode_stream() is
+            holding a whole frame's worth of samples for the new mode. */
+int ilbc_encode_set_mode(ilbc_encode_state_t *s,   /* (i/o) Encoder instance */
+                         int mode);                 /* (i) the new frame size mode, 20 or 30 */
+
 int ilbc_encode(ilbc_encode_state_t *s,         /* (i/o) the general encoder state */
                 uint8_t bytes[],                /* (o) encoded data bits iLBC */
                 const int16_t amp[],            /* (o) speech vector to encode */
                 int len);
 
+/*! Find the size of the working space ilbc_encode_ex() needs.
+    \return The size, in bytes. */
+size_t ilbc_encode_scratch_size(void);
+
+/*! Encode, as ilbc_encode(), but keep all the working data in a scratch
+    area supplied by the caller, rather than on the stack. The scratch
+    area must be at least ilbc_encode_scratch_size() bytes long, and
+    aligned at least as strictly as a float. Nothing is kept in it from
+    one call to the next, so one scratch area may be shared by any number
+    of encoders and decoders which are not running at the same time.
+    \return The number of bytes produced. */
+int ilbc_encode_ex(ilbc_encode_state_t *s,      /* (i/o) the general encoder state */
+                   uint8_t bytes[],             /* (o) encoded data bits iLBC */
+                   const int16_t amp[],         /* (i) speech vector to encode */
+                   int len,                     /* (i) number of samples */
+                   void *scratch);              /* (i/o) working space */
+
+/*! Encode any number of samples. Whole frames are encoded as soon as they
+    are complete, and a partial frame is kept in the encoder until the next
+    call completes it. ilbc_encode() does not use the partial frame, so
+    mixing it with this puts samples out of order.
+    \return The number of bytes produced, which is always a whole number of
+            frames. bytes must have room for (len + blockl - 1)/blockl frames,
+            where blockl is the frame length in samples. */
+int ilbc_encode_stream(ilbc_encode_state_t *s,  /* (i/o) the general encoder state */
+                       uint8_t bytes[],         /* (o) encoded data bits iLBC */
+                       const int16_t amp[],     /* (i) speech to encode */
+                       int len);                /* (i) number of samples, which may be any number */
+
+/*! Find how many samples ilbc_encode_stream() is holding, waiting for the
+    rest of their frame.
+    \return The number of samples. */
+int ilbc_encode_stream_pending(ilbc_encode_state_t *s);    /* (i) the general encoder state */
+
+/*! Encode, as ilbc_encode(), from speech sampled at 16, 32 or 48kHz, or at
+    8kHz, which is just ilbc_encode(). The speech is low pass filtered and
+    decimated to 8kHz as it is read, in the same pass as the codec's input
+    high pass filter, with no separate resampling step. The filter's history
+    stays in the state between calls, and is cleared when the rate changes.
+    It is not exported by ilbc_encode_state_export(), so an imported state
+    starts the filter from silence.
+    \return The number of bytes produced, or -1 if the rate is not one of
+            these, or len is not a whole number of frames at that rate. */
+int ilbc_encode_resampled(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                          uint8_t bytes[],        /* (o) encoded data bits iLBC */
+                          const int16_t amp[],    /* (i) speech to encode, at rate */
+                          int len,                /* (i) number of samples */
+                          int rate);              /* (i) sample rate, in samples per second */
+
+/*! Encode, as ilbc_encode(), from G.711 A-law speech. The codes are expanded
+    straight into the codec's own working block.
+    \return The number of bytes produced. */
+int ilbc_encode_alaw(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const uint8_t alaw[],      /* (i) A-law speech to encode */
+                     int len);                  /* (i) number of samples */
+
+/*! Encode, as ilbc_encode(), from G.711 u-law speech.
+    \return The number of bytes produced. */
+int ilbc_encode_ulaw(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const uint8_t ulaw[],      /* (i) u-law speech to encode */
+                     int len);                  /* (i) number of samples */
+
+/*! Encode one frame with discontinuous transmission (DTX). A voice
+    activity detector, following the background noise level, picks out
+    speech, which is coded as usual. Silence skips the codebook searches,
+    and is sent now and then as a comfort noise SID (RFC 3389), when the
+    silence starts, when its level changes, and about every 400ms. SIDs go
+    to a decoder's ilbc_decode_cng(). A SID is never the length of a frame,
+    so the two can be told apart by length.
+    \return The number of bytes produced, which is the frame length, or
+            ILBC_SID_LEN_MAX for a SID, or 0 when there is nothing to send,
+            or -1 if len is not one frame. */
+int ilbc_encode_dtx(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                    uint8_t bytes[],        /* (o) a frame, a SID, or nothing */
+                    const int16_t amp[],    /* (i) one frame of speech to encode */
+                    int len);               /* (i) number of samples */
+
+/*! Encode whole frames as an RTP payload (RFC 3952), written straight into
+    a packet buffer at the given offset. The frames follow each other with
+    no padding, as RFC 3952 requires.
+    \return The payload length, in bytes, or -1 if len is not a whole number
+            of frames, or the payload would not fit in the buffer. */
+int ilbc_encode_payload(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
+                        uint8_t buf[],              /* (o) the packet buffer */
+                        int buf_len,                /* (i) length of the packet buffer */
+                        int offset,                 /* (i) where the payload starts in the buffer */
+                        const int16_t amp[],        /* (i) speech to encode */
+                        int len);                   /* (i) number of samples */
+
+/*! Encode whole frames as an RTP payload, as ilbc_encode_payload(), into a
+    packet buffer scattered over several pieces. The offset is counted from
+    the start of the first piece. A frame which straddles two pieces is
+    packed aside and copied in; the others are packed in place.
+    \return The payload length, in bytes, or -1 if len is not a whole number
+            of frames, or the payload would not fit in the buffer. */
+int ilbc_encode_payload_iov(ilbc_encode_state_t *s,     /* (i/o) the general encoder state */
+                            const ilbc_iovec_t iov[],   /* (o) the packet buffer pieces */
+                            int iovcnt,                 /* (i) number of pieces */
+                            size_t offset,              /* (i) where the payload starts in the buffer */
+                            const int16_t amp[],        /* (i) speech to encode */
+                            int len);                   /* (i) number of samples */
+
+/*! Encode, as ilbc_encode(), and report the encoder's analysis of each
+    frame. Filling in the side information costs little beside the encoding.
+    \return The number of bytes produced. */
+int ilbc_encode_info(ilbc_encode_state_t *s,    /* (i/o) the general encoder state */
+                     uint8_t bytes[],           /* (o) encoded data bits iLBC */
+                     const int16_t amp[],       /* (i) speech vector to encode */
+                     int len,                   /* (i) number of samples */
+                     ilbc_encode_info_t info[]);    /* (o) side information, one per frame */
+
+/*! Encode, as ilbc_encode(), one channel of interleaved multi-channel
+    audio. The channel's samples are picked out as they are converted for
+    the encoder, so there is no need to deinterleave them first. For the
+    second channel of stereo, for example, pass &amp[1] and a stride of 2.
+    \return The number of bytes produced. */
+int ilbc_encode_strided(ilbc_encode_state_t *s, /* (i/o) the general encoder state */
+                        uint8_t bytes[],        /* (o) encoded data bits iLBC */
+                        const int16_t amp[],    /* (i) the channel's first sample */
+                        int stride,             /* (i) distance between the channel's samples, in samples */
+                        int len);               /* (i) number of samples in the channel */
+
+/*! Encode the same span of audio for a set of independent channels. The
+    channels are worked through the encoder stage by stage, a few at a time,
+    which is more cache friendly than separate calls to ilbc_encode().
+    All the channels must use the same frame size mode.
+    \return The number of bytes produced for each channel, or -1 if the
+            channels' modes do not match. */
+int ilbc_encode_batch(ilbc_encode_state_t *s[],    /* (i/o) the encoder states, one per channel */
+                      uint8_t *bytes[],             /* (o) encoded data bits iLBC, one buffer per channel */
+                      const int16_t *amp[],         /* (i) speech vectors to encode, one per channel */
+                      int len,                      /* (i) samples per channel */
+                      int channels);                /* (i) number of channels */
+
 ilbc_decode_state_t *ilbc_decode_init(ilbc_decode_state_t *s,   /* (i/o) Decoder instance */
                                       int mode,                 /* (i) frame size mode */
-                                      int use_enhancer);        /* (i) 1 to use enhancer
-                                                                       0 to run without enhancer */
+                                      int use_enhancer);        /* (i) ILBC_ENHANCER_xxx */
+
+/*! Put a decoder back as ilbc_decode_init() left it, with the same frame
+    size mode and enhancer, for a new call. A compact decoder stays compact,
+    and the counters are kept.
+    \return s. */
+ilbc_decode_state_t *ilbc_decode_reset(ilbc_decode_state_t *s); /* (i/o) Decoder instance */
+
+/*! Change the frame size mode of a decoder, without starting it again.
+    Its filter memories, LSF history, concealment history and enhancer
+    buffer carry on into the next frame. The enhancer holds back 40
+    samples more in 30ms mode than in 20ms mode, so a change with the
+    enhancer on stretches or shrinks what it holds by a 5ms crossfade,
+    which is far less audible than starting again.
+    \return 0 for OK, or -1 for a bad mode. */
+int ilbc_decode_set_mode(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                         int mode);                 /* (i) the new frame size mode, 20 or 30 */
+
+/*! Find how much memory ilbc_decode_init_at() needs for a decoder. This
+    allows for aligning the state, wherever the memory is.
+    \return The size, in bytes. */
+size_t ilbc_decode_state_size(void);
+
+/*! Initialise a decoder in a block of memory supplied by the caller, which
+    may have any alignment. The state is placed at the first point in the
+    block aligned to ILBC_STATE_ALIGNMENT bytes.
+    \return The decoder, or NULL for a bad mode. */
+ilbc_decode_state_t *ilbc_decode_init_at(void *mem,             /* (i/o) at least ilbc_decode_state_size() bytes */
+                                         int mode,              /* (i) frame size mode */
+                                         int use_enhancer);     /* (i) ILBC_ENHANCER_xxx */
+
+/*! Allocate and initialise a decoder, aligned to ILBC_STATE_ALIGNMENT bytes.
+    \return The decoder, or NULL for a bad mode or no memory. */
+ilbc_decode_state_t *ilbc_decode_alloc(int mode,                /* (i) frame size mode */
+                                       int use_enhancer);       /* (i) ILBC_ENHANCER_xxx */
+
+/*! Find how much memory ilbc_decode_init_compact_at() needs for a compact
+    decoder. A compact decoder has only the state every frame needs. It
+    always runs with ILBC_ENHANCER_OFF, and has no room for the enhancer's
+    state, which is most of a decoder, nor for the buffers of
+    ilbc_decode_stream(), ilbc_decode_resampled() at rates above 8000, and
+    ilbc_decode_cng(), which fail on it. Repeated frames are decoded in full.
+    This suits large numbers of mostly idle streams. A compact decoder can
+    not be copied by value, nor take an ilbc_decode_state_import() of a
+    decoder using the enhancer or holding streamed samples.
+    \return The size, in bytes. */
+size_t ilbc_decode_compact_size(void);
+
+/*! Initialise a compact decoder in a block of memory supplied by the
+    caller, as for ilbc_decode_init_at().
+    \return The decoder, or NULL for a bad mode. */
+ilbc_decode_state_t *ilbc_decode_init_compact_at(void *mem,     /* (i/o) at least ilbc_decode_compact_size() bytes */
+                                                 int mode);     /* (i) frame size mode */
+
+/*! Allocate and initialise a compact decoder, which is freed by
+    ilbc_decode_free().
+    \return The decoder, or NULL for a bad mode or no memory. */
+ilbc_decode_state_t *ilbc_decode_alloc_compact(int mode);       /* (i) frame size mode */
+
+/*! Free a decoder from ilbc_decode_alloc(). */
+void ilbc_decode_free(ilbc_decode_state_t *s);
+
+/* Flags for ilbc_bank_alloc() */
+#define ILBC_BANK_HUGE_PAGES    0x01    /* back the bank with huge pages, where the system has them */
+
+/*! Allocate a bank of memory for many codec states, to be set up with
+    ilbc_encode_init_at(), ilbc_decode_init_at() or
+    ilbc_decode_init_compact_at(), each ilbc_xxx_state_size() bytes on from
+    the last. The whole bank is written by the calling thread before it is
+    returned. On a NUMA system, with the usual first touch policy, the bank
+    is therefore on the memory node of the CPU the caller runs on, so it
+    should be allocated by a thread bound to the node whose workers will
+    use the states. With ILBC_BANK_HUGE_PAGES, the bank is put in huge
+    pages if any are free, or else marked for transparent huge pages.
+    \return The bank, aligned to ILBC_STATE_ALIGNMENT bytes, or NULL for
+            no memory. */
+void *ilbc_bank_alloc(size_t len,                               /* (i) size of the bank, in bytes */
+                      int flags);                               /* (i) ILBC_BANK_xxx */
+
+/*! Free a bank from ilbc_bank_alloc(). The states in it need no other
+    freeing. */
+void ilbc_bank_free(void *bank);
 
 int ilbc_decode(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
                 int16_t amp[],              /* (o) decoded signal block */
                 const uint8_t bytes[],      /* (i) encoded signal bits */
                 int len);
 
+/*! Conceal a burst of lost frames, as many as len bytes would have held,
+    in one call. The pitch and periodicity found for the first lost frame
+    of a burst are reused for the rest of it.
+    \return The number of samples produced. */
 int ilbc_fillin(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
                 int16_t amp[],              /* (o) decoded signal block */
-                int len);
+                int len);                   /* (i) number of bytes the lost frames would have used */
+
+/*! Decode the same span of frames for a set of independent channels. The
+    synthesis and output high pass filters run for several channels at once,
+    which is faster than separate calls to ilbc_decode(). Channels whose
+    frames were lost, and channels using the enhancer, are decoded one at a
+    time, as ilbc_decode() and ilbc_fillin() would. The output is the same
+    as decoding each channel separately. All the channels must use the same
+    frame size mode.
+    \return The number of samples produced for each channel, or -1 if the
+            channels' modes do not match. */
+int ilbc_decode_batch(ilbc_decode_state_t *s[],    /* (i/o) the decoder states, one per channel */
+                      int16_t *amp[],               /* (o) decoded signals, one buffer per channel */
+                      const uint8_t *bytes[],       /* (i) encoded signal bits, one buffer per channel,
+                                                           or NULL for a channel whose frames were lost */
+                      int len,                      /* (i) number of bytes per channel */
+                      int channels);                /* (i) number of channels */
+
+/*! Decode a frame in two stages, which may run on different threads. The
+    first, ilbc_decode_parse(), unpacks and checks the frame, and
+    dequantizes its LSFs. It needs no decoder, so it can be run as each
+    packet arrives, and frames which would only be concealed can be found
+    before they take up any time in synthesis.
+    \return 1 if the frame can be decoded, 0 if it is empty or corrupt, or
+            -1 if len is not the length of one frame. */
+int ilbc_decode_parse(ilbc_frame_params_t *params,  /* (o) the checked parameters */
+                      const uint8_t bytes[],        /* (i) one encoded frame */
+                      int len);                     /* (i) number of bytes */
+
+/*! The second stage of decoding a frame: synthesis from the parameters
+    ilbc_decode_parse() found. Pass NULL, or parameters which are not
+    valid, to conceal the frame. Parsing and then synthesising gives
+    exactly what ilbc_decode() gives.
+    \return The number of samples produced, or -1 if the parameters are for
+            the other frame size mode. */
+int ilbc_decode_synth(ilbc_decode_state_t *s,          /* (i/o) the decoder state structure */
+                      int16_t amp[],                    /* (o) decoded signal block */
+                      const ilbc_frame_params_t *params);   /* (i) the frame, or NULL to conceal */
+
+/*! Find the size of the working space ilbc_decode_ex() and ilbc_fillin_ex()
+    need.
+    \return The size, in bytes. */
+size_t ilbc_decode_scratch_size(void);
+
+/*! Decode, as ilbc_decode(), but keep all the working data in a scratch
+    area supplied by the caller. The scratch area must be at least
+    ilbc_decode_scratch_size() bytes long, and aligned at least as strictly
+    as a float. Nothing is kept in it from one call to the next.
+    \return The number of samples produced. */
+int ilbc_decode_ex(ilbc_decode_state_t *s,      /* (i/o) the decoder state structure */
+                   int16_t amp[],               /* (o) decoded signal block */
+                   const uint8_t bytes[],       /* (i) encoded signal bits */
+                   int len,                     /* (i) number of bytes */
+                   void *scratch);              /* (i/o) working space */
+
+/*! Conceal lost frames, as ilbc_fillin(), but keep all the working data in
+    a scratch area supplied by the caller, as for ilbc_decode_ex().
+    \return The number of samples produced. */
+int ilbc_fillin_ex(ilbc_decode_state_t *s,      /* (i/o) the decoder state structure */
+                   int16_t amp[],               /* (o) decoded signal block */
+                   int len,                     /* (i) number of bytes the lost frames would have used */
+                   void *scratch);              /* (i/o) working space */
+
+/*! Decode, as ilbc_decode(), or conceal, as ilbc_fillin() when bytes is
+    NULL, giving speech at 16, 32 or 48kHz, or at 8kHz. Each frame is
+    interpolated to the rate straight after it is decoded, while it is still
+    in the cache, with no separate resampling step. The
+    interpolator's history stays in the state between calls, is cleared
+    when the rate changes, and is not kept by ilbc_decode_state_export() or
+    ilbc_decode_checkpoint().
+    \return The number of samples produced, at rate, or -1 if the rate is
+            not one of these, len is not a whole number of frames, or
+            the rate is above 8000 for a compact decoder. */
+int ilbc_decode_resampled(ilbc_decode_state_t *s, /* (i/o) the decoder state structure */
+                          int16_t amp[],          /* (o) decoded signal, at rate */
+                          const uint8_t bytes[],  /* (i) encoded signal bits, or NULL to conceal */
+                          int len,                /* (i) number of bytes, or that the lost frames
+                                                         would have used */
+                          int rate);              /* (i) sample rate, in samples per second */
+
+/*! Decode, or conceal when bytes is NULL, and add the signal, times gain,
+    into a conference mix, as the frames are decoded. This saves storing
+    each leg as int16 and reading it back to mix it. The signal has the
+    scale of ilbc_decode_float(), with no rounding or saturation, so the
+    mix is clamped once, by the caller, when all the legs are in.
+    \return The number of samples added into bus, or -1 if len is not a
+            whole number of frames. */
+int ilbc_decode_mix(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                    float bus[],             /* (i/o) the mix the decoded signal is added into */
+                    const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                    int len,                 /* (i) number of bytes, or that the lost frames
+                                                    would have used */
+                    float gain);             /* (i) gain applied to the decoded signal */
+
+/*! Decode, or conceal when bytes is NULL, as ilbc_decode() or ilbc_fillin(),
+    and report what was found for each frame: its pitch, filters and level.
+    \return The number of samples produced, or -1 if len is not a whole
+            number of frames. */
+int ilbc_decode_info(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                     int16_t amp[],              /* (o) decoded signal block */
+                     const uint8_t bytes[],      /* (i) encoded signal bits, or NULL to conceal */
+                     int len,                    /* (i) number of bytes, or that the lost frames
+                                                        would have used */
+                     ilbc_decode_info_t info[]); /* (o) side information, one per frame */
+
+/*! Decode, or conceal when bytes is NULL, into one channel of interleaved
+    multi-channel audio. The samples are written straight into place as
+    they are rounded and clamped, so there is no need to interleave them
+    afterwards. The other channels' samples are left alone.
+    \return The number of samples produced for the channel, or -1 if len
+            is not a whole number of frames. */
+int ilbc_decode_strided(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                        int16_t amp[],           /* (o) where the channel's first sample goes */
+                        int stride,              /* (i) distance between the channel's samples, in samples */
+                        const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                        int len);                /* (i) number of bytes, or that the lost frames
+                                                        would have used */
+
+/*! Decode a burst of frames from a jitter buffer, some of which may have
+    been lost, in one call. The frames are given by pointer, with NULL for
+    each lost one, and lost frames are concealed as by ilbc_fillin().
+    \return The number of samples produced. */
+int ilbc_decode_frames(ilbc_decode_state_t *s,      /* (i/o) the decoder state structure */
+                       int16_t amp[],               /* (o) decoded signal */
+                       const uint8_t *const frames[],   /* (i) the frames, with NULL for each lost one */
+                       int n,                       /* (i) number of frames */
+                       uint32_t *lost);             /* (o) if not NULL, bit n is set if frame n was
+                                                           concealed, whether it was lost or found to
+                                                           be corrupt. Only the first 32 frames are
+                                                           reported. */
+
+/*! Decode a burst of frames, as ilbc_decode_frames(), but with the frames
+    which arrived packed one after another in bytes, and the lost ones
+    marked in a bit mask. Only the first 32 frames can be marked as lost.
+    \return The number of samples produced. */
+int ilbc_decode_frames_masked(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                              int16_t amp[],            /* (o) decoded signal */
+                              const uint8_t bytes[],    /* (i) the frames received, one after another */
+                              int n,                    /* (i) number of frames, received and lost */
+                              uint32_t loss_mask,       /* (i) bit n set if frame n was lost */
+                              uint32_t *lost);          /* (o) frames which were concealed, as for
+                                                           ilbc_decode_frames(), or NULL */
+
+/*! Decode, as ilbc_decode(), but give the signal as floats, with no rounding
+    or saturation. The scale matches ilbc_decode(), so full scale is about
+    +-32768, but peaks may go beyond that.
+    \return The number of samples produced. */
+int ilbc_decode_float(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      float amp[],              /* (o) decoded signal block */
+                      const uint8_t bytes[],    /* (i) encoded signal bits */
+                      int len);                 /* (i) number of bytes */
+
+/*! Conceal lost frames, as ilbc_fillin(), but give the signal as floats, as
+    for ilbc_decode_float().
+    \return The number of samples produced. */
+int ilbc_fillin_float(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      float amp[],              /* (o) decoded signal block */
+                      int len);                 /* (i) number of bytes the lost frames would have used */
+
+/*! Decode to any number of samples. Samples left over from the last call
+    are given first. Then as many whole frames as are needed are taken from
+    bytes, and decoded. Those needed in full go straight into amp, and the
+    unused part of the last one is kept for the next call. If bytes is NULL,
+    frames are concealed instead, as by ilbc_fillin(). ilbc_decode() and
+    ilbc_fillin() do not use the samples held back, so mixing them with this
+    puts samples out of order.
+    \return The number of samples produced. This is short of the number
+            wanted only if bytes runs out of whole frames. For a compact
+            decoder it is -1. */
+int ilbc_decode_stream(ilbc_decode_state_t *s,  /* (i/o) the decoder state structure */
+                       int16_t amp[],           /* (o) decoded signal */
+                       int samples,             /* (i) number of samples wanted, which may be any number */
+                       const uint8_t bytes[],   /* (i) encoded signal bits, or NULL to conceal */
+                       int len,                 /* (i) number of bytes */
+                       int *used);              /* (o) number of bytes used, or NULL */
+
+/*! Find how many decoded samples ilbc_decode_stream() is holding back.
+    \return The number of samples. */
+int ilbc_decode_stream_pending(ilbc_decode_state_t *s);    /* (i) the decoder state structure */
+
+/*! Decode, as ilbc_decode(), straight to G.711 A-law. The codes are exactly
+    those a separate linear to A-law conversion of ilbc_decode()'s output
+    would give.
+    \return The number of samples produced. */
+int ilbc_decode_alaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t alaw[],            /* (o) decoded signal block, as A-law */
+                     const uint8_t bytes[],     /* (i) encoded signal bits */
+                     int len);                  /* (i) number of bytes */
+
+/*! Decode, as ilbc_decode(), straight to G.711 u-law.
+    \return The number of samples produced. */
+int ilbc_decode_ulaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t ulaw[],            /* (o) decoded signal block, as u-law */
+                     const uint8_t bytes[],     /* (i) encoded signal bits */
+                     int len);                  /* (i) number of bytes */
+
+/*! Conceal lost frames, as ilbc_fillin(), straight to G.711 A-law.
+    \return The number of samples produced. */
+int ilbc_fillin_alaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t alaw[],            /* (o) decoded signal block, as A-law */
+                     int len);                  /* (i) number of bytes the lost frames would have used */
+
+/*! Conceal lost frames, as ilbc_fillin(), straight to G.711 u-law.
+    \return The number of samples produced. */
+int ilbc_fillin_ulaw(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     uint8_t ulaw[],            /* (o) decoded signal block, as u-law */
+                     int len);                  /* (i) number of bytes the lost frames would have used */
+
+/*! Find the frame size mode of an RTP payload from its length, which is a
+    whole number of 38 byte (20ms) or 50 byte (30ms) frames (RFC 3952). A
+    length which is a whole number of both, such as 950 bytes, is taken as
+    the preferred mode, if that is one of them.
+    \return 20 or 30, or -1 if the length does not suit either mode. */
+int ilbc_payload_mode(int len,                  /* (i) payload length, in bytes */
+                      int mode);                /* (i) the mode to choose if the length suits both */
+
+/*! Decode an RTP payload (RFC 3952) of one or more frames. The frame size
+    is found from the payload length, preferring the decoder's current
+    mode. If it differs from the current mode, the decoder is switched to
+    the new one by ilbc_decode_set_mode(). Frames
+    marked as empty, or found to be corrupt, are concealed. A payload of
+    NULL means the packet was lost, and all len bytes worth of frames are
+    concealed.
+    \return The number of samples produced, or -1 if the length does not
+            suit either mode, or the frames would not fit in amp. */
+int ilbc_decode_payload(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                        int16_t amp[],              /* (o) decoded signal */
+                        int max_samples,            /* (i) room in amp, in samples */
+                        const uint8_t payload[],    /* (i) the payload, or NULL for a lost packet */
+                        int len,                    /* (i) payload length, in bytes */
+                        uint32_t *lost);            /* (o) if not NULL, bit n is set if frame n was
+                                                           concealed. Only the first 32 frames are
+                                                           reported. */
+
+/*! Look at a frame without decoding it, to judge how active the speaker
+    is, as a conference bridge might to choose which legs to mix. Only a
+    few bits of the frame are read. The start state holds the part of the
+    frame's excitation with the most energy, so its peak follows the
+    speech level, though it leaves out the gain of the synthesis filter.
+    This needs no decoder. Frames which are not mixed should still be
+    passed to their decoder, or its history goes stale.
+    \return 0 for OK, or -1 if len is not the length of one frame. */
+int ilbc_frame_info(const uint8_t bytes[],          /* (i) one encoded frame */
+                    int len,                        /* (i) number of bytes */
+                    ilbc_frame_info_t *info);       /* (o) what was found */
+
+/*! Decode, or conceal, one frame, and then shorten or lengthen it by one
+    pitch period, as a jitter buffer needs to drain or fill. The period is
+    the one the decoder has just found for its enhancer or concealment,
+    refined a little against the decoded signal. The two periods
+    either side of the join are cross faded. The frame is left unchanged if
+    it is not periodic enough, or its period does not fit in it twice, so
+    20ms frames can only be changed for periods of up to 80 samples.
+    \return The number of samples produced, which is the frame length, one
+            period less or one period more, or -1 if len is not one frame. */
+int ilbc_decode_tsm(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                    int16_t amp[],              /* (o) decoded signal, with room for two frames */
+                    const uint8_t bytes[],      /* (i) one frame of encoded signal bits, or NULL to conceal */
+                    int len,                    /* (i) number of bytes */
+                    int action);                /* (i) ILBC_TSM_NORMAL, ILBC_TSM_ACCELERATE or ILBC_TSM_EXPAND */
+
+/*! Make one frame of comfort noise, shaped and scaled as a SID (RFC 3389)
+    asks, such as one from ilbc_encode_dtx(). The noise comes from the same
+    random sequence as the packet loss concealment, and moves smoothly to
+    a new level over a frame. Pass NULL for the frames between SIDs. The
+    speech decoding state is left alone, just as the encoder leaves its
+    own during silence, so the two carry on together when speech starts
+    again.
+    \return The number of samples produced, or -1 for a bad SID or a
+            compact decoder. */
+int ilbc_decode_cng(ilbc_decode_state_t *s,     /* (i/o) the decoder state structure */
+                    int16_t amp[],              /* (o) a frame of comfort noise */
+                    const uint8_t sid[],        /* (i) a SID, or NULL to carry on with the last one */
+                    int len);                   /* (i) length of the SID, in bytes */
+
+/*! Save what the next frame will change in a decoder, so that it can be
+    undone by ilbc_decode_rewind(). This lets a frame be concealed in
+    advance, and then decoded properly if the packet turns up late. Only
+    the parts one frame changes are copied, which for a 30ms decoder with
+    the enhancer is a little over half the state, and less without the
+    enhancer. The samples held by ilbc_decode_stream() are not saved. */
+void ilbc_decode_checkpoint(const ilbc_decode_state_t *s,   /* (i) the decoder state structure */
+                            ilbc_decode_checkpoint_t *cp);  /* (o) the checkpoint */
+
+/*! Put a decoder back as it was at ilbc_decode_checkpoint(), undoing the
+    one frame decoded or concealed since then.
+    \return 0 for OK, or -1 if the decoder is not just one frame on from
+            the checkpoint, in which case it is left alone. */
+int ilbc_decode_rewind(ilbc_decode_state_t *s,              /* (i/o) the decoder state structure */
+                       const ilbc_decode_checkpoint_t *cp); /* (i) the checkpoint */
+
+/*! Export an encoder's state, so it can carry on somewhere else, perhaps on
+    another machine, from ilbc_encode_state_import(). The export is
+    versioned, and has the same byte order on every machine. Only the
+    fields which are not set by the frame size mode are exported. With
+    ILBC_EXPORT_QUANTISED, the signal history is quantised to 16 bits,
+    which makes the export about half the size, and the next few frames a
+    little different.
+    \return The length of the export, or -1 if it does not fit in len bytes.
+            If buf is NULL, the length it would need. */
+int ilbc_encode_state_export(const ilbc_encode_state_t *s,  /* (i) the encoder state structure */
+                             uint8_t buf[],                 /* (o) the exported state, or NULL */
+                             int len,                       /* (i) room in buf, in bytes */
+                             int flags);                    /* (i) ILBC_EXPORT_xxx */
+
+/*! Set up an encoder from ilbc_encode_state_export(). s must already have
+    been initialised, as by ilbc_encode_alloc(), though perhaps for the other
+    frame size mode. It is left unchanged if the export is bad.
+    \return s, or NULL if the export is damaged, or from an unknown
+            version. */
+ilbc_encode_state_t *ilbc_encode_state_import(ilbc_encode_state_t *s,   /* (o) the encoder state structure */
+                                              const uint8_t buf[],      /* (i) the exported state */
+                                              int len);                 /* (i) length of buf, in bytes */
+
+/*! Build a seek index for a stored recording, held as frames one after
+    another, as in an RTP payload. The recording is decoded once, and the
+    decoder's state is exported every interval frames. With the index,
+    ilbc_decode_seek() can start anywhere, after decoding no more than
+    interval frames, and separate parts of one recording can be decoded in
+    parallel, each from its own checkpoint. ILBC_EXPORT_QUANTISED makes
+    each checkpoint about half the size, and the first frames after a
+    seek a little different from a full decode.
+    \return The length of the index, or -1 for bad parameters, or if it does
+            not fit in index_len bytes. If index is NULL, the length it
+            would need. */
+int ilbc_seek_index_build(uint8_t index[],          /* (o) the index, or NULL */
+                          int index_len,            /* (i) room in index, in bytes */
+                          const uint8_t bytes[],    /* (i) the recording, frames one after another */
+                          int len,                  /* (i) length of the recording, in bytes */
+                          int mode,                 /* (i) frame size mode */
+                          int use_enhancer,         /* (i) ILBC_ENHANCER_xxx */
+                          int interval,             /* (i) frames between checkpoints */
+                          int flags);               /* (i) ILBC_EXPORT_xxx */
+
+/*! Set a decoder up to decode a stored recording from the given frame. With
+    a seek index, from ilbc_seek_index_build() with the same frame size
+    mode, the nearest checkpoint at or before the frame is restored, and
+    the frames from there on are decoded, so the result is just what
+    decoding from the start would give. Without an index, the decoder is
+    reset, and only the warmup frames before the frame are decoded, which
+    quickly gets close to, but not exactly, the same result.
+    \return The number of frames decoded to get there, or -1 for a bad
+            frame, or an index which is damaged or for the other mode. */
+int ilbc_decode_seek(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     const uint8_t bytes[],     /* (i) the recording, frames one after another */
+                     int len,                   /* (i) length of the recording, in bytes */
+                     int frame,                 /* (i) the frame to be decoded next */
+                     const uint8_t index[],     /* (i) the recording's seek index, or NULL */
+                     int index_len,             /* (i) length of the index, in bytes */
+                     int warmup);               /* (i) frames to decode first, without an index */
+
+/*! Get a fingerprint of the parts of an encoder's state which decide how it
+    codes the next speech. Encoders with the same fingerprint, given the same
+    speech, give the same bytes. For fan-out, where many listeners get the
+    same mix, one shared encoder codes it once for all of them. A listener
+    joining late can take the shared stream from the next frame, as iLBC
+    frames decode without the encoder's history. A listener whose input
+    moves away from the shared mix, as for mix-minus, gets a private copy
+    from ilbc_encode_clone(), so its stream carries on without a break.
+    When it goes back to the shared mix, keep running the private encoder
+    on it until the fingerprints match, which takes a few frames as the
+    filters forget the difference, and then drop it.
+    \return The fingerprint. */
+uint32_t ilbc_encode_fingerprint(const ilbc_encode_state_t *s);  /* (i) the encoder state structure */
+
+/*! Make dst carry on exactly as src would, for a listener which leaves a
+    shared encoder. dst must already have been initialised, and keeps its
+    own counters.
+    \return dst. */
+ilbc_encode_state_t *ilbc_encode_clone(ilbc_encode_state_t *dst,          /* (o) the new encoder */
+                                       const ilbc_encode_state_t *src);   /* (i) the encoder to copy */
+
+/*! Export a decoder's state, as ilbc_encode_state_export() does for an
+    encoder. The enhancer's history is left out if it is not in use.
+    \return The length of the export, or -1 if it does not fit in len bytes.
+            If buf is NULL, the length it would need. */
+int ilbc_decode_state_export(const ilbc_decode_state_t *s,  /* (i) the decoder state structure */
+                             uint8_t buf[],                 /* (o) the exported state, or NULL */
+                             int len,                       /* (i) room in buf, in bytes */
+                             int flags);                    /* (i) ILBC_EXPORT_xxx */
+
+/*! Set up a decoder from ilbc_decode_state_export(). s must already have
+    been initialised, as by ilbc_decode_alloc(), though perhaps for the other
+    frame size mode. It is left unchanged if the export is bad.
+    \return s, or NULL if the export is damaged, or from an unknown
+            version. */
+ilbc_decode_state_t *ilbc_decode_state_import(ilbc_decode_state_t *s,   /* (o) the decoder state structure */
+                                              const uint8_t buf[],      /* (i) the exported state */
+                                              int len);                 /* (i) length of buf, in bytes */
+
+/*! Read an encoder's counters, and perhaps zero them. Reading them is
+    cheap, and may be done often.
+    \return 0 for OK, or -1 if the library was built without --enable-stats,
+            in which case the counters are all zero. */
+int ilbc_encode_stats(ilbc_encode_state_t *s,   /* (i/o) the encoder state structure */
+                      ilbc_stats_t *stats,      /* (o) the counters */
+                      int reset);               /* (i) 1 to zero the counters after reading them */
+
+/*! Read a decoder's counters, and perhaps zero them.
+    \return 0 for OK, or -1 if the library was built without --enable-stats,
+            in which case the counters are all zero. */
+int ilbc_decode_stats(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      ilbc_stats_t *stats,      /* (o) the counters */
+                      int reset);               /* (i) 1 to zero the counters after reading them */
+
+/*! Get the name of a stage of the codec.
+    \return The name, or NULL for a bad stage. */
+const char *ilbc_profile_name(int stage);       /* (i) ILBC_PROF_xxx */
+
+/*! Read the most stack each entry point has used, and perhaps zero the
+    marks. Each mark runs from the entry point's own frame to the deepest
+    point its callees reached, so it includes any working space the entry
+    point keeps on the stack. The stack below each call is painted first,
+    which is slow, so this is for sizing threads and fibers, not for use in
+    service. The marks are shared by all threads, but each thread paints and
+    measures its own stack.
+    \return 0 for OK, or -1 if the library was built without
+            --enable-stack-watch, in which case the marks are all zero. */
+int ilbc_stack_high_water(size_t marks[ILBC_STACK_ENTRIES], /* (o) bytes used by each entry point, ILBC_STACK_xxx */
+                          int reset);       /* (i) 1 to zero the marks after reading them */
+
+/*! Get the name of an entry point whose stack use is recorded.
+    \return The name, or NULL for a bad entry point. */
+const char *ilbc_stack_name(int entry);     /* (i) ILBC_STACK_xxx */
+
+/*! Find which tier of vector kernels the library is using. This is the
+    best the CPU supports, unless the ILBC_CPU_TIER environment variable
+    names a lower one ("scalar", "sse2", "avx2", "avx512" or "neon") when
+    the library first looks. A tier the CPU does not support is never
+    used.
+    \return ILBC_CPU_xxx */
+int ilbc_cpu_tier(void);
+
+/*! Get the name of a tier of vector kernels, as ILBC_CPU_TIER takes it.
+    \return The name, or NULL for a bad tier. */
+const char *ilbc_cpu_tier_name(int tier);       /* (i) ILBC_CPU_xxx */
 
 #endif
 
 
+#if defined(__cplusplus)
+}
+#endif
+
 #endif
 /*- End of file ------------------------------------------------------------*/
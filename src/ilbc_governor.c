@@ -0,0 +1,337 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_governor.c - Keep many encoders within a CPU budget, by moving
+ *                   channels between complexity levels.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(WIN32)  ||  defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "ilbc2.h"
+#include "ilbc_governor.h"
+
+/* A tick using more than this fraction of the budget is an overload */
+#define GOV_HIGH_MARK       0.95
+/* The fraction of the budget the governor steers for */
+#define GOV_TARGET          0.85
+/* Quality is only given back after this many ticks in a row below this
+   fraction of the budget */
+#define GOV_LOW_MARK        0.70
+#define GOV_CALM_TICKS      25
+/* Until a level's cost has been measured, a step down is taken to save
+   less than any measured step does, and a step up to cost more */
+#define GOV_GUESS_DOWN      0.98
+#define GOV_GUESS_UP        1.20
+
+
+typedef struct
+{
+    ilbc_encode_state_t *enc;
+    int important;
+    /* Charged since the last tick */
+    uint64_t ns;
+    int frames;
+    /* Frames in the last completed tick */
+    int tick_frames;
+    /* Smoothed cost of a frame at the current level, or 0 if not yet known */
+    double frame_ns;
+    /* Set once the channel's level has been changed in this tick */
+    int stepped;
+} gov_channel_t;
+
+struct ilbc_governor_s
+{
+    uint64_t budget_ns;
+    uint64_t last_ns;
+    int calm;
+    int max_channels;
+    int channels;
+    gov_channel_t *channel;
+    /* Smoothed cost of a sample at each complexity level, measured over all
+       the channels, or 0 if not yet known */
+    double level_ns[ILBC_COMPLEXITY_LOWEST + 1];
+};
+
+static uint64_t now_ns(void)
+{
+#if defined(WIN32)  ||  defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t) ((double) count.QuadPart*1.0e9/(double) freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* Whether the costs of both levels have been measured */
+static int level_known(const ilbc_governor_t *g, int from, int to)
+{
+    return g->level_ns[from] > 0.0  &&  g->level_ns[to] > 0.0;
+}
+
+/* The expected cost of a channel's frames at another level, relative to
+   its current one. Until both levels have been seen in use, guess on the
+   safe side. The measured times correct this over the following ticks. */
+static double level_ratio(const ilbc_governor_t *g, int from, int to)
+{
+    if (!level_known(g, from, to))
+        return (to > from)  ?  GOV_GUESS_DOWN  :  GOV_GUESS_UP;
+    return g->level_ns[to]/g->level_ns[from];
+}
+
+/* Move a channel one level, scaling its cost by the expected change.
+   Return the expected change in its cost over a tick like the last. */
+static double step(ilbc_governor_t *g, gov_channel_t *c, int dir)
+{
+    int level;
+    double old_ns;
+
+    level = c->enc->complexity;
+    old_ns = c->frame_ns;
+    ilbc_encode_set_complexity(c->enc, level + dir);
+    c->frame_ns *= level_ratio(g, level, level + dir);
+    c->stepped = 1;
+    return (c->frame_ns - old_ns)*c->tick_frames;
+}
+
+/* Degrade channels until the expected saving reaches excess. The channels
+   which are not important go first, and within each group the channels
+   at the best level go first. If any of the steps taken so far had to be
+   guessed, the important channels are left alone until the next tick has
+   shown what those steps really saved. */
+static int degrade(ilbc_governor_t *g, double excess)
+{
+    gov_channel_t *c;
+    int important;
+    int guessed;
+    int level;
+    int changed;
+    int i;
+
+    changed = 0;
+    guessed = 0;
+    if (excess <= 0.0)
+        return 0;
+    for (important = 0;  important <= 1;  important++)
+    {
+        if (important  &&  guessed)
+            return changed;
+        for (level = ILBC_COMPLEXITY_FULL;  level < ILBC_COMPLEXITY_LOWEST;  level++)
+        {
+            for (i = 0;  i < g->channels;  i++)
+            {
+                c = &g->channel[i];
+                if (c->important != important  ||  c->enc->complexity != level  ||  c->tick_frames == 0  ||  c->stepped)
+                    continue;
+                if (!level_known(g, level, level + 1))
+                    guessed = 1;
+                excess += step(g, c, 1);
+                changed++;
+                if (excess <= 0.0)
+                    return changed;
+            }
+        }
+    }
+    return changed;
+}
+
+/* Restore channels while the expected cost fits in room. The important
+   channels go first, and within each group the channels at the worst
+   level go first. */
+static int restore(ilbc_governor_t *g, double room)
+{
+    gov_channel_t *c;
+    double cost;
+    int important;
+    int level;
+    int changed;
+    int i;
+
+    changed = 0;
+    for (important = 1;  important >= 0;  important--)
+    {
+        for (level = ILBC_COMPLEXITY_LOWEST;  level > ILBC_COMPLEXITY_FULL;  level--)
+        {
+            for (i = 0;  i < g->channels;  i++)
+            {
+                c = &g->channel[i];
+                if (c->important != important  ||  c->enc->complexity != level  ||  c->tick_frames == 0  ||  c->stepped)
+                    continue;
+                cost = c->frame_ns*c->tick_frames*(level_ratio(g, level, level - 1) - 1.0);
+                if (cost > room)
+                    return changed;
+                room -= step(g, c, -1);
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+ilbc_governor_t *ilbc_governor_create(int max_channels, uint64_t budget_ns)
+{
+    ilbc_governor_t *g;
+
+    if (max_channels <= 0  ||  budget_ns == 0)
+        return NULL;
+    if ((g = (ilbc_governor_t *) malloc(sizeof(*g))) == NULL)
+        return NULL;
+    memset(g, 0, sizeof(*g));
+    if ((g->channel = (gov_channel_t *) calloc(max_channels, sizeof(gov_channel_t))) == NULL)
+    {
+        free(g);
+        return NULL;
+    }
+    g->max_channels = max_channels;
+    g->budget_ns = budget_ns;
+    return g;
+}
+
+int ilbc_governor_set_budget(ilbc_governor_t *g, uint64_t budget_ns)
+{
+    if (budget_ns == 0)
+        return -1;
+    g->budget_ns = budget_ns;
+    return 0;
+}
+
+int ilbc_governor_add_channel(ilbc_governor_t *g, ilbc_encode_state_t *s, int important)
+{
+    gov_channel_t *c;
+
+    if (g->channels >= g->max_channels)
+        return -1;
+    c = &g->channel[g->channels];
+    memset(c, 0, sizeof(*c));
+    c->enc = s;
+    c->important = (important != 0);
+    return g->channels++;
+}
+
+int ilbc_governor_encode(ilbc_governor_t *g,
+                         int channel,
+                         uint8_t bytes[],
+                         const int16_t amp[],
+                         int len)
+{
+    gov_channel_t *c;
+    uint64_t t0;
+    int ret;
+
+    c = &g->channel[channel];
+    t0 = now_ns();
+    ret = ilbc_encode(c->enc, bytes, amp, len);
+    c->ns += now_ns() - t0;
+    c->frames += len/c->enc->blockl;
+    return ret;
+}
+
+void ilbc_governor_charge(ilbc_governor_t *g, int channel, int frames, uint64_t ns)
+{
+    g->channel[channel].ns += ns;
+    g->channel[channel].frames += frames;
+}
+
+int ilbc_governor_tick(ilbc_governor_t *g)
+{
+    gov_channel_t *c;
+    double level_used[ILBC_COMPLEXITY_LOWEST + 1];
+    double level_samples[ILBC_COMPLEXITY_LOWEST + 1];
+    double used;
+    double expected;
+    double frame_ns;
+    double sample_ns;
+    int level;
+    int i;
+
+    /* The time charged this tick decides whether to shed load, and how much.
+       Quality is only given back against the smoothed costs, so one quiet
+       tick does not undo the last overload. */
+    used = 0.0;
+    expected = 0.0;
+    memset(level_used, 0, sizeof(level_used));
+    memset(level_samples, 0, sizeof(level_samples));
+    for (i = 0;  i < g->channels;  i++)
+    {
+        c = &g->channel[i];
+        if (c->frames > 0)
+        {
+            used += (double) c->ns;
+            frame_ns = (double) c->ns/c->frames;
+            c->frame_ns = (c->frame_ns > 0.0)  ?  0.75*c->frame_ns + 0.25*frame_ns  :  frame_ns;
+            expected += c->frame_ns*c->frames;
+            level = c->enc->complexity;
+            level_used[level] += (double) c->ns;
+            level_samples[level] += (double) c->frames*c->enc->blockl;
+        }
+        c->tick_frames = c->frames;
+        c->ns = 0;
+        c->frames = 0;
+        c->stepped = 0;
+    }
+    g->last_ns = (uint64_t) used;
+    /* Learn what each level costs on this machine, from the channels using it */
+    for (level = ILBC_COMPLEXITY_FULL;  level <= ILBC_COMPLEXITY_LOWEST;  level++)
+    {
+        if (level_samples[level] > 0.0)
+        {
+            sample_ns = level_used[level]/level_samples[level];
+            g->level_ns[level] = (g->level_ns[level] > 0.0)  ?  0.75*g->level_ns[level] + 0.25*sample_ns  :  sample_ns;
+        }
+    }
+
+    if (used > GOV_HIGH_MARK*g->budget_ns)
+    {
+        g->calm = 0;
+        return degrade(g, used - GOV_TARGET*g->budget_ns);
+    }
+    if (used >= GOV_LOW_MARK*g->budget_ns)
+    {
+        g->calm = 0;
+        return 0;
+    }
+    if (++g->calm < GOV_CALM_TICKS)
+        return 0;
+    /* Give back one round of quality, then wait for the effect to show */
+    g->calm = 0;
+    return restore(g, GOV_TARGET*g->budget_ns - expected);
+}
+
+uint64_t ilbc_governor_load(const ilbc_governor_t *g)
+{
+    return g->last_ns;
+}
+
+void ilbc_governor_free(ilbc_governor_t *g)
+{
+    if (g == NULL)
+        return;
+    free(g->channel);
+    free(g);
+}
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,100 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_governor.h - Keep many encoders within a CPU budget, by moving
+ *                   channels between complexity levels.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#if !defined(_ILBC_GOVERNOR_H_)
+#define _ILBC_GOVERNOR_H_
+
+#include "ilbc2.h"
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*
+ * A governor watches how long a set of encoders takes over each tick (one
+ * frame time, or whatever period the caller works in), and compares that
+ * with a budget. When a tick runs over, it raises the complexity level of
+ * enough channels to bring the next tick back under the budget, moving any
+ * one channel by no more than a level in each tick. What each level costs
+ * is learned from the times charged to the channels using it. Until a level
+ * has been measured, a step to it is assumed to save very little, and the
+ * important channels are left alone in any tick where other channels took
+ * such a guessed step. Once the ticks have stayed well under the budget for
+ * a while, it lowers them again, a step at a time. The gap between the two
+ * thresholds, and the wait before giving quality back, stop channels
+ * flapping between levels.
+ *
+ * Channels marked as important are the last to be degraded, and the first
+ * to be restored. Otherwise the channels at the best level are degraded
+ * first, so the loss of quality is spread over all of them.
+ */
+
+typedef struct ilbc_governor_s ilbc_governor_t;
+
+/*! Create a governor.
+    \return The governor, or NULL for bad parameters or no memory. */
+ilbc_governor_t *ilbc_governor_create(int max_channels,     /* (i) most channels which will be added */
+                                      uint64_t budget_ns);  /* (i) CPU time the channels may use in each tick,
+                                                                   in nanoseconds, summed over all threads */
+
+/*! Change the budget. This takes effect at the next ilbc_governor_tick().
+    \return 0 for OK, or -1 for a bad budget. */
+int ilbc_governor_set_budget(ilbc_governor_t *g,            /* (i/o) the governor */
+                             uint64_t budget_ns);           /* (i) the new budget, in nanoseconds */
+
+/*! Put an encoder under the governor's control. Its complexity level is
+    left as it is until the governor first needs to change it.
+    \return The channel id, or -1 if the governor is full. */
+int ilbc_governor_add_channel(ilbc_governor_t *g,           /* (i/o) the governor */
+                              ilbc_encode_state_t *s,       /* (i/o) the encoder */
+                              int important);               /* (i) 1 to degrade this channel only as a last resort */
+
+/*! Encode, as ilbc_encode(), and charge the time taken to the channel.
+    Different channels may be encoded on different threads at the same
+    time, but not while ilbc_governor_tick() runs.
+    \return The number of bytes produced. */
+int ilbc_governor_encode(ilbc_governor_t *g,                /* (i/o) the governor */
+                         int channel,                       /* (i) the channel id */
+                         uint8_t bytes[],                   /* (o) encoded data bits iLBC */
+                         const int16_t amp[],               /* (i) speech vector to encode */
+                         int len);                          /* (i) number of samples */
+
+/*! Charge time to a channel, for frames encoded some other way, such as
+    by ilbc_encode_batch() or a scheduler job. The rules for threads are
+    those of ilbc_governor_encode(). */
+void ilbc_governor_charge(ilbc_governor_t *g,               /* (i/o) the governor */
+                          int channel,                      /* (i) the channel id */
+                          int frames,                       /* (i) frames encoded */
+                          uint64_t ns);                     /* (i) time taken, in nanoseconds */
+
+/*! End a tick. The time charged to the channels since the last tick is
+    compared with the budget, and complexity levels are changed if need be.
+    \return The number of channels whose level was changed. */
+int ilbc_governor_tick(ilbc_governor_t *g);                 /* (i/o) the governor */
+
+/*! Find the time charged in the last completed tick.
+    \return The time, in nanoseconds. */
+uint64_t ilbc_governor_load(const ilbc_governor_t *g);      /* (i) the governor */
+
+/*! Free a governor. The encoders are left at their current levels. */
+void ilbc_governor_free(ilbc_governor_t *g);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,253 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_profile.c - Timing of the codec's internal stages, for the
+ *                  benchmark program, and stack use of its entry points.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+/* On x86 the per instance statistics use the time stamp counter, which is
+   much cheaper to read than the OS's clock */
+#if defined(ILBC_STATS)  &&  (defined(__i386__)  ||  defined(__x86_64__))
+#define STATS_USE_TSC
+#include <x86intrin.h>
+#elif defined(ILBC_STATS)  &&  defined(_MSC_VER)  &&  (defined(_M_IX86)  ||  defined(_M_X64))
+#define STATS_USE_TSC
+#include <intrin.h>
+#endif
+#if defined(ILBC_PROFILE)  ||  (defined(ILBC_STATS)  &&  !defined(STATS_USE_TSC))
+#define NEED_NOW_NS
+#if defined(WIN32)  ||  defined(_WIN32)
+#include <windows.h>
+#endif
+#endif
+
+#include "ilbc2.h"
+#include "ilbc_profile.h"
+
+#if defined(ILBC_STACK_WATCH)
+/* How far below an entry point's frame the stack is painted. Deeper use is
+   reported as this much. */
+#define STACK_WATCH_WORDS       (128*1024/sizeof(uint32_t))
+#define STACK_WATCH_PAINT       0xDEADBEEFU
+
+#if defined(__GNUC__)
+#define STACK_WATCH_NOINLINE    __attribute__((noinline))
+#define STACK_WATCH_THREAD      __thread
+#elif defined(_MSC_VER)
+#define STACK_WATCH_NOINLINE    __declspec(noinline)
+#define STACK_WATCH_THREAD      __declspec(thread)
+#else
+#define STACK_WATCH_NOINLINE
+#define STACK_WATCH_THREAD
+#endif
+#endif
+
+static const char *stage_names[ILBC_PROF_STAGES] =
+{
+    "LPCencode",
+    "StateSearchW",
+    "iCBSearch",
+    "packing",
+    "decode",
+    "PLC",
+    "enhancer"
+};
+
+static const char *stack_names[ILBC_STACK_ENTRIES] =
+{
+    "ilbc_encode",
+    "ilbc_encode_ex",
+    "ilbc_encode_batch",
+    "ilbc_decode",
+    "ilbc_decode_ex",
+    "ilbc_fillin",
+    "ilbc_fillin_ex",
+    "ilbc_decode_batch"
+};
+
+#if defined(NEED_NOW_NS)
+static uint64_t now_ns(void)
+{
+#if defined(WIN32)  ||  defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (uint64_t) ((double) count.QuadPart*1.0e9/(double) freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+#endif
+
+#if defined(ILBC_PROFILE)
+uint64_t ilbc_profile_ns[ILBC_PROF_STAGES];
+
+uint64_t ilbc_profile_now(void)
+{
+    return now_ns();
+}
+#endif
+
+#if defined(ILBC_STATS)
+uint64_t ilbc_stats_ticks(void)
+{
+#if defined(STATS_USE_TSC)
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+#endif
+
+int ilbc_profile_read(uint64_t ns[ILBC_PROF_STAGES])
+{
+#if defined(ILBC_PROFILE)
+    memcpy(ns, ilbc_profile_ns, sizeof(ilbc_profile_ns));
+    return 0;
+#else
+    memset(ns, 0, ILBC_PROF_STAGES*sizeof(ns[0]));
+    return -1;
+#endif
+}
+
+void ilbc_profile_reset(void)
+{
+#if defined(ILBC_PROFILE)
+    memset(ilbc_profile_ns, 0, sizeof(ilbc_profile_ns));
+#endif
+}
+
+const char *ilbc_profile_name(int stage)
+{
+    if (stage < 0  ||  stage >= ILBC_PROF_STAGES)
+        return NULL;
+    return stage_names[stage];
+}
+
+#if defined(ILBC_STACK_WATCH)
+static size_t stack_marks[ILBC_STACK_ENTRIES];
+/* The entry point calls nested in this thread, and the painted region of the
+   outermost one */
+static STACK_WATCH_THREAD int stack_depth;
+static STACK_WATCH_THREAD uintptr_t stack_top;
+static STACK_WATCH_THREAD uintptr_t stack_bottom;
+
+/* The paint is laid in this function's own frame, which is just below the
+   entry point's, and where the entry point's callees will go */
+static STACK_WATCH_NOINLINE void stack_paint(void)
+{
+    volatile uint32_t paint[STACK_WATCH_WORDS];
+    size_t i;
+
+    for (i = 0;  i < STACK_WATCH_WORDS;  i++)
+        paint[i] = STACK_WATCH_PAINT;
+    stack_bottom = (uintptr_t) &paint[0];
+}
+
+void ilbc_stack_watch_start(uintptr_t top)
+{
+    if (stack_depth++ > 0)
+        return;
+    stack_top = top;
+    stack_paint();
+}
+
+void ilbc_stack_watch_stop(int entry)
+{
+    const volatile uint32_t *p;
+    size_t i;
+    size_t used;
+
+    if (--stack_depth > 0)
+        return;
+    /* The stack grows down, so the deepest use is the lowest word which is
+       no longer paint */
+    p = (const volatile uint32_t *) stack_bottom;
+    for (i = 0;  i < STACK_WATCH_WORDS;  i++)
+    {
+        if (p[i] != STACK_WATCH_PAINT)
+            break;
+    }
+    used = stack_top - (stack_bottom + i*sizeof(uint32_t));
+    if (used > stack_marks[entry])
+        stack_marks[entry] = used;
+}
+#endif
+
+int ilbc_stack_high_water(size_t marks[ILBC_STACK_ENTRIES], /* (o) bytes used by each entry point */
+                          int reset)        /* (i) 1 to zero the marks after reading them */
+{
+#if defined(ILBC_STACK_WATCH)
+    memcpy(marks, stack_marks, sizeof(stack_marks));
+    if (reset)
+        memset(stack_marks, 0, sizeof(stack_marks));
+    return 0;
+#else
+    (void) reset;
+    memset(marks, 0, ILBC_STACK_ENTRIES*sizeof(marks[0]));
+    return -1;
+#endif
+}
+
+const char *ilbc_stack_name(int entry)
+{
+    if (entry < 0  ||  entry >= ILBC_STACK_ENTRIES)
+        return NULL;
+    return stack_names[entry];
+}
+
+int ilbc_encode_stats(ilbc_encode_state_t *s,   /* (i/o) the encoder state structure */
+                      ilbc_stats_t *stats,      /* (o) the counters */
+                      int reset)                /* (i) 1 to zero the counters after reading them */
+{
+#if defined(ILBC_STATS)
+    *stats = s->stats;
+    if (reset)
+        memset(&s->stats, 0, sizeof(s->stats));
+    return 0;
+#else
+    (void) s;
+    (void) reset;
+    memset(stats, 0, sizeof(*stats));
+    return -1;
+#endif
+}
+
+int ilbc_decode_stats(ilbc_decode_state_t *s,   /* (i/o) the decoder state structure */
+                      ilbc_stats_t *stats,      /* (o) the counters */
+                      int reset)                /* (i) 1 to zero the counters after reading them */
+{
+#if defined(ILBC_STATS)
+    *stats = s->stats;
+    if (reset)
+        memset(&s->stats, 0, sizeof(s->stats));
+    return 0;
+#else
+    (void) s;
+    (void) reset;
+    memset(stats, 0, sizeof(*stats));
+    return -1;
+#endif
+}
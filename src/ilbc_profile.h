@@ -0,0 +1,98 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_profile.h - Timing of the codec's internal stages, for the
+ *                  benchmark program, and stack use of its entry points.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#if !defined(_ILBC_PROFILE_H_)
+#define _ILBC_PROFILE_H_
+
+/*
+ * With ILBC_PROFILE defined (configure --enable-profile) each stage's time
+ * is added to a global counter. The counters are shared by all codec
+ * instances, and are not updated atomically, so they are only meaningful
+ * when the codec is run from one thread, as the benchmark does.
+ *
+ * With ILBC_STATS defined (configure --enable-stats) each stage's time is
+ * also added to the counters in the state of the instance doing the work,
+ * along with the frame counts, for ilbc_encode_stats() and
+ * ilbc_decode_stats(). Without either, the macros compile to nothing.
+ */
+#if defined(ILBC_PROFILE)
+extern uint64_t ilbc_profile_ns[ILBC_PROF_STAGES];
+
+uint64_t ilbc_profile_now(void);
+
+#define ILBC_PROFILE_GLOBAL_START(stage)    ilbc_profile_ns[stage] -= ilbc_profile_now()
+#define ILBC_PROFILE_GLOBAL_STOP(stage)     ilbc_profile_ns[stage] += ilbc_profile_now()
+#else
+#define ILBC_PROFILE_GLOBAL_START(stage)    do { } while (0)
+#define ILBC_PROFILE_GLOBAL_STOP(stage)     do { } while (0)
+#endif
+
+#if defined(ILBC_STATS)
+uint64_t ilbc_stats_ticks(void);
+
+#define ILBC_STATS_START(s, stage)          (s)->stats.ticks[stage] -= ilbc_stats_ticks()
+#define ILBC_STATS_STOP(s, stage)           (s)->stats.ticks[stage] += ilbc_stats_ticks()
+#define ILBC_STATS_COUNT(s, field)          (s)->stats.field++
+/* For work done for several instances together, which is shared among them */
+#define ILBC_STATS_SHARED_START(t)          (t) = ilbc_stats_ticks()
+#define ILBC_STATS_SHARED_STOP(t, n)        (t) = (ilbc_stats_ticks() - (t))/(n)
+#define ILBC_STATS_ADD(s, stage, t)         (s)->stats.ticks[stage] += (t)
+#else
+#define ILBC_STATS_START(s, stage)          do { } while (0)
+#define ILBC_STATS_STOP(s, stage)           do { } while (0)
+#define ILBC_STATS_COUNT(s, field)          do { } while (0)
+#define ILBC_STATS_SHARED_START(t)          do { } while (0)
+#define ILBC_STATS_SHARED_STOP(t, n)        do { } while (0)
+#define ILBC_STATS_ADD(s, stage, t)         do { } while (0)
+#endif
+
+#define ILBC_PROFILE_START(s, stage)        do { ILBC_PROFILE_GLOBAL_START(stage); ILBC_STATS_START(s, stage); } while (0)
+#define ILBC_PROFILE_STOP(s, stage)         do { ILBC_STATS_STOP(s, stage); ILBC_PROFILE_GLOBAL_STOP(stage); } while (0)
+
+/*
+ * With ILBC_STACK_WATCH defined (configure --enable-stack-watch) each public
+ * entry point paints the stack below its own frame on the way in, and on the
+ * way out finds how much of the paint its callees overwrote, for
+ * ilbc_stack_high_water(). The paint is laid by the outermost entry point
+ * only, so a wrapper such as ilbc_encode() is measured as a whole, scratch
+ * area and all. Without it, the macros compile to nothing.
+ */
+#if defined(ILBC_STACK_WATCH)
+#if defined(__GNUC__)
+#define ILBC_STACK_FRAME()                  ((uintptr_t) __builtin_frame_address(0))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define ILBC_STACK_FRAME()                  ((uintptr_t) _AddressOfReturnAddress())
+#endif
+
+void ilbc_stack_watch_start(uintptr_t top);
+void ilbc_stack_watch_stop(int entry);
+
+#define ILBC_STACK_WATCH_START()            ilbc_stack_watch_start(ILBC_STACK_FRAME())
+#define ILBC_STACK_WATCH_STOP(entry)        ilbc_stack_watch_stop(entry)
+#else
+#define ILBC_STACK_WATCH_START()            do { } while (0)
+#define ILBC_STACK_WATCH_STOP(entry)        do { } while (0)
+#endif
+
+/*! Read the accumulated time of each stage, in nanoseconds.
+    \return 0 for OK, or -1 if the library was built without profiling. */
+int ilbc_profile_read(uint64_t ns[ILBC_PROF_STAGES]);
+
+/*! Zero the stage timers. */
+void ilbc_profile_reset(void);
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,651 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_scheduler.c - A worker pool for encoding and decoding many
+ *                    channels in parallel.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#if defined(__linux__)
+/* For pthread_setaffinity_np() */
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ilbc2.h"
+#include "ilbc_scheduler.h"
+
+/*
+ * Each worker has its own FIFO of jobs, protected by a mutex. A channel is
+ * always queued on the same (home) worker, so its codec state stays in that
+ * worker's cache. A worker with nothing to do may steal the job at the head
+ * of another worker's queue. A job is only taken from a queue once its
+ * channel's busy flag has been claimed, so the jobs of one channel never
+ * overlap, and always run in the order they were queued.
+ *
+ * On a NUMA system, each worker can be bound to a CPU and given a group,
+ * usually its node. Workers only steal from others in their own group, so
+ * once a channel's home is on a node, and its state is in that node's
+ * memory, no other node touches it.
+ *
+ * Finished jobs go onto a lock free multi-producer, single consumer queue
+ * (the intrusive queue described by Dmitry Vyukov), so the workers never
+ * contend with the thread collecting the results.
+ */
+
+/* How long an idle worker sleeps between attempts to steal work */
+#define IDLE_WAIT_NS        1000000
+
+/* Streams ilbc_decode_bulk() keeps in flight for each worker, so a worker
+   which finishes a stream always has another to steal */
+#define BULK_STREAMS_PER_WORKER 4
+
+typedef struct
+{
+    void *state;
+    int home;
+    int busy;
+} sched_channel_t;
+
+typedef struct
+{
+    ilbc_scheduler_t *s;
+    int id;
+    int group;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    ilbc_job_t *head;
+    ilbc_job_t *tail;
+} sched_worker_t;
+
+struct ilbc_scheduler_s
+{
+    int workers;
+    sched_worker_t *worker;
+    int max_channels;
+    int channels;
+    sched_channel_t *channel;
+    int stop;
+
+    /* Completed job queue */
+    ilbc_job_t *done_head;
+    ilbc_job_t *done_tail;
+    ilbc_job_t done_stub;
+    int waiting;
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_cond;
+};
+
+/*----------------------------------------------------------------*
+ *  Completed job queue
+ *---------------------------------------------------------------*/
+
+static void done_push(ilbc_scheduler_t *s, ilbc_job_t *job)
+{
+    ilbc_job_t *prev;
+
+    __atomic_store_n(&job->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&s->done_head, job, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, job, __ATOMIC_RELEASE);
+}
+
+static ilbc_job_t *done_pop(ilbc_scheduler_t *s)
+{
+    ilbc_job_t *tail;
+    ilbc_job_t *next;
+
+    tail = s->done_tail;
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &s->done_stub)
+    {
+        if (next == NULL)
+            return NULL;
+        s->done_tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next)
+    {
+        s->done_tail = next;
+        return tail;
+    }
+    /* A push may be part way through, in which case come back later */
+    if (tail != __atomic_load_n(&s->done_head, __ATOMIC_ACQUIRE))
+        return NULL;
+    done_push(s, &s->done_stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next)
+    {
+        s->done_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void job_finished(ilbc_scheduler_t *s, ilbc_job_t *job)
+{
+    done_push(s, job);
+    if (__atomic_load_n(&s->waiting, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&s->done_lock);
+        pthread_cond_signal(&s->done_cond);
+        pthread_mutex_unlock(&s->done_lock);
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Job queues
+ *---------------------------------------------------------------*/
+
+/* Take the job at the head of a worker's queue, if its channel is free.
+   The worker's lock must be held. */
+static ilbc_job_t *queue_take(ilbc_scheduler_t *s, sched_worker_t *w)
+{
+    ilbc_job_t *job;
+    int expected;
+
+    if ((job = w->head) == NULL)
+        return NULL;
+    expected = 0;
+    if (!__atomic_compare_exchange_n(&s->channel[job->channel].busy, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return NULL;
+    if ((w->head = job->next) == NULL)
+        w->tail = NULL;
+    return job;
+}
+
+static ilbc_job_t *steal(ilbc_scheduler_t *s, sched_worker_t *self)
+{
+    sched_worker_t *w;
+    ilbc_job_t *job;
+    int i;
+
+    for (i = 1;  i < s->workers;  i++)
+    {
+        w = &s->worker[(self->id + i)%s->workers];
+        if (__atomic_load_n(&w->group, __ATOMIC_RELAXED) != __atomic_load_n(&self->group, __ATOMIC_RELAXED))
+            continue;
+        if (pthread_mutex_trylock(&w->lock))
+            continue;
+        job = queue_take(s, w);
+        pthread_mutex_unlock(&w->lock);
+        if (job)
+            return job;
+    }
+    return NULL;
+}
+
+static void run_job(ilbc_scheduler_t *s, ilbc_job_t *job)
+{
+    void *state;
+
+    state = s->channel[job->channel].state;
+    switch (job->type)
+    {
+    case ILBC_JOB_ENCODE:
+        job->result = ilbc_encode((ilbc_encode_state_t *) state, (uint8_t *) job->out, (const int16_t *) job->in, job->len);
+        break;
+    case ILBC_JOB_DECODE:
+        job->result = ilbc_decode((ilbc_decode_state_t *) state, (int16_t *) job->out, (const uint8_t *) job->in, job->len);
+        break;
+    case ILBC_JOB_FILLIN:
+        job->result = ilbc_fillin((ilbc_decode_state_t *) state, (int16_t *) job->out, job->len);
+        break;
+    }
+    __atomic_store_n(&s->channel[job->channel].busy, 0, __ATOMIC_RELEASE);
+    job_finished(s, job);
+}
+
+static void *worker_thread(void *arg)
+{
+    sched_worker_t *w;
+    ilbc_scheduler_t *s;
+    ilbc_job_t *job;
+    struct timespec ts;
+
+    w = (sched_worker_t *) arg;
+    s = w->s;
+    while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&w->lock);
+        job = queue_take(s, w);
+        pthread_mutex_unlock(&w->lock);
+        if (job == NULL  &&  (job = steal(s, w)) == NULL)
+        {
+            pthread_mutex_lock(&w->lock);
+            if (w->head)
+            {
+                /* Our head job is held up by an earlier job of the same
+                   channel, which another worker stole */
+                pthread_mutex_unlock(&w->lock);
+                sched_yield();
+                continue;
+            }
+            if (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE))
+            {
+                clock_gettime(CLOCK_REALTIME, &ts);
+                if ((ts.tv_nsec += IDLE_WAIT_NS) >= 1000000000)
+                {
+                    ts.tv_nsec -= 1000000000;
+                    ts.tv_sec++;
+                }
+                pthread_cond_timedwait(&w->cond, &w->lock, &ts);
+            }
+            pthread_mutex_unlock(&w->lock);
+            continue;
+        }
+        run_job(s, job);
+    }
+    return NULL;
+}
+
+/* Stop and join the first "started" workers, and free everything */
+static void scheduler_release(ilbc_scheduler_t *s, int started)
+{
+    int i;
+
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELEASE);
+    for (i = 0;  i < started;  i++)
+    {
+        pthread_mutex_lock(&s->worker[i].lock);
+        pthread_cond_broadcast(&s->worker[i].cond);
+        pthread_mutex_unlock(&s->worker[i].lock);
+    }
+    for (i = 0;  i < started;  i++)
+        pthread_join(s->worker[i].thread, NULL);
+    for (i = 0;  i < s->workers;  i++)
+    {
+        pthread_mutex_destroy(&s->worker[i].lock);
+        pthread_cond_destroy(&s->worker[i].cond);
+    }
+    pthread_mutex_destroy(&s->done_lock);
+    pthread_cond_destroy(&s->done_cond);
+    free(s->worker);
+    free(s->channel);
+    free(s);
+}
+
+/*----------------------------------------------------------------*
+ *  Public interface
+ *---------------------------------------------------------------*/
+
+int ilbc_scheduler_add_channel(ilbc_scheduler_t *s, void *state)
+{
+    return ilbc_scheduler_add_channel_on(s, state, s->channels%s->workers);
+}
+
+int ilbc_scheduler_add_channel_on(ilbc_scheduler_t *s, void *state, int worker)
+{
+    sched_channel_t *ch;
+
+    if (s->channels >= s->max_channels  ||  worker < 0  ||  worker >= s->workers)
+        return -1;
+    ch = &s->channel[s->channels];
+    ch->state = state;
+    ch->home = worker;
+    ch->busy = 0;
+    return s->channels++;
+}
+
+int ilbc_scheduler_bind_worker(ilbc_scheduler_t *s, int worker, int cpu, int group)
+{
+    sched_worker_t *w;
+#if defined(__linux__)
+    cpu_set_t set;
+#endif
+
+    if (worker < 0  ||  worker >= s->workers)
+        return -1;
+    w = &s->worker[worker];
+    if (cpu >= 0)
+    {
+#if defined(__linux__)
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(w->thread, sizeof(set), &set))
+            return -1;
+#else
+        return -1;
+#endif
+    }
+    __atomic_store_n(&w->group, group, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int ilbc_scheduler_submit(ilbc_scheduler_t *s, ilbc_job_t *job)
+{
+    sched_worker_t *w;
+
+    if (job->channel < 0  ||  job->channel >= s->channels)
+        return -1;
+    if (job->type != ILBC_JOB_ENCODE  &&  job->type != ILBC_JOB_DECODE  &&  job->type != ILBC_JOB_FILLIN)
+        return -1;
+    w = &s->worker[s->channel[job->channel].home];
+    job->next = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail)
+        w->tail->next = job;
+    else
+        w->head = job;
+    w->tail = job;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+ilbc_job_t *ilbc_scheduler_get_completed(ilbc_scheduler_t *s, int wait)
+{
+    ilbc_job_t *job;
+
+    if ((job = done_pop(s))  ||  !wait)
+        return job;
+    pthread_mutex_lock(&s->done_lock);
+    __atomic_store_n(&s->waiting, 1, __ATOMIC_SEQ_CST);
+    while ((job = done_pop(s)) == NULL)
+        pthread_cond_wait(&s->done_cond, &s->done_lock);
+    __atomic_store_n(&s->waiting, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&s->done_lock);
+    return job;
+}
+
+ilbc_scheduler_t *ilbc_scheduler_create(int workers, int max_channels)
+{
+    ilbc_scheduler_t *s;
+    int i;
+
+    if (workers <= 0  ||  max_channels <= 0)
+        return NULL;
+    if ((s = (ilbc_scheduler_t *) malloc(sizeof(*s))) == NULL)
+        return NULL;
+    memset(s, 0, sizeof(*s));
+    s->worker = (sched_worker_t *) calloc(workers, sizeof(sched_worker_t));
+    s->channel = (sched_channel_t *) calloc(max_channels, sizeof(sched_channel_t));
+    if (s->worker == NULL  ||  s->channel == NULL)
+    {
+        free(s->worker);
+        free(s->channel);
+        free(s);
+        return NULL;
+    }
+    s->max_channels = max_channels;
+    s->done_stub.next = NULL;
+    s->done_head = &s->done_stub;
+    s->done_tail = &s->done_stub;
+    pthread_mutex_init(&s->done_lock, NULL);
+    pthread_cond_init(&s->done_cond, NULL);
+    for (i = 0;  i < workers;  i++)
+    {
+        s->worker[i].s = s;
+        s->worker[i].id = i;
+        pthread_mutex_init(&s->worker[i].lock, NULL);
+        pthread_cond_init(&s->worker[i].cond, NULL);
+    }
+    s->workers = workers;
+    for (i = 0;  i < workers;  i++)
+    {
+        if (pthread_create(&s->worker[i].thread, NULL, worker_thread, &s->worker[i]))
+        {
+            scheduler_release(s, i);
+            return NULL;
+        }
+    }
+    return s;
+}
+
+void ilbc_scheduler_free(ilbc_scheduler_t *s)
+{
+    scheduler_release(s, s->workers);
+}
+
+/* Submit the warm up and main jobs for every segment, and wait for them */
+static void segmented_run(ilbc_scheduler_t *s,
+                          ilbc_job_t jobs[],
+                          uint8_t bytes[],
+                          const int16_t amp[],
+                          uint8_t discard[],
+                          int blockl,
+                          int no_of_bytes,
+                          int frames,
+                          int segment_frames,
+                          int warmup_frames)
+{
+    ilbc_job_t *job;
+    int submitted;
+    int f0;
+    int w0;
+    int i;
+
+    submitted = 0;
+    for (i = 0, f0 = 0;  f0 < frames;  i++, f0 += segment_frames)
+    {
+        /* Run the encoder over the frames just before the segment, and
+           throw the result away, so its history is close to what a serial
+           encoder would have by the start of the segment. */
+        w0 = f0 - warmup_frames;
+        if (w0 < 0)
+            w0 = 0;
+        if (w0 < f0)
+        {
+            job = &jobs[2*i];
+            job->type = ILBC_JOB_ENCODE;
+            job->channel = i;
+            job->in = amp + w0*blockl;
+            job->out = discard + i*warmup_frames*no_of_bytes;
+            job->len = (f0 - w0)*blockl;
+            ilbc_scheduler_submit(s, job);
+            submitted++;
+        }
+        job = &jobs[2*i + 1];
+        job->type = ILBC_JOB_ENCODE;
+        job->channel = i;
+        job->in = amp + f0*blockl;
+        job->out = bytes + f0*no_of_bytes;
+        job->len = ((f0 + segment_frames <= frames)  ?  segment_frames  :  (frames - f0))*blockl;
+        ilbc_scheduler_submit(s, job);
+        submitted++;
+    }
+    for (  ;  submitted > 0;  submitted--)
+        ilbc_scheduler_get_completed(s, 1);
+}
+
+int ilbc_encode_segmented(int workers,
+                          int mode,
+                          uint8_t bytes[],
+                          const int16_t amp[],
+                          int len,
+                          int segment_frames,
+                          int warmup_frames)
+{
+    ilbc_scheduler_t *s;
+    ilbc_encode_state_t **enc;
+    ilbc_job_t *jobs;
+    uint8_t *discard;
+    int blockl;
+    int no_of_bytes;
+    int frames;
+    int segments;
+    int i;
+    int ret;
+
+    if (workers <= 0  ||  segment_frames <= 0  ||  warmup_frames < 0  ||  len < 0)
+        return -1;
+    if (mode == 20)
+    {
+        blockl = ILBC_BLOCK_LEN_20MS;
+        no_of_bytes = ILBC_NO_OF_BYTES_20MS;
+    }
+    else if (mode == 30)
+    {
+        blockl = ILBC_BLOCK_LEN_30MS;
+        no_of_bytes = ILBC_NO_OF_BYTES_30MS;
+    }
+    else
+    {
+        return -1;
+    }
+    if (len%blockl)
+        return -1;
+    if ((frames = len/blockl) == 0)
+        return 0;
+    segments = (frames + segment_frames - 1)/segment_frames;
+    if (workers > segments)
+        workers = segments;
+
+    ret = -1;
+    enc = (ilbc_encode_state_t **) calloc(segments, sizeof(ilbc_encode_state_t *));
+    jobs = (ilbc_job_t *) calloc(2*segments, sizeof(ilbc_job_t));
+    discard = (uint8_t *) malloc(segments*warmup_frames*no_of_bytes + 1);
+    s = NULL;
+    if (enc  &&  jobs  &&  discard  &&  (s = ilbc_scheduler_create(workers, segments)))
+    {
+        for (i = 0;  i < segments;  i++)
+        {
+            if ((enc[i] = ilbc_encode_alloc(mode)) == NULL)
+                break;
+            ilbc_scheduler_add_channel(s, enc[i]);
+        }
+        if (i == segments)
+        {
+            segmented_run(s, jobs, bytes, amp, discard, blockl, no_of_bytes, frames, segment_frames, warmup_frames);
+            ret = frames*no_of_bytes;
+        }
+        ilbc_scheduler_free(s);
+    }
+    if (enc)
+    {
+        for (i = 0;  i < segments  &&  enc[i];  i++)
+            ilbc_encode_free(enc[i]);
+    }
+    free(enc);
+    free(jobs);
+    free(discard);
+    return ret;
+}
+
+int ilbc_decode_bulk(int workers,
+                     int mode,
+                     int use_enhancer,
+                     int16_t *const amp[],
+                     const uint8_t *const bytes[],
+                     const int len[],
+                     int streams)
+{
+    ilbc_scheduler_t *s;
+    ilbc_decode_state_t **dec;
+    ilbc_job_t *jobs;
+    ilbc_job_t **free_jobs;
+    ilbc_job_t *job;
+    int no_of_bytes;
+    int blockl;
+    int slots;
+    int free_count;
+    int next;
+    int i;
+    int ret;
+
+    if (workers <= 0  ||  streams < 0)
+        return -1;
+    if (mode == 20)
+    {
+        blockl = ILBC_BLOCK_LEN_20MS;
+        no_of_bytes = ILBC_NO_OF_BYTES_20MS;
+    }
+    else if (mode == 30)
+    {
+        blockl = ILBC_BLOCK_LEN_30MS;
+        no_of_bytes = ILBC_NO_OF_BYTES_30MS;
+    }
+    else
+    {
+        return -1;
+    }
+    ret = 0;
+    for (i = 0;  i < streams;  i++)
+    {
+        if (len[i] < 0  ||  len[i]%no_of_bytes)
+            return -1;
+        ret += len[i]/no_of_bytes*blockl;
+    }
+    if (streams == 0)
+        return 0;
+    if (workers > streams)
+        workers = streams;
+    slots = workers*BULK_STREAMS_PER_WORKER;
+    if (slots > streams)
+        slots = streams;
+
+    /* Each stream gets its own channel, but only a few decoders exist at
+       once. As each stream finishes, its decoder is freed, and one is made
+       for the next stream. */
+    dec = (ilbc_decode_state_t **) calloc(streams, sizeof(ilbc_decode_state_t *));
+    jobs = (ilbc_job_t *) calloc(slots, sizeof(ilbc_job_t));
+    free_jobs = (ilbc_job_t **) calloc(slots, sizeof(ilbc_job_t *));
+    s = NULL;
+    if (dec == NULL  ||  jobs == NULL  ||  free_jobs == NULL  ||  (s = ilbc_scheduler_create(workers, streams)) == NULL)
+    {
+        free(dec);
+        free(jobs);
+        free(free_jobs);
+        return -1;
+    }
+    for (i = 0;  i < slots;  i++)
+        free_jobs[i] = &jobs[i];
+    free_count = slots;
+    next = 0;
+    for (;;)
+    {
+        while (free_count > 0  &&  next < streams)
+        {
+            /* Without the enhancer, a compact decoder gives the same result */
+            if (use_enhancer == ILBC_ENHANCER_OFF)
+                dec[next] = ilbc_decode_alloc_compact(mode);
+            else
+                dec[next] = ilbc_decode_alloc(mode, use_enhancer);
+            if (dec[next] == NULL)
+                break;
+            job = free_jobs[--free_count];
+            job->type = ILBC_JOB_DECODE;
+            job->channel = ilbc_scheduler_add_channel(s, dec[next]);
+            job->in = bytes[next];
+            job->out = amp[next];
+            job->len = len[next];
+            ilbc_scheduler_submit(s, job);
+            next++;
+        }
+        if (free_count == slots)
+        {
+            /* Nothing is running, so either all is done, or there is no
+               memory for another decoder */
+            if (next < streams)
+                ret = -1;
+            break;
+        }
+        job = ilbc_scheduler_get_completed(s, 1);
+        ilbc_decode_free(dec[job->channel]);
+        dec[job->channel] = NULL;
+        free_jobs[free_count++] = job;
+    }
+    ilbc_scheduler_free(s);
+    free(dec);
+    free(jobs);
+    free(free_jobs);
+    return ret;
+}
@@ -0,0 +1,145 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_scheduler.h - A worker pool for encoding and decoding many
+ *                    channels in parallel.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#if !defined(_ILBC_SCHEDULER_H_)
+#define _ILBC_SCHEDULER_H_
+
+#include "ilbc2.h"
+
+/*! The kinds of job a scheduler can run */
+enum
+{
+    ILBC_JOB_ENCODE = 0,    /* ilbc_encode() on an ilbc_encode_state_t channel */
+    ILBC_JOB_DECODE = 1,    /* ilbc_decode() on an ilbc_decode_state_t channel */
+    ILBC_JOB_FILLIN = 2     /* ilbc_fillin() on an ilbc_decode_state_t channel */
+};
+
+/*! A unit of work for one channel. The caller owns the job, and must
+    keep it, and the buffers it points to, alive until it comes back
+    from ilbc_scheduler_get_completed(). */
+typedef struct ilbc_job_s
+{
+    int type;               /* (i) ILBC_JOB_xxx */
+    int channel;            /* (i) channel id, from ilbc_scheduler_add_channel() */
+    const void *in;         /* (i) input samples (encode) or bytes (decode) */
+    void *out;              /* (o) output bytes (encode) or samples (decode, fillin) */
+    int len;                /* (i) length of the input, as passed to the codec call */
+    int result;             /* (o) return value of the codec call */
+    void *user_data;        /* (i) for the caller's use. Not touched by the scheduler */
+
+    /* Private to the scheduler */
+    struct ilbc_job_s *next;
+} ilbc_job_t;
+
+typedef struct ilbc_scheduler_s ilbc_scheduler_t;
+
+/*! Create a scheduler, and start its worker threads.
+    \return The scheduler, or NULL on failure. */
+ilbc_scheduler_t *ilbc_scheduler_create(int workers,          /* (i) number of worker threads */
+                                        int max_channels);    /* (i) most channels which will be added */
+
+/*! Register a codec state with the scheduler. Each channel is given a
+    home worker, which runs its jobs unless another worker is idle and
+    steals them. Jobs for one channel always run one at a time, in the
+    order they were submitted.
+    \return The channel id, or -1 if the scheduler is full. */
+int ilbc_scheduler_add_channel(ilbc_scheduler_t *s,     /* (i/o) the scheduler */
+                               void *state);            /* (i) an initialised ilbc_encode_state_t or
+                                                               ilbc_decode_state_t */
+
+/*! Register a codec state with the scheduler, as for
+    ilbc_scheduler_add_channel(), but with a chosen home worker. On a NUMA
+    system, this keeps a channel on the node whose memory holds its state.
+    \return The channel id, or -1 if the scheduler is full or the worker
+            does not exist. */
+int ilbc_scheduler_add_channel_on(ilbc_scheduler_t *s,  /* (i/o) the scheduler */
+                                  void *state,          /* (i) an initialised ilbc_encode_state_t or
+                                                               ilbc_decode_state_t */
+                                  int worker);          /* (i) the home worker, from 0 to workers - 1 */
+
+/*! Bind a worker thread to a CPU, and put it in a group. A worker only
+    steals jobs from workers in its own group, and all workers start in
+    group 0. Making each NUMA node a group, with the channels' states
+    allocated on their home worker's node by ilbc_bank_alloc(), means each
+    state is only ever touched by its own node.
+    \return 0 for OK, or -1 for a bad worker or a CPU the thread can not be
+            bound to. Binding is only supported on Linux. */
+int ilbc_scheduler_bind_worker(ilbc_scheduler_t *s,     /* (i/o) the scheduler */
+                               int worker,              /* (i) the worker, from 0 to workers - 1 */
+                               int cpu,                 /* (i) the CPU, or -1 to leave the thread where it is */
+                               int group);              /* (i) the worker's group, usually its node */
+
+/*! Queue a job on its channel's home worker.
+    \return 0 for OK, or -1 for a bad job. */
+int ilbc_scheduler_submit(ilbc_scheduler_t *s,          /* (i/o) the scheduler */
+                          ilbc_job_t *job);             /* (i/o) the job */
+
+/*! Collect a finished job. Only one thread may collect jobs from a
+    scheduler.
+    \return A finished job, or NULL if none is ready and wait is 0. */
+ilbc_job_t *ilbc_scheduler_get_completed(ilbc_scheduler_t *s,  /* (i/o) the scheduler */
+                                         int wait);            /* (i) 1 to block until a job is ready */
+
+/*! Stop the worker threads and free the scheduler. Jobs still queued are
+    abandoned. */
+void ilbc_scheduler_free(ilbc_scheduler_t *s);
+
+/*! Encode a long recording on several threads, for offline work such as
+    bulk transcoding. The input is cut into segments of segment_frames
+    frames, each coded by its own encoder. Before coding its segment, each
+    encoder is run over the warmup_frames frames just before it, and that
+    output is thrown away, so its LPC analysis history, high pass filter
+    and previous LSFs have settled into much the state a single encoder
+    would have had there. The segments' bitstreams are joined in order, to
+    give a stream any decoder can play.
+
+    The first segment is exactly what ilbc_encode() would produce. Only
+    the first frames of each later segment can differ from a serial
+    encoding. The encoder's memory is short, but its high pass filter is
+    recursive, so no amount of warm up guarantees a bit exact result.
+    In practice 2 frames of warm up make a stream identical to the serial
+    one nearly always, and any frame which does differ only makes another
+    quantisation choice of the same quality. With no warm up, the first
+    frame of each segment is coded as though it started the recording,
+    which is audible at each join.
+    \return The number of bytes produced, or -1 for bad parameters, a
+            length which is not a whole number of frames, or no memory. */
+int ilbc_encode_segmented(int workers,              /* (i) number of threads to use */
+                          int mode,                 /* (i) frame size mode, 20 or 30 */
+                          uint8_t bytes[],          /* (o) the bitstream, len/blockl frames long */
+                          const int16_t amp[],      /* (i) the speech to encode */
+                          int len,                  /* (i) number of samples, a multiple of the frame length */
+                          int segment_frames,       /* (i) frames in each segment */
+                          int warmup_frames);       /* (i) frames of warm up before each segment */
+
+/*! Decode many independent recordings at once, for offline work such as
+    feeding speech recognition. Each stream is decoded in full by its own
+    decoder, so the result is exactly what ilbc_decode() gives for it, and
+    the streams are spread over the worker threads. Only a few streams per
+    worker are in progress at any time, so thousands of streams need only
+    a few decoders' worth of memory. Without the enhancer, these are
+    compact decoders.
+    \return The total number of samples produced, or -1 for bad parameters,
+            a stream which is not a whole number of frames, or no memory. */
+int ilbc_decode_bulk(int workers,                   /* (i) number of threads to use */
+                     int mode,                      /* (i) frame size mode, 20 or 30 */
+                     int use_enhancer,              /* (i) ILBC_ENHANCER_xxx */
+                     int16_t *const amp[],          /* (o) the decoded speech, one buffer per stream */
+                     const uint8_t *const bytes[],  /* (i) the bitstreams, one per stream */
+                     const int len[],               /* (i) length of each bitstream, in bytes */
+                     int streams);                  /* (i) number of streams */
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -27,7 +27,10 @@
 #include <string.h>
 #include <math.h>
 
+#include "ilbc2.h"
 #include "iLBC_define.h"
+#include "constants.h"
+#include "helpfun.h"
 #include "lsf.h"
 
 /*----------------------------------------------------------------*
@@ -54,6 +57,8 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
     float *pq_coef;
     float omega;
     float old_omega;
+    int grid;
+    int old_grid;
     int i;
     float hlp;
     float hlp1;
@@ -84,6 +89,8 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
 
     omega = 0.0f;
     old_omega = 0.0f;
+    grid = 0;
+    old_grid = 0;
 
     old_p = FLOAT_MAX;
     old_q = FLOAT_MAX;
@@ -109,7 +116,9 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
         {
             /*  cos(10piw) + pq(0)cos(8piw) + pq(1)cos(6piw) +
                 pq(2)cos(4piw) + pq(3)cod(2piw) + pq(4) */
-            hlp = cosf(omega*TWO_PI);
+            /* On the coarse grid omega is always one of the points in
+               lsf_cosTbl, so its cosine need not be calculated */
+            hlp = (step_idx == 0)  ?  lsf_cosTbl[grid]  :  cosf(omega*TWO_PI);
             hlp1 = 2.0f*hlp+pq_coef[0];
             hlp2 = 2.0f*hlp*hlp1 - 1.0f + pq_coef[1];
             hlp3 = 2.0f*hlp*hlp2 - hlp1 + pq_coef[2];
@@ -132,6 +141,7 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
                         *old = FLOAT_MAX;
 
                     omega = old_omega;
+                    grid = old_grid;
                     step_idx = 0;
 
                     step_idx = LSF_NUMBER_OF_STEPS;
@@ -139,7 +149,10 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
                 else
                 {
                     if (step_idx == 0)
+                    {
                         old_omega = omega;
+                        old_grid = grid;
+                    }
 
                     step_idx++;
                     omega -= steps[step_idx];
@@ -155,6 +168,8 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
                    and old_omega */
                 *old = hlp5;
                 omega += step;
+                if (step_idx == 0)
+                    grid++;
             }
         }
     }
@@ -267,3 +282,195 @@ void lsf2a(float *a_coef,   /* (o) lpc coefficients */
 
     a_coef[0] = 1.0f;
 }
+
+/* The sub-frames lsf2aFrame() works side by side. This is ILBC_NUM_SUB_MAX,
+   rounded up to a whole number of vectors. */
+#define LSF_LANES               8
+
+/*----------------------------------------------------------------*
+ *  conversion from lsf coefficients to lpc coefficients for all
+ *  the sub-frames of a frame. The sub-frames are worked side by
+ *  side, with the recursions running across them, but each one
+ *  gets exactly the coefficients lsf2a() would give it. A sub-frame
+ *  with the same lsf coefficients as the last ones converted takes
+ *  their coefficients, rather than converting them again.
+ *---------------------------------------------------------------*/
+
+void lsf2aFrame(float a_coef[],             /* (o) lpc coefficients, for each sub-frame */
+                const float freq[],         /* (i) lsf coefficients, for each sub-frame */
+                int nsub,                   /* (i) number of sub-frames */
+                ilbc_lsf_memo_t *memo)      /* (i/o) the last lsf coefficients converted */
+{
+    int i;
+    int j;
+    int k;
+    int n;
+    float hlp;
+    float f[ILBC_LPC_FILTERORDER];
+    int lane[ILBC_NUM_SUB_MAX];
+    float p[LPC_HALFORDER][LSF_LANES];
+    float q[LPC_HALFORDER][LSF_LANES];
+    float a[LPC_HALFORDER + 1][LSF_LANES];
+    float a1[LPC_HALFORDER][LSF_LANES];
+    float a2[LPC_HALFORDER][LSF_LANES];
+    float b[LPC_HALFORDER + 1][LSF_LANES];
+    float b1[LPC_HALFORDER][LSF_LANES];
+    float b2[LPC_HALFORDER][LSF_LANES];
+    const float *last;
+
+    /* Give each sub-frame which needs converting a lane. One with the same
+       lsf coefficients as the sub-frame before gets none. The cosines are
+       found here, with the same check for ill-conditioned cases as lsf2a()
+       makes. */
+    n = 0;
+    last = memo->lsf;
+    for (k = 0;  k < nsub;  k++)
+    {
+        if (memcmp(freq + k*ILBC_LPC_FILTERORDER, last, ILBC_LPC_FILTERORDER*sizeof(float)) != 0)
+        {
+            for (i = 0;  i < ILBC_LPC_FILTERORDER;  i++)
+                f[i] = freq[k*ILBC_LPC_FILTERORDER + i]*PI2;
+            if ((f[0] <= 0.0f)  ||  (f[ILBC_LPC_FILTERORDER - 1] >= 0.5f))
+            {
+                if (f[0] <= 0.0f)
+                    f[0] = 0.022f;
+                if (f[ILBC_LPC_FILTERORDER - 1] >= 0.5f)
+                    f[ILBC_LPC_FILTERORDER - 1] = 0.499f;
+                hlp = (f[ILBC_LPC_FILTERORDER - 1] - f[0])/(float) (ILBC_LPC_FILTERORDER - 1);
+                for (i = 1;  i < ILBC_LPC_FILTERORDER;  i++)
+                    f[i] = f[i - 1] + hlp;
+            }
+            for (i = 0;  i < LPC_HALFORDER;  i++)
+            {
+                p[i][n] = cosf(TWO_PI*f[2*i]);
+                q[i][n] = cosf(TWO_PI*f[2*i + 1]);
+            }
+            lane[n++] = k;
+        }
+        last = freq + k*ILBC_LPC_FILTERORDER;
+    }
+
+    if (n > 0)
+    {
+        /* The spare lanes just work on zeros */
+        for (i = 0;  i < LPC_HALFORDER;  i++)
+        {
+            for (j = n;  j < LSF_LANES;  j++)
+            {
+                p[i][j] = 0.0f;
+                q[i][j] = 0.0f;
+            }
+            for (j = 0;  j < LSF_LANES;  j++)
+            {
+                a1[i][j] = 0.0f;
+                a2[i][j] = 0.0f;
+                b1[i][j] = 0.0f;
+                b2[i][j] = 0.0f;
+            }
+        }
+        for (j = 0;  j < LSF_LANES;  j++)
+        {
+            a[0][j] = 0.25f;
+            b[0][j] = 0.25f;
+        }
+        for (i = 0;  i < LPC_HALFORDER;  i++)
+        {
+            for (j = 0;  j < LSF_LANES;  j++)
+            {
+                a[i + 1][j] = a[i][j] - 2*p[i][j]*a1[i][j] + a2[i][j];
+                b[i + 1][j] = b[i][j] - 2*q[i][j]*b1[i][j] + b2[i][j];
+                a2[i][j] = a1[i][j];
+                a1[i][j] = a[i][j];
+                b2[i][j] = b1[i][j];
+                b1[i][j] = b[i][j];
+            }
+        }
+
+        for (k = 0;  k < ILBC_LPC_FILTERORDER;  k++)
+        {
+            for (j = 0;  j < LSF_LANES;  j++)
+            {
+                a[0][j] = (k == 0)  ?  0.25f  :  0.0f;
+                b[0][j] = (k == 0)  ?  -0.25f  :  0.0f;
+            }
+            for (i = 0;  i < LPC_HALFORDER;  i++)
+            {
+                for (j = 0;  j < LSF_LANES;  j++)
+                {
+                    a[i + 1][j] = a[i][j] - 2.0f*p[i][j]*a1[i][j] + a2[i][j];
+                    b[i + 1][j] = b[i][j] - 2.0f*q[i][j]*b1[i][j] + b2[i][j];
+                    a2[i][j] = a1[i][j];
+                    a1[i][j] = a[i][j];
+                    b2[i][j] = b1[i][j];
+                    b1[i][j] = b[i][j];
+                }
+            }
+            for (j = 0;  j < n;  j++)
+                a_coef[lane[j]*(ILBC_LPC_FILTERORDER + 1) + k + 1] = 2.0f*(a[LPC_HALFORDER][j] + b[LPC_HALFORDER][j]);
+        }
+        for (j = 0;  j < n;  j++)
+            a_coef[lane[j]*(ILBC_LPC_FILTERORDER + 1)] = 1.0f;
+    }
+
+    /* Fill in the sub-frames which repeat the one before */
+    for (k = 0, j = 0;  k < nsub;  k++)
+    {
+        if (j < n  &&  lane[j] == k)
+        {
+            j++;
+            continue;
+        }
+        if (k == 0)
+            memcpy(a_coef, memo->a, (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+        else
+            memcpy(a_coef + k*(ILBC_LPC_FILTERORDER + 1), a_coef + (k - 1)*(ILBC_LPC_FILTERORDER + 1), (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+    }
+    memcpy(memo->lsf, freq + (nsub - 1)*ILBC_LPC_FILTERORDER, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(memo->a, a_coef + (nsub - 1)*(ILBC_LPC_FILTERORDER + 1), (ILBC_LPC_FILTERORDER + 1)*sizeof(float));
+}
+
+/*----------------------------------------------------------------*
+ *  interpolation of the lsf coefficients for each sub-frame of a
+ *  frame, and their conversion to lpc coefficients. In 30ms mode
+ *  the first sub-frame lies between the old and the first set of
+ *  lsf coefficients, and the rest between the first and second
+ *  sets. In 20ms mode they all lie between the old and the only
+ *  set.
+ *---------------------------------------------------------------*/
+
+void lsfInterpolate2aFrame(float a_coef[],          /* (o) lpc coefficients, for each sub-frame */
+                           float lsfold[],          /* (i) the lsf coefficients of the previous frame */
+                           float lsf[],             /* (i) the lsf coefficients of this frame */
+                           int mode,                /* (i) frame size mode */
+                           ilbc_lsf_memo_t *memo)   /* (i/o) the last lsf coefficients converted */
+{
+    float lsftmp[ILBC_NUM_SUB_MAX*ILBC_LPC_FILTERORDER];
+    int i;
+
+    if (mode == 30)
+    {
+        interpolate(lsftmp, lsfold, lsf, lsf_weightTbl_30ms[0], ILBC_LPC_FILTERORDER);
+        for (i = 1;  i < NSUB_30MS;  i++)
+            interpolate(lsftmp + i*ILBC_LPC_FILTERORDER, lsf, lsf + ILBC_LPC_FILTERORDER, lsf_weightTbl_30ms[i], ILBC_LPC_FILTERORDER);
+        lsf2aFrame(a_coef, lsftmp, NSUB_30MS, memo);
+    }
+    else
+    {
+        for (i = 0;  i < NSUB_20MS;  i++)
+            interpolate(lsftmp + i*ILBC_LPC_FILTERORDER, lsfold, lsf, lsf_weightTbl_20ms[i], ILBC_LPC_FILTERORDER);
+        lsf2aFrame(a_coef, lsftmp, NSUB_20MS, memo);
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  a memo which holds a true conversion, for a new state
+ *---------------------------------------------------------------*/
+
+void lsfMemoInit(ilbc_lsf_memo_t *memo)     /* (o) the memo */
+{
+    float lsftmp[ILBC_LPC_FILTERORDER];
+
+    memcpy(memo->lsf, lsfmeanTbl, ILBC_LPC_FILTERORDER*sizeof(float));
+    memcpy(lsftmp, lsfmeanTbl, ILBC_LPC_FILTERORDER*sizeof(float));
+    lsf2a(memo->a, lsftmp);
+}
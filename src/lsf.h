@@ -26,4 +26,17 @@ void a2lsf(float *freq,     /* (o) lsf coefficients */
 void lsf2a(float *a_coef,   /* (o) lpc coefficients */
            float *freq);    /* (i) lsf coefficients */
 
+void lsf2aFrame(float a_coef[],             /* (o) lpc coefficients, for each sub-frame */
+                const float freq[],         /* (i) lsf coefficients, for each sub-frame */
+                int nsub,                   /* (i) number of sub-frames */
+                ilbc_lsf_memo_t *memo);     /* (i/o) the last lsf coefficients converted */
+
+void lsfInterpolate2aFrame(float a_coef[],          /* (o) lpc coefficients, for each sub-frame */
+                           float lsfold[],          /* (i) the lsf coefficients of the previous frame */
+                           float lsf[],             /* (i) the lsf coefficients of this frame */
+                           int mode,                /* (i) frame size mode */
+                           ilbc_lsf_memo_t *memo);  /* (i/o) the last lsf coefficients converted */
+
+void lsfMemoInit(ilbc_lsf_memo_t *memo);    /* (o) the memo */
+
 #endif
@@ -24,147 +24,324 @@
 #endif
 
 #include <inttypes.h>
-#include <math.h>
-#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 
 #include "ilbc2.h"
-#include "constants.h"
-#include "helpfun.h"
-#include "string.h"
+#include "iLBC_define.h"
 #include "packing.h"
 
 /*----------------------------------------------------------------*
- *  splitting an integer into first most significant bits and
- *  remaining least significant bits
+ *  The bit layout of a frame
+ *
+ *  The frame is the parameters split up by the ULP tables, class
+ *  by class, with the most significant bits of each parameter in
+ *  the earliest class it appears in. Flattening the ULP tables
+ *  gives a list of fields, each holding some bits of one parameter.
+ *  These lists are derived from ULP_20msTbl and ULP_30msTbl, and
+ *  must be kept in step with them.
  *---------------------------------------------------------------*/
 
-void packsplit(int *index,              /* (i) the value to split */
-               int *firstpart,          /* (o) the value specified by most
-                                               significant bits */
-               int *rest,               /* (o) the value specified by least
-                                               significant bits */
-               int bitno_firstpart,     /* (i) number of bits in most
-                                               significant part */
-               int bitno_total)         /* (i) number of bits in full range of value */
+typedef struct
 {
-    int bitno_rest = bitno_total - bitno_firstpart;
+    uint8_t param;      /* the parameter, as an index into a frame_params_t */
+    uint8_t bits;       /* the number of bits of the parameter in this field */
+    uint8_t shift;      /* the number of less significant bits, sent in later fields */
+} pack_field_t;
 
-    *firstpart = *index >> (bitno_rest);
-    *rest = *index - (*firstpart << (bitno_rest));
-}
+#define PARAM(x)                (uint8_t) (offsetof(frame_params_t, x)/sizeof(int))
 
-/*----------------------------------------------------------------*
- *  combining a value corresponding to msb's with a value
- *  corresponding to lsb's
- *---------------------------------------------------------------*/
+#define PACK_FIELDS_20MS        151
+#define PACK_FIELDS_30MS        177
 
-void packcombine(int *index,        /* (i/o) the msb value in the combined value out */
-                 int rest,          /* (i) the lsb value */
-                 int bitno_rest)    /* (i) the number of bits in the lsb part */
+/* 20 ms frames: 151 fields, making 304 bits */
+static const pack_field_t pack_layout_20msTbl[PACK_FIELDS_20MS] =
 {
-    *index = *index << bitno_rest;
-    *index += rest;
-}
+    /* ULP class 1 */
+    {PARAM(lsf_i[0]), 6, 0}, {PARAM(lsf_i[1]), 7, 0}, {PARAM(lsf_i[2]), 7, 0}, {PARAM(start), 2, 0},
+    {PARAM(state_first), 1, 0}, {PARAM(idxForMax), 6, 0}, {PARAM(extra_cb_index[0]), 6, 1},
+    {PARAM(extra_gain_index[0]), 2, 3}, {PARAM(extra_gain_index[1]), 1, 3},
+    {PARAM(cb_index[0]), 7, 1}, {PARAM(gain_index[0]), 1, 4}, {PARAM(gain_index[1]), 1, 3},
+    {PARAM(gain_index[3]), 1, 4},
+    /* ULP class 2 */
+    {PARAM(idxVec[0]), 1, 2}, {PARAM(idxVec[1]), 1, 2}, {PARAM(idxVec[2]), 1, 2},
+    {PARAM(idxVec[3]), 1, 2}, {PARAM(idxVec[4]), 1, 2}, {PARAM(idxVec[5]), 1, 2},
+    {PARAM(idxVec[6]), 1, 2}, {PARAM(idxVec[7]), 1, 2}, {PARAM(idxVec[8]), 1, 2},
+    {PARAM(idxVec[9]), 1, 2}, {PARAM(idxVec[10]), 1, 2}, {PARAM(idxVec[11]), 1, 2},
+    {PARAM(idxVec[12]), 1, 2}, {PARAM(idxVec[13]), 1, 2}, {PARAM(idxVec[14]), 1, 2},
+    {PARAM(idxVec[15]), 1, 2}, {PARAM(idxVec[16]), 1, 2}, {PARAM(idxVec[17]), 1, 2},
+    {PARAM(idxVec[18]), 1, 2}, {PARAM(idxVec[19]), 1, 2}, {PARAM(idxVec[20]), 1, 2},
+    {PARAM(idxVec[21]), 1, 2}, {PARAM(idxVec[22]), 1, 2}, {PARAM(idxVec[23]), 1, 2},
+    {PARAM(idxVec[24]), 1, 2}, {PARAM(idxVec[25]), 1, 2}, {PARAM(idxVec[26]), 1, 2},
+    {PARAM(idxVec[27]), 1, 2}, {PARAM(idxVec[28]), 1, 2}, {PARAM(idxVec[29]), 1, 2},
+    {PARAM(idxVec[30]), 1, 2}, {PARAM(idxVec[31]), 1, 2}, {PARAM(idxVec[32]), 1, 2},
+    {PARAM(idxVec[33]), 1, 2}, {PARAM(idxVec[34]), 1, 2}, {PARAM(idxVec[35]), 1, 2},
+    {PARAM(idxVec[36]), 1, 2}, {PARAM(idxVec[37]), 1, 2}, {PARAM(idxVec[38]), 1, 2},
+    {PARAM(idxVec[39]), 1, 2}, {PARAM(idxVec[40]), 1, 2}, {PARAM(idxVec[41]), 1, 2},
+    {PARAM(idxVec[42]), 1, 2}, {PARAM(idxVec[43]), 1, 2}, {PARAM(idxVec[44]), 1, 2},
+    {PARAM(idxVec[45]), 1, 2}, {PARAM(idxVec[46]), 1, 2}, {PARAM(idxVec[47]), 1, 2},
+    {PARAM(idxVec[48]), 1, 2}, {PARAM(idxVec[49]), 1, 2}, {PARAM(idxVec[50]), 1, 2},
+    {PARAM(idxVec[51]), 1, 2}, {PARAM(idxVec[52]), 1, 2}, {PARAM(idxVec[53]), 1, 2},
+    {PARAM(idxVec[54]), 1, 2}, {PARAM(idxVec[55]), 1, 2}, {PARAM(idxVec[56]), 1, 2},
+    {PARAM(extra_gain_index[1]), 1, 2}, {PARAM(gain_index[0]), 2, 2}, {PARAM(gain_index[1]), 1, 2},
+    {PARAM(gain_index[3]), 1, 3}, {PARAM(gain_index[4]), 2, 2},
+    /* ULP class 3 */
+    {PARAM(idxVec[0]), 2, 0}, {PARAM(idxVec[1]), 2, 0}, {PARAM(idxVec[2]), 2, 0},
+    {PARAM(idxVec[3]), 2, 0}, {PARAM(idxVec[4]), 2, 0}, {PARAM(idxVec[5]), 2, 0},
+    {PARAM(idxVec[6]), 2, 0}, {PARAM(idxVec[7]), 2, 0}, {PARAM(idxVec[8]), 2, 0},
+    {PARAM(idxVec[9]), 2, 0}, {PARAM(idxVec[10]), 2, 0}, {PARAM(idxVec[11]), 2, 0},
+    {PARAM(idxVec[12]), 2, 0}, {PARAM(idxVec[13]), 2, 0}, {PARAM(idxVec[14]), 2, 0},
+    {PARAM(idxVec[15]), 2, 0}, {PARAM(idxVec[16]), 2, 0}, {PARAM(idxVec[17]), 2, 0},
+    {PARAM(idxVec[18]), 2, 0}, {PARAM(idxVec[19]), 2, 0}, {PARAM(idxVec[20]), 2, 0},
+    {PARAM(idxVec[21]), 2, 0}, {PARAM(idxVec[22]), 2, 0}, {PARAM(idxVec[23]), 2, 0},
+    {PARAM(idxVec[24]), 2, 0}, {PARAM(idxVec[25]), 2, 0}, {PARAM(idxVec[26]), 2, 0},
+    {PARAM(idxVec[27]), 2, 0}, {PARAM(idxVec[28]), 2, 0}, {PARAM(idxVec[29]), 2, 0},
+    {PARAM(idxVec[30]), 2, 0}, {PARAM(idxVec[31]), 2, 0}, {PARAM(idxVec[32]), 2, 0},
+    {PARAM(idxVec[33]), 2, 0}, {PARAM(idxVec[34]), 2, 0}, {PARAM(idxVec[35]), 2, 0},
+    {PARAM(idxVec[36]), 2, 0}, {PARAM(idxVec[37]), 2, 0}, {PARAM(idxVec[38]), 2, 0},
+    {PARAM(idxVec[39]), 2, 0}, {PARAM(idxVec[40]), 2, 0}, {PARAM(idxVec[41]), 2, 0},
+    {PARAM(idxVec[42]), 2, 0}, {PARAM(idxVec[43]), 2, 0}, {PARAM(idxVec[44]), 2, 0},
+    {PARAM(idxVec[45]), 2, 0}, {PARAM(idxVec[46]), 2, 0}, {PARAM(idxVec[47]), 2, 0},
+    {PARAM(idxVec[48]), 2, 0}, {PARAM(idxVec[49]), 2, 0}, {PARAM(idxVec[50]), 2, 0},
+    {PARAM(idxVec[51]), 2, 0}, {PARAM(idxVec[52]), 2, 0}, {PARAM(idxVec[53]), 2, 0},
+    {PARAM(idxVec[54]), 2, 0}, {PARAM(idxVec[55]), 2, 0}, {PARAM(idxVec[56]), 2, 0},
+    {PARAM(extra_cb_index[0]), 1, 0}, {PARAM(extra_cb_index[1]), 7, 0},
+    {PARAM(extra_cb_index[2]), 7, 0}, {PARAM(extra_gain_index[0]), 3, 0},
+    {PARAM(extra_gain_index[1]), 2, 0}, {PARAM(extra_gain_index[2]), 3, 0},
+    {PARAM(cb_index[0]), 1, 0}, {PARAM(cb_index[1]), 7, 0}, {PARAM(cb_index[2]), 7, 0},
+    {PARAM(cb_index[3]), 8, 0}, {PARAM(cb_index[4]), 8, 0}, {PARAM(cb_index[5]), 8, 0},
+    {PARAM(gain_index[0]), 2, 0}, {PARAM(gain_index[1]), 2, 0}, {PARAM(gain_index[2]), 3, 0},
+    {PARAM(gain_index[3]), 3, 0}, {PARAM(gain_index[4]), 2, 0}, {PARAM(gain_index[5]), 3, 0},
+    /* Empty frame flag */
+    {PARAM(last_bit), 1, 0}
+};
+
+/* 30 ms frames: 177 fields, making 400 bits */
+static const pack_field_t pack_layout_30msTbl[PACK_FIELDS_30MS] =
+{
+    /* ULP class 1 */
+    {PARAM(lsf_i[0]), 6, 0}, {PARAM(lsf_i[1]), 7, 0}, {PARAM(lsf_i[2]), 7, 0},
+    {PARAM(lsf_i[3]), 6, 0}, {PARAM(lsf_i[4]), 7, 0}, {PARAM(lsf_i[5]), 7, 0}, {PARAM(start), 3, 0},
+    {PARAM(state_first), 1, 0}, {PARAM(idxForMax), 6, 0}, {PARAM(extra_cb_index[0]), 4, 3},
+    {PARAM(extra_gain_index[0]), 1, 4}, {PARAM(extra_gain_index[1]), 1, 3},
+    {PARAM(cb_index[0]), 6, 2}, {PARAM(gain_index[0]), 1, 4}, {PARAM(gain_index[1]), 1, 3},
+    /* ULP class 2 */
+    {PARAM(idxVec[0]), 1, 2}, {PARAM(idxVec[1]), 1, 2}, {PARAM(idxVec[2]), 1, 2},
+    {PARAM(idxVec[3]), 1, 2}, {PARAM(idxVec[4]), 1, 2}, {PARAM(idxVec[5]), 1, 2},
+    {PARAM(idxVec[6]), 1, 2}, {PARAM(idxVec[7]), 1, 2}, {PARAM(idxVec[8]), 1, 2},
+    {PARAM(idxVec[9]), 1, 2}, {PARAM(idxVec[10]), 1, 2}, {PARAM(idxVec[11]), 1, 2},
+    {PARAM(idxVec[12]), 1, 2}, {PARAM(idxVec[13]), 1, 2}, {PARAM(idxVec[14]), 1, 2},
+    {PARAM(idxVec[15]), 1, 2}, {PARAM(idxVec[16]), 1, 2}, {PARAM(idxVec[17]), 1, 2},
+    {PARAM(idxVec[18]), 1, 2}, {PARAM(idxVec[19]), 1, 2}, {PARAM(idxVec[20]), 1, 2},
+    {PARAM(idxVec[21]), 1, 2}, {PARAM(idxVec[22]), 1, 2}, {PARAM(idxVec[23]), 1, 2},
+    {PARAM(idxVec[24]), 1, 2}, {PARAM(idxVec[25]), 1, 2}, {PARAM(idxVec[26]), 1, 2},
+    {PARAM(idxVec[27]), 1, 2}, {PARAM(idxVec[28]), 1, 2}, {PARAM(idxVec[29]), 1, 2},
+    {PARAM(idxVec[30]), 1, 2}, {PARAM(idxVec[31]), 1, 2}, {PARAM(idxVec[32]), 1, 2},
+    {PARAM(idxVec[33]), 1, 2}, {PARAM(idxVec[34]), 1, 2}, {PARAM(idxVec[35]), 1, 2},
+    {PARAM(idxVec[36]), 1, 2}, {PARAM(idxVec[37]), 1, 2}, {PARAM(idxVec[38]), 1, 2},
+    {PARAM(idxVec[39]), 1, 2}, {PARAM(idxVec[40]), 1, 2}, {PARAM(idxVec[41]), 1, 2},
+    {PARAM(idxVec[42]), 1, 2}, {PARAM(idxVec[43]), 1, 2}, {PARAM(idxVec[44]), 1, 2},
+    {PARAM(idxVec[45]), 1, 2}, {PARAM(idxVec[46]), 1, 2}, {PARAM(idxVec[47]), 1, 2},
+    {PARAM(idxVec[48]), 1, 2}, {PARAM(idxVec[49]), 1, 2}, {PARAM(idxVec[50]), 1, 2},
+    {PARAM(idxVec[51]), 1, 2}, {PARAM(idxVec[52]), 1, 2}, {PARAM(idxVec[53]), 1, 2},
+    {PARAM(idxVec[54]), 1, 2}, {PARAM(idxVec[55]), 1, 2}, {PARAM(idxVec[56]), 1, 2},
+    {PARAM(idxVec[57]), 1, 2}, {PARAM(extra_cb_index[0]), 2, 1}, {PARAM(extra_gain_index[0]), 1, 3},
+    {PARAM(extra_gain_index[1]), 1, 2}, {PARAM(cb_index[0]), 1, 1}, {PARAM(cb_index[3]), 7, 1},
+    {PARAM(cb_index[6]), 7, 1}, {PARAM(cb_index[9]), 7, 1}, {PARAM(gain_index[0]), 2, 2},
+    {PARAM(gain_index[1]), 2, 1}, {PARAM(gain_index[3]), 2, 3}, {PARAM(gain_index[4]), 2, 2},
+    {PARAM(gain_index[6]), 1, 4}, {PARAM(gain_index[7]), 1, 3}, {PARAM(gain_index[9]), 1, 4},
+    {PARAM(gain_index[10]), 1, 3},
+    /* ULP class 3 */
+    {PARAM(idxVec[0]), 2, 0}, {PARAM(idxVec[1]), 2, 0}, {PARAM(idxVec[2]), 2, 0},
+    {PARAM(idxVec[3]), 2, 0}, {PARAM(idxVec[4]), 2, 0}, {PARAM(idxVec[5]), 2, 0},
+    {PARAM(idxVec[6]), 2, 0}, {PARAM(idxVec[7]), 2, 0}, {PARAM(idxVec[8]), 2, 0},
+    {PARAM(idxVec[9]), 2, 0}, {PARAM(idxVec[10]), 2, 0}, {PARAM(idxVec[11]), 2, 0},
+    {PARAM(idxVec[12]), 2, 0}, {PARAM(idxVec[13]), 2, 0}, {PARAM(idxVec[14]), 2, 0},
+    {PARAM(idxVec[15]), 2, 0}, {PARAM(idxVec[16]), 2, 0}, {PARAM(idxVec[17]), 2, 0},
+    {PARAM(idxVec[18]), 2, 0}, {PARAM(idxVec[19]), 2, 0}, {PARAM(idxVec[20]), 2, 0},
+    {PARAM(idxVec[21]), 2, 0}, {PARAM(idxVec[22]), 2, 0}, {PARAM(idxVec[23]), 2, 0},
+    {PARAM(idxVec[24]), 2, 0}, {PARAM(idxVec[25]), 2, 0}, {PARAM(idxVec[26]), 2, 0},
+    {PARAM(idxVec[27]), 2, 0}, {PARAM(idxVec[28]), 2, 0}, {PARAM(idxVec[29]), 2, 0},
+    {PARAM(idxVec[30]), 2, 0}, {PARAM(idxVec[31]), 2, 0}, {PARAM(idxVec[32]), 2, 0},
+    {PARAM(idxVec[33]), 2, 0}, {PARAM(idxVec[34]), 2, 0}, {PARAM(idxVec[35]), 2, 0},
+    {PARAM(idxVec[36]), 2, 0}, {PARAM(idxVec[37]), 2, 0}, {PARAM(idxVec[38]), 2, 0},
+    {PARAM(idxVec[39]), 2, 0}, {PARAM(idxVec[40]), 2, 0}, {PARAM(idxVec[41]), 2, 0},
+    {PARAM(idxVec[42]), 2, 0}, {PARAM(idxVec[43]), 2, 0}, {PARAM(idxVec[44]), 2, 0},
+    {PARAM(idxVec[45]), 2, 0}, {PARAM(idxVec[46]), 2, 0}, {PARAM(idxVec[47]), 2, 0},
+    {PARAM(idxVec[48]), 2, 0}, {PARAM(idxVec[49]), 2, 0}, {PARAM(idxVec[50]), 2, 0},
+    {PARAM(idxVec[51]), 2, 0}, {PARAM(idxVec[52]), 2, 0}, {PARAM(idxVec[53]), 2, 0},
+    {PARAM(idxVec[54]), 2, 0}, {PARAM(idxVec[55]), 2, 0}, {PARAM(idxVec[56]), 2, 0},
+    {PARAM(idxVec[57]), 2, 0}, {PARAM(extra_cb_index[0]), 1, 0}, {PARAM(extra_cb_index[1]), 7, 0},
+    {PARAM(extra_cb_index[2]), 7, 0}, {PARAM(extra_gain_index[0]), 3, 0},
+    {PARAM(extra_gain_index[1]), 2, 0}, {PARAM(extra_gain_index[2]), 3, 0},
+    {PARAM(cb_index[0]), 1, 0}, {PARAM(cb_index[1]), 7, 0}, {PARAM(cb_index[2]), 7, 0},
+    {PARAM(cb_index[3]), 1, 0}, {PARAM(cb_index[4]), 8, 0}, {PARAM(cb_index[5]), 8, 0},
+    {PARAM(cb_index[6]), 1, 0}, {PARAM(cb_index[7]), 8, 0}, {PARAM(cb_index[8]), 8, 0},
+    {PARAM(cb_index[9]), 1, 0}, {PARAM(cb_index[10]), 8, 0}, {PARAM(cb_index[11]), 8, 0},
+    {PARAM(gain_index[0]), 2, 0}, {PARAM(gain_index[1]), 1, 0}, {PARAM(gain_index[2]), 3, 0},
+    {PARAM(gain_index[3]), 3, 0}, {PARAM(gain_index[4]), 2, 0}, {PARAM(gain_index[5]), 3, 0},
+    {PARAM(gain_index[6]), 4, 0}, {PARAM(gain_index[7]), 3, 0}, {PARAM(gain_index[8]), 3, 0},
+    {PARAM(gain_index[9]), 4, 0}, {PARAM(gain_index[10]), 3, 0}, {PARAM(gain_index[11]), 3, 0},
+    /* Empty frame flag */
+    {PARAM(last_bit), 1, 0}
+};
 
 /*----------------------------------------------------------------*
- *  packing of bits into bitstream, i.e., vector of bytes
+ *  pack the parameters of a frame into bytes
  *---------------------------------------------------------------*/
 
-void dopack(uint8_t **bitstream,    /* (i/o) on entrance pointer to
-                                             place in bitstream to pack
-                                             new data, on exit pointer
-                                             to place in bitstream to
-                                             pack future data */
-           int index,               /* (i) the value to pack */
-           int bitno,               /* (i) the number of bits that the
-                                           value will fit within */
-           int *pos)                /* (i/o) write position in the
-                                             current byte */
+int pack_frame(uint8_t bytes[],                 /* (o) the packed frame */
+               const frame_params_t *params,    /* (i) the frame parameters */
+               int mode)                        /* (i) frame size, 20 or 30 (ms) */
 {
-    int posLeft;
-
-    /* Clear the bits before starting in a new byte */
-    if ((*pos) == 0)
-        **bitstream = 0;
+    const pack_field_t *layout;
+    const int *p;
+    uint8_t *out;
+    uint64_t acc;
+    uint32_t word;
+    int fields;
+    int n;
+    int i;
 
-    while (bitno > 0)
+    if (mode == 30)
     {
-        /* Jump to the next byte if end of this byte is reached*/
-        if (*pos == 8)
-        {
-            *pos = 0;
-            (*bitstream)++;
-            **bitstream = 0;
-        }
-
-        posLeft = 8 - (*pos);
-
-        /* Insert index into the bitstream */
-        if (bitno <= posLeft)
-        {
-            **bitstream |= (uint8_t) (index << (posLeft - bitno));
-            *pos += bitno;
-            bitno = 0;
-        }
-        else
+        layout = pack_layout_30msTbl;
+        fields = PACK_FIELDS_30MS;
+    }
+    else
+    {
+        layout = pack_layout_20msTbl;
+        fields = PACK_FIELDS_20MS;
+    }
+    p = (const int *) params;
+    out = bytes;
+    /* The bits not yet written out are the n least significant bits of acc */
+    acc = 0;
+    n = 0;
+    for (i = 0;  i < fields;  i++)
+    {
+        acc = (acc << layout[i].bits) | ((p[layout[i].param] >> layout[i].shift) & ((1 << layout[i].bits) - 1));
+        if ((n += layout[i].bits) >= 32)
         {
-            **bitstream |= (uint8_t) (index >> (bitno - posLeft));
-            *pos = 8;
-            index -= ((index >> (bitno - posLeft)) << (bitno - posLeft));
-            bitno -= posLeft;
+            n -= 32;
+            word = (uint32_t) (acc >> n);
+            out[0] = (uint8_t) (word >> 24);
+            out[1] = (uint8_t) (word >> 16);
+            out[2] = (uint8_t) (word >> 8);
+            out[3] = (uint8_t) word;
+            out += 4;
         }
     }
+    /* The frames are a whole number of bytes long, so this leaves nothing over */
+    while (n >= 8)
+    {
+        n -= 8;
+        *out++ = (uint8_t) (acc >> n);
+    }
+    return (int) (out - bytes);
 }
 
 /*----------------------------------------------------------------*
- *  unpacking of bits from bitstream, i.e., vector of bytes
+ *  unpack the parameters of a frame from bytes
  *---------------------------------------------------------------*/
 
-void unpack(const uint8_t **bitstream,  /* (i/o) on entrance pointer to
-                                                 place in bitstream to
-                                                 unpack new data from, on
-                                                 exit pointer to place in
-                                                 bitstream to unpack future
-                                                 data from */
-            int *index,                 /* (o) resulting value */
-            int bitno,                  /* (i) number of bits used to represent the value */
-            int *pos)                   /* (i/o) read position in the current byte */
+void unpack_frame(frame_params_t *params,       /* (o) the frame parameters */
+                  const uint8_t bytes[],        /* (i) the packed frame */
+                  int mode)                     /* (i) frame size, 20 or 30 (ms) */
 {
-    int BitsLeft;
+    const pack_field_t *layout;
+    const uint8_t *in;
+    const uint8_t *end;
+    int *p;
+    uint64_t acc;
+    int fields;
+    int n;
+    int i;
 
-    *index = 0;
-    while (bitno > 0)
+    if (mode == 30)
     {
-        /* Move forward in bitstream when the end of the byte is reached */
-        if (*pos == 8)
-        {
-            *pos = 0;
-            (*bitstream)++;
-        }
-
-        BitsLeft = 8 - (*pos);
-
-        /* Extract bits to index */
-        if (BitsLeft >= bitno)
-        {
-            *index += ((((**bitstream) << (*pos)) & 0xFF) >> (8 - bitno));
-
-            *pos += bitno;
-            bitno = 0;
-        }
-        else
+        layout = pack_layout_30msTbl;
+        fields = PACK_FIELDS_30MS;
+        end = bytes + ILBC_NO_OF_BYTES_30MS;
+    }
+    else
+    {
+        layout = pack_layout_20msTbl;
+        fields = PACK_FIELDS_20MS;
+        end = bytes + ILBC_NO_OF_BYTES_20MS;
+    }
+    memset(params, 0, sizeof(*params));
+    p = (int *) params;
+    in = bytes;
+    /* The bits not yet used are the n least significant bits of acc */
+    acc = 0;
+    n = 0;
+    for (i = 0;  i < fields;  i++)
+    {
+        if (n < layout[i].bits)
         {
-            if ((8 - bitno) > 0)
+            if (end - in >= 4)
             {
-                *index += ((((**bitstream) << (*pos)) & 0xFF) >> (8 - bitno));
-                *pos = 8;
+                acc = (acc << 32)
+                    | ((uint32_t) in[0] << 24)
+                    | ((uint32_t) in[1] << 16)
+                    | ((uint32_t) in[2] << 8)
+                    | (uint32_t) in[3];
+                in += 4;
+                n += 32;
             }
             else
             {
-                *index += (((int) (((**bitstream) << (*pos)) & 0xFF)) << (bitno - 8));
-                *pos = 8;
+                while (in < end)
+                {
+                    acc = (acc << 8) | *in++;
+                    n += 8;
+                }
             }
-            bitno -= BitsLeft;
         }
+        n -= layout[i].bits;
+        p[layout[i].param] |= (int) ((acc >> n) & ((1 << layout[i].bits) - 1)) << layout[i].shift;
+    }
+}
+
+/*----------------------------------------------------------------*
+ *  Read n bits, starting at bit pos of the frame, where bit 0 is
+ *  the most significant bit of the first byte
+ *---------------------------------------------------------------*/
+
+static int get_bits(const uint8_t bytes[], int pos, int n)
+{
+    uint32_t acc;
+
+    /* The fields read here are never more than 6 bits, so they lie
+       within two bytes */
+    acc = ((uint32_t) bytes[pos >> 3] << 8) | bytes[(pos >> 3) + 1];
+    return (int) ((acc >> (16 - (pos & 7) - n)) & ((1 << n) - 1));
+}
+
+/*----------------------------------------------------------------*
+ *  unpack just the start state position and scale, and the final
+ *  bit, of a frame. These are whole fields in ULP class 1, at a
+ *  fixed place for each mode, so nothing else need be unpacked.
+ *---------------------------------------------------------------*/
+
+void unpack_frame_info(frame_params_t *params,      /* (o) the frame parameters, of which only start,
+                                                           idxForMax and last_bit are set */
+                       const uint8_t bytes[],       /* (i) the packed frame */
+                       int mode)                    /* (i) frame size, 20 or 30 (ms) */
+{
+    if (mode == 30)
+    {
+        /* After 40 bits of LSF indices: start, state_first, idxForMax */
+        params->start = get_bits(bytes, 40, 3);
+        params->idxForMax = get_bits(bytes, 44, 6);
+        params->last_bit = bytes[ILBC_NO_OF_BYTES_30MS - 1] & 1;
+    }
+    else
+    {
+        /* After 20 bits of LSF indices: start, state_first, idxForMax */
+        params->start = get_bits(bytes, 20, 2);
+        params->idxForMax = get_bits(bytes, 23, 6);
+        params->last_bit = bytes[ILBC_NO_OF_BYTES_20MS - 1] & 1;
     }
 }
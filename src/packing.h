@@ -20,40 +20,34 @@
 #ifndef __PACKING_H
 #define __PACKING_H
 
-void packsplit(int *index,              /* (i) the value to split */
-               int *firstpart,          /* (o) the value specified by most
-                                               significant bits */
-               int *rest,               /* (o) the value specified by least
-                                               significant bits */
-               int bitno_firstpart,     /* (i) number of bits in most
-                                               significant part */
-               int bitno_total          /* (i) number of bits in full range
-                                               of value */
-);
+/* All the parameters carried in one frame. The packing layouts address
+   the members as an array of int, so nothing else may be put in here. */
+typedef struct
+{
+    int lsf_i[LSF_NSPLIT*LPC_N_MAX];
+    int start;
+    int state_first;
+    int idxForMax;
+    int idxVec[STATE_LEN];
+    int extra_cb_index[CB_NSTAGES];
+    int extra_gain_index[CB_NSTAGES];
+    int cb_index[CB_NSTAGES*NASUB_MAX];
+    int gain_index[CB_NSTAGES*NASUB_MAX];
+    /* The final bit of a frame. 1 marks an empty or lost frame */
+    int last_bit;
+} frame_params_t;
 
-void packcombine(int *index,            /* (i/o) the msb value in the combined value out */
-                 int rest,              /* (i) the lsb value */
-                 int bitno_rest);       /* (i) the number of bits in the lsb part */
+int pack_frame(uint8_t bytes[],                 /* (o) the packed frame */
+               const frame_params_t *params,    /* (i) the frame parameters */
+               int mode);                       /* (i) frame size, 20 or 30 (ms) */
 
-void dopack(uint8_t **bitstream,        /* (i/o) on entrance pointer to
-                                                 place in bitstream to pack
-                                                 new data, on exit pointer
-                                                 to place in bitstream to
-                                                 pack future data */
-            int index,                  /* (i) the value to pack */
-            int bitno,                  /* (i) the number of bits that the
-                                               value will fit within */
-            int *pos);                  /* (i/o) write position in the current byte */
+void unpack_frame(frame_params_t *params,       /* (o) the frame parameters */
+                  const uint8_t bytes[],        /* (i) the packed frame */
+                  int mode);                    /* (i) frame size, 20 or 30 (ms) */
 
-void unpack(const uint8_t **bitstream,  /* (i/o) on entrance pointer to
-                                                 place in bitstream to
-                                                 unpack new data from, on
-                                                 exit pointer to place in
-                                                 bitstream to unpack future
-                                                 data from */
-            int *index,                 /* (o) resulting value */
-            int bitno,                  /* (i) number of bits used to
-                                               represent the value */
-            int *pos);                  /* (i/o) read position in the current byte */
+void unpack_frame_info(frame_params_t *params,      /* (o) the frame parameters, of which only start,
+                                                           idxForMax and last_bit are set */
+                       const uint8_t bytes[],       /* (i) the packed frame */
+                       int mode);                   /* (i) frame size, 20 or 30 (ms) */
 
 #endif
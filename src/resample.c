@@ -0,0 +1,168 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * resample.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "constants.h"
+#include "hpInput.h"
+#include "floatToPcm.h"
+#include "resample.h"
+
+/*
+ * A front end for 16, 32 and 48kHz audio. Resampling is usually a
+ * separate pass, with a block of float at 8kHz between it and the codec.
+ * Here the encoder's low pass decimator reads the caller's int16 samples
+ * directly, and feeds each 8kHz sample straight through the input high
+ * pass filter, so the codec gets data it would otherwise have made with
+ * hpInput(). The decoder's interpolator takes the high pass filtered
+ * output a whole frame at a time, and hands the result to the vector
+ * kernels of floatToPcm16() in one call. The filters are symmetric FIRs
+ * run at the low rate, so the encoder only works out the samples it
+ * keeps, and the decoder only multiplies by the samples which are not
+ * the zeros stuffed between them.
+ */
+
+static const float *filter(int factor)
+{
+    if (factor == 2)
+        return resample_x2Tbl;
+    if (factor == 4)
+        return resample_x4Tbl;
+    return resample_x6Tbl;
+}
+
+int resampleFactor(int rate)    /* (i) sample rate, in samples per second */
+{
+    switch (rate)
+    {
+    case 8000:
+        return 1;
+    case 16000:
+        return 2;
+    case 32000:
+        return 4;
+    case 48000:
+        return 6;
+    }
+    return -1;
+}
+
+/*----------------------------------------------------------------*
+ *  Low pass filter and decimate to 8kHz, then high pass filter,
+ *  in one pass
+ *---------------------------------------------------------------*/
+
+void decimateHp(float *out,             /* (o) the 8kHz signal, high pass filtered */
+                const int16_t *in,      /* (i) factor*len samples */
+                int len,                /* (i) number of 8kHz samples to produce */
+                int factor,             /* (i) from resampleFactor() */
+                float *hist,            /* (i/o) the last RESAMPLE_TAPS*factor - 1 input samples */
+                float *hpmem)           /* (i/o) the input high pass filter's state */
+{
+    float x[RESAMPLE_TAPS*RESAMPLE_FACTOR_MAX - 1 + RESAMPLE_FACTOR_MAX*ILBC_BLOCK_LEN_MAX];
+    const float *h;
+    const float *px;
+    float acc;
+    int taps;
+    int i;
+    int k;
+    float y;
+    float m0;
+    float m1;
+    float m2;
+    float m3;
+
+    h = filter(factor);
+    taps = RESAMPLE_TAPS*factor;
+    memcpy(x, hist, (taps - 1)*sizeof(float));
+    for (i = 0;  i < factor*len;  i++)
+        x[taps - 1 + i] = (float) in[i];
+
+    m0 = hpmem[0];
+    m1 = hpmem[1];
+    m2 = hpmem[2];
+    m3 = hpmem[3];
+    for (i = 0;  i < len;  i++)
+    {
+        /* The filter is symmetric, so it need not be reversed */
+        px = &x[i*factor + factor - 1];
+        acc = 0.0f;
+        for (k = 0;  k < taps;  k++)
+            acc += h[k]*px[k];
+        /* The same sums, in the same order, as hpInput() */
+        y = hpi_zero_coefsTbl[0]*acc;
+        y += hpi_zero_coefsTbl[1]*m0;
+        y += hpi_zero_coefsTbl[2]*m1;
+        m1 = m0;
+        m0 = acc;
+        y -= hpi_pole_coefsTbl[1]*m2;
+        y -= hpi_pole_coefsTbl[2]*m3;
+        m3 = m2;
+        m2 = y;
+        out[i] = y;
+    }
+    hpmem[0] = m0;
+    hpmem[1] = m1;
+    hpmem[2] = m2;
+    hpmem[3] = m3;
+    memcpy(hist, &x[factor*len], (taps - 1)*sizeof(float));
+}
+
+/*----------------------------------------------------------------*
+ *  Interpolate from 8kHz, and convert to int16
+ *---------------------------------------------------------------*/
+
+void interpolatePcm(int16_t *out,       /* (o) factor*len samples */
+                    const float *in,    /* (i) the 8kHz signal */
+                    int len,            /* (i) number of 8kHz samples */
+                    int factor,         /* (i) from resampleFactor() */
+                    float *hist)        /* (i/o) the last RESAMPLE_TAPS - 1 8kHz samples */
+{
+    float x[RESAMPLE_TAPS - 1 + ILBC_BLOCK_LEN_MAX];
+    float y[RESAMPLE_FACTOR_MAX*ILBC_BLOCK_LEN_MAX];
+    const float *h;
+    const float *px;
+    float acc;
+    float gain;
+    int i;
+    int j;
+    int p;
+
+    h = filter(factor);
+    gain = (float) factor;
+    memcpy(x, hist, (RESAMPLE_TAPS - 1)*sizeof(float));
+    memcpy(&x[RESAMPLE_TAPS - 1], in, len*sizeof(float));
+    for (i = 0;  i < len;  i++)
+    {
+        /* Each output phase uses every factor'th tap, against the 8kHz
+           samples */
+        px = &x[i + RESAMPLE_TAPS - 1];
+        for (p = 0;  p < factor;  p++)
+        {
+            acc = 0.0f;
+            for (j = 0;  j < RESAMPLE_TAPS;  j++)
+                acc += h[p + j*factor]*px[-j];
+            y[i*factor + p] = acc*gain;
+        }
+    }
+    floatToPcm16(out, y, factor*len);
+    memcpy(hist, &x[len], (RESAMPLE_TAPS - 1)*sizeof(float));
+}
@@ -0,0 +1,33 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * resample.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_RESAMPLE_H
+#define __iLBC_RESAMPLE_H
+
+/* The number of samples at rate for each 8kHz sample, or -1 if rate is not
+   one the front end handles */
+int resampleFactor(int rate);    /* (i) sample rate, in samples per second */
+
+void decimateHp(float *out,             /* (o) the 8kHz signal, high pass filtered */
+                const int16_t *in,      /* (i) factor*len samples */
+                int len,                /* (i) number of 8kHz samples to produce */
+                int factor,             /* (i) from resampleFactor() */
+                float *hist,            /* (i/o) the last RESAMPLE_TAPS*factor - 1 input samples */
+                float *hpmem);          /* (i/o) the input high pass filter's state */
+
+void interpolatePcm(int16_t *out,       /* (o) factor*len samples */
+                    const float *in,    /* (i) the 8kHz signal */
+                    int len,            /* (i) number of 8kHz samples */
+                    int factor,         /* (i) from resampleFactor() */
+                    float *hist);       /* (i/o) the last RESAMPLE_TAPS - 1 8kHz samples */
+
+#endif
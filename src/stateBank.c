@@ -0,0 +1,117 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * stateBank.c - Node local blocks of memory for many codec states.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#endif
+
+#include "ilbc2.h"
+
+#if defined(HAVE_SYS_MMAN_H)  &&  (defined(MAP_ANONYMOUS)  ||  defined(MAP_ANON))
+#define ILBC_BANK_MMAP
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS   MAP_ANON
+#endif
+#endif
+
+/* The usual huge page size, to which a huge page mapping is rounded */
+#define BANK_HUGE_PAGE  (2*1024*1024)
+
+/*
+ * A bank starts with a header, padded to the state alignment, which records
+ * how the bank was obtained, so ilbc_bank_free() can give it back the same
+ * way.
+ */
+typedef struct
+{
+    void *base;
+    size_t len;
+    int mapped;
+} bank_header_t;
+
+#define BANK_HEADER_LEN ((sizeof(bank_header_t) + ILBC_STATE_ALIGNMENT - 1) & ~((size_t) ILBC_STATE_ALIGNMENT - 1))
+
+void *ilbc_bank_alloc(size_t len, int flags)
+{
+    bank_header_t *h;
+    uint8_t *base;
+    size_t total;
+
+    total = BANK_HEADER_LEN + len;
+#if defined(ILBC_BANK_MMAP)
+    base = NULL;
+#if defined(MAP_HUGETLB)
+    if ((flags & ILBC_BANK_HUGE_PAGES))
+    {
+        total = (total + BANK_HUGE_PAGE - 1) & ~((size_t) BANK_HUGE_PAGE - 1);
+        base = (uint8_t *) mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == (uint8_t *) MAP_FAILED)
+        {
+            /* No huge pages are reserved, so fall back to ordinary ones */
+            base = NULL;
+            total = BANK_HEADER_LEN + len;
+        }
+    }
+#endif
+    if (base == NULL)
+    {
+        base = (uint8_t *) mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == (uint8_t *) MAP_FAILED)
+            return NULL;
+#if defined(MADV_HUGEPAGE)
+        if ((flags & ILBC_BANK_HUGE_PAGES))
+            madvise(base, total, MADV_HUGEPAGE);
+#endif
+    }
+    h = (bank_header_t *) base;
+    h->mapped = 1;
+#else
+    (void) flags;
+    if ((base = (uint8_t *) malloc(total + ILBC_STATE_ALIGNMENT - 1)) == NULL)
+        return NULL;
+    h = (bank_header_t *) (((uintptr_t) base + ILBC_STATE_ALIGNMENT - 1) & ~((uintptr_t) ILBC_STATE_ALIGNMENT - 1));
+    h->mapped = 0;
+#endif
+    /* Touch every page here, so the pages come from this thread's node,
+       rather than from whichever thread first uses each state */
+    memset((uint8_t *) h + BANK_HEADER_LEN, 0, len);
+    h->base = base;
+    h->len = total;
+    return (uint8_t *) h + BANK_HEADER_LEN;
+}
+
+void ilbc_bank_free(void *bank)
+{
+    bank_header_t *h;
+
+    if (bank == NULL)
+        return;
+    h = (bank_header_t *) ((uint8_t *) bank - BANK_HEADER_LEN);
+#if defined(ILBC_BANK_MMAP)
+    if (h->mapped)
+    {
+        munmap(h->base, h->len);
+        return;
+    }
+#endif
+    free(h->base);
+}
+/*- End of file ------------------------------------------------------------*/
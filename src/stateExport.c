@@ -0,0 +1,599 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * stateExport.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+
+/*
+ * An exported state is a 6 byte header, followed by the fields which are
+ * not fixed by the frame size mode, in a fixed order. Every value is little
+ * endian, and floats are IEEE 754 single precision, so a state may be moved
+ * between any two machines.
+ *
+ *  0   'i' 'L'
+ *  2   format version
+ *  3   'E' for an encoder, or 'D' for a decoder
+ *  4   frame size mode, 20 or 30
+ *  5   flags, ILBC_EXPORT_xxx
+ *
+ * A history buffer is either a run of floats, or, with
+ * ILBC_EXPORT_QUANTISED, its peak magnitude as a float followed by a run of
+ * 16 bit values scaled to that peak.
+ *
+ * A seek index is a 12 byte header, a table of where each checkpoint
+ * starts, from the start of the index, and the checkpoints, which are
+ * decoder exports. Checkpoint k is the state just before frame
+ * k*interval.
+ *
+ *  0   'i' 'X'
+ *  2   format version
+ *  3   frame size mode, 20 or 30
+ *  4   interval, in frames, 32 bits
+ *  8   number of checkpoints, 32 bits
+ * 12   offset of each checkpoint, 32 bits each
+ */
+
+#define EXPORT_VERSION          1
+#define EXPORT_KIND_ENCODER     'E'
+#define EXPORT_KIND_DECODER     'D'
+#define INDEX_HEADER_LEN        12
+
+/* The comfort noise filter of a new decoder, followed by zeros */
+static const float cng_initTbl[ILBC_LPC_FILTERORDER + 1] =
+{
+    1.0f
+};
+
+typedef struct
+{
+    uint8_t *buf;
+    int len;
+    int pos;
+} export_writer_t;
+
+typedef struct
+{
+    const uint8_t *buf;
+    int len;
+    int pos;
+    int bad;
+} export_reader_t;
+
+/*----------------------------------------------------------------*
+ *  writing. With no buffer, or when it is full, the length is
+ *  still counted, so the size needed can be found.
+ *---------------------------------------------------------------*/
+
+static void put_u8(export_writer_t *w, unsigned int x)
+{
+    if (w->buf  &&  w->pos < w->len)
+        w->buf[w->pos] = (uint8_t) x;
+    w->pos++;
+}
+
+static void put_u16(export_writer_t *w, unsigned int x)
+{
+    put_u8(w, x & 0xFF);
+    put_u8(w, (x >> 8) & 0xFF);
+}
+
+static void put_u32(export_writer_t *w, uint32_t x)
+{
+    put_u16(w, x & 0xFFFF);
+    put_u16(w, (x >> 16) & 0xFFFF);
+}
+
+static void put_floats(export_writer_t *w, const float x[], int len)
+{
+    int i;
+    uint32_t u;
+
+    for (i = 0;  i < len;  i++)
+    {
+        memcpy(&u, &x[i], sizeof(u));
+        put_u32(w, u);
+    }
+}
+
+static void put_history(export_writer_t *w, const float x[], int len, int flags)
+{
+    int i;
+    float peak;
+    float scale;
+
+    if ((flags & ILBC_EXPORT_QUANTISED) == 0)
+    {
+        put_floats(w, x, len);
+        return;
+    }
+    peak = 0.0f;
+    for (i = 0;  i < len;  i++)
+    {
+        if (fabsf(x[i]) > peak)
+            peak = fabsf(x[i]);
+    }
+    put_floats(w, &peak, 1);
+    scale = (peak > 0.0f)  ?  32767.0f/peak  :  0.0f;
+    for (i = 0;  i < len;  i++)
+        put_u16(w, (uint16_t) (int16_t) lrintf(x[i]*scale));
+}
+
+static void put_header(export_writer_t *w, int kind, int mode, int flags)
+{
+    put_u8(w, 'i');
+    put_u8(w, 'L');
+    put_u8(w, EXPORT_VERSION);
+    put_u8(w, kind);
+    put_u8(w, mode);
+    put_u8(w, flags);
+}
+
+static int put_end(export_writer_t *w)
+{
+    if (w->buf  &&  w->pos > w->len)
+        return -1;
+    return w->pos;
+}
+
+/*----------------------------------------------------------------*
+ *  reading. Running off the end gives zeros, and marks the
+ *  data as bad.
+ *---------------------------------------------------------------*/
+
+static unsigned int get_u8(export_reader_t *r)
+{
+    if (r->pos >= r->len)
+    {
+        r->bad = 1;
+        return 0;
+    }
+    return r->buf[r->pos++];
+}
+
+static unsigned int get_u16(export_reader_t *r)
+{
+    unsigned int x;
+
+    x = get_u8(r);
+    return x | (get_u8(r) << 8);
+}
+
+static uint32_t get_u32(export_reader_t *r)
+{
+    uint32_t x;
+
+    x = get_u16(r);
+    return x | ((uint32_t) get_u16(r) << 16);
+}
+
+static void get_floats(export_reader_t *r, float x[], int len)
+{
+    int i;
+    uint32_t u;
+
+    for (i = 0;  i < len;  i++)
+    {
+        u = get_u32(r);
+        memcpy(&x[i], &u, sizeof(u));
+    }
+}
+
+static void get_history(export_reader_t *r, float x[], int len, int flags)
+{
+    int i;
+    float scale;
+
+    if ((flags & ILBC_EXPORT_QUANTISED) == 0)
+    {
+        get_floats(r, x, len);
+        return;
+    }
+    get_floats(r, &scale, 1);
+    scale /= 32767.0f;
+    for (i = 0;  i < len;  i++)
+        x[i] = (float) (int16_t) get_u16(r)*scale;
+}
+
+static int get_header(export_reader_t *r, int kind, int *mode, int *flags)
+{
+    if (get_u8(r) != 'i'  ||  get_u8(r) != 'L')
+        return -1;
+    if (get_u8(r) != EXPORT_VERSION  ||  get_u8(r) != (unsigned int) kind)
+        return -1;
+    *mode = get_u8(r);
+    *flags = get_u8(r);
+    if (r->bad  ||  (*flags & ~ILBC_EXPORT_QUANTISED))
+        return -1;
+    return 0;
+}
+
+/*----------------------------------------------------------------*
+ *  encoder
+ *---------------------------------------------------------------*/
+
+int ilbc_encode_state_export(const ilbc_encode_state_t *s,  /* (i) the encoder state structure */
+                             uint8_t buf[],                 /* (o) the exported state, or NULL */
+                             int len,                       /* (i) room in buf, in bytes */
+                             int flags)                     /* (i) ILBC_EXPORT_xxx */
+{
+    export_writer_t w;
+    int i;
+
+    w.buf = buf;
+    w.len = len;
+    w.pos = 0;
+    put_header(&w, EXPORT_KIND_ENCODER, s->mode, flags);
+    put_u8(&w, s->complexity);
+    put_floats(&w, s->anaMem, ILBC_LPC_FILTERORDER);
+    put_floats(&w, s->hpimem, 4);
+    put_floats(&w, s->lsfold, ILBC_LPC_FILTERORDER);
+    put_floats(&w, s->lsfdeqold, ILBC_LPC_FILTERORDER);
+    put_floats(&w, &s->vad_noise, 1);
+    put_u32(&w, (uint32_t) s->vad_hangover);
+    put_u32(&w, (uint32_t) s->sid_age);
+    put_floats(&w, &s->sid_energy, 1);
+    /* Only the start of the LPC buffer is carried from frame to frame */
+    put_history(&w, s->lpc_buffer, LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - s->blockl, flags);
+    /* The samples held by ilbc_encode_stream() came in as 16 bit samples */
+    put_u16(&w, s->stream_fill);
+    for (i = 0;  i < s->stream_fill;  i++)
+        put_u16(&w, (uint16_t) (int16_t) s->stream_block[i]);
+    return put_end(&w);
+}
+
+ilbc_encode_state_t *ilbc_encode_state_import(ilbc_encode_state_t *s,   /* (o) the encoder state structure */
+                                              const uint8_t buf[],      /* (i) the exported state */
+                                              int len)                  /* (i) length of buf, in bytes */
+{
+    ilbc_encode_state_t t;
+    export_reader_t r;
+    int mode;
+    int flags;
+    int i;
+
+    r.buf = buf;
+    r.len = len;
+    r.pos = 0;
+    r.bad = 0;
+    if (get_header(&r, EXPORT_KIND_ENCODER, &mode, &flags) < 0)
+        return NULL;
+    /* Build the state aside, so a bad export leaves s alone */
+    if (ilbc_encode_init(&t, mode) == NULL)
+        return NULL;
+    t.complexity = get_u8(&r);
+    get_floats(&r, t.anaMem, ILBC_LPC_FILTERORDER);
+    get_floats(&r, t.hpimem, 4);
+    get_floats(&r, t.lsfold, ILBC_LPC_FILTERORDER);
+    get_floats(&r, t.lsfdeqold, ILBC_LPC_FILTERORDER);
+    get_floats(&r, &t.vad_noise, 1);
+    t.vad_hangover = (int32_t) get_u32(&r);
+    t.sid_age = (int32_t) get_u32(&r);
+    get_floats(&r, &t.sid_energy, 1);
+    get_history(&r, t.lpc_buffer, LPC_LOOKBACK + ILBC_BLOCK_LEN_MAX - t.blockl, flags);
+    t.stream_fill = get_u16(&r);
+    if (t.stream_fill >= t.blockl)
+        return NULL;
+    for (i = 0;  i < t.stream_fill;  i++)
+        t.stream_block[i] = (float) (int16_t) get_u16(&r);
+    if (r.bad  ||  r.pos != len  ||  t.complexity > ILBC_COMPLEXITY_LOWEST)
+        return NULL;
+    /* The counters belong to this instance, not the exported one */
+    t.stats = s->stats;
+    t.alloc_base = s->alloc_base;
+    memcpy(s, &t, sizeof(t));
+    return s;
+}
+
+/*----------------------------------------------------------------*
+ *  encoder fan-out. Two encoders with the same fingerprint code the
+ *  same speech to the same bytes, so their listeners can share one.
+ *---------------------------------------------------------------*/
+
+/* Room for the largest unquantised encoder export */
+#define FINGERPRINT_BUF_LEN     2048
+
+static uint32_t fnv1a(uint32_t h, const uint8_t buf[], int len)
+{
+    int i;
+
+    for (i = 0;  i < len;  i++)
+    {
+        h ^= buf[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+uint32_t ilbc_encode_fingerprint(const ilbc_encode_state_t *s)  /* (i) the encoder state structure */
+{
+    uint8_t buf[FINGERPRINT_BUF_LEN];
+    uint32_t h;
+    int len;
+
+    /* Everything which decides what comes out next is in the export,
+       except the resampler's history */
+    len = ilbc_encode_state_export(s, buf, FINGERPRINT_BUF_LEN, 0);
+    h = fnv1a(2166136261U, buf, len);
+    h = fnv1a(h, (const uint8_t *) &s->resample_rate, sizeof(s->resample_rate));
+    if (s->resample_rate != 8000)
+        h = fnv1a(h, (const uint8_t *) s->resample_hist, sizeof(s->resample_hist));
+    return h;
+}
+
+ilbc_encode_state_t *ilbc_encode_clone(ilbc_encode_state_t *dst,          /* (o) the new encoder */
+                                       const ilbc_encode_state_t *src)    /* (i) the encoder to copy */
+{
+    ilbc_stats_t stats;
+    void *alloc_base;
+
+    if (dst == src)
+        return dst;
+    /* The counters and the memory belong to dst */
+    stats = dst->stats;
+    alloc_base = dst->alloc_base;
+    memcpy(dst, src, sizeof(*dst));
+    dst->stats = stats;
+    dst->alloc_base = alloc_base;
+    return dst;
+}
+
+/*----------------------------------------------------------------*
+ *  decoder
+ *---------------------------------------------------------------*/
+
+int ilbc_decode_state_export(const ilbc_decode_state_t *s,  /* (i) the decoder state structure */
+                             uint8_t buf[],                 /* (o) the exported state, or NULL */
+                             int len,                       /* (i) room in buf, in bytes */
+                             int flags)                     /* (i) ILBC_EXPORT_xxx */
+{
+    export_writer_t w;
+    int i;
+
+    w.buf = buf;
+    w.len = len;
+    w.pos = 0;
+    put_header(&w, EXPORT_KIND_DECODER, s->mode, flags);
+    put_u8(&w, s->use_enhancer);
+    put_u16(&w, s->last_lag);
+    put_u16(&w, s->prevLag);
+    put_u32(&w, (uint32_t) s->consPLICount);
+    put_u8(&w, s->prevPLI);
+    put_u8(&w, s->prev_enh_pl);
+    put_floats(&w, &s->per, 1);
+    put_u32(&w, (uint32_t) s->seed);
+    put_floats(&w, s->syntMem, ILBC_LPC_FILTERORDER);
+    put_floats(&w, s->hpomem, 4);
+    put_floats(&w, s->lsfdeqold, ILBC_LPC_FILTERORDER);
+    put_floats(&w, s->prevLpc, ILBC_LPC_FILTERORDER + 1);
+    put_floats(&w, s->old_syntdenum, s->nsub*(ILBC_LPC_FILTERORDER + 1));
+    put_history(&w, s->prevResidual, s->blockl, flags);
+    /* The enhancer's history is never looked at when it is off */
+    if (s->use_enhancer)
+    {
+        put_history(&w, s->enh_buf, ENH_BUFL, flags);
+        put_floats(&w, s->enh_period, ENH_NBLOCKS_TOT);
+    }
+    if (s->full_state)
+    {
+        put_floats(&w, s->cng_a, ILBC_LPC_FILTERORDER + 1);
+        put_floats(&w, s->cng_mem, ILBC_LPC_FILTERORDER);
+        put_floats(&w, &s->cng_gain, 1);
+        put_floats(&w, &s->cng_target, 1);
+    }
+    else
+    {
+        /* A compact state has no comfort noise, so give what a new one has */
+        put_floats(&w, cng_initTbl, ILBC_LPC_FILTERORDER + 1);
+        put_floats(&w, cng_initTbl + 1, ILBC_LPC_FILTERORDER);
+        put_floats(&w, cng_initTbl + 1, 2);
+    }
+    put_u16(&w, s->stream_len - s->stream_pos);
+    for (i = s->stream_pos;  i < s->stream_len;  i++)
+        put_u16(&w, (uint16_t) s->stream_buf[i]);
+    return put_end(&w);
+}
+
+ilbc_decode_state_t *ilbc_decode_state_import(ilbc_decode_state_t *s,   /* (o) the decoder state structure */
+                                              const uint8_t buf[],      /* (i) the exported state */
+                                              int len)                  /* (i) length of buf, in bytes */
+{
+    ilbc_decode_state_t t;
+    export_reader_t r;
+    int mode;
+    int flags;
+    int use_enhancer;
+    int i;
+
+    r.buf = buf;
+    r.len = len;
+    r.pos = 0;
+    r.bad = 0;
+    if (get_header(&r, EXPORT_KIND_DECODER, &mode, &flags) < 0)
+        return NULL;
+    use_enhancer = get_u8(&r);
+    if (use_enhancer > ILBC_ENHANCER_MINIMAL)
+        return NULL;
+    /* Build the state aside, so a bad export leaves s alone */
+    if (ilbc_decode_init(&t, mode, use_enhancer) == NULL)
+        return NULL;
+    t.last_lag = get_u16(&r);
+    t.prevLag = get_u16(&r);
+    t.consPLICount = (int) get_u32(&r);
+    t.prevPLI = get_u8(&r);
+    t.prev_enh_pl = get_u8(&r);
+    get_floats(&r, &t.per, 1);
+    t.seed = get_u32(&r);
+    get_floats(&r, t.syntMem, ILBC_LPC_FILTERORDER);
+    get_floats(&r, t.hpomem, 4);
+    get_floats(&r, t.lsfdeqold, ILBC_LPC_FILTERORDER);
+    get_floats(&r, t.prevLpc, ILBC_LPC_FILTERORDER + 1);
+    get_floats(&r, t.old_syntdenum, t.nsub*(ILBC_LPC_FILTERORDER + 1));
+    get_history(&r, t.prevResidual, t.blockl, flags);
+    if (use_enhancer)
+    {
+        get_history(&r, t.enh_buf, ENH_BUFL, flags);
+        get_floats(&r, t.enh_period, ENH_NBLOCKS_TOT);
+    }
+    get_floats(&r, t.cng_a, ILBC_LPC_FILTERORDER + 1);
+    get_floats(&r, t.cng_mem, ILBC_LPC_FILTERORDER);
+    get_floats(&r, &t.cng_gain, 1);
+    get_floats(&r, &t.cng_target, 1);
+    t.stream_len = get_u16(&r);
+    if (t.stream_len >= t.blockl)
+        return NULL;
+    for (i = 0;  i < t.stream_len;  i++)
+        t.stream_buf[i] = (int16_t) get_u16(&r);
+    /* The lags index back into the history, so they must be in range */
+    if (r.bad  ||  r.pos != len  ||  t.consPLICount < 0)
+        return NULL;
+    if (t.last_lag < 4  ||  t.last_lag > t.blockl - 3  ||  t.prevLag < 1  ||  t.prevLag > t.blockl)
+        return NULL;
+    /* A compact state has no room for the enhancer, or for streamed samples.
+       Nor does it have comfort noise, so that state is dropped. */
+    if (!s->full_state  &&  (use_enhancer  ||  t.stream_len > 0))
+        return NULL;
+    /* The counters belong to this instance, not the exported one */
+    t.stats = s->stats;
+    t.alloc_base = s->alloc_base;
+    t.full_state = s->full_state;
+    memcpy(s, &t, (s->full_state)  ?  sizeof(t)  :  offsetof(ilbc_decode_state_t, stream_buf));
+    return s;
+}
+
+/*----------------------------------------------------------------*
+ *  seek index
+ *---------------------------------------------------------------*/
+
+int ilbc_seek_index_build(uint8_t index[],          /* (o) the index, or NULL */
+                          int index_len,            /* (i) room in index, in bytes */
+                          const uint8_t bytes[],    /* (i) the recording, frames one after another */
+                          int len,                  /* (i) length of the recording, in bytes */
+                          int mode,                 /* (i) frame size mode */
+                          int use_enhancer,         /* (i) ILBC_ENHANCER_xxx */
+                          int interval,             /* (i) frames between checkpoints */
+                          int flags)                /* (i) ILBC_EXPORT_xxx */
+{
+    ilbc_decode_state_t s;
+    export_writer_t w;
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    int frames;
+    int count;
+    int pos;
+    int n;
+    int i;
+
+    if (interval <= 0  ||  ilbc_decode_init(&s, mode, use_enhancer) == NULL  ||  len%s.no_of_bytes)
+        return -1;
+    frames = len/s.no_of_bytes;
+    count = (frames + interval - 1)/interval;
+    w.buf = index;
+    w.len = index_len;
+    w.pos = 0;
+    put_u8(&w, 'i');
+    put_u8(&w, 'X');
+    put_u8(&w, EXPORT_VERSION);
+    put_u8(&w, mode);
+    put_u32(&w, interval);
+    put_u32(&w, count);
+    /* The table is filled in as the checkpoints are written */
+    pos = INDEX_HEADER_LEN + 4*count;
+    for (i = 0;  i < frames;  i++)
+    {
+        if (i%interval == 0)
+        {
+            put_u32(&w, pos);
+            /* Only the length is wanted when the index won't fit */
+            if (index  &&  pos < index_len)
+                n = ilbc_decode_state_export(&s, index + pos, index_len - pos, flags);
+            else
+                n = ilbc_decode_state_export(&s, NULL, 0, flags);
+            if (n < 0)
+                n = ilbc_decode_state_export(&s, NULL, 0, flags);
+            pos += n;
+        }
+        ilbc_decode(&s, amp, bytes + i*s.no_of_bytes, s.no_of_bytes);
+    }
+    if (index  &&  pos > index_len)
+        return -1;
+    return pos;
+}
+
+int ilbc_decode_seek(ilbc_decode_state_t *s,    /* (i/o) the decoder state structure */
+                     const uint8_t bytes[],     /* (i) the recording, frames one after another */
+                     int len,                   /* (i) length of the recording, in bytes */
+                     int frame,                 /* (i) the frame to be decoded next */
+                     const uint8_t index[],     /* (i) the recording's seek index, or NULL */
+                     int index_len,             /* (i) length of the index, in bytes */
+                     int warmup)                /* (i) frames to decode first, without an index */
+{
+    export_reader_t r;
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    uint32_t interval;
+    uint32_t count;
+    uint32_t k;
+    uint32_t start;
+    uint32_t end;
+    int from;
+    int i;
+
+    if (frame < 0  ||  (frame + 1)*s->no_of_bytes > len)
+        return -1;
+    if (index == NULL)
+    {
+        /* Fast converge. The decoder's memory is short, so a few frames
+           of warm up bring it close to where a full decode would be. */
+        if (warmup < 0)
+            return -1;
+        from = (frame > warmup)  ?  (frame - warmup)  :  0;
+        ilbc_decode_reset(s);
+    }
+    else
+    {
+        r.buf = index;
+        r.len = index_len;
+        r.pos = 0;
+        r.bad = 0;
+        if (get_u8(&r) != 'i'  ||  get_u8(&r) != 'X'  ||  get_u8(&r) != EXPORT_VERSION)
+            return -1;
+        if ((int) get_u8(&r) != s->mode)
+            return -1;
+        interval = get_u32(&r);
+        count = get_u32(&r);
+        if (r.bad  ||  interval == 0)
+            return -1;
+        k = frame/interval;
+        if (k >= count  ||  INDEX_HEADER_LEN + 4*(k + 1) > (uint32_t) index_len)
+            return -1;
+        r.pos = INDEX_HEADER_LEN + 4*k;
+        start = get_u32(&r);
+        end = (k + 1 < count)  ?  get_u32(&r)  :  (uint32_t) index_len;
+        if (start < INDEX_HEADER_LEN + 4*count  ||  end < start  ||  end > (uint32_t) index_len)
+            return -1;
+        if (ilbc_decode_state_import(s, index + start, end - start) == NULL)
+            return -1;
+        from = k*interval;
+    }
+    for (i = from;  i < frame;  i++)
+        ilbc_decode(s, amp, bytes + i*s->no_of_bytes, s->no_of_bytes);
+    return frame - from;
+}
@@ -0,0 +1,123 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * timeScale.c - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+#include "ilbc2.h"
+#include "iLBC_define.h"
+#include "timeScale.h"
+
+/*----------------------------------------------------------------*
+ *  Find the lag, close to the decoder's pitch estimate, at which
+ *  the first two periods of a block are most alike. Returns the
+ *  normalised correlation at that lag.
+ *---------------------------------------------------------------*/
+
+static float best_period(const float in[],  /* (i) the block */
+                         int len,           /* (i) length of the block */
+                         int *lag)          /* (i/o) the pitch estimate in, the best lag out */
+{
+    int l;
+    int lo;
+    int hi;
+    int k;
+    float cc;
+    float ea;
+    float eb;
+    float r;
+    float best;
+
+    lo = *lag - TSM_SLOP;
+    hi = *lag + TSM_SLOP;
+    if (lo < TSM_MIN_LAG)
+        lo = TSM_MIN_LAG;
+    if (hi > len/2)
+        hi = len/2;
+    best = -1.0f;
+    for (l = lo;  l <= hi;  l++)
+    {
+        cc = 0.0f;
+        ea = 0.0f;
+        eb = 0.0f;
+        for (k = 0;  k < l;  k++)
+        {
+            cc += in[k]*in[k + l];
+            ea += in[k]*in[k];
+            eb += in[k + l]*in[k + l];
+        }
+        /* Very quiet periods can be joined wherever we like */
+        if (ea < TSM_QUIET_ENERGY*l  &&  eb < TSM_QUIET_ENERGY*l)
+            r = 1.0f;
+        else if (ea > 0.0f  &&  eb > 0.0f)
+            r = cc/sqrtf(ea*eb);
+        else
+            r = 0.0f;
+        if (r > best)
+        {
+            best = r;
+            *lag = l;
+        }
+    }
+    return best;
+}
+
+/*----------------------------------------------------------------*
+ *  Remove or repeat one pitch period of a block, cross fading
+ *  between neighbouring periods so the joins are smooth. Returns
+ *  the number of samples in the result, which is len if the block
+ *  is not periodic enough to be changed.
+ *---------------------------------------------------------------*/
+
+int timeScale(float out[],          /* (o) the result, with room for len + lag samples */
+              const float in[],     /* (i) the block */
+              int len,              /* (i) length of the block */
+              int lag,              /* (i) the decoder's pitch estimate */
+              int action)           /* (i) ILBC_TSM_xxx */
+{
+    int k;
+    float w;
+    float step;
+
+    if (action == ILBC_TSM_NORMAL
+        ||
+        2*(lag - TSM_SLOP) > len
+        ||
+        best_period(in, len, &lag) < TSM_MIN_CORR)
+    {
+        memmove(out, in, len*sizeof(float));
+        return len;
+    }
+    step = 1.0f/(float) lag;
+    if (action == ILBC_TSM_ACCELERATE)
+    {
+        /* Fade from the first period into the second, and drop one */
+        for (k = 0, w = 0.0f;  k < lag;  k++, w += step)
+            out[k] = (1.0f - w)*in[k] + w*in[k + lag];
+        memmove(out + lag, in + 2*lag, (len - 2*lag)*sizeof(float));
+        return len - lag;
+    }
+    /* Keep the first period, then fade from the second back into the first,
+       which leads on into the second again */
+    memmove(out + 2*lag, in + lag, (len - lag)*sizeof(float));
+    for (k = 0, w = 0.0f;  k < lag;  k++, w += step)
+        out[lag + k] = (1.0f - w)*in[k + lag] + w*in[k];
+    memmove(out, in, lag*sizeof(float));
+    return len + lag;
+}
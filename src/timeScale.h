@@ -0,0 +1,22 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * timeScale.h - The iLBC low bit rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __iLBC_TIMESCALE_H
+#define __iLBC_TIMESCALE_H
+
+int timeScale(float out[],          /* (o) the result, with room for len + lag samples */
+              const float in[],     /* (i) the block */
+              int len,              /* (i) length of the block */
+              int lag,              /* (i) the decoder's pitch estimate */
+              int action);          /* (i) ILBC_TSM_xxx */
+
+#endif
@@ -0,0 +1,495 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_api_tests.c - Test the behaviour of the iLBC library's extended API.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page ilbc_api_tests_page iLBC API tests
+\section ilbc_api_tests_page_sec_1 What does it do?
+Each of the calls beyond plain encoding and decoding is checked against
+what plain encoding and decoding give for the same speech. Batch decoding
+must match decoding each channel separately. An exported, imported or
+cloned state must carry on exactly as the original. A rewound decoder must
+carry on as if the rewound frame had never been seen. The other calls are
+checked for the lengths they give, and for the cases they must refuse.
+
+\section ilbc_api_tests_page_sec_2 How is it used?
+ilbc_api_tests [speech file]. The speech is 16 bit 8kHz PCM, and defaults
+to ../localtests/iLBC.INP. The program returns non-zero if any test fails.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "ilbc.h"
+
+#define IN_FILE_NAME            "../localtests/iLBC.INP"
+
+#define MAX_SAMPLES             200000
+#define BATCH_CHANNELS          11
+#define SILENT_FRAMES           100
+
+static int16_t speech[MAX_SAMPLES];
+static int speech_len;
+
+/* Lose some frames, in a pattern which differs between channels */
+static int lost(int frame, int channel)
+{
+    return ((frame*7 + channel*13)%17) == 0;
+}
+
+static int report(const char *name, int mode, int failures)
+{
+    printf("%-28s %dms: %s\n", name, mode, (failures)  ?  "failed"  :  "OK");
+    return (failures)  ?  1  :  0;
+}
+
+static uint8_t *encode_speech(int mode, int *frames)
+{
+    ilbc_encode_state_t enc;
+    uint8_t *bytes;
+    int blockl;
+
+    ilbc_encode_init(&enc, mode);
+    blockl = enc.blockl;
+    *frames = speech_len/blockl;
+    if ((bytes = (uint8_t *) malloc(*frames*enc.no_of_bytes)) == NULL)
+        return NULL;
+    ilbc_encode(&enc, bytes, speech, *frames*blockl);
+    return bytes;
+}
+
+/* ilbc_decode_batch() must match ilbc_decode() and ilbc_fillin() on each
+   channel, with losses, an enhanced channel and compact channels */
+static int test_batch(int mode)
+{
+    ilbc_decode_state_t *serial[BATCH_CHANNELS];
+    ilbc_decode_state_t *batch[BATCH_CHANNELS];
+    int16_t serial_out[BATCH_CHANNELS][ILBC_BLOCK_LEN_MAX];
+    int16_t batch_out[BATCH_CHANNELS][ILBC_BLOCK_LEN_MAX];
+    int16_t *amp[BATCH_CHANNELS];
+    const uint8_t *in[BATCH_CHANNELS];
+    uint8_t *bytes;
+    int use_enhancer;
+    int frames;
+    int no_of_bytes;
+    int blockl;
+    int failures;
+    int frame;
+    int i;
+    int c;
+
+    if ((bytes = encode_speech(mode, &frames)) == NULL)
+        return report("Batch decode", mode, 1);
+    for (c = 0;  c < BATCH_CHANNELS;  c++)
+    {
+        use_enhancer = (c == 3)  ?  ILBC_ENHANCER_FULL  :  ILBC_ENHANCER_OFF;
+        serial[c] = ilbc_decode_alloc(mode, use_enhancer);
+        if (c == 5  ||  c == 7)
+            batch[c] = ilbc_decode_alloc_compact(mode);
+        else
+            batch[c] = ilbc_decode_alloc(mode, use_enhancer);
+    }
+    blockl = serial[0]->blockl;
+    no_of_bytes = serial[0]->no_of_bytes;
+    failures = 0;
+    for (i = 0;  i < frames;  i++)
+    {
+        for (c = 0;  c < BATCH_CHANNELS;  c++)
+        {
+            frame = (i + c*37)%frames;
+            in[c] = (lost(i, c)  &&  c != 0)  ?  NULL  :  bytes + frame*no_of_bytes;
+            amp[c] = batch_out[c];
+            if (in[c])
+                ilbc_decode(serial[c], serial_out[c], in[c], no_of_bytes);
+            else
+                ilbc_fillin(serial[c], serial_out[c], no_of_bytes);
+        }
+        if (ilbc_decode_batch(batch, amp, in, no_of_bytes, BATCH_CHANNELS) != blockl)
+            failures++;
+        for (c = 0;  c < BATCH_CHANNELS;  c++)
+        {
+            if (memcmp(serial_out[c], batch_out[c], blockl*sizeof(int16_t)))
+                failures++;
+        }
+    }
+    for (c = 0;  c < BATCH_CHANNELS;  c++)
+    {
+        ilbc_decode_free(serial[c]);
+        ilbc_decode_free(batch[c]);
+    }
+    free(bytes);
+    return report("Batch decode", mode, failures);
+}
+
+/* An exported and imported state, or a clone, must carry on exactly as the
+   state it came from */
+static int test_export_import(int mode)
+{
+    ilbc_encode_state_t enc;
+    ilbc_encode_state_t enc_copy;
+    ilbc_encode_state_t enc_clone;
+    ilbc_decode_state_t dec;
+    ilbc_decode_state_t dec_copy;
+    uint8_t state[8192];
+    uint8_t out[ILBC_NO_OF_BYTES_MAX];
+    uint8_t out_copy[ILBC_NO_OF_BYTES_MAX];
+    uint8_t out_clone[ILBC_NO_OF_BYTES_MAX];
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    int16_t amp_copy[ILBC_BLOCK_LEN_MAX];
+    uint8_t *bytes;
+    int frames;
+    int blockl;
+    int no_of_bytes;
+    int failures;
+    int len;
+    int i;
+
+    failures = 0;
+    ilbc_encode_init(&enc, mode);
+    blockl = enc.blockl;
+    no_of_bytes = enc.no_of_bytes;
+    frames = speech_len/blockl;
+    for (i = 0;  i < frames/2;  i++)
+        ilbc_encode(&enc, out, speech + i*blockl, blockl);
+    /* The copies start in the other mode, which the import must put right */
+    ilbc_encode_init(&enc_copy, 50 - mode);
+    ilbc_encode_init(&enc_clone, mode);
+    if ((len = ilbc_encode_state_export(&enc, state, sizeof(state), 0)) < 0
+        ||
+        ilbc_encode_state_import(&enc_copy, state, len) != &enc_copy)
+    {
+        failures++;
+    }
+    ilbc_encode_clone(&enc_clone, &enc);
+    for (  ;  i < frames;  i++)
+    {
+        ilbc_encode(&enc, out, speech + i*blockl, blockl);
+        ilbc_encode(&enc_copy, out_copy, speech + i*blockl, blockl);
+        ilbc_encode(&enc_clone, out_clone, speech + i*blockl, blockl);
+        if (memcmp(out, out_copy, no_of_bytes)  ||  memcmp(out, out_clone, no_of_bytes))
+            failures++;
+    }
+
+    if ((bytes = encode_speech(mode, &frames)) == NULL)
+        return report("Export, import and clone", mode, 1);
+    ilbc_decode_init(&dec, mode, ILBC_ENHANCER_FULL);
+    ilbc_decode_init(&dec_copy, 50 - mode, ILBC_ENHANCER_OFF);
+    for (i = 0;  i < frames/2;  i++)
+    {
+        if (lost(i, 1))
+            ilbc_fillin(&dec, amp, no_of_bytes);
+        else
+            ilbc_decode(&dec, amp, bytes + i*no_of_bytes, no_of_bytes);
+    }
+    if ((len = ilbc_decode_state_export(&dec, state, sizeof(state), 0)) < 0
+        ||
+        ilbc_decode_state_import(&dec_copy, state, len) != &dec_copy)
+    {
+        failures++;
+    }
+    for (  ;  i < frames;  i++)
+    {
+        if (lost(i, 1))
+        {
+            ilbc_fillin(&dec, amp, no_of_bytes);
+            ilbc_fillin(&dec_copy, amp_copy, no_of_bytes);
+        }
+        else
+        {
+            ilbc_decode(&dec, amp, bytes + i*no_of_bytes, no_of_bytes);
+            ilbc_decode(&dec_copy, amp_copy, bytes + i*no_of_bytes, no_of_bytes);
+        }
+        if (memcmp(amp, amp_copy, blockl*sizeof(int16_t)))
+            failures++;
+    }
+    /* A damaged export must be refused, leaving the state alone */
+    state[len/2] ^= 0xFF;
+    if (ilbc_decode_state_import(&dec_copy, state, len - 1) != NULL)
+        failures++;
+    free(bytes);
+    return report("Export, import and clone", mode, failures);
+}
+
+/* Concealing a frame, then rewinding and decoding it when it turns up late,
+   must give what decoding it in the first place gives */
+static int test_rewind(int mode)
+{
+    ilbc_decode_state_t dec;
+    ilbc_decode_state_t ref;
+    ilbc_decode_checkpoint_t cp;
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    int16_t amp_ref[ILBC_BLOCK_LEN_MAX];
+    uint8_t *bytes;
+    int frames;
+    int blockl;
+    int no_of_bytes;
+    int failures;
+    int i;
+
+    if ((bytes = encode_speech(mode, &frames)) == NULL)
+        return report("Checkpoint and rewind", mode, 1);
+    ilbc_decode_init(&dec, mode, ILBC_ENHANCER_FULL);
+    ilbc_decode_init(&ref, mode, ILBC_ENHANCER_FULL);
+    blockl = dec.blockl;
+    no_of_bytes = dec.no_of_bytes;
+    failures = 0;
+    for (i = 0;  i < frames;  i++)
+    {
+        if (lost(i, 2))
+        {
+            ilbc_decode_checkpoint(&dec, &cp);
+            ilbc_fillin(&dec, amp, no_of_bytes);
+            if (ilbc_decode_rewind(&dec, &cp))
+                failures++;
+        }
+        ilbc_decode(&dec, amp, bytes + i*no_of_bytes, no_of_bytes);
+        ilbc_decode(&ref, amp_ref, bytes + i*no_of_bytes, no_of_bytes);
+        if (memcmp(amp, amp_ref, blockl*sizeof(int16_t)))
+            failures++;
+    }
+    /* A checkpoint more than one frame old must be refused */
+    ilbc_decode_checkpoint(&dec, &cp);
+    ilbc_fillin(&dec, amp, no_of_bytes);
+    ilbc_fillin(&dec, amp, no_of_bytes);
+    if (ilbc_decode_rewind(&dec, &cp) == 0)
+        failures++;
+    free(bytes);
+    return report("Checkpoint and rewind", mode, failures);
+}
+
+/* Changing mode part way through must give frames of the new length, which
+   a decoder changing mode at the same point decodes */
+static int test_set_mode(int mode)
+{
+    ilbc_encode_state_t enc;
+    ilbc_decode_state_t dec;
+    uint8_t out[ILBC_NO_OF_BYTES_MAX];
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    int failures;
+    int other;
+    int pos;
+    int i;
+
+    failures = 0;
+    other = 50 - mode;
+    ilbc_encode_init(&enc, mode);
+    ilbc_decode_init(&dec, mode, ILBC_ENHANCER_FULL);
+    if (ilbc_encode_set_mode(&enc, 25) == 0  ||  ilbc_decode_set_mode(&dec, 25) == 0)
+        failures++;
+    for (pos = 0, i = 0;  i < 100;  i++)
+    {
+        if (i == 50)
+        {
+            if (ilbc_encode_set_mode(&enc, other)  ||  ilbc_decode_set_mode(&dec, other))
+                failures++;
+        }
+        if (ilbc_encode(&enc, out, speech + pos, enc.blockl) != enc.no_of_bytes)
+            failures++;
+        if (ilbc_decode(&dec, amp, out, enc.no_of_bytes) != enc.blockl)
+            failures++;
+        pos += enc.blockl;
+    }
+    if (enc.mode != other  ||  dec.mode != other  ||  enc.blockl != dec.blockl)
+        failures++;
+    return report("Change of mode", mode, failures);
+}
+
+/* Resampled encoding at 8kHz is plain encoding. At other rates it gives a
+   whole number of frames, and leaves silence detection as ilbc_encode()
+   would, so an exported copy carries on in step. */
+static int test_resampled(int mode)
+{
+    ilbc_encode_state_t enc;
+    ilbc_encode_state_t ref;
+    ilbc_encode_state_t copy;
+    int16_t wide[2*ILBC_BLOCK_LEN_MAX];
+    int16_t silence[ILBC_BLOCK_LEN_MAX];
+    uint8_t state[8192];
+    uint8_t out[ILBC_NO_OF_BYTES_MAX];
+    uint8_t out_ref[ILBC_NO_OF_BYTES_MAX];
+    int blockl;
+    int no_of_bytes;
+    int failures;
+    int len;
+    int i;
+    int j;
+
+    failures = 0;
+    ilbc_encode_init(&enc, mode);
+    ilbc_encode_init(&ref, mode);
+    blockl = enc.blockl;
+    no_of_bytes = enc.no_of_bytes;
+    for (i = 0;  i < 50;  i++)
+    {
+        ilbc_encode_resampled(&enc, out, speech + i*blockl, blockl, 8000);
+        ilbc_encode(&ref, out_ref, speech + i*blockl, blockl);
+        if (memcmp(out, out_ref, no_of_bytes))
+            failures++;
+    }
+    if (ilbc_encode_resampled(&enc, out, speech, blockl, 11025) >= 0)
+        failures++;
+    if (ilbc_encode_resampled(&enc, out, speech, blockl, 16000) >= 0)
+        failures++;
+
+    /* Settle into digital silence, then send speech at 16kHz */
+    memset(silence, 0, sizeof(silence));
+    for (i = 0;  i < 10;  i++)
+        ilbc_encode(&enc, out, silence, blockl);
+    for (i = 0;  i < 5;  i++)
+    {
+        for (j = 0;  j < 2*blockl;  j++)
+            wide[j] = speech[(i + 20)*blockl + j/2];
+        if (ilbc_encode_resampled(&enc, out, wide, 2*blockl, 16000) != no_of_bytes)
+            failures++;
+    }
+    ilbc_encode_init(&copy, mode);
+    if ((len = ilbc_encode_state_export(&enc, state, sizeof(state), 0)) < 0
+        ||
+        ilbc_encode_state_import(&copy, state, len) != &copy)
+    {
+        failures++;
+    }
+    for (i = 0;  i < 5;  i++)
+    {
+        ilbc_encode(&enc, out, silence, blockl);
+        ilbc_encode(&copy, out_ref, silence, blockl);
+        if (memcmp(out, out_ref, no_of_bytes))
+            failures++;
+    }
+    return report("Resampled encode", mode, failures);
+}
+
+/* DTX must code speech as frames, and silence as occasional SIDs, from
+   which the decoder makes quiet comfort noise */
+static int test_dtx(int mode)
+{
+    ilbc_encode_state_t enc;
+    ilbc_decode_state_t dec;
+    ilbc_decode_state_t *compact;
+    int16_t silence[ILBC_BLOCK_LEN_MAX];
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    uint8_t out[ILBC_NO_OF_BYTES_MAX];
+    int blockl;
+    int no_of_bytes;
+    int failures;
+    int frames;
+    int sids;
+    int gaps;
+    int len;
+    int i;
+    int j;
+
+    failures = 0;
+    ilbc_encode_init(&enc, mode);
+    ilbc_decode_init(&dec, mode, ILBC_ENHANCER_FULL);
+    blockl = enc.blockl;
+    no_of_bytes = enc.no_of_bytes;
+    memset(silence, 0, sizeof(silence));
+    frames = 0;
+    sids = 0;
+    gaps = 0;
+    for (i = 0;  i < 100 + SILENT_FRAMES;  i++)
+    {
+        len = ilbc_encode_dtx(&enc, out, (i < 100)  ?  speech + i*blockl  :  silence, blockl);
+        if (len == no_of_bytes)
+        {
+            frames++;
+            if (ilbc_decode(&dec, amp, out, len) != blockl)
+                failures++;
+            continue;
+        }
+        if (len == 0)
+        {
+            gaps++;
+            len = ilbc_decode_cng(&dec, amp, NULL, 0);
+        }
+        else
+        {
+            sids++;
+            len = ilbc_decode_cng(&dec, amp, out, len);
+        }
+        if (len != blockl)
+            failures++;
+        /* Comfort noise for digital silence must be very quiet */
+        if (i >= 100 + 10)
+        {
+            for (j = 0;  j < blockl;  j++)
+            {
+                if (abs(amp[j]) > 64)
+                    break;
+            }
+            if (j < blockl)
+                failures++;
+        }
+    }
+    /* The speech must not be lost, and the silence must not be sent in full */
+    if (frames < 90  ||  sids == 0  ||  gaps < SILENT_FRAMES/2)
+        failures++;
+    if (ilbc_encode_dtx(&enc, out, speech, blockl - 1) >= 0)
+        failures++;
+    /* A compact decoder has no room for comfort noise */
+    compact = ilbc_decode_alloc_compact(mode);
+    if (ilbc_decode_cng(compact, amp, NULL, 0) >= 0)
+        failures++;
+    ilbc_decode_free(compact);
+    return report("DTX and comfort noise", mode, failures);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in;
+    int failures;
+    int mode;
+
+    if ((in = fopen((argc > 1)  ?  argv[1]  :  IN_FILE_NAME, "rb")) == NULL)
+    {
+        fprintf(stderr, "Cannot open speech file %s\n", (argc > 1)  ?  argv[1]  :  IN_FILE_NAME);
+        exit(2);
+    }
+    speech_len = fread(speech, sizeof(int16_t), MAX_SAMPLES, in);
+    fclose(in);
+    if (speech_len < 100*ILBC_BLOCK_LEN_MAX)
+    {
+        fprintf(stderr, "Speech file is too short\n");
+        exit(2);
+    }
+
+    failures = 0;
+    for (mode = 20;  mode <= 30;  mode += 10)
+    {
+        failures += test_batch(mode);
+        failures += test_export_import(mode);
+        failures += test_rewind(mode);
+        failures += test_set_mode(mode);
+        failures += test_resampled(mode);
+        failures += test_dtx(mode);
+    }
+    if (failures)
+    {
+        printf("%d tests failed\n", failures);
+        return 1;
+    }
+    printf("Tests passed\n");
+    return 0;
+}
+/*- End of file ------------------------------------------------------------*/
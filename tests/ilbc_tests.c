@@ -54,6 +54,92 @@ will be compressed to iLBC data, decompressed, and the resulting audio stored in
 
 #define SAMPLE_RATE     8000
 
+#define MEMBER_SIZE(type, member) sizeof(((type *) 0)->member)
+
+/* Upper limits on the codec's memory use. The states are held to the sizes
+   of the original RFC3951 code (x86-64, and the decoder without the enhancer
+   for the compact one), plus the buffers of the features added since, plus
+   a little for their scalars and padding. Growth beyond that needs a reason,
+   and a new allowance here. */
+#define BASE_ENCODE_STATE       1376
+#define BASE_DECODE_STATE       4040
+#define BASE_DECODE_COMPACT     1444
+#define STATE_SLACK             (256 + ILBC_STATE_ALIGNMENT - 1)
+
+#define MAX_ENCODE_STATE        (BASE_ENCODE_STATE \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, stream_block) \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, resample_hist) \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, silence_frame) \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, lsfdeq_memo) \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, lsf_memo) \
+                                 + MEMBER_SIZE(ilbc_encode_state_t, stats) \
+                                 + STATE_SLACK)
+#define MAX_DECODE_STATE        (BASE_DECODE_STATE \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, stream_buf) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, resample_hist) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, cng_a) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, cng_mem) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, repeat_frame) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, repeat_block) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, lsfdeq_memo) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, stats) \
+                                 + STATE_SLACK)
+#define MAX_DECODE_COMPACT      (BASE_DECODE_COMPACT \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, lsfdeq_memo) \
+                                 + MEMBER_SIZE(ilbc_decode_state_t, stats) \
+                                 + STATE_SLACK)
+
+/* The scratch areas have no counterpart in the original code, which kept
+   all this on the stack. They are held a little above their present size,
+   so any growth is caught. The stack limits are looser, as they depend on
+   the compiler, and are only checked in a library built with
+   --enable-stack-watch. */
+#define MAX_ENCODE_SCRATCH      18700
+#define MAX_DECODE_SCRATCH      9400
+
+static const size_t max_stackTbl[ILBC_STACK_ENTRIES] =
+{
+    30000,      /* ilbc_encode */
+    30000,      /* ilbc_encode_ex */
+    80000,      /* ilbc_encode_batch */
+    20000,      /* ilbc_decode */
+    20000,      /* ilbc_decode_ex */
+    15000,      /* ilbc_fillin */
+    15000,      /* ilbc_fillin_ex */
+    45000       /* ilbc_decode_batch */
+};
+
+static int check_size(const char *name, size_t len, size_t max)
+{
+    printf("%-22s: %6lu bytes (limit %lu)\n", name, (unsigned long) len, (unsigned long) max);
+    if (len <= max)
+        return 0;
+    printf("    %s has grown beyond its limit\n", name);
+    return 1;
+}
+
+/* Check the state, scratch and stack sizes have not grown */
+static int check_memory(void)
+{
+    size_t marks[ILBC_STACK_ENTRIES];
+    int failed;
+    int i;
+
+    failed = 0;
+    failed += check_size("Encoder state", ilbc_encode_state_size(), MAX_ENCODE_STATE);
+    failed += check_size("Encoder scratch", ilbc_encode_scratch_size(), MAX_ENCODE_SCRATCH);
+    failed += check_size("Decoder state", ilbc_decode_state_size(), MAX_DECODE_STATE);
+    failed += check_size("Compact decoder state", ilbc_decode_compact_size(), MAX_DECODE_COMPACT);
+    failed += check_size("Decoder scratch", ilbc_decode_scratch_size(), MAX_DECODE_SCRATCH);
+    if (ilbc_stack_high_water(marks, 0) == 0)
+    {
+        /* Entry points this program does not call have marks of zero */
+        for (i = 0;  i < ILBC_STACK_ENTRIES;  i++)
+            failed += check_size(ilbc_stack_name(i), marks[i], max_stackTbl[i]);
+    }
+    return failed;
+}
+
 /*---------------------------------------------------------------*
  *  Main program to test iLBC encoding and decoding
  *
@@ -347,5 +433,7 @@ int main(int argc, char *argv[])
     fclose(ofileid);
     if (argc == 6)
         fclose(cfileid);
+    if (check_memory())
+        return(1);
     return(0);
 }
@@ -104,5 +104,14 @@ then
 fi
 echo ilbc_tests 30ms 5% loss completed OK
 
+./ilbc_api_tests ../localtests/iLBC.INP >$STDOUT_DEST 2>$STDERR_DEST
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo ilbc_api_tests failed!
+    exit $RETVAL
+fi
+echo ilbc_api_tests completed OK
+
 echo
 echo All regression tests successfully completed
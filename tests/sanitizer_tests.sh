@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# iLBC - a library for the iLBC codec
+#
+# sanitizer_tests.sh
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2, as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+
+# Build the library, in a tree of its own, with the address sanitizer, and
+# run the tests against it. The conformance check against the reference
+# output is left to regression_tests.sh. Run this from the tests directory
+# of a configured tree.
+
+SRCDIR=`cd .. && pwd`
+BUILDDIR=`pwd`/sanitizer_build
+
+rm -rf $BUILDDIR
+mkdir $BUILDDIR
+cd $BUILDDIR
+
+echo Building the library with the address sanitizer
+echo
+
+$SRCDIR/configure --enable-tests --disable-shared \
+    CFLAGS="-g -O1 -fsanitize=address -fno-omit-frame-pointer" \
+    LDFLAGS="-fsanitize=address" >/dev/null
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo configure failed!
+    exit $RETVAL
+fi
+make >/dev/null
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo make failed!
+    exit $RETVAL
+fi
+
+cd tests
+for MODE in 20 30
+do
+    ./ilbc_tests $MODE $SRCDIR/localtests/iLBC.INP tmp.BIT tmp.OUT $SRCDIR/localtests/tlm05.chn >/dev/null
+    RETVAL=$?
+    if [ $RETVAL != 0 ]
+    then
+        echo ilbc_tests ${MODE}ms failed!
+        exit $RETVAL
+    fi
+    echo ilbc_tests ${MODE}ms completed OK
+done
+
+./ilbc_api_tests $SRCDIR/localtests/iLBC.INP >/dev/null
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo ilbc_api_tests failed!
+    exit $RETVAL
+fi
+echo ilbc_api_tests completed OK
+
+echo
+echo All sanitizer tests successfully completed
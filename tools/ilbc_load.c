@@ -0,0 +1,1023 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_load.c - Run many channels of the iLBC low bit rate speech codec
+ *               at once, to find how many a machine can carry.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+/*! \page ilbc_load_page iLBC load generator
+\section ilbc_load_page_sec_1 What does it do?
+It simulates a media server carrying many iLBC channels. Every frame
+period (a tick) each channel encodes one frame, and decodes one frame, or
+conceals it if it was lost. The channels are shared among a number of
+threads, and each thread keeps its channels' states in memory it
+allocated itself, so on a NUMA machine they are local to it.
+
+The frames come from one of two places:
+
+    - speech, by default ../localtests/iLBC.INP. Each channel encodes the
+      speech, starting at its own place in it, and the frames it produces
+      are lost according to the loss model before they are decoded.
+    - RTP streams in a pcap capture, with -p. Each channel plays one of
+      the iLBC streams found in the capture, starting at its own place in
+      it, and the packets missing from the capture are lost. The decoded
+      speech is encoded again, as a transcoding leg would be. A loss
+      model may add more loss.
+
+The loss models are:
+
+    - none, the default.
+    - bernoulli:<p>, losing each frame with probability p.
+    - gilbert:<p>,<r>, a two state model which goes from receiving to
+      losing with probability p, and back with probability r, for bursts
+      of 1/r frames on average.
+    - a .chn file, like ../localtests/tlm05.chn, which every channel
+      follows, from its own starting point.
+
+By default the ticks are paced in real time. With -f they run back to back,
+to load the machine as heavily as possible.
+
+It reports, as JSON:
+
+    - the time each tick took, from its start until every thread had
+      finished its channels, at the 50th, 99th and 99.9th percentiles,
+      and the longest.
+    - how many ticks took longer than the frame period, and so would have
+      missed their deadline.
+    - the channels one core can sustain, which is the audio time carried
+      over the time the threads spent working.
+    - the fraction of frames which were lost.
+
+With -a <percent>, the encoders run under a governor, which keeps their
+time within that percentage of the threads' time by raising and lowering
+each channel's complexity level, and the number of channels left at each
+level is reported.
+
+With -g <limit>, the exit status is 1 if the 99.9th percentile tick time is
+over <limit> microseconds, or any tick missed its deadline, and 0
+otherwise, so it can be used as a pass or fail test.
+
+\section ilbc_load_page_sec_2 How is it used?
+ilbc_load [-m 20|30] [-c <channels>] [-j <threads>] [-s <seconds>] [-l <loss model>] [-p <pcap file>] [-n] [-f] [-a <percent>] [-g <limit>] [<speech file>]
+
+-m gives the frame size mode (default 30). -c gives the number of channels
+(default 1000), -j the number of threads (default one per processor), and
+-s how long to run, in seconds of audio (default 10). -n turns off the
+decoder's enhancer.
+
+Only classic pcap files are read, not pcapng, with Ethernet, Linux cooked,
+BSD loopback or raw IP framing, over IPv4 or IPv6. A UDP payload is taken
+as RTP if it has version 2 and its payload is a whole number of frames of
+the chosen mode. Each SSRC and destination port is a stream.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ilbc2.h"
+#include "ilbc_governor.h"
+
+#define IN_FILE_NAME            "../localtests/iLBC.INP"
+
+#define DEFAULT_MODE            30
+#define DEFAULT_CHANNELS        1000
+#define DEFAULT_SECONDS         10
+
+/* Channels start this many frames apart in their source, a prime, so
+   they are not all doing the same thing at once */
+#define CHANNEL_STAGGER         7919
+
+enum
+{
+    LOSS_NONE = 0,
+    LOSS_BERNOULLI,
+    LOSS_GILBERT,
+    LOSS_CHN
+};
+
+typedef struct
+{
+    int type;
+    double p;
+    double r;
+    int16_t *chn;
+    int chn_frames;
+} loss_model_t;
+
+/* A stream of frames, as captured. lost[i] is set for a frame which never
+   arrived. */
+typedef struct
+{
+    uint32_t ssrc;
+    uint16_t port;
+    int frames_per_packet;
+    int frames;
+    int room;
+    uint8_t *bits;
+    uint8_t *lost;
+    /* While reading the capture */
+    int packets;
+    int packet_room;
+    uint32_t *seq;
+    int *first_frame;
+} rtp_stream_t;
+
+typedef struct
+{
+    ilbc_encode_state_t *enc;
+    ilbc_decode_state_t *dec;
+    int gov_channel;
+    int pos;
+    int stream;
+    int bad_state;
+    uint32_t rand;
+} channel_t;
+
+typedef struct load_s load_t;
+
+typedef struct
+{
+    load_t *load;
+    int id;
+    int first_channel;
+    int channels;
+    channel_t *channel;
+    void *bank;
+    uint64_t busy_ns;
+    uint64_t frames;
+    uint64_t lost;
+    int failed;
+} load_thread_t;
+
+struct load_s
+{
+    int mode;
+    int blockl;
+    int no_of_bytes;
+    int enhance;
+    int channels;
+    int threads;
+    int ticks;
+    int tick;
+    int stop;
+    loss_model_t loss;
+
+    /* The encoders' governor, with -a */
+    ilbc_governor_t *gov;
+
+    /* Speech source */
+    int16_t *amp;
+    int frames;
+
+    /* Captured source */
+    rtp_stream_t *stream;
+    int streams;
+
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+    load_thread_t *thread;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x;
+    uint64_t y;
+
+    x = *(const uint64_t *) a;
+    y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void *read_file(const char *name, long *len)
+{
+    FILE *f;
+    void *buf;
+
+    if ((f = fopen(name, "rb")) == NULL)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (*len <= 0  ||  (buf = malloc(*len)) == NULL)
+    {
+        fclose(f);
+        return NULL;
+    }
+    *len = (long) fread(buf, 1, *len, f);
+    fclose(f);
+    return buf;
+}
+
+/*- Loss models ------------------------------------------------------------*/
+
+static int parse_loss_model(loss_model_t *m, const char *spec)
+{
+    long len;
+
+    memset(m, 0, sizeof(*m));
+    if (strcmp(spec, "none") == 0)
+    {
+        m->type = LOSS_NONE;
+        return 0;
+    }
+    if (strncmp(spec, "bernoulli:", 10) == 0)
+    {
+        m->type = LOSS_BERNOULLI;
+        m->p = atof(spec + 10);
+        return (m->p >= 0.0  &&  m->p <= 1.0)  ?  0  :  -1;
+    }
+    if (strncmp(spec, "gilbert:", 8) == 0)
+    {
+        m->type = LOSS_GILBERT;
+        if (sscanf(spec + 8, "%lf,%lf", &m->p, &m->r) != 2)
+            return -1;
+        return (m->p >= 0.0  &&  m->p <= 1.0  &&  m->r > 0.0  &&  m->r <= 1.0)  ?  0  :  -1;
+    }
+    m->type = LOSS_CHN;
+    if ((m->chn = (int16_t *) read_file(spec, &len)) == NULL)
+        return -1;
+    m->chn_frames = (int) (len/sizeof(int16_t));
+    return (m->chn_frames > 0)  ?  0  :  -1;
+}
+
+/* A cheap generator, with a state for each channel, so the threads never
+   share one */
+static double next_uniform(channel_t *ch)
+{
+    ch->rand ^= ch->rand << 13;
+    ch->rand ^= ch->rand >> 17;
+    ch->rand ^= ch->rand << 5;
+    return (ch->rand >> 8)*(1.0/16777216.0);
+}
+
+static int frame_lost(const loss_model_t *m, channel_t *ch, int frame)
+{
+    switch (m->type)
+    {
+    case LOSS_BERNOULLI:
+        return next_uniform(ch) < m->p;
+    case LOSS_GILBERT:
+        if (ch->bad_state)
+            ch->bad_state = (next_uniform(ch) >= m->r);
+        else
+            ch->bad_state = (next_uniform(ch) < m->p);
+        return ch->bad_state;
+    case LOSS_CHN:
+        return m->chn[frame%m->chn_frames] == 0;
+    }
+    return 0;
+}
+
+/*- Reading RTP from a pcap file -------------------------------------------*/
+
+static uint32_t get_u32(const uint8_t *p, int swap)
+{
+    if (swap)
+        return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+/* Find the UDP payload in a captured packet.
+   Returns the payload length, or -1 if this is not a UDP packet we can use. */
+static int udp_payload(const uint8_t *pkt, int len, int linktype, int swap, const uint8_t **payload, uint16_t *port)
+{
+    const uint8_t *p;
+    int ethertype;
+    int family;
+    int ihl;
+    int n;
+
+    p = pkt;
+    ethertype = -1;
+    switch (linktype)
+    {
+    case 0:
+        /* BSD loopback, with the address family in the capturing machine's order */
+        if (len < 4)
+            return -1;
+        family = (int) get_u32(p, swap);
+        ethertype = (family == 2)  ?  0x0800  :  ((family == 24  ||  family == 28  ||  family == 30)  ?  0x86DD  :  -1);
+        p += 4;
+        len -= 4;
+        break;
+    case 1:
+        /* Ethernet, perhaps with VLAN tags */
+        if (len < 14)
+            return -1;
+        ethertype = get_be16(p + 12);
+        p += 14;
+        len -= 14;
+        while ((ethertype == 0x8100  ||  ethertype == 0x88A8)  &&  len >= 4)
+        {
+            ethertype = get_be16(p + 2);
+            p += 4;
+            len -= 4;
+        }
+        break;
+    case 101:
+        /* Raw IP */
+        if (len < 1)
+            return -1;
+        ethertype = ((p[0] >> 4) == 6)  ?  0x86DD  :  0x0800;
+        break;
+    case 113:
+        /* Linux cooked */
+        if (len < 16)
+            return -1;
+        ethertype = get_be16(p + 14);
+        p += 16;
+        len -= 16;
+        break;
+    case 276:
+        /* Linux cooked, version 2 */
+        if (len < 20)
+            return -1;
+        ethertype = get_be16(p);
+        p += 20;
+        len -= 20;
+        break;
+    default:
+        return -1;
+    }
+    if (ethertype == 0x0800)
+    {
+        if (len < 20  ||  (p[0] >> 4) != 4)
+            return -1;
+        ihl = (p[0] & 0x0F)*4;
+        /* Only UDP, and only whole datagrams */
+        if (p[9] != 17  ||  (get_be16(p + 6) & 0x3FFF)  ||  len < ihl + 8)
+            return -1;
+        n = get_be16(p + 2);
+        if (n < len)
+            len = n;
+        p += ihl;
+        len -= ihl;
+    }
+    else if (ethertype == 0x86DD)
+    {
+        /* Extension headers are not followed */
+        if (len < 48  ||  (p[0] >> 4) != 6  ||  p[6] != 17)
+            return -1;
+        p += 40;
+        len -= 40;
+    }
+    else
+    {
+        return -1;
+    }
+    n = get_be16(p + 4);
+    if (n < 8  ||  n > len)
+        return -1;
+    *port = get_be16(p + 2);
+    *payload = p + 8;
+    return n - 8;
+}
+
+static rtp_stream_t *find_stream(load_t *load, uint32_t ssrc, uint16_t port)
+{
+    rtp_stream_t *st;
+    int i;
+
+    for (i = 0;  i < load->streams;  i++)
+    {
+        if (load->stream[i].ssrc == ssrc  &&  load->stream[i].port == port)
+            return &load->stream[i];
+    }
+    if ((st = (rtp_stream_t *) realloc(load->stream, (load->streams + 1)*sizeof(rtp_stream_t))) == NULL)
+        return NULL;
+    load->stream = st;
+    st = &load->stream[load->streams++];
+    memset(st, 0, sizeof(*st));
+    st->ssrc = ssrc;
+    st->port = port;
+    return st;
+}
+
+static int add_packet(load_t *load, rtp_stream_t *st, uint32_t seq, const uint8_t *payload, int frames)
+{
+    void *p;
+
+    if (st->packets >= st->packet_room)
+    {
+        st->packet_room = (st->packet_room)  ?  2*st->packet_room  :  256;
+        if ((p = realloc(st->seq, st->packet_room*sizeof(uint32_t))) == NULL)
+            return -1;
+        st->seq = (uint32_t *) p;
+        if ((p = realloc(st->first_frame, st->packet_room*sizeof(int))) == NULL)
+            return -1;
+        st->first_frame = (int *) p;
+    }
+    if (st->frames + frames > st->room)
+    {
+        st->room = 2*(st->frames + frames) + 256;
+        if ((p = realloc(st->bits, (size_t) st->room*load->no_of_bytes)) == NULL)
+            return -1;
+        st->bits = (uint8_t *) p;
+    }
+    /* Keep the sequence numbers unwrapped, relative to the last packet */
+    if (st->packets > 0)
+        seq = st->seq[st->packets - 1] + (int16_t) (seq - st->seq[st->packets - 1]);
+    else
+        seq += 0x10000;
+    if (st->frames_per_packet == 0)
+        st->frames_per_packet = frames;
+    st->seq[st->packets] = seq;
+    st->first_frame[st->packets] = st->frames;
+    memcpy(st->bits + (size_t) st->frames*load->no_of_bytes, payload, (size_t) frames*load->no_of_bytes);
+    st->frames += frames;
+    st->packets++;
+    return 0;
+}
+
+/* Put a stream's packets in sequence order, dropping duplicates, and mark
+   the frames of the missing packets as lost */
+static int order_stream(load_t *load, rtp_stream_t *st)
+{
+    uint8_t *bits;
+    uint8_t *lost;
+    uint32_t first;
+    uint32_t last;
+    int *slot;
+    int slots;
+    int frames;
+    int count;
+    int i;
+    int j;
+    int k;
+
+    first = st->seq[0];
+    last = st->seq[0];
+    for (i = 1;  i < st->packets;  i++)
+    {
+        if (st->seq[i] < first)
+            first = st->seq[i];
+        if (st->seq[i] > last)
+            last = st->seq[i];
+    }
+    slots = (int) (last - first + 1);
+    if ((slot = (int *) malloc(slots*sizeof(int))) == NULL)
+        return -1;
+    for (i = 0;  i < slots;  i++)
+        slot[i] = -1;
+    for (i = 0;  i < st->packets;  i++)
+        slot[st->seq[i] - first] = i;
+    frames = slots*st->frames_per_packet;
+    bits = (uint8_t *) malloc((size_t) frames*load->no_of_bytes);
+    lost = (uint8_t *) malloc(frames);
+    if (bits == NULL  ||  lost == NULL)
+    {
+        free(slot);
+        free(bits);
+        free(lost);
+        return -1;
+    }
+    frames = 0;
+    for (i = 0;  i < slots;  i++)
+    {
+        /* A missing packet, or a short one, leaves lost frames */
+        count = 0;
+        if ((k = slot[i]) >= 0)
+            count = ((k + 1 < st->packets)  ?  st->first_frame[k + 1]  :  st->frames) - st->first_frame[k];
+        for (j = 0;  j < st->frames_per_packet;  j++)
+        {
+            lost[frames] = (j >= count);
+            if (j < count)
+                memcpy(bits + (size_t) frames*load->no_of_bytes, st->bits + (size_t) (st->first_frame[k] + j)*load->no_of_bytes, load->no_of_bytes);
+            frames++;
+        }
+    }
+    free(slot);
+    free(st->bits);
+    free(st->seq);
+    free(st->first_frame);
+    st->seq = NULL;
+    st->first_frame = NULL;
+    st->bits = bits;
+    st->lost = lost;
+    st->frames = frames;
+    return 0;
+}
+
+static int read_pcap(load_t *load, const char *name)
+{
+    uint8_t *buf;
+    const uint8_t *p;
+    const uint8_t *end;
+    const uint8_t *payload;
+    rtp_stream_t *st;
+    uint32_t magic;
+    uint32_t incl_len;
+    uint16_t port;
+    long len;
+    int linktype;
+    int swap;
+    int n;
+    int hdr;
+    int other_mode;
+    int i;
+
+    if ((buf = (uint8_t *) read_file(name, &len)) == NULL  ||  len < 24)
+    {
+        free(buf);
+        return -1;
+    }
+    magic = get_u32(buf, 0);
+    if (magic == 0xA1B2C3D4  ||  magic == 0xA1B23C4D)
+        swap = 0;
+    else if (magic == 0xD4C3B2A1  ||  magic == 0x4D3CB2A1)
+        swap = 1;
+    else
+    {
+        fprintf(stderr, "'%s' is not a pcap file\n", name);
+        free(buf);
+        return -1;
+    }
+    linktype = (int) (get_u32(buf + 20, swap) & 0x0FFFFFFF);
+
+    other_mode = 0;
+    p = buf + 24;
+    end = buf + len;
+    while (p + 16 <= end)
+    {
+        incl_len = get_u32(p + 8, swap);
+        p += 16;
+        if (incl_len > (uint32_t) (end - p))
+            break;
+        n = udp_payload(p, (int) incl_len, linktype, swap, &payload, &port);
+        p += incl_len;
+        /* RTP version 2, with its CSRCs, extension and padding */
+        if (n < 12  ||  (payload[0] >> 6) != 2)
+            continue;
+        hdr = 12 + 4*(payload[0] & 0x0F);
+        if ((payload[0] & 0x10))
+        {
+            if (n < hdr + 4)
+                continue;
+            hdr += 4 + 4*get_be16(payload + hdr + 2);
+        }
+        if ((payload[0] & 0x20)  &&  n > hdr)
+            n -= payload[n - 1];
+        n -= hdr;
+        if (n <= 0)
+            continue;
+        if (n%load->no_of_bytes)
+        {
+            if (n%((load->mode == 20)  ?  ILBC_NO_OF_BYTES_30MS  :  ILBC_NO_OF_BYTES_20MS) == 0)
+                other_mode++;
+            continue;
+        }
+        if ((st = find_stream(load, get_u32(payload + 8, 0), port)) == NULL
+            ||
+            add_packet(load, st, get_be16(payload + 2), payload + hdr, n/load->no_of_bytes))
+        {
+            free(buf);
+            return -1;
+        }
+    }
+    free(buf);
+    if (other_mode)
+        fprintf(stderr, "Skipped %d packets which look like %dms iLBC\n", other_mode, (load->mode == 20)  ?  30  :  20);
+    for (i = 0;  i < load->streams;  i++)
+    {
+        if (order_stream(load, &load->stream[i]))
+            return -1;
+    }
+    return load->streams;
+}
+
+/*- The channels -----------------------------------------------------------*/
+
+static int setup_channels(load_thread_t *t)
+{
+    load_t *load;
+    channel_t *ch;
+    uint8_t *mem;
+    size_t enc_size;
+    size_t dec_size;
+    int i;
+    int c;
+
+    load = t->load;
+    enc_size = ilbc_encode_state_size();
+    dec_size = (load->enhance)  ?  ilbc_decode_state_size()  :  ilbc_decode_compact_size();
+    if ((t->channel = (channel_t *) calloc(t->channels, sizeof(channel_t))) == NULL)
+        return -1;
+    /* The states are allocated here, in this thread, so they are in memory
+       local to it */
+    if ((t->bank = ilbc_bank_alloc(t->channels*(enc_size + dec_size), ILBC_BANK_HUGE_PAGES)) == NULL)
+        return -1;
+    mem = (uint8_t *) t->bank;
+    for (i = 0;  i < t->channels;  i++)
+    {
+        ch = &t->channel[i];
+        c = t->first_channel + i;
+        ch->enc = ilbc_encode_init_at(mem, load->mode);
+        mem += enc_size;
+        if (load->enhance)
+            ch->dec = ilbc_decode_init_at(mem, load->mode, ILBC_ENHANCER_FULL);
+        else
+            ch->dec = ilbc_decode_init_compact_at(mem, load->mode);
+        mem += dec_size;
+        if (load->streams)
+        {
+            ch->stream = c%load->streams;
+            ch->pos = (int) (((int64_t) c*CHANNEL_STAGGER)%load->stream[ch->stream].frames);
+        }
+        else
+        {
+            ch->pos = (int) (((int64_t) c*CHANNEL_STAGGER)%load->frames);
+        }
+        ch->rand = 2463534242U ^ (uint32_t) (c*2654435761U);
+        if (ch->rand == 0)
+            ch->rand = 1;
+    }
+    return 0;
+}
+
+static void encode(load_t *load, channel_t *ch, uint8_t bytes[], const int16_t amp[])
+{
+    if (load->gov)
+        ilbc_governor_encode(load->gov, ch->gov_channel, bytes, amp, load->blockl);
+    else
+        ilbc_encode(ch->enc, bytes, amp, load->blockl);
+}
+
+static void run_tick(load_thread_t *t)
+{
+    load_t *load;
+    channel_t *ch;
+    const rtp_stream_t *st;
+    int16_t amp[ILBC_BLOCK_LEN_MAX];
+    uint8_t bytes[ILBC_NO_OF_BYTES_MAX];
+    int lost;
+    int i;
+
+    load = t->load;
+    for (i = 0;  i < t->channels;  i++)
+    {
+        ch = &t->channel[i];
+        if (load->streams)
+        {
+            /* Decode the captured stream, and encode it again */
+            st = &load->stream[ch->stream];
+            lost = st->lost[ch->pos]  ||  frame_lost(&load->loss, ch, ch->pos);
+            if (lost)
+                ilbc_fillin(ch->dec, amp, load->no_of_bytes);
+            else
+                ilbc_decode(ch->dec, amp, st->bits + (size_t) ch->pos*load->no_of_bytes, load->no_of_bytes);
+            encode(load, ch, bytes, amp);
+            if (++ch->pos >= st->frames)
+                ch->pos = 0;
+        }
+        else
+        {
+            /* Encode the speech, lose some frames, and decode the rest */
+            encode(load, ch, bytes, load->amp + (size_t) ch->pos*load->blockl);
+            lost = frame_lost(&load->loss, ch, ch->pos);
+            if (lost)
+                ilbc_fillin(ch->dec, amp, load->no_of_bytes);
+            else
+                ilbc_decode(ch->dec, amp, bytes, load->no_of_bytes);
+            if (++ch->pos >= load->frames)
+                ch->pos = 0;
+        }
+        t->frames++;
+        t->lost += lost;
+    }
+}
+
+static void *load_thread(void *arg)
+{
+    load_thread_t *t;
+    load_t *load;
+    uint64_t t0;
+
+    t = (load_thread_t *) arg;
+    load = t->load;
+    t->failed = setup_channels(t);
+    pthread_barrier_wait(&load->done);
+    for (;;)
+    {
+        pthread_barrier_wait(&load->start);
+        if (load->stop)
+            break;
+        t0 = now_ns();
+        run_tick(t);
+        t->busy_ns += now_ns() - t0;
+        pthread_barrier_wait(&load->done);
+    }
+    return NULL;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-m 20|30] [-c <channels>] [-j <threads>] [-s <seconds>] [-l <loss model>] [-p <pcap file>] [-n] [-f] [-a <percent>] [-g <limit>] [<speech file>]\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    load_t load;
+    pthread_t *threads;
+    uint64_t *tick_ns;
+    uint64_t period_ns;
+    uint64_t start;
+    uint64_t t0;
+    uint64_t busy_ns;
+    uint64_t frames;
+    uint64_t lost;
+    struct timespec ts;
+    const char *in_file_name;
+    const char *pcap_file_name;
+    const char *loss_spec;
+    double seconds;
+    double channels_per_core;
+    double limit_us;
+    double gov_percent;
+    long len;
+    int levels[ILBC_COMPLEXITY_LOWEST + 1];
+    int flat_out;
+    int missed;
+    int started;
+    int failed;
+    int opt;
+    int i;
+    int j;
+
+    memset(&load, 0, sizeof(load));
+    load.mode = DEFAULT_MODE;
+    load.enhance = 1;
+    load.channels = DEFAULT_CHANNELS;
+    load.threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    seconds = DEFAULT_SECONDS;
+    loss_spec = "none";
+    pcap_file_name = NULL;
+    flat_out = 0;
+    limit_us = -1.0;
+    gov_percent = 0.0;
+    while ((opt = getopt(argc, argv, "a:c:fg:j:l:m:np:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            if ((gov_percent = atof(optarg)) <= 0.0)
+            {
+                fprintf(stderr, "Bad encoder budget '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'c':
+            if ((load.channels = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "Bad channel count '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'f':
+            flat_out = 1;
+            break;
+        case 'g':
+            limit_us = atof(optarg);
+            break;
+        case 'j':
+            if ((load.threads = atoi(optarg)) < 1)
+            {
+                fprintf(stderr, "Bad thread count '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'l':
+            loss_spec = optarg;
+            break;
+        case 'm':
+            load.mode = atoi(optarg);
+            if (load.mode != 20  &&  load.mode != 30)
+            {
+                fprintf(stderr, "Bad mode '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'n':
+            load.enhance = 0;
+            break;
+        case 'p':
+            pcap_file_name = optarg;
+            break;
+        case 's':
+            if ((seconds = atof(optarg)) <= 0.0)
+            {
+                fprintf(stderr, "Bad duration '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind < argc - 1)
+        usage(argv[0]);
+    in_file_name = (optind < argc)  ?  argv[optind]  :  IN_FILE_NAME;
+    load.blockl = (load.mode == 20)  ?  ILBC_BLOCK_LEN_20MS  :  ILBC_BLOCK_LEN_30MS;
+    load.no_of_bytes = (load.mode == 20)  ?  ILBC_NO_OF_BYTES_20MS  :  ILBC_NO_OF_BYTES_30MS;
+    load.ticks = (int) ceil(seconds*1000.0/load.mode);
+    if (parse_loss_model(&load.loss, loss_spec))
+    {
+        fprintf(stderr, "Bad loss model '%s'\n", loss_spec);
+        exit(2);
+    }
+
+    if (pcap_file_name)
+    {
+        if (read_pcap(&load, pcap_file_name) <= 0)
+        {
+            fprintf(stderr, "No %dms iLBC RTP streams in '%s'\n", load.mode, pcap_file_name);
+            exit(2);
+        }
+    }
+    else
+    {
+        if ((load.amp = (int16_t *) read_file(in_file_name, &len)) == NULL)
+        {
+            fprintf(stderr, "Cannot read speech file '%s'\n", in_file_name);
+            exit(2);
+        }
+        if ((load.frames = (int) (len/sizeof(int16_t))/load.blockl) < 1)
+        {
+            fprintf(stderr, "Speech file '%s' is shorter than a frame\n", in_file_name);
+            exit(2);
+        }
+    }
+
+    if (load.threads > load.channels)
+        load.threads = load.channels;
+    threads = (pthread_t *) malloc(load.threads*sizeof(pthread_t));
+    load.thread = (load_thread_t *) calloc(load.threads, sizeof(load_thread_t));
+    tick_ns = (uint64_t *) malloc(load.ticks*sizeof(uint64_t));
+    if (threads == NULL  ||  load.thread == NULL  ||  tick_ns == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    pthread_barrier_init(&load.start, NULL, load.threads + 1);
+    pthread_barrier_init(&load.done, NULL, load.threads + 1);
+    for (i = 0;  i < load.threads;  i++)
+    {
+        load.thread[i].load = &load;
+        load.thread[i].id = i;
+        load.thread[i].first_channel = (int) ((int64_t) load.channels*i/load.threads);
+        load.thread[i].channels = (int) ((int64_t) load.channels*(i + 1)/load.threads) - load.thread[i].first_channel;
+    }
+    for (started = 0;  started < load.threads;  started++)
+    {
+        if (pthread_create(&threads[started], NULL, load_thread, &load.thread[started]))
+        {
+            fprintf(stderr, "Cannot start thread %d\n", started);
+            exit(2);
+        }
+    }
+    /* Wait for every thread to set up its channels */
+    pthread_barrier_wait(&load.done);
+    failed = 0;
+    for (i = 0;  i < load.threads;  i++)
+        failed |= load.thread[i].failed;
+
+    period_ns = (uint64_t) load.mode*1000000;
+    if (gov_percent > 0.0  &&  !failed)
+    {
+        if ((load.gov = ilbc_governor_create(load.channels, (uint64_t) (gov_percent/100.0*load.threads*period_ns))) == NULL)
+        {
+            fprintf(stderr, "Cannot create the governor\n");
+            exit(2);
+        }
+        for (i = 0;  i < load.threads;  i++)
+        {
+            for (j = 0;  j < load.thread[i].channels;  j++)
+                load.thread[i].channel[j].gov_channel = ilbc_governor_add_channel(load.gov, load.thread[i].channel[j].enc, 0);
+        }
+    }
+    missed = 0;
+    start = now_ns();
+    for (load.tick = 0;  !failed  &&  load.tick < load.ticks;  load.tick++)
+    {
+        if (!flat_out)
+        {
+            t0 = start + load.tick*period_ns;
+            ts.tv_sec = (time_t) (t0/1000000000);
+            ts.tv_nsec = (long) (t0%1000000000);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        t0 = now_ns();
+        pthread_barrier_wait(&load.start);
+        pthread_barrier_wait(&load.done);
+        tick_ns[load.tick] = now_ns() - t0;
+        if (tick_ns[load.tick] > period_ns)
+            missed++;
+        if (load.gov)
+            ilbc_governor_tick(load.gov);
+    }
+    load.stop = 1;
+    pthread_barrier_wait(&load.start);
+    for (i = 0;  i < started;  i++)
+        pthread_join(threads[i], NULL);
+    if (failed)
+    {
+        fprintf(stderr, "Out of memory for the channels\n");
+        exit(2);
+    }
+
+    busy_ns = 0;
+    frames = 0;
+    lost = 0;
+    memset(levels, 0, sizeof(levels));
+    for (i = 0;  i < load.threads;  i++)
+    {
+        busy_ns += load.thread[i].busy_ns;
+        frames += load.thread[i].frames;
+        lost += load.thread[i].lost;
+        for (j = 0;  j < load.thread[i].channels;  j++)
+            levels[load.thread[i].channel[j].enc->complexity]++;
+        free(load.thread[i].channel);
+        ilbc_bank_free(load.thread[i].bank);
+    }
+    qsort(tick_ns, load.ticks, sizeof(tick_ns[0]), cmp_u64);
+    /* Audio time carried, over the time spent carrying it */
+    channels_per_core = (busy_ns)  ?  (double) frames*period_ns/busy_ns  :  0.0;
+
+    printf("{\n");
+    printf("    \"mode\": %d,\n", load.mode);
+    printf("    \"channels\": %d,\n", load.channels);
+    printf("    \"threads\": %d,\n", load.threads);
+    printf("    \"source\": \"%s\",\n", (pcap_file_name)  ?  pcap_file_name  :  in_file_name);
+    if (pcap_file_name)
+        printf("    \"streams\": %d,\n", load.streams);
+    printf("    \"loss_model\": \"%s\",\n", loss_spec);
+    printf("    \"paced\": %s,\n", (flat_out)  ?  "false"  :  "true");
+    printf("    \"ticks\": %d,\n", load.ticks);
+    printf("    \"tick_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f},\n",
+           tick_ns[load.ticks/2]/1000.0,
+           tick_ns[(int) ((int64_t) load.ticks*99/100)]/1000.0,
+           tick_ns[(int) ((int64_t) load.ticks*999/1000)]/1000.0,
+           tick_ns[load.ticks - 1]/1000.0);
+    printf("    \"missed_deadlines\": %d,\n", missed);
+    printf("    \"channels_per_core\": %.1f,\n", channels_per_core);
+    printf("    \"loss_rate\": %.4f,\n", (frames)  ?  (double) lost/frames  :  0.0);
+    if (load.gov)
+    {
+        printf("    \"encoder_budget_percent\": %.1f,\n", gov_percent);
+        printf("    \"complexity_levels\": [");
+        for (i = 0;  i <= ILBC_COMPLEXITY_LOWEST;  i++)
+            printf("%s%d", (i)  ?  ", "  :  "", levels[i]);
+        printf("],\n");
+    }
+    printf("    \"cpu_tier\": \"%s\"\n", ilbc_cpu_tier_name(ilbc_cpu_tier()));
+    printf("}\n");
+
+    failed = (limit_us >= 0.0  &&  (missed > 0  ||  tick_ns[(int) ((int64_t) load.ticks*999/1000)]/1000.0 > limit_us));
+    pthread_barrier_destroy(&load.start);
+    pthread_barrier_destroy(&load.done);
+    for (i = 0;  i < load.streams;  i++)
+    {
+        free(load.stream[i].bits);
+        free(load.stream[i].lost);
+    }
+    free(load.stream);
+    free(load.loss.chn);
+    ilbc_governor_free(load.gov);
+    free(load.amp);
+    free(tick_ns);
+    free(load.thread);
+    free(threads);
+    return (failed)  ?  1  :  0;
+}
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,463 @@
+/*
+ * iLBC - a library for the iLBC codec
+ *
+ * ilbc_transcode.c - Encode or decode many files with the iLBC low bit
+ *                    rate speech codec.
+ *
+ * All Rights Reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/*! \file */
+
+/*! \page ilbc_transcode_page iLBC batch transcoder
+\section ilbc_transcode_page_sec_1 What does it do?
+It encodes speech files to iLBC, or decodes iLBC files to speech, a whole
+file at a time. Each input file is mapped into memory, and the output file
+is created at its final size and mapped too, so the codec reads and writes
+the files directly, with no per frame system calls. The files are shared
+among a pool of threads, one per processor by default.
+
+Speech is 16 bit 8000 samples/second mono, either raw, in the machine's
+byte order, or a WAV file. A WAV file is recognised by its header, rather
+than by its name, and is only understood on a little endian machine.
+When decoding, a WAV file is written if the output file name ends in
+".wav". iLBC files are raw frames, one after another, with no header.
+
+When encoding, a final part frame is padded with silence. When decoding,
+a final part frame is ignored.
+
+\section ilbc_transcode_page_sec_2 How is it used?
+ilbc_transcode -e|-d [-m 20|30] [-j <threads>] [-n] <infile> <outfile> [<infile> <outfile> ...]
+
+-e encodes, -d decodes. -m gives the frame size mode (default 30). -n turns
+off the decoder's enhancer. The exit status is 0 if every file was
+transcoded, and 1 if any failed.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ilbc2.h"
+
+#define DEFAULT_MODE            30
+
+#define WAV_HEADER_LEN          44
+
+typedef struct
+{
+    int decode;
+    int mode;
+    int enhance;
+    char **names;
+    int files;
+    int next;
+    int failures;
+    pthread_mutex_t report_lock;
+} job_list_t;
+
+/* A mapped file. The mapping may be longer than the data, if the data
+   starts after a header. */
+typedef struct
+{
+    int fd;
+    uint8_t *map;
+    size_t map_len;
+    uint8_t *data;
+    size_t len;
+} mapped_file_t;
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void put_le32(uint8_t *p, uint32_t x)
+{
+    p[0] = (uint8_t) x;
+    p[1] = (uint8_t) (x >> 8);
+    p[2] = (uint8_t) (x >> 16);
+    p[3] = (uint8_t) (x >> 24);
+}
+
+static void put_le16(uint8_t *p, uint16_t x)
+{
+    p[0] = (uint8_t) x;
+    p[1] = (uint8_t) (x >> 8);
+}
+
+static void write_wav_header(uint8_t *p, uint32_t data_len)
+{
+    memcpy(p, "RIFF", 4);
+    put_le32(p + 4, 36 + data_len);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    put_le32(p + 16, 16);
+    put_le16(p + 20, 1);
+    put_le16(p + 22, 1);
+    put_le32(p + 24, 8000);
+    put_le32(p + 28, 8000*sizeof(int16_t));
+    put_le16(p + 32, sizeof(int16_t));
+    put_le16(p + 34, 16);
+    memcpy(p + 36, "data", 4);
+    put_le32(p + 40, data_len);
+}
+
+/* Find the samples in a WAV file. Returns 1 if the data is a suitable WAV
+   file, 0 if it is not a WAV file at all, and -1 if it is a WAV file we
+   cannot use. */
+static int find_wav_data(mapped_file_t *f)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t chunk_len;
+    int have_fmt;
+
+    if (f->len < 12  ||  memcmp(f->data, "RIFF", 4)  ||  memcmp(f->data + 8, "WAVE", 4))
+        return 0;
+    have_fmt = 0;
+    p = f->data + 12;
+    end = f->data + f->len;
+    while (end - p >= 8)
+    {
+        chunk_len = get_le32(p + 4);
+        if (memcmp(p, "fmt ", 4) == 0)
+        {
+            if (chunk_len < 16  ||  (size_t) (end - p - 8) < chunk_len)
+                return -1;
+            /* Only 16 bit 8000 samples/second mono PCM will do */
+            if (get_le16(p + 8) != 1  ||  get_le16(p + 10) != 1  ||  get_le32(p + 12) != 8000  ||  get_le16(p + 22) != 16)
+                return -1;
+            have_fmt = 1;
+        }
+        else if (memcmp(p, "data", 4) == 0)
+        {
+            if (!have_fmt)
+                return -1;
+            f->data = (uint8_t *) p + 8;
+            f->len = ((size_t) (end - p - 8) < chunk_len)  ?  (size_t) (end - p - 8)  :  chunk_len;
+            return 1;
+        }
+        /* Chunks are padded to an even length */
+        if ((size_t) (end - p - 8) < chunk_len + (chunk_len & 1))
+            break;
+        p += 8 + chunk_len + (chunk_len & 1);
+    }
+    return -1;
+}
+
+static int map_input(mapped_file_t *f, const char *name)
+{
+    struct stat st;
+
+    memset(f, 0, sizeof(*f));
+    if ((f->fd = open(name, O_RDONLY)) < 0)
+        return -1;
+    if (fstat(f->fd, &st) < 0)
+    {
+        close(f->fd);
+        return -1;
+    }
+    f->map_len = (size_t) st.st_size;
+    if (f->map_len > 0)
+    {
+        f->map = (uint8_t *) mmap(NULL, f->map_len, PROT_READ, MAP_PRIVATE, f->fd, 0);
+        if (f->map == MAP_FAILED)
+        {
+            close(f->fd);
+            return -1;
+        }
+        /* The codec reads the file from start to end, just once */
+        madvise(f->map, f->map_len, MADV_SEQUENTIAL);
+    }
+    f->data = f->map;
+    f->len = f->map_len;
+    return 0;
+}
+
+/* Create a file of its final size, and map it for writing */
+static int map_output(mapped_file_t *f, const char *name, size_t len)
+{
+    memset(f, 0, sizeof(*f));
+    if ((f->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0)
+        return -1;
+    if (ftruncate(f->fd, (off_t) len) < 0)
+    {
+        close(f->fd);
+        return -1;
+    }
+    f->map_len = len;
+    if (len > 0)
+    {
+        f->map = (uint8_t *) mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+        if (f->map == MAP_FAILED)
+        {
+            close(f->fd);
+            return -1;
+        }
+    }
+    f->data = f->map;
+    f->len = len;
+    return 0;
+}
+
+static int unmap_file(mapped_file_t *f)
+{
+    int ret;
+
+    ret = 0;
+    if (f->map_len > 0  &&  munmap(f->map, f->map_len) < 0)
+        ret = -1;
+    if (close(f->fd) < 0)
+        ret = -1;
+    return ret;
+}
+
+static int has_suffix(const char *name, const char *suffix)
+{
+    size_t n;
+    size_t m;
+
+    n = strlen(name);
+    m = strlen(suffix);
+    return n >= m  &&  strcasecmp(name + n - m, suffix) == 0;
+}
+
+static const char *encode_file(const char *in_name, const char *out_name, int mode)
+{
+    ilbc_encode_state_t *enc;
+    mapped_file_t in;
+    mapped_file_t out;
+    int16_t last[ILBC_BLOCK_LEN_MAX];
+    const int16_t *amp;
+    size_t samples;
+    size_t frames;
+    size_t whole;
+    int blockl;
+    int no_of_bytes;
+    const char *err;
+
+    if (map_input(&in, in_name) < 0)
+        return strerror(errno);
+    if (find_wav_data(&in) < 0)
+    {
+        unmap_file(&in);
+        return "not a 16 bit 8000 samples/second mono WAV file";
+    }
+    if ((enc = ilbc_encode_alloc(mode)) == NULL)
+    {
+        unmap_file(&in);
+        return "out of memory";
+    }
+    blockl = enc->blockl;
+    no_of_bytes = enc->no_of_bytes;
+    samples = in.len/sizeof(int16_t);
+    whole = samples/blockl;
+    frames = (samples + blockl - 1)/blockl;
+    if ((size_t) (int) (whole*blockl) != whole*blockl)
+    {
+        ilbc_encode_free(enc);
+        unmap_file(&in);
+        return "file too long";
+    }
+    err = NULL;
+    if (map_output(&out, out_name, frames*no_of_bytes) < 0)
+    {
+        err = strerror(errno);
+    }
+    else
+    {
+        amp = (const int16_t *) in.data;
+        ilbc_encode(enc, out.data, amp, (int) (whole*blockl));
+        if (frames > whole)
+        {
+            /* Pad the last part frame with silence */
+            memset(last, 0, sizeof(last));
+            memcpy(last, amp + whole*blockl, (samples - whole*blockl)*sizeof(int16_t));
+            ilbc_encode(enc, out.data + whole*no_of_bytes, last, blockl);
+        }
+        if (unmap_file(&out) < 0)
+            err = strerror(errno);
+    }
+    ilbc_encode_free(enc);
+    unmap_file(&in);
+    return err;
+}
+
+static const char *decode_file(const char *in_name, const char *out_name, int mode, int enhance)
+{
+    ilbc_decode_state_t *dec;
+    mapped_file_t in;
+    mapped_file_t out;
+    size_t frames;
+    size_t header_len;
+    size_t data_len;
+    int blockl;
+    int no_of_bytes;
+    const char *err;
+
+    if (map_input(&in, in_name) < 0)
+        return strerror(errno);
+    if ((dec = ilbc_decode_alloc(mode, enhance)) == NULL)
+    {
+        unmap_file(&in);
+        return "out of memory";
+    }
+    blockl = dec->blockl;
+    no_of_bytes = dec->no_of_bytes;
+    frames = in.len/no_of_bytes;
+    data_len = frames*blockl*sizeof(int16_t);
+    header_len = (has_suffix(out_name, ".wav"))  ?  WAV_HEADER_LEN  :  0;
+    if ((size_t) (int) (frames*no_of_bytes) != frames*no_of_bytes  ||  (header_len  &&  data_len > 0xFFFFFFFFU - 36))
+    {
+        ilbc_decode_free(dec);
+        unmap_file(&in);
+        return "file too long";
+    }
+    err = NULL;
+    if (map_output(&out, out_name, header_len + data_len) < 0)
+    {
+        err = strerror(errno);
+    }
+    else
+    {
+        if (header_len)
+            write_wav_header(out.data, (uint32_t) data_len);
+        ilbc_decode(dec, (int16_t *) (out.data + header_len), in.data, (int) (frames*no_of_bytes));
+        if (unmap_file(&out) < 0)
+            err = strerror(errno);
+    }
+    ilbc_decode_free(dec);
+    unmap_file(&in);
+    return err;
+}
+
+static void *worker(void *arg)
+{
+    job_list_t *jobs;
+    const char *err;
+    int i;
+
+    jobs = (job_list_t *) arg;
+    while ((i = __atomic_fetch_add(&jobs->next, 1, __ATOMIC_RELAXED)) < jobs->files)
+    {
+        if (jobs->decode)
+            err = decode_file(jobs->names[2*i], jobs->names[2*i + 1], jobs->mode, jobs->enhance);
+        else
+            err = encode_file(jobs->names[2*i], jobs->names[2*i + 1], jobs->mode);
+        if (err)
+        {
+            pthread_mutex_lock(&jobs->report_lock);
+            fprintf(stderr, "%s: %s\n", jobs->names[2*i], err);
+            jobs->failures++;
+            pthread_mutex_unlock(&jobs->report_lock);
+        }
+    }
+    return NULL;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s -e|-d [-m 20|30] [-j <threads>] [-n] <infile> <outfile> [<infile> <outfile> ...]\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    job_list_t jobs;
+    pthread_t *threads;
+    int direction;
+    int workers;
+    int started;
+    int opt;
+    int i;
+
+    jobs.mode = DEFAULT_MODE;
+    jobs.enhance = 1;
+    direction = -1;
+    workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "edm:j:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            direction = 0;
+            break;
+        case 'd':
+            direction = 1;
+            break;
+        case 'm':
+            jobs.mode = atoi(optarg);
+            if (jobs.mode != 20  &&  jobs.mode != 30)
+            {
+                fprintf(stderr, "Bad mode '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            if (workers < 1)
+            {
+                fprintf(stderr, "Bad thread count '%s'\n", optarg);
+                exit(2);
+            }
+            break;
+        case 'n':
+            jobs.enhance = 0;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (direction < 0  ||  optind >= argc  ||  ((argc - optind) & 1))
+        usage(argv[0]);
+    jobs.decode = direction;
+    jobs.names = argv + optind;
+    jobs.files = (argc - optind)/2;
+    jobs.next = 0;
+    jobs.failures = 0;
+    pthread_mutex_init(&jobs.report_lock, NULL);
+
+    if (workers < 1)
+        workers = 1;
+    if (workers > jobs.files)
+        workers = jobs.files;
+    if ((threads = (pthread_t *) malloc(workers*sizeof(pthread_t))) == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(2);
+    }
+    /* This thread works too, so it needs one fewer helper */
+    for (started = 0;  started < workers - 1;  started++)
+    {
+        if (pthread_create(&threads[started], NULL, worker, &jobs))
+            break;
+    }
+    worker(&jobs);
+    for (i = 0;  i < started;  i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&jobs.report_lock);
+    return (jobs.failures)  ?  1  :  0;
+}
+/*- End of file ------------------------------------------------------------*/